@@ -39,9 +39,21 @@ uint CompareAndSet(uint volatile *ptr, uint const comparand, uint const value)
 __forceinline
 bool CompareAndSet64(uint64_t volatile *data, uint64_t *comparand, uint64_t *value)
 {
-	return 1 == ::InterlockedCompareExchange64((long long volatile*)data, *(long long*)value, *(long long*)comparand);
+	// exchange returns the prior value - we won if it was what we expected
+	long long expected = *(long long*)comparand;
+	return expected == ::InterlockedCompareExchange64((long long volatile*)data, *(long long*)value, expected);
 }
 
+#if defined(_WIN64)
+//--------------------------------------------------------------------
+// data must be 16 byte aligned.  On failure comparand is updated to the current value.
+__forceinline
+bool CompareAndSet128(uint64_t volatile *data, uint64_t *comparand, uint64_t const *value)
+{
+	return 1 == ::InterlockedCompareExchange128((long long volatile*)data, (long long)value[1], (long long)value[0], (long long*)comparand);
+}
+#endif
+
 
 //--------------------------------------------------------------------
 template <typename T>
@@ -1,5 +1,12 @@
 #include "Engine/Core/BlockAllocator.hpp"
 #include "Engine/Core/ThreadSafeQueue.hpp"
+#include "Engine/Core/Time.hpp"
+#include "Engine/Core/Logging.hpp"
+#include "Engine/Core/CriticalSection.hpp"
+#include <atomic>
+#include <limits.h>
+#include <vector>
+#include <algorithm>
 
 
 
@@ -13,6 +20,9 @@ public:
 static int const BLOCK_SIZE = 1024;
 static uint const NUM_QUEUES = 8;
 
+// blocks each benchmark thread keeps on hand, so frees are not just alloc-free pairs
+static uint const HELD_BLOCK_COUNT = 64;
+
 static SystemAllocator gSystemAllocator;
 static BlockAllocator gBlockAllocator(BLOCK_SIZE);
 static ThreadSafeBlockAllocator gTSBlockAllocator(BLOCK_SIZE);
@@ -20,6 +30,62 @@ static LocklessBlockAllocator gLFBlockAllocator(BLOCK_SIZE);
 
 static ThreadSafeQueue<void*> gQueues[NUM_QUEUES];
 
+static std::atomic<uint> gNextThreadIndex(0);
+
+// not handed out yet, and handed back while the thread is exiting
+static uint const THREAD_INDEX_NONE = UINT_MAX;
+static uint const THREAD_INDEX_EXITED = UINT_MAX - 1;
+static thread_local uint tThreadIndex = THREAD_INDEX_NONE;
+
+// Every live lockless allocator and the indices of threads that have exited.
+// Reached through a function so allocators constructed statically in other
+// files can register before this file's statics exist.
+struct thread_index_registry_t
+{
+	CriticalSection lock;
+	std::vector<LocklessBlockAllocator*> allocators;
+	std::vector<uint> free_indices;
+};
+
+static thread_index_registry_t* GetThreadIndexRegistry()
+{
+	static thread_index_registry_t registry;
+	return &registry;
+}
+
+// Its destructor is what notices the thread exiting
+class ThreadIndexOwner
+{
+public:
+	ThreadIndexOwner()
+		: index(THREAD_INDEX_NONE)
+	{
+	}
+
+	~ThreadIndexOwner()
+	{
+		if (THREAD_INDEX_NONE == index) {
+			return;
+		}
+
+		thread_index_registry_t *registry = GetThreadIndexRegistry();
+		SCOPE_LOCK(&registry->lock);
+		if (index < LOCKLESS_MAX_THREADS) {
+			for (LocklessBlockAllocator *allocator : registry->allocators) {
+				allocator->flush_thread(index);
+			}
+		}
+		registry->free_indices.push_back(index);
+
+		// anything freed after this goes straight to the shared list
+		tThreadIndex = THREAD_INDEX_EXITED;
+	}
+
+public:
+	uint index;
+};
+static thread_local ThreadIndexOwner tThreadIndexOwner;
+
 // static uint AddBytes(void *ptr)
 // {
 // 	uint v = 0;
@@ -30,4 +96,190 @@ static ThreadSafeQueue<void*> gQueues[NUM_QUEUES];
 // 	}
 // 
 // 	return v;
-// }
\ No newline at end of file
+// }
+
+//------------------------------------------------------------------------
+uint BlockAllocatorGetThreadIndex()
+{
+	if (THREAD_INDEX_NONE == tThreadIndex) {
+		thread_index_registry_t *registry = GetThreadIndexRegistry();
+		{
+			SCOPE_LOCK(&registry->lock);
+			if (!registry->free_indices.empty()) {
+				tThreadIndex = registry->free_indices.back();
+				registry->free_indices.pop_back();
+			}
+		}
+
+		if (THREAD_INDEX_NONE == tThreadIndex) {
+			tThreadIndex = gNextThreadIndex.fetch_add(1);
+		}
+
+		// first use constructs it, which is what gets its destructor run at thread exit
+		tThreadIndexOwner.index = tThreadIndex;
+	}
+
+	return tThreadIndex;
+}
+
+//------------------------------------------------------------------------
+void BlockAllocatorRegister(LocklessBlockAllocator *allocator)
+{
+	thread_index_registry_t *registry = GetThreadIndexRegistry();
+	SCOPE_LOCK(&registry->lock);
+	registry->allocators.push_back(allocator);
+}
+
+//------------------------------------------------------------------------
+void BlockAllocatorUnregister(LocklessBlockAllocator *allocator)
+{
+	thread_index_registry_t *registry = GetThreadIndexRegistry();
+	SCOPE_LOCK(&registry->lock);
+	std::vector<LocklessBlockAllocator*> &allocators = registry->allocators;
+	allocators.erase(std::remove(allocators.begin(), allocators.end(), allocator), allocators.end());
+}
+
+//------------------------------------------------------------------------
+// Stamp the ends of a block with its own address so a block handed out
+// twice, or scribbled on while free, shows up when it is checked.
+static uint64_t const BLOCK_STAMP = 0xb10cb10cb10cb10cULL;
+
+static void StampBlock(void *ptr)
+{
+	uint64_t stamp = BLOCK_STAMP ^ (uint64_t)(uintptr_t)ptr;
+	byte_t *bytes = (byte_t*)ptr;
+	memcpy(bytes, &stamp, sizeof(stamp));
+	memcpy(bytes + BLOCK_SIZE - sizeof(stamp), &stamp, sizeof(stamp));
+}
+
+static void CheckAndClearBlock(void *ptr)
+{
+	uint64_t stamp = BLOCK_STAMP ^ (uint64_t)(uintptr_t)ptr;
+	byte_t *bytes = (byte_t*)ptr;
+	if ((0 != memcmp(bytes, &stamp, sizeof(stamp))) 
+		|| (0 != memcmp(bytes + BLOCK_SIZE - sizeof(stamp), &stamp, sizeof(stamp)))) {
+		__debugbreak();
+	}
+
+	memset(bytes, 0, sizeof(stamp));
+	memset(bytes + BLOCK_SIZE - sizeof(stamp), 0, sizeof(stamp));
+}
+
+//------------------------------------------------------------------------
+struct allocator_stress_t
+{
+	IAllocator *allocator;
+	uint index;
+	uint op_count;
+};
+
+// Each thread keeps a few blocks of its own and passes others to its
+// neighbour through the queues, so a good share of frees happen on a
+// different thread than the alloc.
+static void AllocatorStressThread(allocator_stress_t *stress)
+{
+	IAllocator *allocator = stress->allocator;
+	ThreadSafeQueue<void*> *outbox = &gQueues[(stress->index + 1) % NUM_QUEUES];
+	ThreadSafeQueue<void*> *inbox = &gQueues[stress->index % NUM_QUEUES];
+
+	void *held[HELD_BLOCK_COUNT];
+	memset(held, 0, sizeof(held));
+
+	for (uint i = 0; i < stress->op_count; ++i) {
+		void *ptr = allocator->alloc(BLOCK_SIZE);
+		StampBlock(ptr);
+
+		uint slot = (i * 7) % HELD_BLOCK_COUNT;
+		if (0 == (i & 1)) {
+			if (nullptr != held[slot]) {
+				CheckAndClearBlock(held[slot]);
+				allocator->free(held[slot]);
+			}
+			held[slot] = ptr;
+		}
+		else {
+			outbox->push(ptr);
+		}
+
+		void *incoming = nullptr;
+		if (inbox->pop(&incoming)) {
+			CheckAndClearBlock(incoming);
+			allocator->free(incoming);
+		}
+	}
+
+	for (uint i = 0; i < HELD_BLOCK_COUNT; ++i) {
+		if (nullptr != held[i]) {
+			CheckAndClearBlock(held[i]);
+			allocator->free(held[i]);
+		}
+	}
+}
+
+//------------------------------------------------------------------------
+static double RunAllocatorStress(IAllocator *allocator, uint thread_count, uint op_count)
+{
+	allocator_stress_t *stress = new allocator_stress_t[thread_count];
+	thread_handle *threads = new thread_handle[thread_count];
+
+	uint64_t start = TimeGetOpCount();
+	for (uint i = 0; i < thread_count; ++i) {
+		stress[i].allocator = allocator;
+		stress[i].index = i;
+		stress[i].op_count = op_count;
+		threads[i] = ThreadCreate(AllocatorStressThread, &stress[i]);
+	}
+
+	for (uint i = 0; i < thread_count; ++i) {
+		ThreadJoin(threads[i]);
+	}
+
+	// whatever is still in flight between threads
+	for (uint i = 0; i < NUM_QUEUES; ++i) {
+		void *ptr = nullptr;
+		while (gQueues[i].pop(&ptr)) {
+			CheckAndClearBlock(ptr);
+			allocator->free(ptr);
+		}
+	}
+
+	double ms = TimeOpCountTo_ms(TimeGetOpCount() - start);
+
+	delete[] threads;
+	delete[] stress;
+	return ms;
+}
+
+//------------------------------------------------------------------------
+void BlockAllocatorBenchmark(uint thread_count, uint op_count)
+{
+	struct allocator_entry_t
+	{
+		char const *name;
+		IAllocator *allocator;
+	};
+
+	allocator_entry_t entries[] = {
+		{ "malloc", &gSystemAllocator },
+		{ "locked", &gTSBlockAllocator },
+		{ "lockless", &gLFBlockAllocator },
+	};
+
+	uint total_ops = thread_count * op_count;
+	for (allocator_entry_t const &entry : entries) {
+		double ms = RunAllocatorStress(entry.allocator, thread_count, op_count);
+		double ops_per_second = (ms > 0.0) ? ((double)total_ops * 1000.0 / ms) : 0.0;
+		LogPrint("BlockAllocatorBenchmark [%s]: %u threads x %u allocs in %.2f ms (%.0f allocs/sec)",
+			entry.name, thread_count, op_count, ms, ops_per_second);
+	}
+
+	block_allocator_stats_t stats;
+	gLFBlockAllocator.get_stats(&stats);
+	LogPrint("BlockAllocatorBenchmark [lockless]: %u slabs, %u blocks, %u live, %u magazine allocs, %u shared allocs, %u shared frees",
+		stats.slab_count, stats.block_capacity, stats.live_blocks, stats.magazine_allocs, stats.shared_allocs, stats.shared_frees);
+
+	// everything came back, so nothing should be live
+	if (0 != stats.live_blocks) {
+		__debugbreak();
+	}
+}
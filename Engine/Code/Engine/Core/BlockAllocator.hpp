@@ -2,6 +2,8 @@
 #include "Engine/Core/CriticalSection.hpp"
 #include "Engine/Core/Atomic.hpp"
 #include <stdio.h>
+#include <malloc.h>
+#include <string.h>
 
 
 typedef unsigned int uint;
@@ -166,51 +168,116 @@ public:
 	CriticalSection lock;
 };
 
+// blocks cached per thread before half are flushed back to the shared list
+uint const LOCKLESS_MAGAZINE_SIZE = 32;
+
+// threads alive at once past this many skip the magazines and go straight to the shared list
+uint const LOCKLESS_MAX_THREADS = 64;
+
+// default backing allocation, carved into blocks
+size_t const LOCKLESS_SLAB_SIZE = 64 * 1024;
+
+class LocklessBlockAllocator;
+
+// Small per-process index for the calling thread, handed out on first use.  When
+// the thread exits its magazine in every lockless allocator is flushed back to
+// the shared list and the index goes to the next new thread.
+uint BlockAllocatorGetThreadIndex();
+void BlockAllocatorRegister(LocklessBlockAllocator *allocator);
+void BlockAllocatorUnregister(LocklessBlockAllocator *allocator);
+
+struct block_allocator_stats_t
+{
+	size_t block_size;
+	uint slab_count;
+	uint block_capacity;   // blocks carved from slabs so far
+	uint live_blocks;      // handed out and not yet freed
+	uint magazine_allocs;  // allocs served from a thread's magazine
+	uint shared_allocs;    // blocks pulled from the shared list
+	uint shared_frees;     // blocks pushed back to the shared list
+};
+
 #pragma warning(push)
 #pragma warning(disable: 4201)
 #pragma warning(disable: 4324)
 
 //--------------------------------------------------------------------
 //--------------------------------------------------------------------
+// Lock-free pool.  The shared free list is a stack whose head is a
+// pointer + ABA counter pair swapped with a double width CAS.  Blocks
+// come from slabs that live as long as the allocator, so reading next
+// off a block another thread just popped is always safe - the tag makes
+// the CAS fail instead.  Each thread keeps a small magazine in front of
+// the shared list so the common case touches no shared memory at all.
 class LocklessBlockAllocator : public IAllocator
 {
-	// on 32-bit, this is a 64-bit structure
-	// on 64-bit, this is a 128-bit structure
-	// Both these have an CAS instruction associated with them
-
 	struct block_t
 	{
 		block_t *next;
 	};
 
-	union __declspec(align(16)) node_t
+	struct slab_t
+	{
+		slab_t *next;
+	};
+
+	// pointer + tag, swapped as a single unit (128-bit on x64, 64-bit on Win32)
+#if defined(_WIN64)
+	struct __declspec(align(16)) node_t
+#else
+	struct __declspec(align(8)) node_t
+#endif
 	{
-		struct {
-			block_t *next;
-			uintptr_t aba; // useing a uintptr_t so it is the same size as a pointer
-		};
-		struct {
-			// for 32-bit you'd only need one 64-bit value
-			uint64_t data[2];
-		};
+		block_t *next;
+		uintptr_t aba;
 	};
 
+	// only ever touched by the owning thread, padded so neighbours don't share a line
+	struct magazine_t
+	{
+		block_t *head;
+		uint count;
+		uint alloc_count;
+		uint free_count;
+		uint refill_count;
+		char pad[64 - sizeof(block_t*) - (4 * sizeof(uint))];
+	};
 
 public:
-	LocklessBlockAllocator(size_t bs)
+	LocklessBlockAllocator(size_t bs, size_t slab_bytes = LOCKLESS_SLAB_SIZE)
 	{
 		head.next = nullptr;
 		head.aba = 0;
+		slabs = nullptr;
 
-		// first difference is that we add
-		// our block size to the requested block size, as
-		// we are no longer allowed to "reuse" the memory
-		block_size = Max(bs, sizeof(block_t));
-		alloc_count = 0;
+		// keep blocks 16 byte aligned so anything with aligned_storage can live in them
+		block_size = (Max(bs, sizeof(block_t)) + 15) & ~(size_t)15;
+
+		slab_header_size = 64;
+		slab_size = Max(slab_bytes, slab_header_size + (block_size * LOCKLESS_MAGAZINE_SIZE));
+		blocks_per_slab = (uint)((slab_size - slab_header_size) / block_size);
+
+		slab_count = 0;
+		block_capacity = 0;
+		shared_alloc_count = 0;
+		shared_free_count = 0;
+		unowned_alloc_count = 0;
+		unowned_free_count = 0;
+
+		memset(magazines, 0, sizeof(magazines));
+		BlockAllocatorRegister(this);
 	}
 
 	~LocklessBlockAllocator()
 	{
+		BlockAllocatorUnregister(this);
+
+		slab_t *slab = slabs;
+		while (nullptr != slab) {
+			slab_t *next = slab->next;
+			::_aligned_free(slab);
+			slab = next;
+		}
 	}
 
 	void* alloc(size_t size)
@@ -219,72 +286,253 @@ public:
 			return nullptr;
 		}
 
-		void *ptr = nullptr;
+		magazine_t *mag = get_magazine();
+		if (nullptr == mag) {
+			AtomicIncrement(&unowned_alloc_count);
+			return alloc_shared();
+		}
+
+		if (0 == mag->count) {
+			refill(mag);
+			if (0 == mag->count) {
+				return nullptr;
+			}
+		}
+
+		block_t *block = mag->head;
+		mag->head = block->next;
+		--mag->count;
+		++mag->alloc_count;
+		return block;
+	}
+
+	void free(void *ptr)
+	{
+		if (nullptr == ptr) {
+			return;
+		}
+
+		block_t *block = (block_t*)ptr;
+
+		magazine_t *mag = get_magazine();
+		if (nullptr == mag) {
+			AtomicIncrement(&unowned_free_count);
+			push_shared(block, block, 1);
+			return;
+		}
+
+		block->next = mag->head;
+		mag->head = block;
+		++mag->count;
+		++mag->free_count;
+
+		if (mag->count >= LOCKLESS_MAGAZINE_SIZE) {
+			flush(mag, LOCKLESS_MAGAZINE_SIZE / 2);
+		}
+	}
+
+	// Only from the thread that owns index, as it exits
+	void flush_thread(uint index)
+	{
+		magazine_t *mag = &magazines[index];
+		if (0 != mag->count) {
+			flush(mag, mag->count);
+		}
+	}
+
+	// approximate while other threads are running
+	void get_stats(block_allocator_stats_t *out) const
+	{
+		out->block_size = block_size;
+		out->slab_count = slab_count;
+		out->block_capacity = block_capacity;
+		out->shared_allocs = shared_alloc_count;
+		out->shared_frees = shared_free_count;
+		out->magazine_allocs = 0;
+
+		uint allocs = unowned_alloc_count;
+		uint frees = unowned_free_count;
+		for (uint i = 0; i < LOCKLESS_MAX_THREADS; ++i) {
+			allocs += magazines[i].alloc_count;
+			frees += magazines[i].free_count;
+			out->magazine_allocs += magazines[i].alloc_count;
+		}
+
+		out->live_blocks = allocs - frees;
+	}
+
+private:
+	inline magazine_t* get_magazine()
+	{
+		uint index = BlockAllocatorGetThreadIndex();
+		return (index < LOCKLESS_MAX_THREADS) ? &magazines[index] : nullptr;
+	}
+
+	//--------------------------------------------------------------------
+	static bool swap_head(node_t volatile *dst, node_t *comparand, node_t const *value)
+	{
+#if defined(_WIN64)
+		return CompareAndSet128((uint64_t volatile*)dst, (uint64_t*)comparand, (uint64_t const*)value);
+#else
+		return CompareAndSet64((uint64_t volatile*)dst, (uint64_t*)comparand, (uint64_t*)value);
+#endif
+	}
+
+	//--------------------------------------------------------------------
+	block_t* pop_shared()
+	{
+		node_t cur_head;
+		cur_head.aba = head.aba;
+		cur_head.next = head.next;
 
-		/** lockfree free **/
 		while (true) {
-			node_t cur_head = head;
 			block_t *top = cur_head.next;
-
-			// list was empty when we checked
 			if (nullptr == top) {
-				InterlockedIncrement((LONG*)&alloc_count);
-				ptr = ::malloc(block_size);
-				return ptr;
+				return nullptr;
 			}
 
-			ptr = top;
-
+			// top may be popped and reused under us - then the tag will have moved on
 			node_t new_head;
-			new_head.aba = cur_head.aba + 1;
 			new_head.next = top->next;
+			new_head.aba = cur_head.aba + 1;
 
-			// ABA problem occurs here.
-			// free_list == top, but top->next isn't free_list->next by the time
-			// it runs - so may cause corruption
-			if (CompareAndSet64(head.data, cur_head.data, new_head.data)) {
-				return ptr;
+			if (swap_head(&head, &cur_head, &new_head)) {
+				AtomicIncrement(&shared_alloc_count);
+				return top;
 			}
+
+#if !defined(_WIN64)
+			cur_head.aba = head.aba;
+			cur_head.next = head.next;
+#endif
 		}
 	}
 
-	void free(void *ptr)
+	//--------------------------------------------------------------------
+	// pushes an already linked chain [first..last] in one swap
+	void push_shared(block_t *first, block_t *last, uint count)
 	{
-		if (nullptr == ptr) {
-			return;
-		}
-
-		block_t *node = (block_t*)ptr;
+		node_t cur_head;
+		cur_head.aba = head.aba;
+		cur_head.next = head.next;
 
 		while (true) {
-			node_t cur_head = head;
+			last->next = cur_head.next;
 
-			node->next = cur_head.next;
 			node_t new_head;
+			new_head.next = first;
 			new_head.aba = cur_head.aba + 1;
-			new_head.next = node;
 
-			if (CompareAndSet64(head.data, cur_head.data, new_head.data)) {
-				break;
+			if (swap_head(&head, &cur_head, &new_head)) {
+				AtomicAdd(&shared_free_count, count);
+				return;
 			}
+
+#if !defined(_WIN64)
+			cur_head.aba = head.aba;
+			cur_head.next = head.next;
+#endif
 		}
 	}
 
+	//--------------------------------------------------------------------
+	// one block for the caller, the rest of a fresh slab goes to the shared list
+	block_t* carve_slab()
+	{
+		byte_t *memory = (byte_t*)::_aligned_malloc(slab_size, 64);
+		if (nullptr == memory) {
+			return nullptr;
+		}
+
+		slab_t *slab = (slab_t*)memory;
+		slab_t *cur_slabs = slabs;
+		while (true) {
+			slab->next = cur_slabs;
+			slab_t *prev = CompareAndSetPointer(&slabs, cur_slabs, slab);
+			if (prev == cur_slabs) {
+				break;
+			}
+			cur_slabs = prev;
+		}
 
+		byte_t *first = memory + slab_header_size;
+		for (uint i = 0; i < (blocks_per_slab - 1); ++i) {
+			((block_t*)(first + (i * block_size)))->next = (block_t*)(first + ((i + 1) * block_size));
+		}
 
+		AtomicIncrement(&slab_count);
+		AtomicAdd(&block_capacity, blocks_per_slab);
 
-public:
-	// head MUST be 128 byte aligned;
-	node_t head;           // now a full node - we'll be replacing BOTH piece at once
-	size_t block_size;      // List of free blocks;
+		block_t *mine = (block_t*)first;
+		if (blocks_per_slab > 1) {
+			block_t *rest = (block_t*)(first + block_size);
+			block_t *last = (block_t*)(first + ((blocks_per_slab - 1) * block_size));
+			push_shared(rest, last, 0);
+		}
 
-	uint alloc_count;
-};
+		return mine;
+	}
+
+	//--------------------------------------------------------------------
+	block_t* alloc_shared()
+	{
+		block_t *block = pop_shared();
+		if (nullptr == block) {
+			block = carve_slab();
+		}
 
+		return block;
+	}
 
+	//--------------------------------------------------------------------
+	void refill(magazine_t *mag)
+	{
+		++mag->refill_count;
+		for (uint i = 0; i < (LOCKLESS_MAGAZINE_SIZE / 2); ++i) {
+			block_t *block = alloc_shared();
+			if (nullptr == block) {
+				return;
+			}
 
+			block->next = mag->head;
+			mag->head = block;
+			++mag->count;
+		}
+	}
 
+	//--------------------------------------------------------------------
+	void flush(magazine_t *mag, uint count)
+	{
+		block_t *first = mag->head;
+		block_t *last = first;
+		for (uint i = 1; i < count; ++i) {
+			last = last->next;
+		}
+
+		mag->head = last->next;
+		mag->count -= count;
+		push_shared(first, last, count);
+	}
 
+public:
+	// head MUST be aligned to its own size for the double width CAS
+	node_t head;
+	size_t block_size;
+	size_t slab_size;
+	size_t slab_header_size;
+	uint blocks_per_slab;
+	slab_t *volatile slabs;
+
+	uint slab_count;
+	uint block_capacity;
+	uint shared_alloc_count;
+	uint shared_free_count;
+	uint unowned_alloc_count;
+	uint unowned_free_count;
+
+	magazine_t magazines[LOCKLESS_MAX_THREADS];
+};
 
+void BlockAllocatorBenchmark(uint thread_count, uint op_count);
 
-#pragma warning(pop)
\ No newline at end of file
+#pragma warning(pop)
@@ -5,19 +5,23 @@
 #include "Engine/Core/Time.hpp"
 #include "Engine/Core/Logging.hpp"
 #include "Engine/Core/CriticalSection.hpp"
+#include "Engine/Core/Atomic.hpp"
 #include <sstream>
 #include <vector>
 #include <algorithm>
+#include <atomic>
 
 
-static uint g_allocCount = 0;
-static uint g_frameAllocs = 0;
-static uint g_frameFrees = 0;
-static size_t g_allocatedByteCount = 0;
+// all constant initialised - operator new runs before any static constructor
+static std::atomic<uint> g_allocCount(0);
+static std::atomic<uint> g_frameAllocs(0);
+static std::atomic<uint> g_frameFrees(0);
+static std::atomic<size_t> g_allocatedByteCount(0);
 static uint g_highWater = 0;
-static callstack_list* g_callstackHead = nullptr;
 static bool g_wasReportRun = false;
-static CriticalSection g_memoryLocker;
+static bool g_symbolsLoaded = false;
+
+static std::atomic<uint> g_sampleRate(1);
 
 
 
@@ -29,10 +33,366 @@ uint GetHighwaterAllocation()
 	return g_highWater;
 }
 
+//------------------------------------------------------------------------
+static std::string MemoryBytesToString(long long bytes)
+{
+	double reported = (double)bytes;
+	char const *unit = "B";
+
+	long long magnitude = (bytes < 0) ? -bytes : bytes;
+	if (magnitude > (2LL * 1024LL * 1024LL * 1024LL)) {
+		reported /= (1024.0 * 1024.0 * 1024.0);
+		unit = "GiB";
+	}
+	else if (magnitude > (2LL * 1024LL * 1024LL)) {
+		reported /= (1024.0 * 1024.0);
+		unit = "MiB";
+	}
+	else if (magnitude > (2LL * 1024LL)) {
+		reported /= 1024.0;
+		unit = "KiB";
+	}
+
+	char buffer[64];
+	sprintf_s(buffer, 64, "%0.3f %s", reported, unit);
+	return buffer;
+}
+
+#if defined (TRACK_MEMORY)
+	#if (TRACK_MEMORY == TRACK_MEMORY_VERBOSE)
+
+//------------------------------------------------------------------------
+// Verbose Tracking
+//
+// Callsites live in a fixed open addressed table keyed by callstack hash,
+// slots are never removed so an index stays valid for the whole run.  Each
+// thread caches hash -> index and batches its count deltas, so the shared
+// lock is only taken for a new callsite or once every MEMORY_BATCH_SIZE
+// tracked allocations.
+//------------------------------------------------------------------------
+static uint const MEMORY_THREAD_CACHE_SIZE = 256;
+static uint const MEMORY_MAX_PROBES = 64;
+
+struct alloc_callsite_t
+{
+	CallStack *callstack;   // null while the slot is free
+	long long live_count;
+	long long live_bytes;
+	unsigned long long total_count;
+	unsigned long long total_bytes;
+};
+
+struct alloc_delta_t
+{
+	uint callsite;
+	int count;
+	long long bytes;
+};
+
+struct alloc_batch_t
+{
+	std::atomic<bool> lock;
+	uint count;
+	alloc_delta_t deltas[MEMORY_BATCH_SIZE];
+	alloc_batch_t *next;
+};
+
+struct alloc_cache_entry_t
+{
+	uint32_t hash;
+	uint callsite;          // 0 (never a real callsite) when empty
+};
+
+struct memory_snapshot_entry_t
+{
+	long long live_count;
+	long long live_bytes;
+};
+
+struct memory_snapshot_t
+{
+	uint id;
+	double time;
+	memory_snapshot_entry_t *entries;
+};
+
+// CriticalSection needs its constructor to have run, this doesn't
+static std::atomic<bool> g_memoryLock(false);
+static alloc_callsite_t *g_callsites = nullptr;
+static uint g_callsiteCount = 0;
+static alloc_batch_t *volatile g_allocBatches = nullptr;
+
+static thread_local alloc_cache_entry_t t_callsiteCache[MEMORY_THREAD_CACHE_SIZE];
+static thread_local alloc_batch_t *t_allocBatch = nullptr;
+static thread_local uint32_t t_sampleState = 0;
+
+static memory_snapshot_t g_snapshots[MEMORY_SNAPSHOT_COUNT];
+static uint g_nextSnapshotId = 1;
+
+//------------------------------------------------------------------------
+class MemorySpinLock
+{
+public:
+	MemorySpinLock(std::atomic<bool> &lock)
+		: m_lock(lock)
+	{
+		while (m_lock.exchange(true, std::memory_order_acquire)) {
+			ThreadYield();
+		}
+	}
+
+	~MemorySpinLock()
+	{
+		m_lock.store(false, std::memory_order_release);
+	}
+
+private:
+	std::atomic<bool> &m_lock;
+};
+
+//------------------------------------------------------------------------
+// Must hold g_memoryLock.  Untracked so it can run from inside operator new.
+static alloc_callsite_t* MemoryGetCallsitesLocked()
+{
+	if (nullptr == g_callsites) {
+		g_callsites = (alloc_callsite_t*) ::calloc(MEMORY_CALLSITE_CAPACITY, sizeof(alloc_callsite_t));
+	}
+
+	return g_callsites;
+}
+
+//------------------------------------------------------------------------
+static void MemoryApplyDeltasLocked(alloc_delta_t const *deltas, uint count)
+{
+	alloc_callsite_t *callsites = MemoryGetCallsitesLocked();
+	for (uint i = 0; i < count; ++i) {
+		alloc_delta_t const &delta = deltas[i];
+		alloc_callsite_t &site = callsites[delta.callsite];
+		site.live_count += delta.count;
+		site.live_bytes += delta.bytes;
+
+		if (delta.count > 0) {
+			site.total_count += delta.count;
+			site.total_bytes += delta.bytes;
+		}
+	}
+}
+
+//------------------------------------------------------------------------
+static alloc_batch_t* MemoryGetThreadBatch()
+{
+	alloc_batch_t *batch = t_allocBatch;
+	if (nullptr != batch) {
+		return batch;
+	}
+
+	// batches outlive their thread so pending deltas are never lost
+	batch = (alloc_batch_t*) ::malloc(sizeof(alloc_batch_t));
+	batch->lock = false;
+	batch->count = 0;
+
+	alloc_batch_t *head = g_allocBatches;
+	while (true) {
+		batch->next = head;
+		alloc_batch_t *prev = CompareAndSetPointer(&g_allocBatches, head, batch);
+		if (prev == head) {
+			break;
+		}
+		head = prev;
+	}
+
+	t_allocBatch = batch;
+	return batch;
+}
+
+//------------------------------------------------------------------------
+static void MemoryRecordDelta(uint callsite, int count, long long bytes)
+{
+	alloc_batch_t *batch = MemoryGetThreadBatch();
+	MemorySpinLock batch_lock(batch->lock);
+
+	// runs of the same callsite fold into one entry
+	if (batch->count > 0) {
+		alloc_delta_t &last = batch->deltas[batch->count - 1];
+		if ((last.callsite == callsite) && ((last.count > 0) == (count > 0))) {
+			last.count += count;
+			last.bytes += bytes;
+			return;
+		}
+	}
+
+	if (MEMORY_BATCH_SIZE == batch->count) {
+		MemorySpinLock table_lock(g_memoryLock);
+		MemoryApplyDeltasLocked(batch->deltas, batch->count);
+		batch->count = 0;
+	}
+
+	alloc_delta_t &delta = batch->deltas[batch->count++];
+	delta.callsite = callsite;
+	delta.count = count;
+	delta.bytes = bytes;
+}
+
+//------------------------------------------------------------------------
+static void MemoryFlushAllBatches()
+{
+	alloc_batch_t *batch = g_allocBatches;
+	while (nullptr != batch) {
+		MemorySpinLock batch_lock(batch->lock);
+		MemorySpinLock table_lock(g_memoryLock);
+		MemoryApplyDeltasLocked(batch->deltas, batch->count);
+		batch->count = 0;
+
+		batch = batch->next;
+	}
+}
+
+//------------------------------------------------------------------------
+static uint MemoryFindCallsite(void* const *frames, uint frame_count, uint32_t hash)
+{
+	alloc_cache_entry_t &cached = t_callsiteCache[hash & (MEMORY_THREAD_CACHE_SIZE - 1)];
+	if ((0 != cached.callsite) && (cached.hash == hash)) {
+		return cached.callsite;
+	}
+
+	uint callsite = MEMORY_CALLSITE_OVERFLOW;
+	{
+		MemorySpinLock lock(g_memoryLock);
+		alloc_callsite_t *callsites = MemoryGetCallsitesLocked();
+
+		// 0 and 1 are reserved
+		uint const range = MEMORY_CALLSITE_CAPACITY - 2;
+		uint const start = (hash * 2654435761U) % range;
+		for (uint probe = 0; probe < MEMORY_MAX_PROBES; ++probe) {
+			uint index = 2 + ((start + probe) % range);
+			alloc_callsite_t &site = callsites[index];
+
+			if (nullptr == site.callstack) {
+				site.callstack = CreateCallstackFromFrames(frames, frame_count, hash);
+				++g_callsiteCount;
+				callsite = index;
+				break;
+			}
+
+			if (site.callstack->m_hash == hash) {
+				callsite = index;
+				break;
+			}
+		}
+	}
+
+	cached.hash = hash;
+	cached.callsite = callsite;
+	return callsite;
+}
+
+//------------------------------------------------------------------------
+// Sampled allocations count as sample_rate allocations so the table stays an
+// unbiased estimate.  Random rather than every Nth to avoid aliasing with
+// code that allocates in fixed patterns.
+static void MemoryTrackAlloc(allocation_t *header)
+{
+	uint const rate = g_sampleRate.load(std::memory_order_relaxed);
+	if (rate > 1) {
+		uint32_t state = t_sampleState;
+		if (0 == state) {
+			state = (uint32_t)(uintptr_t)&t_sampleState | 1;
+		}
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		t_sampleState = state;
+
+		if (0 != (state % rate)) {
+			return;
+		}
+	}
+
+	void *frames[MEMORY_CALLSTACK_DEPTH];
+	uint32_t hash = 0;
+	uint frame_count = CallstackCapture(frames, MEMORY_CALLSTACK_DEPTH, 1, &hash);
+
+	header->callsite = MemoryFindCallsite(frames, frame_count, hash);
+	header->weight = rate;
+	MemoryRecordDelta(header->callsite, (int)rate, (long long)header->byte_size * rate);
+}
+
+//------------------------------------------------------------------------
+static void MemoryTrackFree(allocation_t const *header)
+{
+	if (MEMORY_CALLSITE_UNSAMPLED == header->callsite) {
+		return;
+	}
+
+	MemoryRecordDelta(header->callsite, -(int)header->weight, -((long long)header->byte_size * header->weight));
+}
+
+//------------------------------------------------------------------------
+static CallStack* MemoryGetCallstack(uint callsite)
+{
+	MemorySpinLock lock(g_memoryLock);
+	return MemoryGetCallsitesLocked()[callsite].callstack;
+}
+
+//------------------------------------------------------------------------
+static void MemoryLogCallstack(uint callsite)
+{
+	if (MEMORY_CALLSITE_OVERFLOW == callsite) {
+		LogTaggedPrintf("stack", "     <callsite table full>\n");
+		return;
+	}
+
+	CallStack *cs = MemoryGetCallstack(callsite);
+	if (nullptr == cs) {
+		return;
+	}
+
+	if (!g_symbolsLoaded) {
+		g_symbolsLoaded = CallstackSystemInit();
+	}
+
+	char line_buffer[512];
+	if (!g_symbolsLoaded) {
+		for (uint i = 0; i < cs->m_frameCount; ++i) {
+			sprintf_s(line_buffer, 512, "     0x%p\n", cs->m_frames[i]);
+			LogTaggedPrintf("stack", "%s", line_buffer);
+		}
+		return;
+	}
+
+	// this specific format will make it double click-able in an output window
+	// taking you to the offending line.
+	callstack_line_t lines[MEMORY_CALLSTACK_DEPTH];
+	uint line_count = CallstackGetLines(lines, MEMORY_CALLSTACK_DEPTH, cs);
+	for (uint i = 0; i < line_count; ++i) {
+		sprintf_s(line_buffer, 512, "     %s(%u): %s\n", lines[i].filename, lines[i].line, lines[i].function_name);
+		LogTaggedPrintf("stack", "%s", line_buffer);
+	}
+}
+
+//------------------------------------------------------------------------
+static bool MemoryStatsSort(memory_callsite_stats_t const &a, memory_callsite_stats_t const &b)
+{
+	return a.live_bytes > b.live_bytes;
+}
+
+//------------------------------------------------------------------------
+static memory_snapshot_t* MemoryFindSnapshot(uint id)
+{
+	memory_snapshot_t *snapshot = &g_snapshots[id % MEMORY_SNAPSHOT_COUNT];
+	if ((0 == id) || (snapshot->id != id)) {
+		return nullptr;
+	}
+
+	return snapshot;
+}
+
+	#endif
+#endif
+
 #if defined (TRACK_MEMORY)
 void* operator new(size_t const size)
 {
-	SCOPE_LOCK(&g_memoryLocker);
 	++g_allocCount;
 	++g_frameAllocs;
 	g_allocatedByteCount += size;
@@ -40,38 +400,12 @@ void* operator new(size_t const size)
 	size_t alloc_size = size + sizeof(allocation_t);
 	allocation_t *ptr = (allocation_t*)malloc(alloc_size);
 	ptr->byte_size = size;
+	ptr->callsite = MEMORY_CALLSITE_UNSAMPLED;
+	ptr->weight = 0;
 
 	//Verbose
 	#if (TRACK_MEMORY == TRACK_MEMORY_VERBOSE)
-		ptr->callstack_node.currentVal = CreateCallstack(0);
-		ptr->callstack_node.total_allocation = size;
-		ptr->callstack_node.next = nullptr;
-
-		bool run = true;
-		callstack_list* currentNode = nullptr;
-		while (g_callstackHead != nullptr && run)
-		{
-			if (currentNode == nullptr)
-			{
-				currentNode = g_callstackHead;
-			}
-
-			if (currentNode->next != nullptr)
-			{
-				currentNode = currentNode->next;
-			}
-			else
-			{
-				currentNode->next = &ptr->callstack_node;
-				run = false;
-			}
-
-		}
-
-		if (g_callstackHead == nullptr)
-		{
-			g_callstackHead = &ptr->callstack_node;
-		}
+		MemoryTrackAlloc(ptr);
 	#endif
 
 	return ptr + 1;
@@ -84,8 +418,6 @@ void operator delete(void *ptr)
 	if (nullptr == ptr)
 		return;
 
-	SCOPE_LOCK(&g_memoryLocker);
-
 	--g_allocCount;
 	++g_frameFrees;
 
@@ -95,35 +427,7 @@ void operator delete(void *ptr)
 	g_allocatedByteCount -= size_ptr->byte_size;
 
 	#if (TRACK_MEMORY == TRACK_MEMORY_VERBOSE)
-		if(size_ptr->callstack_node.currentVal != nullptr)
-			DestroyCallstack(size_ptr->callstack_node.currentVal);
-		
-		//Set pointer to current stack null
-		bool run = true;
-		callstack_list* currentNode = nullptr;
-		while (g_callstackHead != nullptr && run && &size_ptr->callstack_node != NULL)
-		{
-			if (currentNode == nullptr && g_callstackHead != &size_ptr->callstack_node)
-			{
-				currentNode = g_callstackHead;
-			}
-			else
-			{
-				g_callstackHead = nullptr;
-				run = false;
-				continue;
-			}
-
-			if (currentNode->next != nullptr && currentNode->next != &size_ptr->callstack_node)
-			{
-				currentNode = currentNode->next;
-			}
-			else
-			{
-				currentNode->next = nullptr;
-				run = false;
-			}
-		}
+		MemoryTrackFree(size_ptr);
 	#endif
 
 	free(size_ptr);
@@ -136,209 +440,213 @@ void ResetFrameMemoryTracking()
 	g_frameFrees = 0;
 }
 
-void ReportVerboseCallStacks(const std::string& args)
+//------------------------------------------------------------------------
+void MemoryTrackerSetSampleRate(uint sample_rate)
 {
-	SCOPE_LOCK(&g_memoryLocker);
-	g_wasReportRun = true;
-
-	std::stringstream stream = std::stringstream(args);
-	std::string list[2];
-	std::string segment;
+	g_sampleRate = (sample_rate > 0) ? sample_rate : 1;
+}
 
-	int index = 0;
-	while (std::getline(stream, segment, '-'))
-	{
-		if (index > 1)
-			index = 1;
+//------------------------------------------------------------------------
+uint MemoryTrackerGetSampleRate()
+{
+	return g_sampleRate;
+}
 
-		list[index] = segment;
-		++index;
-	}
+//------------------------------------------------------------------------
+// No allocations while the table is locked - out is caller owned.
+uint MemoryTrackerGetTopCallsites(memory_callsite_stats_t *out, uint max_count)
+{
+	#if (defined(TRACK_MEMORY) && (TRACK_MEMORY == TRACK_MEMORY_VERBOSE))
+		if (0 == max_count) {
+			return 0;
+		}
 
-	double startTime = 0.0;
-	double endTime = GetCurrentTimeSeconds();
+		MemoryFlushAllBatches();
 
-	if (list[0] != "" && list[1] != "")
-	{
-		startTime = std::stod(list[0]);
-		endTime = std::stod(list[1]);
-	}
+		MemorySpinLock lock(g_memoryLock);
+		alloc_callsite_t *callsites = MemoryGetCallsitesLocked();
 
-	std::vector<callstack_list*> report_callstack;
-	report_callstack.reserve(g_allocCount + 1);
+		uint count = 0;
+		for (uint index = MEMORY_CALLSITE_OVERFLOW; index < MEMORY_CALLSITE_CAPACITY; ++index) {
+			alloc_callsite_t const &site = callsites[index];
+			if (site.live_bytes <= 0) {
+				continue;
+			}
 
-	callstack_list* temp = g_callstackHead;
-	while (temp != nullptr)
-	{
-		report_callstack.push_back(temp);
-		temp = temp->next;
-	}
+			if ((count == max_count) && (site.live_bytes <= out[count - 1].live_bytes)) {
+				continue;
+			}
 
-	std::sort(report_callstack.begin(), report_callstack.end(), SortCallStackList);
+			// insertion into the sorted top list
+			uint slot = (count < max_count) ? count++ : (count - 1);
+			while ((slot > 0) && (out[slot - 1].live_bytes < site.live_bytes)) {
+				out[slot] = out[slot - 1];
+				--slot;
+			}
 
-	callstack_list* currentNode = nullptr;
+			out[slot].callsite = index;
+			out[slot].live_count = site.live_count;
+			out[slot].live_bytes = site.live_bytes;
+			out[slot].total_count = site.total_count;
+			out[slot].total_bytes = site.total_bytes;
+		}
 
-	uint totalSimiliarAllocs = 0;
-	size_t totalSimiliarSize = 0;
+		return count;
+	#else
+		out;
+		max_count;
+		return 0;
+	#endif
+}
 
-	float reportedTotalBytes = (float)g_allocatedByteCount;
-	std::string sizeTotal = "B";
+//------------------------------------------------------------------------
+void MemoryTrackerReportTop(uint count)
+{
+	g_wasReportRun = true;
 
-	if (g_allocatedByteCount > (2 * 1024) && g_allocatedByteCount < (2 * 1024 * 1024))
-	{
-		//KB
-		reportedTotalBytes /= 1024.0f;
-		sizeTotal = "KiB";
-	}
-	else if ((unsigned long)g_allocatedByteCount > (2UL * 1024UL * 1024UL) && (unsigned long)g_allocatedByteCount < (2UL * 1024UL * 1024UL * 1024UL))
-	{
-		//MB
-		reportedTotalBytes /= (1024.0f * 1024.0f);
-		sizeTotal = "MiB";
-	}
-	else if ((unsigned long)g_allocatedByteCount > (2UL * 1024UL * 1024UL * 1024UL))
-	{
-		//GB
-		reportedTotalBytes /= (1024.0f * 1024.0f * 1024.0f);
-		sizeTotal = "GiB";
-	}
+	char init_buffer[128];
+	sprintf_s(init_buffer, 128, "\n%u live allocation(s).  Total: %s\n", (uint)g_allocCount, MemoryBytesToString((long long)g_allocatedByteCount).c_str());
+	LogTaggedPrintf("leaks", "%s", init_buffer);
 
-	char init_buffer[64];
-	sprintf_s(init_buffer, 64, "\n%u leaked allocation(s).  Total: %0.3f %s\n", g_allocCount, reportedTotalBytes, sizeTotal.c_str());
-	//OutputDebugStringA(init_buffer);
-	//printf(init_buffer);
-	LogTaggedPrintf("leaks", init_buffer);
+	#if (defined(TRACK_MEMORY) && (TRACK_MEMORY == TRACK_MEMORY_VERBOSE))
+		if (0 == count) {
+			return;
+		}
 
-	for(auto iterate = report_callstack.begin(); iterate != report_callstack.end(); ++iterate)
-	{
-		currentNode = *iterate;
-		callstack_list* nextNode = currentNode->next;
+		std::vector<memory_callsite_stats_t> top(count);
+		uint found = MemoryTrackerGetTopCallsites(top.data(), count);
 
-		uint32_t& currentHash = currentNode->currentVal->m_hash;
-		uint32_t nextHash;
-		if (nextNode == nullptr)
-			nextHash = currentHash + 1;
-		else
-			nextHash = nextNode->currentVal->m_hash;
+		LogTaggedPrintf("allocs", "Top %u of %u callsite(s) by live bytes, sampling 1 in %u", found, g_callsiteCount, (uint)g_sampleRate);
+		for (uint i = 0; i < found; ++i) {
+			memory_callsite_stats_t const &stats = top[i];
+			LogTaggedPrintf("allocs", "\n#%u: %lld live allocation(s), Total: %s  (%llu allocation(s), %s over the run)\n",
+				i + 1, stats.live_count, MemoryBytesToString(stats.live_bytes).c_str(),
+				stats.total_count, MemoryBytesToString((long long)stats.total_bytes).c_str());
+			MemoryLogCallstack(stats.callsite);
+		}
+	#endif
+}
 
-		if (nextHash == currentHash) 
-		{
-			totalSimiliarSize += currentNode->total_allocation;
-			totalSimiliarAllocs++;
+//------------------------------------------------------------------------
+// Only live counts are kept, enough to see what grew between two points.
+uint MemoryTrackerTakeSnapshot()
+{
+	#if (defined(TRACK_MEMORY) && (TRACK_MEMORY == TRACK_MEMORY_VERBOSE))
+		uint id = g_nextSnapshotId++;
+		memory_snapshot_t &snapshot = g_snapshots[id % MEMORY_SNAPSHOT_COUNT];
+		if (nullptr == snapshot.entries) {
+			snapshot.entries = (memory_snapshot_entry_t*) ::malloc(MEMORY_CALLSITE_CAPACITY * sizeof(memory_snapshot_entry_t));
 		}
 
-		if (nextHash != currentHash)
+		MemoryFlushAllBatches();
 		{
-			//Print total allocs for type and total size
-			float reportedBytes = (float)totalSimiliarSize;
-			std::string size = "B";
-
-			if (totalSimiliarSize > (2 * 1024) && totalSimiliarSize < (2 * 1024 * 1024))
-			{
-				//KB
-				reportedBytes /= 1024.0f;
-				size = "KiB";
-			}
-			else if ((unsigned long)totalSimiliarSize > (2UL * 1024UL * 1024UL) && (unsigned long)totalSimiliarSize < (2UL * 1024UL * 1024UL * 1024UL))
-			{
-				//MB
-				reportedBytes /= (1024.0f * 1024.0f);
-				size = "MiB";
-			}
-			else if ((unsigned long)totalSimiliarSize > (2UL * 1024UL * 1024UL * 1024UL))
-			{
-				//GB
-				reportedBytes /= (1024.0f * 1024.0f * 1024.0f);
-				size = "GiB";
+			MemorySpinLock lock(g_memoryLock);
+			alloc_callsite_t const *callsites = MemoryGetCallsitesLocked();
+			for (uint i = 0; i < MEMORY_CALLSITE_CAPACITY; ++i) {
+				snapshot.entries[i].live_count = callsites[i].live_count;
+				snapshot.entries[i].live_bytes = callsites[i].live_bytes;
 			}
+		}
+
+		snapshot.id = id;
+		snapshot.time = GetCurrentTimeSeconds();
+		LogTaggedPrintf("allocs", "Memory snapshot %u taken, %u live allocation(s)", id, (uint)g_allocCount);
+		return id;
+	#else
+		return 0;
+	#endif
+}
 
-			char collection_buffer[128];
-			sprintf_s(collection_buffer, 128, "\nGroup contained %s allocation(s), Total: %0.3f %s\n", std::to_string(totalSimiliarAllocs).c_str(), reportedBytes, size.c_str());
-			//OutputDebugStringA(collection_buffer);
-			//printf(collection_buffer);
-			LogTaggedPrintf("allocs", collection_buffer);
+//------------------------------------------------------------------------
+void MemoryTrackerReportDiff(uint from_snapshot, uint to_snapshot, uint count)
+{
+	#if (defined(TRACK_MEMORY) && (TRACK_MEMORY == TRACK_MEMORY_VERBOSE))
+		memory_snapshot_t const *from = MemoryFindSnapshot(from_snapshot);
+		memory_snapshot_t const *to = MemoryFindSnapshot(to_snapshot);
+		if ((nullptr == from) || (nullptr == to)) {
+			LogTaggedPrintf("leaks", "Memory snapshots %u and %u are not both available (last %u are kept)", from_snapshot, to_snapshot, MEMORY_SNAPSHOT_COUNT);
+			return;
+		}
 
-			//Reset total allocs and size
-			totalSimiliarAllocs = 0;
-			totalSimiliarSize = 0;
+		std::vector<memory_callsite_stats_t> growth;
+		long long total_bytes = 0;
+		long long total_count = 0;
+		for (uint i = 0; i < MEMORY_CALLSITE_CAPACITY; ++i) {
+			long long delta_count = to->entries[i].live_count - from->entries[i].live_count;
+			long long delta_bytes = to->entries[i].live_bytes - from->entries[i].live_bytes;
+			total_count += delta_count;
+			total_bytes += delta_bytes;
+
+			if ((delta_bytes > 0) || (delta_count > 0)) {
+				memory_callsite_stats_t stats;
+				stats.callsite = i;
+				stats.live_count = delta_count;
+				stats.live_bytes = delta_bytes;
+				stats.total_count = 0;
+				stats.total_bytes = 0;
+				growth.push_back(stats);
+			}
 		}
 
-		// Printing a call stack, happens when making report
-		char line_buffer[512];
-		callstack_line_t lines[128];
-		uint line_count = CallstackGetLines(lines, 128, currentNode->currentVal);
-		for (uint i = 0; i < line_count; ++i) {
-			// this specific format will make it double click-able in an output window 
-			// taking you to the offending line.
+		std::sort(growth.begin(), growth.end(), MemoryStatsSort);
 
-			if(args == "" || args == "default" || (currentNode->currentVal->m_time >= startTime - 0.00001 && currentNode->currentVal->m_time <= endTime + 0.00001))
-			{
-				//Print Line For Call Stack
-				sprintf_s(line_buffer, 512, "     %s(%u): %s\n", lines[i].filename, lines[i].line, lines[i].function_name);
-			}
+		LogTaggedPrintf("leaks", "\nSnapshot %u -> %u (%0.2f s): %lld allocation(s), %s net.  %u callsite(s) grew\n",
+			from_snapshot, to_snapshot, to->time - from->time, total_count, MemoryBytesToString(total_bytes).c_str(), (uint)growth.size());
 
-			// print to output and console
-			//OutputDebugStringA(line_buffer);
-			//printf(line_buffer);
-			LogTaggedPrintf("stack", line_buffer);
+		uint shown = ((uint)growth.size() < count) ? (uint)growth.size() : count;
+		for (uint i = 0; i < shown; ++i) {
+			LogTaggedPrintf("allocs", "\n#%u: +%lld allocation(s), +%s\n", i + 1, growth[i].live_count, MemoryBytesToString(growth[i].live_bytes).c_str());
+			MemoryLogCallstack(growth[i].callsite);
 		}
-	}
+	#else
+		from_snapshot;
+		to_snapshot;
+		count;
+	#endif
 }
 
-bool SortCallStackList(const callstack_list* first, const callstack_list* second)
+//------------------------------------------------------------------------
+// args is the number of callsites to show
+void ReportVerboseCallStacks(const std::string& args)
 {
-	return (first->total_allocation < second->total_allocation);
+	uint count = 16;
+	if ((args != "") && (args != "default")) {
+		int requested = atoi(args.c_str());
+		count = (requested > 0) ? (uint)requested : count;
+	}
+
+	MemoryTrackerReportTop(count);
 }
 
 void ConsolePrintMemValues(const std::string& args)
 {
 	args;
 
-	#if defined (TRACK_MEMORY) 
+	#if defined (TRACK_MEMORY)
 
 		#if (TRACK_MEMORY == TRACK_MEMORY_BASIC)
-			float reportedBytes = (float)g_allocatedByteCount;
-			std::string size = " B";
-
-			if (g_allocatedByteCount > (2 * 1024) && g_allocatedByteCount < (2 * 1024 * 1024))
-			{
-				//KB
-				reportedBytes /= 1024.0f;
-				size = " KiB";
-			}
-			else if (g_allocatedByteCount > (2 * 1024 * 1024) && g_allocatedByteCount < (2 * 1024 * 1024 * 1024))
-			{
-				//MB
-				reportedBytes /= (1024.0f * 1024.0f);
-				size = " MiB";
-			}
-			else if (g_allocatedByteCount > (2 * 1024 * 1024 * 1024))
-			{
-				//GB
-				reportedBytes /= (1024.0f * 1024.0f * 1024.0f);
-				size = " GiB";
-			}
+			std::string size = MemoryBytesToString((long long)g_allocatedByteCount);
 
 			command_cb totalAllocations;
-			totalAllocations.message = "Total Allocations: " + std::to_string(g_allocCount);
+			totalAllocations.message = "Total Allocations: " + std::to_string((uint)g_allocCount);
 			totalAllocations.color = Rgba(255, 153, 51, 255);
 			g_console->m_logHistory.push_back(totalAllocations);
 			g_console->m_cursorY -= g_console->m_consoleFont->m_lineHeight;
 
 			command_cb totalAllocatedBytes;
-			totalAllocatedBytes.message = "Bytes Allocated: " + std::to_string(reportedBytes) + size;
+			totalAllocatedBytes.message = "Bytes Allocated: " + size;
 			totalAllocatedBytes.color = Rgba(255, 153, 51, 255);
 			g_console->m_logHistory.push_back(totalAllocatedBytes);
 			g_console->m_cursorY -= g_console->m_consoleFont->m_lineHeight;
 
 			command_cb lastFrameAlloc;
-			lastFrameAlloc.message = "Allocations Last Frame: " + std::to_string(g_frameAllocs);
+			lastFrameAlloc.message = "Allocations Last Frame: " + std::to_string((uint)g_frameAllocs);
 			lastFrameAlloc.color = Rgba(255, 153, 51, 255);
 			g_console->m_logHistory.push_back(lastFrameAlloc);
 			g_console->m_cursorY -= g_console->m_consoleFont->m_lineHeight;
 
 			command_cb freesLastFrame;
-			freesLastFrame.message = "Frees Last Frame: " + std::to_string(g_frameFrees);
+			freesLastFrame.message = "Frees Last Frame: " + std::to_string((uint)g_frameFrees);
 			freesLastFrame.color = Rgba(255, 153, 51, 255);
 			g_console->m_logHistory.push_back(freesLastFrame);
 			g_console->m_cursorY -= g_console->m_consoleFont->m_lineHeight;
@@ -354,16 +662,18 @@ void ConsolePrintMemValues(const std::string& args)
 void ShutDownVerboseReport()
 {
 	#if defined(TRACK_MEMORY)
-		if (g_wasReportRun == true)
+		#if (TRACK_MEMORY == TRACK_MEMORY_VERBOSE)
+			if (g_wasReportRun == false)
+			{
+				ReportVerboseCallStacks("");
+			}
+		#endif
+
+		if (g_symbolsLoaded)
 		{
 			CallstackSystemDeinit();
-			return;
+			g_symbolsLoaded = false;
 		}
-	
-		#if (TRACK_MEMORY == TRACK_MEMORY_VERBOSE)
-			ReportVerboseCallStacks("");
-			CallstackSystemDeinit();
-		#endif
 	#endif
 }
 
@@ -374,12 +684,12 @@ uint GetAllocCount()
 
 uint GetFrameAllocs()
 {
-	return g_frameAllocs;
+	return g_frameAllocs.load(std::memory_order_relaxed);
 }
 
 uint GetFrameFrees()
 {
-	return g_frameFrees;
+	return g_frameFrees.load(std::memory_order_relaxed);
 }
 
 size_t GetAllocByteCount()
@@ -391,7 +701,66 @@ void InitializeVerboseReporting()
 {
 	#if defined(TRACK_MEMORY)
 		#if (TRACK_MEMORY == TRACK_MEMORY_VERBOSE)
-			CallstackSystemInit();
+			if (!g_symbolsLoaded)
+				g_symbolsLoaded = CallstackSystemInit();
 		#endif
 	#endif
-}
\ No newline at end of file
+}
+
+//------------------------------------------------------------------------
+// Console Commands
+//------------------------------------------------------------------------
+static uint MemoryArgToUInt(arguments const &args, uint index, uint default_value)
+{
+	if (args.arg_list.size() <= index) {
+		return default_value;
+	}
+
+	int value = atoi(args.arg_list[index].c_str());
+	return (value > 0) ? (uint)value : default_value;
+}
+
+// MemTop [count]
+void MemoryTopCommand(void* data)
+{
+	arguments args = *(arguments*)data;
+	MemoryTrackerReportTop(MemoryArgToUInt(args, 0, 16));
+}
+
+// MemSnapshot
+void MemorySnapshotCommand(void*)
+{
+	MemoryTrackerTakeSnapshot();
+}
+
+// MemDiff [from] [to] [count] - defaults to the last two snapshots
+void MemoryDiffCommand(void* data)
+{
+	arguments args = *(arguments*)data;
+
+	#if (defined(TRACK_MEMORY) && (TRACK_MEMORY == TRACK_MEMORY_VERBOSE))
+		uint last = g_nextSnapshotId - 1;
+	#else
+		uint last = 0;
+	#endif
+
+	uint from = MemoryArgToUInt(args, 0, (last > 0) ? (last - 1) : 0);
+	uint to = MemoryArgToUInt(args, 1, last);
+	MemoryTrackerReportDiff(from, to, MemoryArgToUInt(args, 2, 16));
+}
+
+// MemSampleRate [rate]
+void MemorySampleRateCommand(void* data)
+{
+	arguments args = *(arguments*)data;
+	MemoryTrackerSetSampleRate(MemoryArgToUInt(args, 0, 1));
+	LogTaggedPrintf("allocs", "Memory tracker sampling 1 in %u allocation(s)", MemoryTrackerGetSampleRate());
+}
+
+void RegisterMemoryCommands()
+{
+	g_console->RegisterCommand("MemTop", MemoryTopCommand);
+	g_console->RegisterCommand("MemSnapshot", MemorySnapshotCommand);
+	g_console->RegisterCommand("MemDiff", MemoryDiffCommand);
+	g_console->RegisterCommand("MemSampleRate", MemorySampleRateCommand);
+}
@@ -20,27 +20,43 @@ class CallStack;
 // undefined
 #else 
 //#define TRACK_MEMORY           TRACK_MEMORY_BASIC
+// profiler is cheap enough to leave on outside of final builds
+#define PROFILED_BUILD
 #endif
 
 
-// Treat as Linked List
-struct callstack_list
-{
-	CallStack* currentVal = nullptr;
-	size_t total_allocation = 0;
-	callstack_list* next = nullptr;
-};
+// Verbose tracking aggregates by callsite (callstack hash) instead of
+// keeping every allocation in a list.  Only 1 in sample_rate allocations
+// pays for a stack walk, their counts are weighted so totals stay estimates
+// of the real numbers.
+uint const MEMORY_CALLSITE_CAPACITY = 1 << 15;
+uint const MEMORY_CALLSTACK_DEPTH = 32;
+uint const MEMORY_BATCH_SIZE = 64;
+uint const MEMORY_SNAPSHOT_COUNT = 8;
 
+// reserved callsites
+uint const MEMORY_CALLSITE_UNSAMPLED = 0;
+uint const MEMORY_CALLSITE_OVERFLOW = 1;
+
+// header in front of every tracked allocation, keeps malloc's alignment
 struct allocation_t
 {
 	size_t byte_size;
-	#if defined(TRACK_MEMORY)
-		#if (TRACK_MEMORY == TRACK_MEMORY_VERBOSE)
-			callstack_list callstack_node;
-		#endif
-	#endif
+	uint callsite;
+	uint weight;
+#if !defined(_WIN64)
+	uint pad;
+#endif
 };
 
+struct memory_callsite_stats_t
+{
+	uint callsite;
+	long long live_count;
+	long long live_bytes;
+	unsigned long long total_count;
+	unsigned long long total_bytes;
+};
 
 
 void operator delete(void *ptr);
@@ -49,10 +65,23 @@ uint GetHighwaterAllocation();
 void ConsolePrintMemValues(const std::string& args);
 void ResetFrameMemoryTracking();
 void ReportVerboseCallStacks(const std::string& args);
-bool SortCallStackList(const callstack_list* first, const callstack_list* second);
 void InitializeVerboseReporting();
 void ShutDownVerboseReport();
 uint GetAllocCount();
 uint GetFrameAllocs();
 uint GetFrameFrees();
-size_t GetAllocByteCount();
\ No newline at end of file
+size_t GetAllocByteCount();
+
+// 1 tracks every allocation
+void MemoryTrackerSetSampleRate(uint sample_rate);
+uint MemoryTrackerGetSampleRate();
+
+// top callsites by live bytes, most first.  Returns the number written.
+uint MemoryTrackerGetTopCallsites(memory_callsite_stats_t *out, uint max_count);
+void MemoryTrackerReportTop(uint count);
+
+// snapshots live in a small ring, ids keep counting up
+uint MemoryTrackerTakeSnapshot();
+void MemoryTrackerReportDiff(uint from_snapshot, uint to_snapshot, uint count);
+
+void RegisterMemoryCommands();
\ No newline at end of file
@@ -117,6 +117,29 @@ CallStack* CreateCallstack(uint skip_frames)
 	return cs;
 }
 
+//------------------------------------------------------------------------
+uint CallstackCapture(void **frames, uint max_frames, uint skip_frames, uint32_t *out_hash)
+{
+	DWORD hash = 0;
+	uint frame_count = CaptureStackBackTrace(1 + skip_frames, max_frames, frames, &hash);
+	*out_hash = hash;
+	return frame_count;
+}
+
+//------------------------------------------------------------------------
+CallStack* CreateCallstackFromFrames(void* const *frames, uint frame_count, uint32_t hash)
+{
+	CallStack *cs = (CallStack*) ::malloc(sizeof(CallStack));
+	cs = new (cs) CallStack();
+
+	cs->m_frameCount = min(MAX_FRAMES_PER_CALLSTACK, frame_count);
+	memcpy(cs->m_frames, frames, sizeof(void*) * cs->m_frameCount);
+	cs->m_time = GetCurrentTimeSeconds();
+	cs->m_hash = hash;
+
+	return cs;
+}
+
 //------------------------------------------------------------------------
 // Fills lines with human readable data for the given callstack
 // Fills from top to bottom (top being most recently called, with each next one being the calling function of the previous)
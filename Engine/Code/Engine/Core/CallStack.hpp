@@ -31,4 +31,8 @@ void CallstackSystemDeinit();
 CallStack* CreateCallstack(uint skip_frames);
 void DestroyCallstack(CallStack *c);
 
+// Raw capture into a caller buffer - no allocation, so usable from operator new.
+uint CallstackCapture(void **frames, uint max_frames, uint skip_frames, uint32_t *out_hash);
+CallStack* CreateCallstackFromFrames(void* const *frames, uint frame_count, uint32_t hash);
+
 uint CallstackGetLines(callstack_line_t *line_buffer, uint const max_lines, CallStack *cs);
\ No newline at end of file
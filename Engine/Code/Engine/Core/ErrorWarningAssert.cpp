@@ -61,7 +61,7 @@ void DebuggerPrintf( const char* messageFormat, ... )
 	}
 #endif
 #if defined(TRACK_MEMORY)
-	LogTaggedPrintf("debug", messageLiteral);
+	LogTaggedPrintf("debug", "%s", messageLiteral);
 #endif
 	std::cout << messageLiteral;
 }
@@ -0,0 +1,72 @@
+#include "Engine/Core/FixedTickLoop.hpp"
+#include <math.h>
+
+FixedTickLoop::FixedTickLoop()
+	: tick_seconds(1.0f / 60.0f)
+	, max_ticks_per_update(8)
+	, tick(0)
+	, accumulator(0.0)
+	, ticks_this_update(0)
+	, dropped_ticks(0)
+	, is_started(false)
+{
+}
+
+void FixedTickLoop::SetTickRate(float hz)
+{
+	tick_seconds = 1.0f / hz;
+	Reset();
+}
+
+void FixedTickLoop::Reset()
+{
+	tick = 0;
+	accumulator = 0.0;
+	ticks_this_update = 0;
+	is_started = false;
+}
+
+void FixedTickLoop::Update(double time)
+{
+	ticks_this_update = 0;
+
+	// tick from the absolute time rather than summing frame times, nothing drifts
+	double due = floor(time / (double)tick_seconds);
+	if (due < 0.0)
+		due = 0.0;
+
+	tick_t due_tick = (tick_t)due;
+	if (!is_started)
+	{
+		is_started = true;
+		tick = due_tick;
+	}
+	else if (due_tick > tick + max_ticks_per_update)
+	{
+		dropped_ticks += due_tick - tick - max_ticks_per_update;
+		tick = due_tick - max_ticks_per_update;
+	}
+
+	// a clock that was pulled back just waits for it to come round again
+	accumulator = time - GetTickTime(tick);
+}
+
+bool FixedTickLoop::CheckAndStep()
+{
+	if (accumulator < (double)tick_seconds)
+		return false;
+
+	++tick;
+	++ticks_this_update;
+	accumulator -= (double)tick_seconds;
+	return true;
+}
+
+float FixedTickLoop::GetAlpha() const
+{
+	float alpha = (float)(accumulator / (double)tick_seconds);
+	if (alpha < 0.0f)
+		return 0.0f;
+
+	return (alpha < 1.0f) ? alpha : 1.0f;
+}
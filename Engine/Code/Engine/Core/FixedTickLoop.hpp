@@ -0,0 +1,36 @@
+#pragma once
+#include <stdint.h>
+
+typedef unsigned int uint;
+typedef uint64_t tick_t;
+
+// Steps a simulation at a fixed rate off an absolute clock.  Tick n is due once
+// the clock reaches n * tick_seconds, so two loops fed the same clock (the host's,
+// through NetClock on a client) run the same tick numbers.  Whatever is left over
+// after the last due tick is the accumulator, and alpha is how far into the next
+// tick it is - render between the last two ticks' states with it.
+//
+//	loop.Update(NetClockGetHostTime());
+//	while (loop.CheckAndStep())
+//		Simulate(loop.tick_seconds);
+class FixedTickLoop
+{
+public:
+	FixedTickLoop();
+
+	void SetTickRate(float hz);
+	void Reset();							// the next Update starts at whatever tick is due
+	void Update(double time);
+	bool CheckAndStep();					// advances tick while one is due
+	float GetAlpha() const;
+	inline double GetTickTime(tick_t at_tick) const { return (double)at_tick * tick_seconds; }
+
+public:
+	float tick_seconds;
+	uint max_ticks_per_update;			// any more than that are dropped, after a stall
+	tick_t tick;						// the last one stepped
+	double accumulator;					// time past tick
+	uint ticks_this_update;
+	uint64_t dropped_ticks;
+	bool is_started;
+};
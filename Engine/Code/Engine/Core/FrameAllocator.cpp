@@ -0,0 +1,169 @@
+#include "Engine/Core/FrameAllocator.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+
+
+static DoubleBufferedAllocator *gFrameAllocator = nullptr;
+
+//------------------------------------------------------------------------
+static size_t ArenaRoundUp(size_t size)
+{
+	return (size + (ARENA_ALIGNMENT - 1)) & ~(ARENA_ALIGNMENT - 1);
+}
+
+//------------------------------------------------------------------------
+LinearAllocator::LinearAllocator(size_t cap)
+	: offset(0)
+	, high_water(0)
+	, overflow(nullptr)
+	, overflow_bytes(0)
+{
+	capacity = ArenaRoundUp(cap);
+	buffer = (byte_t*)::_aligned_malloc(capacity, ARENA_ALIGNMENT);
+}
+
+//------------------------------------------------------------------------
+LinearAllocator::~LinearAllocator()
+{
+	reset();
+	::_aligned_free(buffer);
+}
+
+//------------------------------------------------------------------------
+void* LinearAllocator::alloc(size_t size)
+{
+	size_t bytes = ArenaRoundUp(size);
+	size_t start = offset.fetch_add(bytes);
+	if ((start + bytes) <= capacity) {
+		return buffer + start;
+	}
+
+	return alloc_overflow(bytes);
+}
+
+//------------------------------------------------------------------------
+// Header is padded to the arena alignment so the block after it stays aligned.
+void* LinearAllocator::alloc_overflow(size_t size)
+{
+	size_t header_size = ArenaRoundUp(sizeof(overflow_t));
+	byte_t *memory = (byte_t*)::_aligned_malloc(header_size + size, ARENA_ALIGNMENT);
+	if (nullptr == memory) {
+		return nullptr;
+	}
+
+	overflow_t *block = (overflow_t*)memory;
+	block->size = size;
+
+	SCOPE_LOCK(&overflow_lock);
+	block->next = overflow;
+	overflow = block;
+	overflow_bytes += size;
+
+	return memory + header_size;
+}
+
+//------------------------------------------------------------------------
+void LinearAllocator::rewind(arena_marker_t marker)
+{
+	ASSERT_OR_DIE(marker <= offset.load(), "Arena rewound past its current offset!");
+	offset.store(marker);
+}
+
+//------------------------------------------------------------------------
+void LinearAllocator::reset()
+{
+	size_t used = offset.load();
+	if (used > capacity) {
+		used = capacity;
+	}
+
+	used += overflow_bytes;
+	if (used > high_water) {
+		high_water = used;
+	}
+
+	overflow_t *block = overflow;
+	while (nullptr != block) {
+		overflow_t *next = block->next;
+		::_aligned_free(block);
+		block = next;
+	}
+
+	// spilled this time - grow so the same load fits next time
+	if (0 != overflow_bytes) {
+		size_t new_capacity = ArenaRoundUp(high_water + (high_water / 4));
+		::_aligned_free(buffer);
+		buffer = (byte_t*)::_aligned_malloc(new_capacity, ARENA_ALIGNMENT);
+		capacity = new_capacity;
+	}
+
+	overflow = nullptr;
+	overflow_bytes = 0;
+	offset.store(0);
+}
+
+//------------------------------------------------------------------------
+DoubleBufferedAllocator::DoubleBufferedAllocator(size_t capacity)
+	: current(0)
+{
+	arenas[0] = new LinearAllocator(capacity);
+	arenas[1] = new LinearAllocator(capacity);
+}
+
+//------------------------------------------------------------------------
+DoubleBufferedAllocator::~DoubleBufferedAllocator()
+{
+	delete arenas[0];
+	delete arenas[1];
+}
+
+//------------------------------------------------------------------------
+void DoubleBufferedAllocator::swap()
+{
+	current ^= 1;
+	arenas[current]->reset();
+}
+
+//------------------------------------------------------------------------
+void FrameAllocatorStartup(size_t bytes_per_frame /*= FRAME_ARENA_SIZE*/)
+{
+	ASSERT_OR_DIE(nullptr == gFrameAllocator, "Frame allocator already started!");
+	gFrameAllocator = new DoubleBufferedAllocator(bytes_per_frame);
+}
+
+//------------------------------------------------------------------------
+void FrameAllocatorShutdown()
+{
+	delete gFrameAllocator;
+	gFrameAllocator = nullptr;
+}
+
+//------------------------------------------------------------------------
+void FrameAllocatorBeginFrame()
+{
+	if (nullptr != gFrameAllocator) {
+		gFrameAllocator->swap();
+	}
+}
+
+//------------------------------------------------------------------------
+DoubleBufferedAllocator* FrameAllocatorGet()
+{
+	return gFrameAllocator;
+}
+
+//------------------------------------------------------------------------
+LinearAllocator* FrameAllocatorGetCurrentArena()
+{
+	if (nullptr == gFrameAllocator) {
+		return nullptr;
+	}
+
+	return gFrameAllocator->get_current();
+}
+
+//------------------------------------------------------------------------
+void* FrameAlloc(size_t size)
+{
+	ASSERT_OR_DIE(nullptr != gFrameAllocator, "Frame allocator was not started!");
+	return gFrameAllocator->alloc(size);
+}
@@ -0,0 +1,172 @@
+#pragma once
+#include "Engine/Core/BlockAllocator.hpp"
+#include "Engine/Core/CriticalSection.hpp"
+#include <atomic>
+#include <vector>
+
+// default size of each frame arena
+size_t const FRAME_ARENA_SIZE = 4 * 1024 * 1024;
+
+// every arena allocation is rounded to this, so everything comes back this aligned
+size_t const ARENA_ALIGNMENT = 16;
+
+typedef size_t arena_marker_t;
+
+//------------------------------------------------------------------------
+// Bump allocator.  alloc() is lock free so job threads can share an arena,
+// free() does nothing - memory comes back all at once on reset() or rewind().
+// Anything past the end spills to the heap and the arena grows to fit on the
+// next reset(), so a steady frame settles at zero heap allocations.
+//------------------------------------------------------------------------
+class LinearAllocator : public IAllocator
+{
+	struct overflow_t
+	{
+		overflow_t *next;
+		size_t size;
+	};
+
+public:
+	LinearAllocator(size_t capacity);
+	~LinearAllocator();
+
+	virtual void* alloc(size_t size) override;
+	virtual void free(void*) override {}
+
+	// only valid when nothing else allocated from this arena after the marker was taken
+	inline arena_marker_t get_marker() const { return offset.load(); }
+	void rewind(arena_marker_t marker);
+	void reset();
+
+	inline size_t get_used_bytes() const { return offset.load(); }
+
+private:
+	void* alloc_overflow(size_t size);
+
+public:
+	byte_t *buffer;
+	size_t capacity;
+	std::atomic<size_t> offset;
+	size_t high_water;
+
+	CriticalSection overflow_lock;
+	overflow_t *overflow;
+	size_t overflow_bytes;
+};
+
+//------------------------------------------------------------------------
+// Two arenas, swapped once a frame.  Memory handed out in frame N stays
+// valid through frame N+1, so results can be consumed a frame late.
+//------------------------------------------------------------------------
+class DoubleBufferedAllocator : public IAllocator
+{
+public:
+	DoubleBufferedAllocator(size_t capacity);
+	~DoubleBufferedAllocator();
+
+	virtual void* alloc(size_t size) override { return arenas[current]->alloc(size); }
+	virtual void free(void*) override {}
+
+	// resets the older arena and makes it current
+	void swap();
+	inline LinearAllocator* get_current() { return arenas[current]; }
+	inline LinearAllocator* get_previous() { return arenas[current ^ 1]; }
+
+public:
+	LinearAllocator *arenas[2];
+	uint current;
+};
+
+//------------------------------------------------------------------------
+// Rewinds an arena back to where it was when the scope opened.
+//------------------------------------------------------------------------
+class ScopedArenaMarker
+{
+public:
+	ScopedArenaMarker(LinearAllocator *arena)
+		: m_arena(arena)
+		, m_marker((nullptr != arena) ? arena->get_marker() : 0)
+	{}
+
+	~ScopedArenaMarker()
+	{
+		if (nullptr != m_arena) {
+			m_arena->rewind(m_marker);
+		}
+	}
+
+public:
+	LinearAllocator *m_arena;
+	arena_marker_t m_marker;
+};
+
+#define ARENA_SCOPE( arena ) ScopedArenaMarker COMBINE(__arena_,__LINE__)(arena)
+#define FRAME_ALLOC_SCOPE() ARENA_SCOPE(FrameAllocatorGetCurrentArena())
+
+//------------------------------------------------------------------------
+// STL adapter.  With no allocator it falls back to the heap, so code using
+// it still works in apps that never started the frame allocator.
+//------------------------------------------------------------------------
+template <typename T>
+class StlAllocator
+{
+public:
+	typedef T value_type;
+
+	template <typename U>
+	struct rebind { typedef StlAllocator<U> other; };
+
+	StlAllocator(IAllocator *allocator = nullptr) : m_allocator(allocator) {}
+
+	template <typename U>
+	StlAllocator(StlAllocator<U> const &other) : m_allocator(other.m_allocator) {}
+
+	T* allocate(size_t count)
+	{
+		size_t bytes = count * sizeof(T);
+		if (nullptr == m_allocator) {
+			return (T*)::malloc(bytes);
+		}
+
+		return (T*)m_allocator->alloc(bytes);
+	}
+
+	void deallocate(T *ptr, size_t)
+	{
+		if (nullptr == m_allocator) {
+			::free(ptr);
+		}
+		else {
+			m_allocator->free(ptr);
+		}
+	}
+
+	template <typename U>
+	bool operator==(StlAllocator<U> const &other) const { return m_allocator == other.m_allocator; }
+
+	template <typename U>
+	bool operator!=(StlAllocator<U> const &other) const { return m_allocator != other.m_allocator; }
+
+public:
+	IAllocator *m_allocator;
+};
+
+template <typename T>
+using FrameVector = std::vector<T, StlAllocator<T>>;
+
+//------------------------------------------------------------------------
+// Global frame allocator.  FrameAllocatorBeginFrame() must be called from
+// the main thread while no jobs are allocating from it.
+//------------------------------------------------------------------------
+void FrameAllocatorStartup(size_t bytes_per_frame = FRAME_ARENA_SIZE);
+void FrameAllocatorShutdown();
+void FrameAllocatorBeginFrame();
+DoubleBufferedAllocator* FrameAllocatorGet();
+LinearAllocator* FrameAllocatorGetCurrentArena();
+void* FrameAlloc(size_t size);
+
+template <typename T>
+StlAllocator<T> FrameStlAllocator()
+{
+	return StlAllocator<T>(FrameAllocatorGet());
+}
@@ -1,37 +1,445 @@
 #include "Engine/Core/Job.hpp"
 #include "Engine/Core/BlockAllocator.hpp"
+#include "Engine/Core/WorkStealingQueue.hpp"
 #include "Engine/Core/Time.hpp"
 #include "Engine/Core/ErrorWarningAssert.hpp"
 #include "Engine/Core/Profiling.hpp"
+#include "Engine/Core/BuildConfig.hpp"
+#include "Engine/Core/CriticalSection.hpp"
+#include "Engine/EngineConfig.hpp"
 #include <thread>
+#include <algorithm>
 
 
+// how many times an idle worker retries stealing before going to sleep
+static uint const JOB_WORKER_SPIN_COUNT = 32;
+
+//------------------------------------------------------------------------
+// One level per priority.  Jobs with a deadline sit in a min heap ahead of
+// the plain FIFO for their level, and any deadline that has already passed
+// jumps every level.
+class JobQueue
+{
+public:
+	JobQueue();
+
+	void push(Job *job);
+	bool pop(Job **out, uint lowest_priority = JOB_PRIORITY_LOW);
+	bool peek_urgency(uint *out_priority, uint64_t *out_deadline);
+	inline bool empty() const { return 0 == count.load(); }
+
+private:
+	bool pop_level(uint level, Job **out);
+	bool pop_overdue(Job **out);
+
+public:
+	ThreadSafeQueue<Job*> fifo[JOB_PRIORITY_COUNT];
+	std::vector<Job*> deadlines[JOB_PRIORITY_COUNT];
+	CriticalSection deadline_lock;
+
+	std::atomic<uint> level_counts[JOB_PRIORITY_COUNT];
+	std::atomic<uint> deadline_count;
+	std::atomic<uint> count;
+	std::atomic<uint> pop_count;
+};
+
+//------------------------------------------------------------------------
+// One per generic thread.  Jobs dispatched from a worker land in its own
+// deque, idle workers steal from the others.
+class JobWorker
+{
+public:
+	WorkStealingQueue<Job*> deque;
+	Signal signal;
+	std::atomic<bool> is_sleeping;
+	thread_handle thread;
+	uint index;
+};
 
 class JobSystem
 {
 public:
-	ThreadSafeQueue<Job*> *queues;
+	JobQueue *queues;
 	Signal **signals;
+	uint *profile_tags;   // interned category names, shown as trace categories
 	uint queue_count;
 
-	bool is_running;
+	uint latency[JOB_PRIORITY_COUNT][JOB_LATENCY_BUCKET_COUNT];
+	uint missed_deadlines[JOB_PRIORITY_COUNT];
+
+	JobWorker *workers;
+	uint worker_count;
+	std::atomic<uint> sleeping_count;
+
+	std::atomic<bool> is_running;
 };
 
 static JobSystem *gJobSystem = nullptr;
-static BlockAllocator* gJobAlloc = nullptr;
+// jobs are created and released from every thread
+static LocklessBlockAllocator* gJobAlloc = nullptr;
+static thread_local JobWorker *tLocalWorker = nullptr;
+
+// dependent overflow chunks come out of the job pool
+static_assert(sizeof(job_dependent_chunk_t) <= sizeof(Job), "Dependent chunk must fit in a job block.");
+
+//------------------------------------------------------------------------
+static bool JobDeadlineLater(Job const *a, Job const *b)
+{
+	return a->deadline_ops > b->deadline_ops;
+}
+
+//------------------------------------------------------------------------
+JobQueue::JobQueue()
+	: deadline_count(0)
+	, count(0)
+	, pop_count(0)
+{
+	for (uint i = 0; i < JOB_PRIORITY_COUNT; ++i) {
+		level_counts[i] = 0;
+		deadlines[i].reserve(64);
+	}
+}
+
+//------------------------------------------------------------------------
+void JobQueue::push(Job *job)
+{
+	// counted before the push so a racing pop never sees the counts go below zero
+	uint level = job->priority;
+	++count;
+	++level_counts[level];
+
+	if (0 != job->deadline_ops) {
+		SCOPE_LOCK(&deadline_lock);
+		deadlines[level].push_back(job);
+		std::push_heap(deadlines[level].begin(), deadlines[level].end(), JobDeadlineLater);
+		++deadline_count;
+	}
+	else {
+		fifo[level].push(job);
+	}
+}
+
+//------------------------------------------------------------------------
+// Highest level first, down to lowest_priority.  Every JOB_PRIORITY_AGING_INTERVAL
+// pops the scan runs bottom up instead - still never below lowest_priority, so
+// a caller that only wants urgent work never gets handed background jobs.
+bool JobQueue::pop(Job **out, uint lowest_priority /*= JOB_PRIORITY_LOW*/)
+{
+	if (empty()) {
+		return false;
+	}
+
+	if ((0 != deadline_count.load()) && pop_overdue(out)) {
+		return true;
+	}
+
+	bool aging = ((pop_count.fetch_add(1) % JOB_PRIORITY_AGING_INTERVAL) == (JOB_PRIORITY_AGING_INTERVAL - 1));
+	if (aging) {
+		int lowest_level = (lowest_priority < JOB_PRIORITY_COUNT) ? (int)lowest_priority : (int)(JOB_PRIORITY_COUNT - 1);
+		for (int level = lowest_level; level >= 0; --level) {
+			if (pop_level((uint)level, out)) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	for (uint level = 0; (level <= lowest_priority) && (level < JOB_PRIORITY_COUNT); ++level) {
+		if (pop_level(level, out)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//------------------------------------------------------------------------
+bool JobQueue::pop_level(uint level, Job **out)
+{
+	if (0 == level_counts[level].load()) {
+		return false;
+	}
+
+	bool popped = false;
+	if (0 != deadline_count.load()) {
+		SCOPE_LOCK(&deadline_lock);
+		std::vector<Job*> &heap = deadlines[level];
+		if (!heap.empty()) {
+			std::pop_heap(heap.begin(), heap.end(), JobDeadlineLater);
+			*out = heap.back();
+			heap.pop_back();
+			--deadline_count;
+			popped = true;
+		}
+	}
+
+	if (!popped) {
+		popped = fifo[level].pop(out);
+	}
+
+	if (popped) {
+		--level_counts[level];
+		--count;
+	}
+
+	return popped;
+}
+
+//------------------------------------------------------------------------
+bool JobQueue::pop_overdue(Job **out)
+{
+	uint64_t now = TimeGetOpCount();
+
+	SCOPE_LOCK(&deadline_lock);
+	int best_level = -1;
+	for (uint level = 0; level < JOB_PRIORITY_COUNT; ++level) {
+		std::vector<Job*> &heap = deadlines[level];
+		if (heap.empty() || (heap.front()->deadline_ops > now)) {
+			continue;
+		}
+
+		if ((best_level < 0) || (heap.front()->deadline_ops < deadlines[best_level].front()->deadline_ops)) {
+			best_level = (int)level;
+		}
+	}
+
+	if (best_level < 0) {
+		return false;
+	}
+
+	std::vector<Job*> &heap = deadlines[best_level];
+	std::pop_heap(heap.begin(), heap.end(), JobDeadlineLater);
+	*out = heap.back();
+	heap.pop_back();
+
+	--deadline_count;
+	--level_counts[best_level];
+	--count;
+	return true;
+}
+
+//------------------------------------------------------------------------
+// Most urgent level with work, and the earliest deadline on that level
+// (or any overdue one).  Only a hint - another thread may pop it first.
+bool JobQueue::peek_urgency(uint *out_priority, uint64_t *out_deadline)
+{
+	if (empty()) {
+		return false;
+	}
+
+	uint level = 0;
+	while ((level < JOB_PRIORITY_COUNT) && (0 == level_counts[level].load())) {
+		++level;
+	}
+
+	if (level == JOB_PRIORITY_COUNT) {
+		return false;
+	}
+
+	*out_priority = level;
+	*out_deadline = UINT64_MAX;
+
+	if (0 != deadline_count.load()) {
+		uint64_t now = TimeGetOpCount();
+
+		SCOPE_LOCK(&deadline_lock);
+		for (uint i = 0; i < JOB_PRIORITY_COUNT; ++i) {
+			std::vector<Job*> &heap = deadlines[i];
+			if (heap.empty()) {
+				continue;
+			}
+
+			uint64_t deadline = heap.front()->deadline_ops;
+			if ((i == level) || (deadline <= now)) {
+				if (deadline <= now) {
+					*out_priority = JOB_PRIORITY_CRITICAL;
+				}
+				if (deadline < *out_deadline) {
+					*out_deadline = deadline;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------
+static bool JobSystemHasGenericWork()
+{
+	if (!gJobSystem->queues[JOB_GENERIC].empty()) {
+		return true;
+	}
+
+	for (uint i = 0; i < gJobSystem->worker_count; ++i) {
+		if (!gJobSystem->workers[i].deque.empty()) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//------------------------------------------------------------------------
+// Wakes a single sleeping worker, if there is one.  Cheap when everyone is busy.
+static void JobSystemWakeOneWorker()
+{
+	if (0 == gJobSystem->sleeping_count.load()) {
+		return;
+	}
+
+	uint start = (nullptr != tLocalWorker) ? tLocalWorker->index + 1 : 0;
+	for (uint i = 0; i < gJobSystem->worker_count; ++i) {
+		JobWorker *worker = &gJobSystem->workers[(start + i) % gJobSystem->worker_count];
+
+		// claim the sleeper so two dispatches don't both wake the same thread
+		bool expected = true;
+		if (worker->is_sleeping.compare_exchange_strong(expected, false)) {
+			worker->signal.signal_all(); // auto-reset, only releases this worker
+			return;
+		}
+	}
+}
+
+//------------------------------------------------------------------------
+// Only plain normal priority work goes to worker deques, anything with an
+// opinion about ordering goes through the shared queue so it can be honoured.
+static void JobSystemPushGeneric(Job *job)
+{
+	JobWorker *worker = tLocalWorker;
+	bool is_plain = (JOB_PRIORITY_NORMAL == job->priority) && (0 == job->deadline_ops);
+	if ((nullptr == worker) || !is_plain || !worker->deque.push(job)) {
+		gJobSystem->queues[JOB_GENERIC].push(job);
+	}
+
+	// pairs with the fence in JobWorkerSleep - either the sleeper sees this job,
+	// or we see the sleeper.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	JobSystemWakeOneWorker();
+
+	Signal *signal = gJobSystem->signals[JOB_GENERIC];
+	if (nullptr != signal) {
+		signal->signal_all();
+	}
+}
+
+//------------------------------------------------------------------------
+// Urgent shared work first, then the local deque (LIFO, cache warm), then the
+// rest of the shared queue, then steal from the other workers.
+static bool JobSystemPopGeneric(Job **out)
+{
+	JobQueue *shared = &gJobSystem->queues[JOB_GENERIC];
+	if (shared->pop(out, JOB_PRIORITY_HIGH)) {
+		return true;
+	}
+
+	JobWorker *self = tLocalWorker;
+	if ((nullptr != self) && self->deque.pop(out)) {
+		return true;
+	}
+
+	if (shared->pop(out)) {
+		return true;
+	}
+
+	uint count = gJobSystem->worker_count;
+	uint start = (nullptr != self) ? self->index + 1 : 0;
+	for (uint i = 0; i < count; ++i) {
+		JobWorker *victim = &gJobSystem->workers[(start + i) % count];
+		if ((victim != self) && victim->deque.steal(out)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//------------------------------------------------------------------------
+static void JobWorkerSleep(JobWorker *worker)
+{
+	worker->is_sleeping.store(true);
+	gJobSystem->sleeping_count.fetch_add(1);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	// re-check after announcing we're asleep, a dispatch may have raced us
+	if (gJobSystem->is_running && !JobSystemHasGenericWork()) {
+		worker->signal.wait();
+	}
+
+	worker->is_sleeping.store(false);
+	gJobSystem->sleeping_count.fetch_sub(1);
+}
 
 //------------------------------------------------------------------------
-static void GenericJobThread(Signal *signal)
+static void GenericJobThread(JobWorker *worker)
 {
+	tLocalWorker = worker;
+
+	char name[32];
+	sprintf_s(name, sizeof(name), "Job Worker %u", worker->index);
+	ProfilerSetThreadName(name);
+
 	JobConsumer consumer;
 	consumer.add_category(JOB_GENERIC);
 
+	uint idle_count = 0;
 	while (gJobSystem->is_running) {
-		signal->wait();
-		consumer.consume_all();
+		if (consumer.consume_job()) {
+			idle_count = 0;
+			continue;
+		}
+
+		++idle_count;
+		if (idle_count < JOB_WORKER_SPIN_COUNT) {
+			ThreadYield();
+		}
+		else {
+			JobWorkerSleep(worker);
+			idle_count = 0;
+		}
 	}
 
 	consumer.consume_all();
+	tLocalWorker = nullptr;
+}
+
+//------------------------------------------------------------------------
+static void JobRecordLatency(Job *job)
+{
+	uint64_t now = TimeGetOpCount();
+	uint64_t us = TimeOpCountTo_us(now - job->enqueue_ops);
+
+	uint bucket = 0;
+	while ((us > 0) && (bucket < (JOB_LATENCY_BUCKET_COUNT - 1))) {
+		us >>= 1;
+		++bucket;
+	}
+
+	AtomicIncrement(&gJobSystem->latency[job->priority][bucket]);
+	if ((0 != job->deadline_ops) && (now > job->deadline_ops)) {
+		AtomicIncrement(&gJobSystem->missed_deadlines[job->priority]);
+	}
+}
+
+//------------------------------------------------------------------------
+static void JobExecute(Job *job)
+{
+	PROFILE_LOG_SCOPE_CATEGORY("JobExecute", gJobSystem->profile_tags[job->type]);
+	JobRecordLatency(job);
+	job->state = RUNNING;
+
+	job->work_cb(job->user_data);
+
+	job->on_finish();
+
+	// group may be gone the moment this hits zero, don't touch it after
+	JobGroup *group = job->group;
+	if (nullptr != group) {
+		AtomicDecrement(&group->pending);
+	}
+
+	JobRelease(job);
 }
 
 //------------------------------------------------------------------------
@@ -39,11 +447,24 @@ void Job::on_finish()
 {
 	state = FINISHED;
 
-	for (uint i = 0; i < dependents.size(); ++i) {
+	uint inline_count = (dependent_count < JOB_INLINE_DEPENDENT_COUNT) ? dependent_count : JOB_INLINE_DEPENDENT_COUNT;
+	for (uint i = 0; i < inline_count; ++i) {
 		dependents[i]->on_dependancy_finished();
 	}
 
-	dependents.clear();
+	job_dependent_chunk_t *chunk = dependent_chunks;
+	while (nullptr != chunk) {
+		for (uint i = 0; i < chunk->count; ++i) {
+			chunk->jobs[i]->on_dependancy_finished();
+		}
+
+		job_dependent_chunk_t *next = chunk->next;
+		gJobAlloc->free(chunk);
+		chunk = next;
+	}
+
+	dependent_chunks = nullptr;
+	dependent_count = 0;
 }
 
 //------------------------------------------------------------------------
@@ -59,73 +480,157 @@ void Job::dependent_on(Job *parent)
 
 	AtomicIncrement(&num_dependencies);
 	JobAcquire(this);
-	parent->dependents.push_back(this);
+	parent->add_dependent(this);
+}
+
+//------------------------------------------------------------------------
+// First few go inline, the rest into chunks borrowed from the job pool.
+void Job::add_dependent(Job *child)
+{
+	if (dependent_count < JOB_INLINE_DEPENDENT_COUNT) {
+		dependents[dependent_count] = child;
+		++dependent_count;
+		return;
+	}
+
+	job_dependent_chunk_t *chunk = dependent_chunks;
+	if ((nullptr == chunk) || (chunk->count == JOB_DEPENDENT_CHUNK_COUNT)) {
+		chunk = (job_dependent_chunk_t*)gJobAlloc->alloc(sizeof(job_dependent_chunk_t));
+		chunk->count = 0;
+		chunk->next = dependent_chunks;
+		dependent_chunks = chunk;
+	}
+
+	chunk->jobs[chunk->count] = child;
+	++chunk->count;
+	++dependent_count;
+}
+
+//------------------------------------------------------------------------
+static std::string JobCategoryName(uint category)
+{
+	static char const *names[JOB_TYPE_COUNT] = { "job_generic", "job_main", "job_io", "job_render", "job_logger" };
+	if (category < JOB_TYPE_COUNT) {
+		return names[category];
+	}
+
+	char name[32];
+	sprintf_s(name, sizeof(name), "job_%u", category);
+	return name;
 }
 
 //------------------------------------------------------------------------
 void JobSystemStartup(uint job_category_count, int generic_thread_count /*= -1*/)
 {
-	int core_count = (int)std::thread::hardware_concurrency();
+	// positive is an exact count, zero or negative is relative to the core count
+	int worker_count = generic_thread_count;
 	if (generic_thread_count <= 0) {
-		core_count += generic_thread_count;
+		worker_count = (int)std::thread::hardware_concurrency() + generic_thread_count;
+	}
+	if (worker_count < 1) {
+		worker_count = 1;
 	}
-	core_count--; // one is always being created - so subtract from total wanted;
 
-	gJobAlloc = new BlockAllocator(sizeof(Job) * job_category_count);
+	gJobAlloc = new LocklessBlockAllocator(sizeof(Job));
 	
 	// We need queues! 
 	gJobSystem = new JobSystem();
-	gJobSystem->queues = new ThreadSafeQueue<Job*>[job_category_count];
+	gJobSystem->queues = new JobQueue[job_category_count];
 	gJobSystem->signals = new Signal*[job_category_count];
 	gJobSystem->queue_count = job_category_count;
 	gJobSystem->is_running = true;
 
+	gJobSystem->profile_tags = new uint[job_category_count];
 	for (uint i = 0; i < job_category_count; ++i) {
 		gJobSystem->signals[i] = nullptr;
+		gJobSystem->profile_tags[i] = ProfilerInternTag(JobCategoryName(i).c_str());
+	}
+	JobSystemResetLatency();
+
+	// generic work is woken per worker, not through a category signal
+	gJobSystem->worker_count = (uint)worker_count;
+	gJobSystem->workers = new JobWorker[worker_count];
+	gJobSystem->sleeping_count = 0;
+
+	for (uint i = 0; i < gJobSystem->worker_count; ++i) {
+		JobWorker *worker = &gJobSystem->workers[i];
+		worker->index = i;
+		worker->is_sleeping = false;
+		worker->thread = INVALID_THREAD_HANDLE;
 	}
 
-	// create the signal
-	gJobSystem->signals[JOB_GENERIC] = new Signal();
-
-	ThreadCreate(GenericJobThread, gJobSystem->signals[JOB_GENERIC]);
-	for (int i = 0; i < core_count; ++i) {
-		ThreadCreate(GenericJobThread, gJobSystem->signals[JOB_GENERIC]);
+	// start threads only once every worker exists, they steal from each other immediately
+	for (uint i = 0; i < gJobSystem->worker_count; ++i) {
+		gJobSystem->workers[i].thread = ThreadCreate(GenericJobThread, &gJobSystem->workers[i]);
 	}
 }
 
 //------------------------------------------------------------------------
 void JobSystemShutdown()
 {
-	uint loop_count = gJobSystem->queue_count;
+	gJobSystem->is_running = false;
+
+	// workers drain generic work before exiting
+	for (uint i = 0; i < gJobSystem->worker_count; ++i) {
+		gJobSystem->workers[i].signal.signal_all();
+	}
+
+	for (uint i = 0; i < gJobSystem->worker_count; ++i) {
+		ThreadJoin(gJobSystem->workers[i].thread);
+	}
+
+	// Anything left in a worker deque or a category nobody consumed is dropped.
+	// Releasing a job that never ran releases everything waiting on it too, so
+	// every payload is destroyed before the pool they live in goes.
+	Job* job = nullptr;
+	for (uint i = 0; i < gJobSystem->worker_count; ++i) {
+		while (gJobSystem->workers[i].deque.steal(&job)) {
+			JobRelease(job);
+		}
+	}
 
-	for (uint index = 0; index < loop_count; ++index)
+	for (uint index = 0; index < gJobSystem->queue_count; ++index)
 	{
-		ThreadSafeQueue<Job*> queue = gJobSystem->queues[index];
-		if (!queue.empty())
+		while (gJobSystem->queues[index].pop(&job))
 		{
-			Job* job = nullptr;
-			while (queue.pop(&job))
-			{
-				JobDispatchAndRelease(job);
-			}
+			JobRelease(job);
 		}
 	}
 
-	delete gJobAlloc;
+	// only jobs someone still holds a ref to are left, their payloads leak
+	block_allocator_stats_t stats;
+	gJobAlloc->get_stats(&stats);
+	ASSERT_RECOVERABLE(0 == stats.live_blocks, "Jobs were still referenced at job system shutdown");
+
+	delete[] gJobSystem->workers;
+	delete[] gJobSystem->signals;
+	delete[] gJobSystem->profile_tags;
+	delete[] gJobSystem->queues;
 	delete gJobSystem;
+	gJobSystem = nullptr;
+
+	delete gJobAlloc;
+	gJobAlloc = nullptr;
 }
 
 //------------------------------------------------------------------------
 Job* JobCreate(uint category, job_work_cb work_cb, void *user_data)
 {
 	Job* job = nullptr;
-	job = gJobAlloc->create<Job>();
+	job = (Job*)gJobAlloc->alloc(sizeof(Job));
 	job->type = static_cast<eJobType>(category);
 	job->work_cb = work_cb;
 	job->user_data = user_data;
 	job->num_dependencies = 1;
 	job->ref_count = 1;
 	job->state = WAITING;
+	job->group = nullptr;
+	job->destroy_cb = nullptr;
+	job->dependent_chunks = nullptr;
+	job->dependent_count = 0;
+	job->priority = JOB_PRIORITY_NORMAL;
+	job->deadline_ops = 0;
+	job->enqueue_ops = 0;
 
 	return job;
 }
@@ -153,8 +658,14 @@ void JobDispatch(Job *job)
 	}
 
 	job->state = ENQUEUED;
+	job->enqueue_ops = TimeGetOpCount();
 
 	JobAcquire(job);
+	if (JOB_GENERIC == job->type) {
+		JobSystemPushGeneric(job);
+		return;
+	}
+
 	gJobSystem->queues[job->type].push(job);
 
 	Signal *signal = gJobSystem->signals[job->type];
@@ -167,6 +678,29 @@ void JobRelease(Job *job)
 {
 	uint ref_count = AtomicDecrement(&job->ref_count);
 	if (0 == ref_count) {
+		if (nullptr != job->destroy_cb) {
+			job->destroy_cb(job->user_data);
+		}
+
+		// Never ran, so its dependents are still waiting on it and will never run
+		// either - drop the ref each one took in dependent_on so they go too.
+		// A finished job already handed these off in on_finish.
+		uint inline_count = (job->dependent_count < JOB_INLINE_DEPENDENT_COUNT) ? job->dependent_count : JOB_INLINE_DEPENDENT_COUNT;
+		for (uint i = 0; i < inline_count; ++i) {
+			JobRelease(job->dependents[i]);
+		}
+
+		job_dependent_chunk_t *chunk = job->dependent_chunks;
+		while (nullptr != chunk) {
+			for (uint i = 0; i < chunk->count; ++i) {
+				JobRelease(chunk->jobs[i]);
+			}
+
+			job_dependent_chunk_t *next = chunk->next;
+			gJobAlloc->free(chunk);
+			chunk = next;
+		}
+
 		gJobAlloc->free(job);
 	}
 }
@@ -208,7 +742,124 @@ void JobSystemSetCategorySignal(uint cat_id, Signal *signal)
 	gJobSystem->signals[cat_id] = signal;
 }
 
-ThreadSafeQueue<Job*>* JobSystemGetQueue(uint category)
+uint JobSystemGetWorkerCount()
+{
+	if (nullptr == gJobSystem) {
+		return 0;
+	}
+
+	return gJobSystem->worker_count;
+}
+
+//------------------------------------------------------------------------
+// Must be called before the job is dispatched.
+void JobSetPriority(Job *job, eJobPriority priority)
+{
+	ASSERT_OR_DIE(job->state < ENQUEUED, "Job was already dispatched!");
+	job->priority = priority;
+}
+
+//------------------------------------------------------------------------
+void JobSetDeadline(Job *job, double ms_from_now)
+{
+	ASSERT_OR_DIE(job->state < ENQUEUED, "Job was already dispatched!");
+	if (ms_from_now < 0.0) {
+		ms_from_now = 0.0;
+	}
+
+	job->deadline_ops = TimeGetOpCount() + TimeOpCountFrom_ms(ms_from_now);
+}
+
+//------------------------------------------------------------------------
+void JobSystemGetLatencyHistogram(eJobPriority priority, uint *out_buckets, uint *out_missed_deadlines /*= nullptr*/)
+{
+	for (uint i = 0; i < JOB_LATENCY_BUCKET_COUNT; ++i) {
+		out_buckets[i] = gJobSystem->latency[priority][i];
+	}
+
+	if (nullptr != out_missed_deadlines) {
+		*out_missed_deadlines = gJobSystem->missed_deadlines[priority];
+	}
+}
+
+//------------------------------------------------------------------------
+void JobSystemResetLatency()
+{
+	memset(gJobSystem->latency, 0, sizeof(gJobSystem->latency));
+	memset(gJobSystem->missed_deadlines, 0, sizeof(gJobSystem->missed_deadlines));
+}
+
+//------------------------------------------------------------------------
+// Bucket N holds jobs that waited less than 2^N us in a queue.
+static uint JobLatencyBucketLimit_us(uint bucket)
+{
+	return (0 == bucket) ? 1 : (1U << bucket);
+}
+
+static uint JobLatencyPercentile_us(uint const *buckets, uint total, float percentile)
+{
+	uint target = (uint)((float)total * percentile);
+	uint running = 0;
+	for (uint i = 0; i < JOB_LATENCY_BUCKET_COUNT; ++i) {
+		running += buckets[i];
+		if (running > target) {
+			return JobLatencyBucketLimit_us(i);
+		}
+	}
+
+	return JobLatencyBucketLimit_us(JOB_LATENCY_BUCKET_COUNT - 1);
+}
+
+void JobSystemReportLatency()
+{
+	static char const *PRIORITY_NAMES[JOB_PRIORITY_COUNT] = { "critical", "high", "normal", "low" };
+
+	for (uint priority = 0; priority < JOB_PRIORITY_COUNT; ++priority) {
+		uint buckets[JOB_LATENCY_BUCKET_COUNT];
+		uint missed = 0;
+		JobSystemGetLatencyHistogram((eJobPriority)priority, buckets, &missed);
+
+		uint total = 0;
+		for (uint i = 0; i < JOB_LATENCY_BUCKET_COUNT; ++i) {
+			total += buckets[i];
+		}
+
+		if (0 == total) {
+			continue;
+		}
+
+		LogPrint("Job latency [%s]: %u jobs, p50 < %u us, p99 < %u us, %u missed deadlines",
+			PRIORITY_NAMES[priority], total,
+			JobLatencyPercentile_us(buckets, total, .5f),
+			JobLatencyPercentile_us(buckets, total, .99f),
+			missed);
+
+		for (uint i = 0; i < JOB_LATENCY_BUCKET_COUNT; ++i) {
+			if (0 != buckets[i]) {
+				LogPrint("    < %u us: %u", JobLatencyBucketLimit_us(i), buckets[i]);
+			}
+		}
+	}
+}
+
+//------------------------------------------------------------------------
+static void JobLatencyReportCmd(void*)
+{
+	JobSystemReportLatency();
+}
+
+static void JobLatencyResetCmd(void*)
+{
+	JobSystemResetLatency();
+}
+
+void RegisterJobCommands()
+{
+	g_console->RegisterCommand("JobLatency", JobLatencyReportCmd);
+	g_console->RegisterCommand("JobLatencyReset", JobLatencyResetCmd);
+}
+
+JobQueue* JobSystemGetQueue(uint category)
 {
 	if (category >= gJobSystem->queue_count) {
 		return nullptr;
@@ -219,7 +870,13 @@ ThreadSafeQueue<Job*>* JobSystemGetQueue(uint category)
 
 void JobConsumer::add_category(uint category)
 {
-	ThreadSafeQueue<Job*>* queue = JobSystemGetQueue(category);
+	// generic work is spread over the worker deques, not a single queue
+	if (JOB_GENERIC == category) {
+		consumes_generic = true;
+		return;
+	}
+
+	JobQueue* queue = JobSystemGetQueue(category);
 	if (nullptr == queue)
 		return;
 
@@ -230,26 +887,112 @@ void JobConsumer::add_category(uint category)
 
 bool JobConsumer::consume_job()
 {
+	if (JOB_CONSUME_URGENT == mode) {
+		return consume_urgent_job();
+	}
+
 	Job *job = nullptr;
 	for (uint i = 0; i < queues.size(); ++i) {
-		ThreadSafeQueue<Job*> *queue = queues[i];
+		JobQueue *queue = queues[i];
 		if (queue->pop(&job)) {
+			JobExecute(job);
+			return true;
+		}
+	}
 
-			job->state = RUNNING;
+	if (consumes_generic && JobSystemPopGeneric(&job)) {
+		JobExecute(job);
+		return true;
+	}
 
-			job->work_cb(job->user_data);
+	return false;
+}
 
-			job->on_finish();
-			job->dependents.clear();
+//------------------------------------------------------------------------
+// Picks the queue whose head is most urgent - overdue deadlines, then priority,
+// then earliest deadline.  Generic work is compared through the shared queue,
+// worker deques only ever hold normal priority work so they come last.
+bool JobConsumer::consume_urgent_job()
+{
+	JobQueue *best = nullptr;
+	uint best_priority = JOB_PRIORITY_COUNT;
+	uint64_t best_deadline = UINT64_MAX;
+
+	uint queue_count = (uint)queues.size();
+	for (uint i = 0; i <= queue_count; ++i) {
+		JobQueue *queue = nullptr;
+		if (i < queue_count) {
+			queue = queues[i];
+		}
+		else if (consumes_generic) {
+			queue = &gJobSystem->queues[JOB_GENERIC];
+		}
+		else {
+			break;
+		}
 
-			JobRelease(job);
+		uint priority;
+		uint64_t deadline;
+		if (!queue->peek_urgency(&priority, &deadline)) {
+			continue;
+		}
+
+		if ((priority < best_priority) || ((priority == best_priority) && (deadline < best_deadline))) {
+			best = queue;
+			best_priority = priority;
+			best_deadline = deadline;
+		}
+	}
+
+	Job *job = nullptr;
+	if ((nullptr != best) && best->pop(&job)) {
+		JobExecute(job);
+		return true;
+	}
+
+	// lost a race, or only worker deques have anything - fall back to the normal order
+	for (uint i = 0; i < queues.size(); ++i) {
+		if (queues[i]->pop(&job)) {
+			JobExecute(job);
 			return true;
 		}
 	}
 
+	if (consumes_generic && JobSystemPopGeneric(&job)) {
+		JobExecute(job);
+		return true;
+	}
+
 	return false;
 }
 
+//------------------------------------------------------------------------
+static bool JobConsumerHasUrgentWork(std::vector<JobQueue*> const &queues, bool consumes_generic)
+{
+	uint queue_count = (uint)queues.size();
+	for (uint i = 0; i <= queue_count; ++i) {
+		JobQueue *queue = nullptr;
+		if (i < queue_count) {
+			queue = queues[i];
+		}
+		else if (consumes_generic) {
+			queue = &gJobSystem->queues[JOB_GENERIC];
+		}
+		else {
+			break;
+		}
+
+		uint priority;
+		uint64_t deadline;
+		if (queue->peek_urgency(&priority, &deadline) && (JOB_PRIORITY_CRITICAL == priority)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//------------------------------------------------------------------------
 uint JobConsumer::consume_all()
 {
 	uint count = 0;
@@ -273,9 +1016,63 @@ uint JobConsumer::consume_for_ms(uint ms)
 		++count;
 	} while ((TimeGet_ms() - start) < ms);
 
+	// out of budget, but critical and overdue work doesn't wait for next frame
+	if (JOB_CONSUME_URGENT == mode) {
+		while (JobConsumerHasUrgentWork(queues, consumes_generic) && consume_job()) {
+			++count;
+		}
+	}
+
 	return count;
 }
 
+//------------------------------------------------------------------------
+void JobGroup::add(Job *job)
+{
+	ASSERT_OR_DIE(job->state < ENQUEUED, "Job was already dispatched!");
+
+	AtomicIncrement(&pending);
+	job->group = this;
+}
+
+//------------------------------------------------------------------------
+void JobGroup::run(uint category, job_work_cb cb, void *user_data)
+{
+	Job *job = JobCreate(category, cb, user_data);
+	add(job);
+	JobDispatchAndRelease(job);
+}
+
+//------------------------------------------------------------------------
+void JobGroup::wait(JobConsumer *consumer /*= nullptr*/)
+{
+	JobConsumer local_consumer;
+	if (nullptr == consumer) {
+		local_consumer.add_category(JOB_GENERIC);
+		consumer = &local_consumer;
+	}
+
+	while (!is_finished()) {
+		if (!consumer->consume_job()) {
+			ThreadYield();
+		}
+	}
+}
+
+//------------------------------------------------------------------------
+int JobParallelForGetGrain(int count, int grain)
+{
+	if (grain > 0) {
+		return grain;
+	}
+
+	// aim for a handful of chunks per participant so stragglers can be picked up
+	int participants = (int)JobSystemGetWorkerCount() + 1;
+	grain = count / (participants * 8);
+	return (grain > 0) ? grain : 1;
+}
+
+//------------------------------------------------------------------------
 static void EmptyJob(void *ptr)
 {
 	uint *count_ptr = (uint*)ptr;
@@ -283,13 +1080,14 @@ static void EmptyJob(void *ptr)
 }
 
 static bool gDone = false;
+static uint gExpectedCount = 0;
 static void OnEverythingDone(void *ptr)
 {
 	uint *count_ptr = (uint*)ptr;
 
-	// assert count_ptr is 1000 [make sure all other jobs got to run first!]
+	// assert count_ptr is what we dispatched [make sure all other jobs got to run first!]
 	uint count = *count_ptr;
-	if (count != 1000) {
+	if (count != gExpectedCount) {
 		__debugbreak();
 	}
 
@@ -306,6 +1104,7 @@ void JobSystemTest()
 	{
 		PROFILE_LOG_SCOPE("JobDispatchAndReleaseTime");
 		uint count = 0;
+		gExpectedCount = 1000;
 		Job *final_job = JobCreate(JOB_GENERIC, OnEverythingDone, &count);
 
 		for (uint i = 0; i < 1000; ++i) {
@@ -325,4 +1124,267 @@ void JobSystemTest()
 			__debugbreak();
 		}
 	}
-}
\ No newline at end of file
+
+	// Parallel for should touch every index exactly once
+	{
+		uint const count = 100000;
+		uint *touched = new uint[count];
+		memset(touched, 0, sizeof(uint) * count);
+
+		JobParallelFor(0, (int)count, 0, [=](int index) {
+			AtomicIncrement(&touched[index]);
+		});
+
+		for (uint i = 0; i < count; ++i) {
+			if (touched[i] != 1) {
+				__debugbreak();
+			}
+		}
+
+		delete[] touched;
+	}
+
+	// Lambda payloads - final job has far more dependents than fit inline
+	{
+		uint run_count = 0;
+		Job *final_job = JobCreate(JOB_GENERIC, [&run_count]() { AtomicIncrement(&run_count); });
+		for (uint i = 0; i < 100; ++i) {
+			job = JobCreate(JOB_GENERIC, [&run_count]() { AtomicIncrement(&run_count); });
+			final_job->dependent_on(job);
+			JobDispatchAndRelease(job);
+		}
+
+		JobDispatch(final_job);
+		JobWaitAndRelease(final_job);
+		if (run_count != 101) {
+			__debugbreak();
+		}
+	}
+
+	// Priorities - nothing else consumes JOB_IO here, so the order is deterministic
+	{
+		uint order[4];
+		uint next = 0;
+		uint *order_ptr = order;
+		uint *next_ptr = &next;
+
+		Job *low = JobCreate(JOB_IO, [order_ptr, next_ptr]() { order_ptr[(*next_ptr)++] = JOB_PRIORITY_LOW; });
+		Job *normal = JobCreate(JOB_IO, [order_ptr, next_ptr]() { order_ptr[(*next_ptr)++] = JOB_PRIORITY_NORMAL; });
+		Job *high = JobCreate(JOB_IO, [order_ptr, next_ptr]() { order_ptr[(*next_ptr)++] = JOB_PRIORITY_HIGH; });
+		Job *overdue = JobCreate(JOB_IO, [order_ptr, next_ptr]() { order_ptr[(*next_ptr)++] = JOB_PRIORITY_CRITICAL; });
+		JobSetPriority(low, JOB_PRIORITY_LOW);
+		JobSetPriority(high, JOB_PRIORITY_HIGH);
+		JobSetPriority(overdue, JOB_PRIORITY_LOW);
+		JobSetDeadline(overdue, 0.0);
+
+		JobDispatchAndRelease(low);
+		JobDispatchAndRelease(normal);
+		JobDispatchAndRelease(high);
+		JobDispatchAndRelease(overdue);
+
+		// an aging pop would take low first - start the count where none lands in these four
+		gJobSystem->queues[JOB_IO].pop_count = 0;
+
+		JobConsumer consumer;
+		consumer.add_category(JOB_IO);
+		consumer.set_mode(JOB_CONSUME_URGENT);
+		consumer.consume_all();
+
+		// overdue low jumps everything, then strictly by priority
+		if ((next != 4) 
+			|| (order[0] != JOB_PRIORITY_CRITICAL) 
+			|| (order[1] != JOB_PRIORITY_HIGH) 
+			|| (order[2] != JOB_PRIORITY_NORMAL) 
+			|| (order[3] != JOB_PRIORITY_LOW)) {
+			__debugbreak();
+		}
+	}
+
+	JobSystemAllocationBenchmark(10000);
+	BlockAllocatorBenchmark(JobSystemGetWorkerCount() + 1, 200000);
+
+	// And now make sure it holds up under load
+	JobSystemBenchmark(1000000);
+	JobSystemReportLatency();
+}
+
+//------------------------------------------------------------------------
+struct job_spawn_test_t
+{
+	uint *count;
+	uint child_count;
+};
+
+static void SpawnChildrenJob(void *ptr)
+{
+	job_spawn_test_t *spawn = (job_spawn_test_t*)ptr;
+	uint child_count = spawn->child_count;
+	uint *count = spawn->count;
+
+	// dispatched from a worker, so these land in its local deque
+	for (uint i = 0; i < child_count; ++i) {
+		Job *child = JobCreate(JOB_GENERIC, EmptyJob, count);
+		JobDispatchAndRelease(child);
+	}
+}
+
+static void LogJobThroughput(char const *name, uint job_count, uint64_t op_count)
+{
+	double ms = TimeOpCountTo_ms(op_count);
+	double jobs_per_second = (ms > 0.0) ? ((double)job_count * 1000.0 / ms) : 0.0;
+	LogPrint("JobSystemBenchmark [%s]: %u jobs on %u workers in %.2f ms (%.0f jobs/sec)", 
+		name, job_count, gJobSystem->worker_count, ms, jobs_per_second);
+}
+
+//------------------------------------------------------------------------
+void JobSystemBenchmark(uint job_count)
+{
+	// the calling thread helps drain, same as any other waiter would
+	JobConsumer consumer;
+	consumer.add_category(JOB_GENERIC);
+
+	// Fan in - everything is dispatched from here, so workers pull from the shared queue
+	{
+		uint count = 0;
+		gExpectedCount = job_count;
+
+		uint64_t start = TimeGetOpCount();
+		Job *final_job = JobCreate(JOB_GENERIC, OnEverythingDone, &count);
+		for (uint i = 0; i < job_count; ++i) {
+			Job *job = JobCreate(JOB_GENERIC, EmptyJob, &count);
+			final_job->dependent_on(job);
+			JobDispatchAndRelease(job);
+		}
+
+		JobDispatch(final_job);
+		JobWaitAndRelease(final_job, &consumer);
+		LogJobThroughput("fan-in", job_count, TimeGetOpCount() - start);
+	}
+
+	// Spawn - jobs are created by jobs, so they go to worker deques and get stolen
+	{
+		uint count = 0;
+		uint spawner_count = gJobSystem->worker_count * 4;
+
+		job_spawn_test_t spawn;
+		spawn.count = &count;
+		spawn.child_count = job_count / spawner_count;
+		uint expected = spawn.child_count * spawner_count;
+
+		uint64_t start = TimeGetOpCount();
+
+		// join on the spawners so [spawn] outlives them
+		uint join_count = 0;
+		Job *spawners_done = JobCreate(JOB_GENERIC, EmptyJob, &join_count);
+		for (uint i = 0; i < spawner_count; ++i) {
+			Job *spawner = JobCreate(JOB_GENERIC, SpawnChildrenJob, &spawn);
+			spawners_done->dependent_on(spawner);
+			JobDispatchAndRelease(spawner);
+		}
+
+		JobDispatch(spawners_done);
+		JobWaitAndRelease(spawners_done, &consumer);
+
+		while (*(volatile uint*)&count < expected) {
+			if (!consumer.consume_job()) {
+				ThreadYield();
+			}
+		}
+
+		LogJobThroughput("spawn", expected, TimeGetOpCount() - start);
+	}
+
+	block_allocator_stats_t stats;
+	gJobAlloc->get_stats(&stats);
+	LogPrint("JobSystemBenchmark [pool]: %u slabs, %u blocks of %u bytes, %u live, %u magazine allocs, %u shared pops",
+		stats.slab_count, stats.block_capacity, (uint)stats.block_size, stats.live_blocks, 
+		stats.magazine_allocs, stats.shared_allocs);
+}
+
+//------------------------------------------------------------------------
+struct legacy_job_payload_t
+{
+	uint *count;
+	uint value;
+};
+
+static void LegacyPayloadJob(void *ptr)
+{
+	legacy_job_payload_t *payload = (legacy_job_payload_t*)ptr;
+	AtomicAdd(payload->count, payload->value);
+	delete payload;
+}
+
+//------------------------------------------------------------------------
+// Counts heap allocations made per job for the old heap payload style vs
+// lambda payloads stored inside the job.  Only operator new is counted, so
+// this reports zero everywhere when TRACK_MEMORY is off.
+void JobSystemAllocationBenchmark(uint job_count)
+{
+#if !defined(TRACK_MEMORY)
+	LogPrint("JobSystemAllocationBenchmark: TRACK_MEMORY is off, allocation counts unavailable.");
+#endif
+
+	JobConsumer consumer;
+	consumer.add_category(JOB_GENERIC);
+
+	// warm up the job pool and queues so the steady state is what gets measured
+	{
+		uint count = 0;
+		Job *final_job = JobCreate(JOB_GENERIC, [](){});
+		for (uint i = 0; i < job_count; ++i) {
+			Job *job = JobCreate(JOB_GENERIC, EmptyJob, &count);
+			final_job->dependent_on(job);
+			JobDispatchAndRelease(job);
+		}
+		JobDispatch(final_job);
+		JobWaitAndRelease(final_job, &consumer);
+	}
+
+	// legacy - payload is new'd by the caller and deleted by the job
+	{
+		uint count = 0;
+		uint start_allocs = GetFrameAllocs();
+		uint64_t start = TimeGetOpCount();
+
+		Job *final_job = JobCreate(JOB_GENERIC, [](){});
+		for (uint i = 0; i < job_count; ++i) {
+			legacy_job_payload_t *payload = new legacy_job_payload_t();
+			payload->count = &count;
+			payload->value = 1;
+
+			Job *job = JobCreate(JOB_GENERIC, LegacyPayloadJob, payload);
+			final_job->dependent_on(job);
+			JobDispatchAndRelease(job);
+		}
+		JobDispatch(final_job);
+		JobWaitAndRelease(final_job, &consumer);
+
+		uint allocs = GetFrameAllocs() - start_allocs;
+		LogPrint("JobSystemAllocationBenchmark [legacy]: %u jobs, %u allocs (%.2f per job), %.2f ms",
+			job_count, allocs, (double)allocs / (double)job_count, TimeOpCountTo_ms(TimeGetOpCount() - start));
+	}
+
+	// lambda - captures live in the job's inline payload
+	{
+		uint count = 0;
+		uint start_allocs = GetFrameAllocs();
+		uint64_t start = TimeGetOpCount();
+
+		Job *final_job = JobCreate(JOB_GENERIC, [](){});
+		for (uint i = 0; i < job_count; ++i) {
+			uint *count_ptr = &count;
+			uint value = 1;
+
+			Job *job = JobCreate(JOB_GENERIC, [count_ptr, value]() { AtomicAdd(count_ptr, value); });
+			final_job->dependent_on(job);
+			JobDispatchAndRelease(job);
+		}
+		JobDispatch(final_job);
+		JobWaitAndRelease(final_job, &consumer);
+
+		uint allocs = GetFrameAllocs() - start_allocs;
+		LogPrint("JobSystemAllocationBenchmark [lambda]: %u jobs, %u allocs (%.2f per job), %.2f ms",
+			job_count, allocs, (double)allocs / (double)job_count, TimeOpCountTo_ms(TimeGetOpCount() - start));
+	}
+}
@@ -6,6 +6,10 @@
 #include "Engine/Core/Signal.hpp"
 #include "Engine/Core/Atomic.hpp"
 #include <vector>
+#include <stdint.h>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 
 enum eJobType : uint
@@ -26,7 +30,49 @@ enum eJobState : uint
 	FINISHED
 };
 
+// Lower value is more urgent.  Every category queue keeps one level per priority.
+enum eJobPriority : uint
+{
+	JOB_PRIORITY_CRITICAL = 0,	// needed this frame
+	JOB_PRIORITY_HIGH,
+	JOB_PRIORITY_NORMAL,
+	JOB_PRIORITY_LOW,			// background work - saving, prefetching
+	JOB_PRIORITY_COUNT,
+};
+
+enum eJobConsumeMode : uint
+{
+	JOB_CONSUME_IN_ORDER,	// categories in the order they were added
+	JOB_CONSUME_URGENT,		// most urgent job over all categories, runs past consume_for_ms budget for critical/overdue work
+};
+
+// every Nth pop from a queue services the lowest non-empty level first so nothing starves
+uint const JOB_PRIORITY_AGING_INTERVAL = 16;
+
+// queue latency histogram buckets are powers of two in microseconds, last one is everything above
+uint const JOB_LATENCY_BUCKET_COUNT = 20;
+
 typedef void(*job_work_cb)(void*);
+typedef void(*job_destroy_cb)(void*);
+
+// Callables handed to JobCreate live inside the Job block, so they must fit here
+uint const JOB_PAYLOAD_SIZE = 64;
+uint const JOB_PAYLOAD_ALIGN = 16;
+
+// Most jobs have one or two dependents, more than this chains overflow blocks
+uint const JOB_INLINE_DEPENDENT_COUNT = 4;
+uint const JOB_DEPENDENT_CHUNK_COUNT = 14;
+
+class Job;
+class JobGroup;
+class JobQueue;
+
+struct job_dependent_chunk_t
+{
+	Job *jobs[JOB_DEPENDENT_CHUNK_COUNT];
+	uint count;
+	job_dependent_chunk_t *next;
+};
 
 class Job
 {
@@ -34,16 +80,25 @@ public:
 	eJobType type;
 	job_work_cb work_cb;
 	void *user_data;
-	std::vector<Job*> dependents;
+	job_destroy_cb destroy_cb; // set when user_data is an inline payload
+	Job *dependents[JOB_INLINE_DEPENDENT_COUNT];
+	job_dependent_chunk_t *dependent_chunks;
+	uint dependent_count;
 	uint num_dependencies;
 	uint dispatch_count;
 	uint ref_count;
 	eJobState state;
+	JobGroup *group;
+	eJobPriority priority;
+	uint64_t deadline_ops; // 0 when there is no deadline
+	uint64_t enqueue_ops; // when the job actually hit a queue
+	std::aligned_storage<JOB_PAYLOAD_SIZE, JOB_PAYLOAD_ALIGN>::type payload;
 
 public:
 	void on_finish();
 	void on_dependancy_finished();
 	void dependent_on(Job *parent);
+	void add_dependent(Job *child);
 	inline bool is_finished() const { return state == FINISHED; }
 };
 
@@ -54,8 +109,15 @@ public:
 	bool consume_job();
 	uint consume_all();
 	uint consume_for_ms(uint ms);
+	inline void set_mode(eJobConsumeMode consume_mode) { mode = consume_mode; }
+
+private:
+	bool consume_urgent_job();
+
 public:
-	std::vector<ThreadSafeQueue<Job*>*> queues;
+	std::vector<JobQueue*> queues;
+	bool consumes_generic = false;
+	eJobConsumeMode mode = JOB_CONSUME_IN_ORDER;
 };
 
 void JobSystemStartup(uint job_category_count, int generic_thread_count = -1);
@@ -70,6 +132,159 @@ void JobSystemSetCategorySignal(uint cat_id, Signal *signal);
 void JobWait(Job *job, JobConsumer *consumer);
 void JobWaitAndRelease(Job *job, JobConsumer *consumer = nullptr);
 void JobAcquire(Job *job);
+uint JobSystemGetWorkerCount();
+void JobSetPriority(Job *job, eJobPriority priority);
+void JobSetDeadline(Job *job, double ms_from_now);
+void JobSystemGetLatencyHistogram(eJobPriority priority, uint *out_buckets, uint *out_missed_deadlines = nullptr);
+void JobSystemResetLatency();
+void JobSystemReportLatency();
+void RegisterJobCommands();
+void JobSystemAllocationBenchmark(uint job_count);
+
+//------------------------------------------------------------------------
+// Callable jobs - the callable is stored in Job::payload, no heap involved.
+//------------------------------------------------------------------------
+template <typename CB>
+void JobInvokePayload(void *ptr)
+{
+	(*(CB*)ptr)();
+}
+
+template <typename CB>
+void JobDestroyPayload(void *ptr)
+{
+	((CB*)ptr)->~CB();
+}
+
+//------------------------------------------------------------------------
+template <typename CB>
+Job* JobCreate(uint category, CB &&cb)
+{
+	typedef typename std::decay<CB>::type payload_t;
+	static_assert(sizeof(payload_t) <= JOB_PAYLOAD_SIZE, "Job payload too large - capture less, or capture a pointer to it.");
+	static_assert(alignof(payload_t) <= JOB_PAYLOAD_ALIGN, "Job payload is over aligned.");
+
+	Job *job = JobCreate(category, JobInvokePayload<payload_t>, nullptr);
+	job->user_data = new (&job->payload) payload_t(std::forward<CB>(cb));
+	job->destroy_cb = JobDestroyPayload<payload_t>;
+	return job;
+}
+
+//------------------------------------------------------------------------
+template <typename CB>
+void JobRun(uint category, CB &&cb)
+{
+	Job *job = JobCreate(category, std::forward<CB>(cb));
+	JobDispatchAndRelease(job);
+
+	JobConsumer consumer;
+	consumer.add_category(category);
+	consumer.consume_all();
+}
+
 void JobSystemTest();
+void JobSystemBenchmark(uint job_count);
+
+//------------------------------------------------------------------------
+// Fork/join - tracks a set of jobs, wait() helps run work until they are all done.
+class JobGroup
+{
+public:
+	JobGroup() : pending(0) {}
+	~JobGroup() { wait(); }
+
+	// job must not be dispatched yet
+	void add(Job *job);
+	void run(uint category, job_work_cb cb, void *user_data);
+	template <typename CB> void run(uint category, CB &&cb);
+	void wait(JobConsumer *consumer = nullptr);
+	inline bool is_finished() const { return 0 == *(volatile uint const*)&pending; }
+
+public:
+	uint pending;
+};
+
+//------------------------------------------------------------------------
+template <typename CB>
+void JobGroup::run(uint category, CB &&cb)
+{
+	Job *job = JobCreate(category, std::forward<CB>(cb));
+	add(job);
+	JobDispatchAndRelease(job);
+}
+
+//------------------------------------------------------------------------
+// JobParallelFor
+//------------------------------------------------------------------------
+template <typename CB>
+struct parallel_for_t
+{
+	CB const *cb;
+	int end;
+	int grain;
+	std::atomic<int> next;
+};
+
+//------------------------------------------------------------------------
+// Every participant pulls [grain] sized chunks off a shared cursor until the
+// range is gone, so uneven work balances itself.
+template <typename CB>
+void JobParallelForWork(void *ptr)
+{
+	parallel_for_t<CB> *range = (parallel_for_t<CB>*)ptr;
+	for (;;) {
+		int start = range->next.fetch_add(range->grain);
+		if (start >= range->end) {
+			return;
+		}
+
+		int stop = ((range->end - start) > range->grain) ? (start + range->grain) : range->end;
+		for (int index = start; index < stop; ++index) {
+			(*range->cb)(index);
+		}
+	}
+}
+
+int JobParallelForGetGrain(int count, int grain);
+
+//------------------------------------------------------------------------
+// Calls cb(index) for every index in [begin, end).  Blocks until done, the
+// calling thread takes chunks as well.  grain <= 0 picks one based on worker count.
+// Runs inline if the job system is not running.
+template <typename CB>
+void JobParallelFor(int begin, int end, int grain, CB const &cb)
+{
+	if (end <= begin) {
+		return;
+	}
+
+	uint worker_count = JobSystemGetWorkerCount();
+	grain = JobParallelForGetGrain(end - begin, grain);
+	int chunk_count = ((end - begin) + grain - 1) / grain;
+
+	if ((0 == worker_count) || (chunk_count <= 1)) {
+		for (int index = begin; index < end; ++index) {
+			cb(index);
+		}
+		return;
+	}
+
+	parallel_for_t<CB> range;
+	range.cb = &cb;
+	range.end = end;
+	range.grain = grain;
+	range.next = begin;
+
+	// no point waking more helpers than there are chunks left after ours
+	uint helper_count = ((uint)(chunk_count - 1) < worker_count) ? (uint)(chunk_count - 1) : worker_count;
+
+	JobGroup group;
+	for (uint i = 0; i < helper_count; ++i) {
+		group.run(JOB_GENERIC, JobParallelForWork<CB>, &range);
+	}
+
+	JobParallelForWork<CB>(&range);
+	group.wait();
+}
 
 #endif 
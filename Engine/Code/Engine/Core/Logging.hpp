@@ -1,13 +1,179 @@
 #pragma once
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <string>
+#include <type_traits>
 
-void LogTaggedPrintf(char const *tag, char const *format, ...);
-void LogPrint(char const *msg, ...);
+typedef unsigned int uint;
+
+//------------------------------------------------------------------------
+// Callers only copy the format pointer and the raw argument bits into a lock
+// free ring - formatting, timestamps and file writes happen on the logger
+// thread.  Formats that don't live in the executable's read only data (stack
+// buffers, std::string::c_str) are copied along with the arguments.
+//------------------------------------------------------------------------
+uint const LOG_MAX_ARG_BYTES = 1024;
+uint const LOG_MAX_TAGS = 256;
+uint const LOG_TAG_NAME_SIZE = 32;
+
+enum eLogArgType : uint8_t
+{
+	LOG_ARG_INT32,
+	LOG_ARG_INT64,
+	LOG_ARG_DOUBLE,
+	LOG_ARG_POINTER,
+	LOG_ARG_STRING,
+};
+
+struct log_arg_buffer_t
+{
+	uint size = 0;
+	char data[LOG_MAX_ARG_BYTES];
+
+	void write(eLogArgType type, void const *src, uint byte_count);
+	void write_string(char const *str, size_t length);
+};
+
+uint LogInternTag(char const *tag);
+bool LogIsTagEnabled(uint tag_id);
+void LogSubmit(uint tag_id, char const *format, log_arg_buffer_t const &args);
+void LogErrorBreak();
+
+void LogTaggedPrintv(char const *tag, char const *format, va_list variableArgumentList);
 void RegisterLogCommands();
 void LogFlushTest(char const *text);
+void LogFlush();
 void LogTest(int thread_count, int line_count);
 void LogShutdown();
 void LogStartup();
-void LogError(char const *msg, ...);
-void LogWarning(char const *msg, ...);
-void LogCallStackPrint(const char* tag, const char* format, ...);
-void LogConsume();
\ No newline at end of file
+void LogCallStackLines(char const *tag);
+void LogConsume();
+
+void LogDisable(char const *tag);
+void LogEnable(char const *tag);
+void LogDisableAll();
+void LogEnableAll();
+
+
+//------------------------------------------------------------------------
+// Argument Encoding
+//------------------------------------------------------------------------
+template <typename T>
+struct log_arg_type_of
+{
+	typedef typename std::remove_cv<typename std::remove_pointer<T>::type>::type pointee_t;
+
+	static eLogArgType const value = std::is_floating_point<T>::value ? LOG_ARG_DOUBLE
+		: std::is_pointer<T>::value ? (std::is_same<pointee_t, char>::value ? LOG_ARG_STRING : LOG_ARG_POINTER)
+		: (sizeof(T) <= sizeof(int32_t)) ? LOG_ARG_INT32
+		: LOG_ARG_INT64;
+};
+
+template <eLogArgType TYPE>
+using log_arg_tag_t = std::integral_constant<eLogArgType, TYPE>;
+
+template <typename T>
+inline void LogEncodeValue(log_arg_buffer_t &buffer, T const &v, log_arg_tag_t<LOG_ARG_INT32>)
+{
+	int32_t value = (int32_t)v;
+	buffer.write(LOG_ARG_INT32, &value, sizeof(value));
+}
+
+template <typename T>
+inline void LogEncodeValue(log_arg_buffer_t &buffer, T const &v, log_arg_tag_t<LOG_ARG_INT64>)
+{
+	int64_t value = (int64_t)v;
+	buffer.write(LOG_ARG_INT64, &value, sizeof(value));
+}
+
+template <typename T>
+inline void LogEncodeValue(log_arg_buffer_t &buffer, T const &v, log_arg_tag_t<LOG_ARG_DOUBLE>)
+{
+	double value = (double)v;
+	buffer.write(LOG_ARG_DOUBLE, &value, sizeof(value));
+}
+
+template <typename T>
+inline void LogEncodeValue(log_arg_buffer_t &buffer, T const &v, log_arg_tag_t<LOG_ARG_POINTER>)
+{
+	void const *value = (void const*)v;
+	buffer.write(LOG_ARG_POINTER, &value, sizeof(value));
+}
+
+template <typename T>
+inline void LogEncodeValue(log_arg_buffer_t &buffer, T const &v, log_arg_tag_t<LOG_ARG_STRING>)
+{
+	char const *str = (char const*)v;
+	if (nullptr == str) {
+		str = "(null)";
+	}
+	buffer.write_string(str, strlen(str));
+}
+
+template <typename T>
+inline void LogEncodeArg(log_arg_buffer_t &buffer, T const &arg)
+{
+	// arrays (string literals, char buffers) decay to pointers here
+	typedef typename std::decay<T const>::type value_t;
+	value_t value = arg;
+	LogEncodeValue(buffer, value, log_arg_tag_t<log_arg_type_of<value_t>::value>());
+}
+
+inline void LogEncodeArg(log_arg_buffer_t &buffer, std::string const &arg)
+{
+	buffer.write_string(arg.c_str(), arg.size());
+}
+
+inline void LogEncodeArgs(log_arg_buffer_t&) {}
+
+template <typename T, typename ...ARGS>
+inline void LogEncodeArgs(log_arg_buffer_t &buffer, T const &arg, ARGS const&... args)
+{
+	LogEncodeArg(buffer, arg);
+	LogEncodeArgs(buffer, args...);
+}
+
+
+//------------------------------------------------------------------------
+// Logging
+//------------------------------------------------------------------------
+template <typename ...ARGS>
+void LogTaggedPrintf(char const *tag, char const *format, ARGS const&... args)
+{
+	uint tag_id = LogInternTag(tag);
+	if (!LogIsTagEnabled(tag_id)) {
+		return;
+	}
+
+	log_arg_buffer_t buffer;
+	LogEncodeArgs(buffer, args...);
+	LogSubmit(tag_id, format, buffer);
+}
+
+template <typename ...ARGS>
+void LogPrint(char const *msg, ARGS const&... args)
+{
+	LogTaggedPrintf("default", msg, args...);
+}
+
+template <typename ...ARGS>
+void LogWarning(char const *msg, ARGS const&... args)
+{
+	LogTaggedPrintf("warning", msg, args...);
+}
+
+// flushes the log, then dies
+template <typename ...ARGS>
+void LogError(char const *msg, ARGS const&... args)
+{
+	LogTaggedPrintf("error", msg, args...);
+	LogErrorBreak();
+}
+
+template <typename ...ARGS>
+void LogCallStackPrint(const char* tag, const char* format, ARGS const&... args)
+{
+	LogTaggedPrintf(tag, format, args...);
+	LogCallStackLines(tag);
+}
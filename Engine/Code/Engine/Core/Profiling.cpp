@@ -3,6 +3,7 @@
 #include "Engine/Core/CriticalSection.hpp"
 #include "Engine/Core/BuildConfig.hpp"
 #include "Engine/Core/Logging.hpp"
+#include "Engine/Core/Atomic.hpp"
 #include "Engine/EngineConfig.hpp"
 #include <string>
 #include <locale>
@@ -10,1183 +11,1067 @@
 #include <algorithm>
 #include <iomanip>
 #include <sstream>
+#include <atomic>
 
-struct profile_node
+//------------------------------------------------------------------------
+// Each thread records fixed size begin/end events into its own ring.  The
+// owner is the only writer, the collector (main thread, once a frame) is the
+// only reader, so publishing is just a release store of the write cursor.
+// Reports are rebuilt from the last PROFILER_HISTORY_SIZE frames on demand.
+//------------------------------------------------------------------------
+
+// high bit of the tag marks an end event
+static uint const PROFILE_END_FLAG = 0x80000000;
+
+struct profile_event_t
 {
-	profile_node()
-		:tag("")
-		, start(0)
-		, end(0)
-		, allocs(0)
-		, frees(0)
-		, parent(nullptr)
-		, first_child(nullptr)
-		, last_child(nullptr)
-		, prev_sibling(nullptr)
-		, next_sibling(nullptr)
-	{
+	uint64_t time;
+	uint tag;
+	uint allocs;
+	uint frees;
+	uint category;
+};
 
-	}
+// Scopes are kept or dropped whole.  A push only goes in when the ring also
+// has room for the pops of everything open, so a recorded scope always gets
+// its pop.  A push that doesn't fit (or comes while paused) takes everything
+// under it down too, pop included, so the tree never closes the wrong parent.
+struct profile_thread_t
+{
+	profile_event_t *ring;
+	std::atomic<uint64_t> write;
+	uint depth;						// recorded scopes still open
+	uint drop_depth;				// > 0 while inside a dropped scope
+	std::atomic<uint> dropped;		// scopes dropped for a full ring, taken by the collector
+	char pad0[64 - sizeof(profile_event_t*) - sizeof(std::atomic<uint64_t>) - (2 * sizeof(uint)) - sizeof(std::atomic<uint>)];
+
+	// collector side, kept off the owner's line
+	std::atomic<uint64_t> read;
+	char pad1[64 - sizeof(std::atomic<uint64_t>)];
+
+	uint index;
+	uint name_tag;
+	char name[32];
+	profile_thread_t *next;
+};
 
+// one thread's events inside a collected frame
+struct profile_span_t
+{
+	uint thread_index;
+	uint first;
+	uint count;
+};
 
-	const char* tag;
+struct profile_frame_t
+{
 	uint64_t start;
 	uint64_t end;
+	std::vector<profile_event_t> events;
+	std::vector<profile_span_t> spans;
+	uint dropped;		// scopes lost to full rings, every thread
+};
 
-	uint allocs;
-	uint frees;
-
-	profile_node* parent;
-	profile_node* first_child;
-	profile_node* last_child;
-	profile_node* prev_sibling;
-	profile_node* next_sibling;
+// pointer -> tag cache, so pushing by string doesn't need the intern lock
+static uint const TAG_CACHE_SIZE = PROFILER_MAX_TAGS * 2;
+struct tag_cache_entry_t
+{
+	std::atomic<char const*> key;
+	std::atomic<uint> tag;
 };
 
+static std::atomic<bool> g_profilerRunning(false);
+static std::atomic<bool> g_canRecord(true);
+static bool g_resumeRequested = false;
+
+static char const *g_tagNames[PROFILER_MAX_TAGS];
+static std::atomic<uint> g_tagCount(0);
+static CriticalSection g_tagLock;
+static tag_cache_entry_t g_tagCache[TAG_CACHE_SIZE];
+
+static profile_thread_t *volatile g_profileThreads = nullptr;
+static std::atomic<uint> g_profileThreadCount(0);
+static thread_local profile_thread_t *t_profileThread = nullptr;
+
+static profile_frame_t g_frames[PROFILER_HISTORY_SIZE];
+static uint g_frameHead = 0;   // next frame to fill
+static uint g_frameCount = 0;  // frames holding data
 
-static profile_node* g_profilerRoot = nullptr;
-static profile_node* g_activeNode = nullptr;
-static bool g_canRecord = true;
-static DWORD g_threadID;
-static int g_nodeTracker = 0;
 static uint64_t g_frameStart = 0;
 static uint64_t g_frameEnd = 0;
-static bool g_resumeRequested = false;
 
-profile_node* FindRootFromActiveNode()
+// frames copied out of the history while a trace capture runs
+struct profile_trace_capture_t
 {
-	ASSERT_OR_DIE(g_threadID == ::GetCurrentThreadId(), "Thread Calling Find Root From Active not the same that Initialized the Profiler!");
-	if (nullptr == g_activeNode)
-		return nullptr;
-
-	profile_node* current_node = g_activeNode;
-	while (nullptr != current_node->parent)
-	{
-		current_node = current_node->parent;
+	uint frames_left;
+	std::string filename;
+	std::vector<profile_frame_t> frames;
+};
+
+static profile_trace_capture_t *g_traceCapture = nullptr;
+
+static void ProfilerWriteTrace(profile_trace_capture_t const &capture);
+
+//------------------------------------------------------------------------
+// Tags
+//------------------------------------------------------------------------
+uint ProfilerInternTag(char const *tag)
+{
+	SCOPE_LOCK(&g_tagLock);
+
+	uint count = g_tagCount.load();
+	for (uint i = 0; i < count; ++i) {
+		if (0 == strcmp(g_tagNames[i], tag)) {
+			return i;
+		}
 	}
 
-	return current_node;
+	if (count >= PROFILER_MAX_TAGS) {
+		return PROFILER_INVALID_TAG;
+	}
+
+	// tags live as long as the process - copy so runtime strings are safe
+	size_t length = strlen(tag) + 1;
+	char *copy = (char*)::malloc(length);
+	memcpy(copy, tag, length);
+
+	g_tagNames[count] = copy;
+	g_tagCount.store(count + 1);
+	return count;
 }
 
-void DeleteFromRootNode(profile_node* root_node)
+//------------------------------------------------------------------------
+char const* ProfilerGetTagName(uint tag)
 {
-	ASSERT_OR_DIE(g_threadID == ::GetCurrentThreadId(), "Thread Calling Delete From Root not the same that Initialized the Profiler!");
-	profile_node* current_node = root_node;
-
-	while (nullptr != current_node && nullptr != current_node->parent)
-	{
-		if (nullptr != current_node->last_child)
-		{
-			current_node = current_node->last_child;
-			continue;
+	if (tag >= g_tagCount.load()) {
+		return "<unknown>";
+	}
+
+	return g_tagNames[tag];
+}
+
+//------------------------------------------------------------------------
+static uint ProfilerFindOrInternTag(char const *tag)
+{
+	uintptr_t hash = ((uintptr_t)tag >> 3) * 2654435761U;
+	for (uint probe = 0; probe < TAG_CACHE_SIZE; ++probe) {
+		tag_cache_entry_t &entry = g_tagCache[(hash + probe) % TAG_CACHE_SIZE];
+		char const *key = entry.key.load(std::memory_order_acquire);
+		if (key == tag) {
+			uint id = entry.tag.load(std::memory_order_acquire);
+			if (PROFILER_INVALID_TAG != id) {
+				return id;
+			}
+
+			// another thread is still filling this slot in
+			return ProfilerInternTag(tag);
 		}
 
-		if (nullptr != current_node->prev_sibling)
-		{
-			profile_node* temp = current_node->prev_sibling;
-			delete current_node;
-			current_node = temp;
-			continue;
+		if (nullptr == key) {
+			char const *expected = nullptr;
+			if (entry.key.compare_exchange_strong(expected, tag)) {
+				uint id = ProfilerInternTag(tag);
+				entry.tag.store(id, std::memory_order_release);
+				return id;
+			}
+
+			if (expected == tag) {
+				return ProfilerInternTag(tag);
+			}
 		}
+	}
 
-		if (nullptr != current_node->parent)
-		{
-			profile_node* parent = current_node->parent;
-			parent->first_child = nullptr;
-			parent->last_child = nullptr;
-			delete current_node;
-			current_node = parent;
-			continue;
+	return ProfilerInternTag(tag);
+}
+
+//------------------------------------------------------------------------
+// Threads
+//------------------------------------------------------------------------
+static profile_thread_t* ProfilerRegisterThread()
+{
+	profile_thread_t *thread = new profile_thread_t();
+	thread->ring = new profile_event_t[PROFILER_RING_SIZE];
+	thread->write = 0;
+	thread->read = 0;
+	thread->depth = 0;
+	thread->drop_depth = 0;
+	thread->dropped = 0;
+	thread->index = g_profileThreadCount.fetch_add(1);
+	sprintf_s(thread->name, sizeof(thread->name), "Thread %u", thread->index);
+	thread->name_tag = ProfilerInternTag(thread->name);
+
+	// publish - collector only ever walks forward from the head
+	profile_thread_t *head = g_profileThreads;
+	while (true) {
+		thread->next = head;
+		profile_thread_t *prev = CompareAndSetPointer(&g_profileThreads, head, thread);
+		if (prev == head) {
+			break;
 		}
+		head = prev;
 	}
 
-	if (nullptr != current_node)
-		delete current_node;
+	t_profileThread = thread;
+	return thread;
+}
+
+//------------------------------------------------------------------------
+static inline profile_thread_t* ProfilerGetThread()
+{
+	profile_thread_t *thread = t_profileThread;
+	if (nullptr == thread) {
+		thread = ProfilerRegisterThread();
+	}
 
-	root_node = nullptr;
+	return thread;
 }
 
-void ProfilerStartup()
+//------------------------------------------------------------------------
+void ProfilerSetThreadName(char const *name)
 {
 #if defined PROFILED_BUILD
-	g_threadID = ::GetCurrentThreadId();
+	profile_thread_t *thread = ProfilerGetThread();
+	strncpy_s(thread->name, sizeof(thread->name), name, _TRUNCATE);
+	thread->name_tag = ProfilerInternTag(thread->name);
+#else
+	name;
 #endif
 }
 
-void SetFrameStartTime(uint64_t op_count)
+//------------------------------------------------------------------------
+static inline void ProfilerRecord(uint tag, uint category)
 {
-	g_frameStart = op_count;
-}
+	if (!g_profilerRunning.load(std::memory_order_relaxed)) {
+		return;
+	}
 
-void SetFrameEndTime(uint64_t op_count)
-{
-	g_frameEnd = op_count;
+	profile_thread_t *thread = ProfilerGetThread();
+	bool const is_end = (0 != (tag & PROFILE_END_FLAG));
+	if (0 != thread->drop_depth) {
+		if (is_end) {
+			--thread->drop_depth;
+		}
+		else {
+			++thread->drop_depth;
+			thread->dropped.fetch_add(1, std::memory_order_relaxed);
+		}
+		return;
+	}
+
+	uint64_t write = thread->write.load(std::memory_order_relaxed);
+	if (is_end) {
+		// opened before this thread recorded anything, the room was never kept for it
+		if (0 == thread->depth) {
+			return;
+		}
+		--thread->depth;
+	}
+	else {
+		// paused scopes are dropped whole too, but aren't counted
+		bool const paused = !g_canRecord.load(std::memory_order_relaxed);
+		uint64_t used = write - thread->read.load(std::memory_order_acquire);
+		if (paused || ((used + thread->depth + 2) > PROFILER_RING_SIZE)) {
+			thread->drop_depth = 1;
+			if (!paused) {
+				thread->dropped.fetch_add(1, std::memory_order_relaxed);
+			}
+			return;
+		}
+		++thread->depth;
+	}
+
+	profile_event_t &evt = thread->ring[write & (PROFILER_RING_SIZE - 1)];
+	evt.time = TimeGetOpCount();
+	evt.tag = tag;
+	evt.allocs = GetFrameAllocs();
+	evt.frees = GetFrameFrees();
+	evt.category = category;
+
+	thread->write.store(write + 1, std::memory_order_release);
 }
 
-void ProfilerShutdown()
+//------------------------------------------------------------------------
+void ProfilerPushTag(uint tag, uint category_tag /*= PROFILER_INVALID_TAG*/)
 {
 #if defined PROFILED_BUILD
-	ASSERT_OR_DIE(g_threadID == ::GetCurrentThreadId(), "Thread Calling Profiler Shutdown not the same that Initialized the Profiler!");
-	
-	if (nullptr != g_activeNode)
-	{
-		profile_node* root = FindRootFromActiveNode();
-		DeleteFromRootNode(root);
+	if (PROFILER_INVALID_TAG != tag) {
+		ProfilerRecord(tag, category_tag);
 	}
-	
-	if(nullptr != g_profilerRoot)
-		DeleteFromRootNode(g_profilerRoot);
+#else
+	tag;
+	category_tag;
 #endif
 }
 
-uint64_t GetTotalFrameTime()
+//------------------------------------------------------------------------
+void ProfilerPush(char const *tag)
 {
-	return g_frameEnd - g_frameStart;
+#if defined PROFILED_BUILD
+	if (g_profilerRunning.load(std::memory_order_relaxed)) {
+		ProfilerPushTag(ProfilerFindOrInternTag(tag));
+	}
+#else
+	tag;
+#endif
 }
 
-void ProfilerPause(void*)
+//------------------------------------------------------------------------
+void ProfilerPop()
 {
-	ASSERT_OR_DIE(g_threadID == ::GetCurrentThreadId(), "Thread Calling Profiler Pause not the same that Initialized the Profiler!");
-	g_canRecord = false;
+#if defined PROFILED_BUILD
+	ProfilerRecord(PROFILE_END_FLAG, PROFILER_INVALID_TAG);
+#endif
 }
 
-void ProfilerResume(void*)
+//------------------------------------------------------------------------
+// Frames
+//------------------------------------------------------------------------
+void ProfilerStartup()
 {
-	ASSERT_OR_DIE(g_threadID == ::GetCurrentThreadId(), "Thread Calling Profiler Resume not the same that Initialized the Profiler!");
-	g_resumeRequested = true;
+#if defined PROFILED_BUILD
+	g_frameHead = 0;
+	g_frameCount = 0;
+	g_frameStart = TimeGetOpCount();
+	g_profilerRunning = true;
+
+	ProfilerSetThreadName("Main");
+#endif
 }
 
-void ProfilerPush(char const *tag)
+//------------------------------------------------------------------------
+// Threads must be done recording - call after the job system has shut down.
+void ProfilerShutdown()
 {
 #if defined PROFILED_BUILD
-	ASSERT_OR_DIE(g_threadID == ::GetCurrentThreadId(), "Thread Calling Profiler Push not the same that Initialized the Profiler!");
-	if (!g_canRecord) {
+	g_profilerRunning = false;
 
-		if (g_resumeRequested && g_nodeTracker == 0)
-		{
-			g_canRecord = true;
-			g_resumeRequested = false;
-		}
-		else
-		{
-			g_nodeTracker++;
-			return;
-		}
-	}
+	delete g_traceCapture;
+	g_traceCapture = nullptr;
 
-	profile_node* node = new profile_node();
-	node->tag = tag;
-	node->start = TimeGetOpCount();
-	node->parent = g_activeNode;
-
-	if(nullptr != g_activeNode)
-	{
-		if (nullptr == g_activeNode->first_child)
-		{
-			g_activeNode->first_child = node;
-			g_activeNode->last_child = node;
-		}
-		else
-		{
-			g_activeNode->last_child->next_sibling = node;
-			node->prev_sibling = g_activeNode->last_child;
-			g_activeNode->last_child = node;
-		}
+	profile_thread_t *thread = g_profileThreads;
+	while (nullptr != thread) {
+		profile_thread_t *next = thread->next;
+		delete[] thread->ring;
+		delete thread;
+		thread = next;
 	}
 
-	g_activeNode = node;
+	g_profileThreads = nullptr;
+	g_profileThreadCount = 0;
+	t_profileThread = nullptr;
+
+	for (uint i = 0; i < PROFILER_HISTORY_SIZE; ++i) {
+		g_frames[i].events.clear();
+		g_frames[i].spans.clear();
+		g_frames[i].dropped = 0;
+	}
+	g_frameCount = 0;
 #endif
 }
 
-void CalcAllocsAndFreesFromChildren()
+//------------------------------------------------------------------------
+// Main thread, once a frame.  Drains every ring into the next history slot,
+// whose vectors are reused so this stops allocating once warm.
+void ProfilerEndFrame()
 {
-	uint totalAllocCount = GetAllocCount();
-	uint totalFreesCount = GetFrameFrees();
-
-	profile_node* current_child = g_activeNode->first_child;
-	uint childAllocCount = 0;
-	uint childFreeCount = 0;
-
-	while (nullptr != current_child)
-	{
-		childAllocCount += current_child->allocs;
-		childFreeCount += current_child->frees;
-		current_child = current_child->next_sibling;
+#if defined PROFILED_BUILD
+	if (!g_profilerRunning) {
+		return;
 	}
 
-	g_activeNode->allocs = totalAllocCount - childAllocCount;
-	g_activeNode->frees = totalFreesCount - childFreeCount;
-}
+	uint64_t now = TimeGetOpCount();
+	SetFrameEndTime(now);
 
-void ProfilerPop()
-{
-#if defined PROFILED_BUILD
-	ASSERT_OR_DIE(g_threadID == ::GetCurrentThreadId(), "Thread Calling Profiler Pop not the same that Initialized the Profiler!");
-	ASSERT_OR_DIE(g_activeNode != nullptr, "Active Node was nullptr when popping!");
+	profile_frame_t &frame = g_frames[g_frameHead];
+	frame.start = g_frameStart;
+	frame.end = now;
+	frame.events.clear();
+	frame.spans.clear();
+	frame.dropped = 0;
 
-	if (!g_canRecord) {
-		g_nodeTracker--;
-	}
+	profile_thread_t *thread = g_profileThreads;
+	while (nullptr != thread) {
+		frame.dropped += thread->dropped.exchange(0, std::memory_order_relaxed);
 
-	g_activeNode->end = TimeGetOpCount();
+		uint64_t write = thread->write.load(std::memory_order_acquire);
+		uint64_t read = thread->read.load(std::memory_order_relaxed);
 
-	if (nullptr == g_activeNode->first_child)
-	{
-		g_activeNode->allocs = GetAllocCount();
-		g_activeNode->frees = GetFrameFrees();
-	}
-	else
-	{
-		CalcAllocsAndFreesFromChildren();
+		if (write != read) {
+			profile_span_t span;
+			span.thread_index = thread->index;
+			span.first = (uint)frame.events.size();
+			span.count = (uint)(write - read);
+
+			for (uint64_t i = read; i < write; ++i) {
+				frame.events.push_back(thread->ring[i & (PROFILER_RING_SIZE - 1)]);
+			}
+
+			frame.spans.push_back(span);
+			thread->read.store(write, std::memory_order_release);
+		}
+
+		thread = thread->next;
 	}
 
-	if (nullptr == g_activeNode->parent)
-	{
-		// move this to our completed frames list, and free up any old frames we may not care about anymore
-		if (nullptr != g_profilerRoot)
-			DeleteFromRootNode(g_profilerRoot);
+	if (nullptr != g_traceCapture) {
+		g_traceCapture->frames.push_back(frame);
+		--g_traceCapture->frames_left;
+		if (0 == g_traceCapture->frames_left) {
+			ProfilerWriteTrace(*g_traceCapture);
+			delete g_traceCapture;
+			g_traceCapture = nullptr;
+		}
+	}
 
-		g_profilerRoot = g_activeNode;
-		g_activeNode = g_activeNode->parent;
+	g_frameHead = (g_frameHead + 1) % PROFILER_HISTORY_SIZE;
+	if (g_frameCount < PROFILER_HISTORY_SIZE) {
+		++g_frameCount;
 	}
-	else
-	{
-		g_activeNode = g_activeNode->parent;
+
+	// resume on a frame boundary so reports start clean
+	if (g_resumeRequested) {
+		g_resumeRequested = false;
+		g_canRecord = true;
 	}
+
+	SetFrameStartTime(now);
 #endif
 }
 
-profile_node* ProfilerGetPreviousFrame()
+void SetFrameStartTime(uint64_t op_count)
 {
-	ASSERT_OR_DIE(g_threadID == ::GetCurrentThreadId(), "Thread Calling Profiler Get Previous Frame not the same that Initialized the Profiler!");
-	return g_profilerRoot;
+	g_frameStart = op_count;
 }
 
-profile_node* ProfilerGetPreviousFrame(char const *root_tag)
+void SetFrameEndTime(uint64_t op_count)
 {
-	ASSERT_OR_DIE(g_threadID == ::GetCurrentThreadId(), "Thread Calling Profiler Get Previous Frame not the same that Initialized the Profiler!");
-	profile_node* req_root = g_profilerRoot;
-
-	while (nullptr != req_root && req_root->tag != root_tag)
-	{
-		if (nullptr != req_root->last_child)
-		{
-			req_root = req_root->last_child;
-			continue;
-		}
+	g_frameEnd = op_count;
+}
 
-		if (nullptr != req_root->prev_sibling)
-		{
-			req_root = req_root->prev_sibling;
-			continue;
-		}
+uint64_t GetTotalFrameTime()
+{
+	return g_frameEnd - g_frameStart;
+}
 
-		if (nullptr != req_root->parent)
-		{
-			while (nullptr == req_root->parent->prev_sibling)
-			{
-				req_root = req_root->parent;
-			}
+void ProfilerPause(void*)
+{
+	g_canRecord = false;
+}
 
-			if (req_root->tag != root_tag)
-				req_root = req_root->parent->prev_sibling;
+void ProfilerResume(void*)
+{
+	g_resumeRequested = true;
+}
 
-			continue;
-		}
+//------------------------------------------------------------------------
+static profile_thread_t* ProfilerFindThread(uint index)
+{
+	profile_thread_t *thread = g_profileThreads;
+	while ((nullptr != thread) && (thread->index != index)) {
+		thread = thread->next;
 	}
 
-	return req_root;
+	return thread;
 }
 
+//------------------------------------------------------------------------
 // Reporting Section
-struct profile_data
-{
-	profile_data()
-		:tag("")
-		, call_count(1)
-		, total_time_as_percent(0.0f)
-		, total_time("0.0 s")
-		, self_time_as_percent(0.0f)
-		, self_time("0.0 s")
-		, alloc_count(0)
-		, free_count(0)
-		, parent(nullptr)
-		, first_child(nullptr)
-		, prev_sibling(nullptr)
-		, next_sibling(nullptr)
-	{
+//------------------------------------------------------------------------
+enum ReportStyle {
+	TREE_VIEW,
+	FLAT_VIEW
+};
 
-	}
+static uint const REPORT_NO_NODE = 0xffffffff;
+
+struct report_node_t
+{
+	uint tag;
+	uint parent;
+	uint first_child;
+	uint next_sibling;
+	uint depth;
 
-	const char* tag;
 	uint call_count;
-	float total_time_as_percent;
-	std::string total_time;
-	float self_time_as_percent;
-	std::string self_time;
+	uint64_t total_time;
+	uint64_t child_time;
 	uint alloc_count;
 	uint free_count;
-
-	profile_data* parent;
-	profile_data* first_child;
-	profile_data* prev_sibling;
-	profile_data* next_sibling;
 };
 
-enum ReportStyle {
-	TREE_VIEW,
-	FLAT_VIEW
+struct report_open_scope_t
+{
+	uint node;
+	profile_event_t begin;
 };
 
-static ReportStyle g_treeReportStyle = TREE_VIEW;
-#include <vector>
-
 class ProfilerReport
 {
 public:
-	ProfilerReport(profile_node* node_head);
-	uint GetFreeCount(profile_node* node);
-	uint GetAllocsCount(profile_node* node);
-	profile_data* CreateDataFromNode(profile_node* node);
-	void CreateTreeView();
-	void CreateFlatView();
-	void SortByTotalTime();
-	void Log();
-	void SortBySelfTime();
-	uint GetCallCount(profile_node* node);
+	ProfilerReport(uint frame_count, uint thread_index);
 	void CreateTree(const ReportStyle& style);
+	void Log();
+
+private:
+	void AddThreadEvents(uint thread_index, profile_event_t const *events, uint count, uint64_t frame_end);
+	uint GetRoot(uint thread_index);
+	uint GetChild(uint parent, uint tag);
+	void CloseScope(report_open_scope_t const &scope, uint64_t end_time, uint end_allocs, uint end_frees);
+	void CreateFlatView();
+	void LogNode(report_node_t const &node, std::string const &padding);
+	void LogChildrenSorted(uint parent, std::string const &padding);
+
 public:
-	profile_data* m_head;
-	profile_node* m_nodeHead;
+	std::vector<report_node_t> m_nodes;
+	std::vector<uint> m_roots;      // per thread index, REPORT_NO_NODE when unused
+	std::vector<report_node_t> m_flatList;
+	std::vector<report_open_scope_t> m_stack;
+	uint m_frameCount;
+	uint m_threadIndex;             // PROFILER_INVALID_TAG for every thread
+	uint64_t m_totalTime;
+	uint m_droppedCount;            // scopes lost to full rings, every thread
 	ReportStyle m_style;
-	std::vector<profile_data*> m_flatList;
 };
 
-ProfilerReport::ProfilerReport(profile_node* node_head)
-	:m_head(nullptr)
-{
-	m_nodeHead = node_head;
-	//m_head = CreateDataFromNode(node_head);
-}
-
-uint64_t GetTotalTimeForNode(profile_node* node)
+//------------------------------------------------------------------------
+ProfilerReport::ProfilerReport(uint frame_count, uint thread_index)
+	: m_frameCount(frame_count)
+	, m_threadIndex(thread_index)
+	, m_totalTime(0)
+	, m_droppedCount(0)
+	, m_style(TREE_VIEW)
 {
-	if (nullptr != node->first_child)
-	{
-		// get totals from children
-
-		profile_node* current_child = node->first_child;
-		uint64_t total = node->end - node->start;
-
-		while (nullptr != current_child)
-		{
-			uint64_t child_total = current_child->end - current_child->start;
-			total -= child_total;
-			current_child = current_child->next_sibling;
-		}
-
-		return total;
-	}
-	else
-	{
-		// return current nodes total
-		return node->end - node->start;
+	if (m_frameCount > g_frameCount) {
+		m_frameCount = g_frameCount;
 	}
 }
 
-uint ProfilerReport::GetCallCount(profile_node* node)
+//------------------------------------------------------------------------
+uint ProfilerReport::GetRoot(uint thread_index)
 {
-	profile_node* current_node = m_nodeHead;
-	uint count = 0;
-
-	while (nullptr != current_node)
-	{
-		if (nullptr != current_node->last_child)
-		{
-			current_node = current_node->last_child;
-			continue;
-		}
-
-		if (nullptr != current_node->prev_sibling)
-		{
-			if (current_node->tag == node->tag)
-				++count;
-
-			current_node = current_node->prev_sibling;
-			continue;
-		}
-
-		if (nullptr != current_node->parent)
-		{
-			if (nullptr != current_node && current_node->tag == node->tag)
-				++count;
-
-			current_node = current_node->parent;
-
-			if (nullptr != current_node && current_node->tag == node->tag)
-				++count;
-			
-			if(nullptr != current_node)
-			{
-				profile_node* temp = current_node;
+	if (thread_index >= m_roots.size()) {
+		m_roots.resize(thread_index + 1, REPORT_NO_NODE);
+	}
 
-				while (nullptr != temp && nullptr == temp->prev_sibling)
-				{
-					temp = temp->parent;
-				}
+	if (REPORT_NO_NODE == m_roots[thread_index]) {
+		profile_thread_t *thread = ProfilerFindThread(thread_index);
 
-				if (nullptr == temp)
-					break;
+		report_node_t root;
+		memset(&root, 0, sizeof(root));
+		root.tag = (nullptr != thread) ? thread->name_tag : PROFILER_INVALID_TAG;
+		root.parent = REPORT_NO_NODE;
+		root.first_child = REPORT_NO_NODE;
+		root.next_sibling = REPORT_NO_NODE;
 
-				current_node = temp->prev_sibling;
-				if (current_node->tag == node->tag)
-					++count;
-				//if (nullptr == temp->prev_sibling)
-				//	current_node = current_node->parent;
-				//else
-				//	current_node = current_node->prev_sibling;
-			}
-			
-			continue;
-		}
+		m_roots[thread_index] = (uint)m_nodes.size();
+		m_nodes.push_back(root);
 	}
 
-	return count;
+	return m_roots[thread_index];
 }
 
-// if (nullptr == current_data->prev_sibling && nullptr == current_data->next_sibling)
-// {
-// 	has_reached_end_of_branch = true;
-// 	current_data = current_data->parent;
-// 	continue;
-// }
-
-uint ProfilerReport::GetAllocsCount(profile_node* node)
+//------------------------------------------------------------------------
+// same tag under the same parent merges into one node
+uint ProfilerReport::GetChild(uint parent, uint tag)
 {
-	if (nullptr != node->first_child)
-	{
-		// get totals from children
-
-		profile_node* current_child = node->first_child;
-		uint total = node->allocs;
-
-		while (nullptr != current_child)
-		{
-			uint child_allocs = current_child->allocs;
-			total -= child_allocs;
-			current_child = current_child->next_sibling;
+	uint child = m_nodes[parent].first_child;
+	uint last = REPORT_NO_NODE;
+	while (REPORT_NO_NODE != child) {
+		if (m_nodes[child].tag == tag) {
+			return child;
 		}
-
-		return total;
+		last = child;
+		child = m_nodes[child].next_sibling;
 	}
-	else
-	{
-		// return current nodes total
-		return node->allocs;
-	}
-}
 
-uint ProfilerReport::GetFreeCount(profile_node* node) //
-{
-	if (nullptr != node->first_child)
-	{
-		// get totals from children
-
-		profile_node* current_child = node->first_child;
-		uint total = node->frees;
-
-		while (nullptr != current_child)
-		{
-			uint child_frees = current_child->frees;
-			total -= child_frees;
-			current_child = current_child->next_sibling;
-		}
+	report_node_t node;
+	memset(&node, 0, sizeof(node));
+	node.tag = tag;
+	node.parent = parent;
+	node.first_child = REPORT_NO_NODE;
+	node.next_sibling = REPORT_NO_NODE;
+	node.depth = m_nodes[parent].depth + 1;
+
+	uint index = (uint)m_nodes.size();
+	m_nodes.push_back(node);
 
-		return total;
+	if (REPORT_NO_NODE == last) {
+		m_nodes[parent].first_child = index;
 	}
-	else
-	{
-		// return current nodes total
-		return node->frees;
+	else {
+		m_nodes[last].next_sibling = index;
 	}
-}
 
-profile_data* ProfilerReport::CreateDataFromNode(profile_node* node)
-{
-	profile_data* data = new profile_data();
-	data->tag = node->tag;
-	data->call_count = GetCallCount(node);
-
-	uint64_t total_frame_time = GetTotalFrameTime();
-	uint64_t data_total_time_for_self = GetTotalTimeForNode(node);
-
-	data->total_time_as_percent = (float)TimeOpCountToSeconds(node->end - node->start) / (float)TimeOpCountToSeconds(total_frame_time);
-	std::string total_string = TimeOpCountToString(node->end - node->start);
-	data->total_time = total_string;
-
-	data->self_time_as_percent = (float)data_total_time_for_self / (float)total_frame_time;
-	std::string self_string = TimeOpCountToString(data_total_time_for_self);
-	data->self_time = self_string;
-
-	data->alloc_count = node->allocs;
-	data->free_count = node->frees;
-
-	return data;
+	return index;
 }
 
-void SetSiblingsParent(profile_data* first_sibling, profile_data* parent)
+//------------------------------------------------------------------------
+void ProfilerReport::CloseScope(report_open_scope_t const &scope, uint64_t end_time, uint end_allocs, uint end_frees)
 {
-	profile_data* current_data = first_sibling;
+	report_node_t &node = m_nodes[scope.node];
+	uint64_t elapsed = end_time - scope.begin.time;
 
-	if (nullptr != current_data->prev_sibling)
-		current_data->prev_sibling->parent = parent;
+	++node.call_count;
+	node.total_time += elapsed;
 
-	while (nullptr != current_data)
-	{
-		current_data->parent = parent;
-		current_data = current_data->next_sibling;
+	// frame counters reset every frame, so a scope spanning frames reads low
+	if (end_allocs >= scope.begin.allocs) {
+		node.alloc_count += end_allocs - scope.begin.allocs;
+	}
+	if (end_frees >= scope.begin.frees) {
+		node.free_count += end_frees - scope.begin.frees;
 	}
+
+	m_nodes[node.parent].child_time += elapsed;
+	m_nodes[node.parent].total_time += (m_stack.size() == 1) ? elapsed : 0;
 }
 
-void ProfilerReport::CreateTreeView()
+//------------------------------------------------------------------------
+// Unmatched ends (scope opened before the history window, or while paused)
+// are skipped, scopes still open at the end of the frame are cut there.
+void ProfilerReport::AddThreadEvents(uint thread_index, profile_event_t const *events, uint count, uint64_t frame_end)
 {
-	profile_node* current_node = m_nodeHead;
-	profile_data* prev_added_node = nullptr;
-	profile_data* data_added_before_branch_traversal = nullptr;
-
-	while (nullptr != current_node)
-	{
-		if (nullptr != current_node->last_child)
-		{
-			if (nullptr != prev_added_node)
-				data_added_before_branch_traversal = prev_added_node;
-
-			prev_added_node = nullptr;
-			current_node = current_node->last_child;
-			continue;
-		}
+	uint root = GetRoot(thread_index);
+	m_stack.clear();
 
-		if (nullptr != current_node->prev_sibling)
-		{
-			profile_data* data = CreateDataFromNode(current_node);
-
-			if (nullptr == prev_added_node)
-			{
-				prev_added_node = data;
-			}
-			else
-			{
-				data->next_sibling = prev_added_node;
-				prev_added_node->prev_sibling = data;
-				prev_added_node = data;
+	for (uint i = 0; i < count; ++i) {
+		profile_event_t const &evt = events[i];
+		if (0 != (evt.tag & PROFILE_END_FLAG)) {
+			if (m_stack.empty()) {
+				continue;
 			}
 
-			current_node = current_node->prev_sibling;
+			CloseScope(m_stack.back(), evt.time, evt.allocs, evt.frees);
+			m_stack.pop_back();
 			continue;
 		}
 
-		if (nullptr != current_node->parent)
-		{
-			profile_data* data = CreateDataFromNode(current_node);
+		uint parent = m_stack.empty() ? root : m_stack.back().node;
 
-			if (nullptr == prev_added_node)
-			{
-				prev_added_node = data;
-			}
-			else
-			{
-				data->next_sibling = prev_added_node;
-				prev_added_node->prev_sibling = data;
-				prev_added_node = data;
-			}
-
-			current_node = current_node->parent;
-
-			data = CreateDataFromNode(current_node);
-
-			if (nullptr == prev_added_node)
-			{
-				prev_added_node = data;
-			}
-			else
-			{
-				SetSiblingsParent(prev_added_node, data);
-				data->first_child = prev_added_node;
-				prev_added_node = data;
-			}
+		report_open_scope_t scope;
+		scope.node = GetChild(parent, evt.tag);
+		scope.begin = evt;
+		m_stack.push_back(scope);
+	}
 
-			if (nullptr != current_node)
-			{
-				profile_node* temp = current_node;
+	while (!m_stack.empty()) {
+		report_open_scope_t const &scope = m_stack.back();
+		CloseScope(scope, frame_end, scope.begin.allocs, scope.begin.frees);
+		m_stack.pop_back();
+	}
+}
 
-				while (nullptr != temp && nullptr == temp->prev_sibling)
-				{
-					temp = temp->parent;
+//------------------------------------------------------------------------
+void ProfilerReport::CreateFlatView()
+{
+	std::vector<uint> tag_to_flat;
+	for (report_node_t const &node : m_nodes) {
+		if (REPORT_NO_NODE == node.parent) {
+			continue;
+		}
 
-					if (nullptr == temp)
-						break;
+		if (node.tag >= tag_to_flat.size()) {
+			tag_to_flat.resize(node.tag + 1, REPORT_NO_NODE);
+		}
 
-					data = CreateDataFromNode(temp);
-					data->first_child = prev_added_node;
+		if (REPORT_NO_NODE == tag_to_flat[node.tag]) {
+			tag_to_flat[node.tag] = (uint)m_flatList.size();
+
+			report_node_t flat = node;
+			flat.call_count = 0;
+			flat.total_time = 0;
+			flat.child_time = 0;
+			flat.alloc_count = 0;
+			flat.free_count = 0;
+			flat.depth = 0;
+			m_flatList.push_back(flat);
+		}
 
-					if (nullptr == prev_added_node->parent)
-						prev_added_node->parent = data;
+		report_node_t &flat = m_flatList[tag_to_flat[node.tag]];
+		flat.call_count += node.call_count;
+		flat.total_time += node.total_time;
+		flat.child_time += node.child_time;
+		flat.alloc_count += node.alloc_count;
+		flat.free_count += node.free_count;
+	}
+}
 
-					if (nullptr != data_added_before_branch_traversal && nullptr != temp->parent)
-					{
-						data->next_sibling = data_added_before_branch_traversal;
-						data_added_before_branch_traversal->prev_sibling = data;
-						data_added_before_branch_traversal->parent = data->parent;
-					}
+bool TotalTimeSort(report_node_t const &i, report_node_t const &j) { return (i.total_time > j.total_time); }
+bool SelfTimeSort(report_node_t const &i, report_node_t const &j) { return ((i.total_time - i.child_time) > (j.total_time - j.child_time)); }
 
-					prev_added_node = data;
-				}
+//------------------------------------------------------------------------
+void ProfilerReport::CreateTree(const ReportStyle& style)
+{
+	m_style = style;
 
-				if (nullptr == temp)
-					break;
+	for (uint i = 0; i < m_frameCount; ++i) {
+		uint slot = (g_frameHead + PROFILER_HISTORY_SIZE - 1 - i) % PROFILER_HISTORY_SIZE;
+		profile_frame_t const &frame = g_frames[slot];
+		m_totalTime += frame.end - frame.start;
+		m_droppedCount += frame.dropped;
 
-				current_node = temp->prev_sibling;
+		for (profile_span_t const &span : frame.spans) {
+			if ((PROFILER_INVALID_TAG != m_threadIndex) && (span.thread_index != m_threadIndex)) {
+				continue;
 			}
 
-			continue;
+			AddThreadEvents(span.thread_index, &frame.events[span.first], span.count, frame.end);
 		}
 	}
 
-
-	m_head = prev_added_node;
-
+	if (FLAT_VIEW == style) {
+		CreateFlatView();
+		std::sort(m_flatList.begin(), m_flatList.end(), SelfTimeSort);
+	}
 }
 
-bool DoesDataAlreadyExist(profile_data* data_root, const char* tag_to_check)
+//------------------------------------------------------------------------
+void ProfilerReport::LogNode(report_node_t const &node, std::string const &padding)
 {
-	profile_data* current_data = data_root;
+	std::string msg_format = "%-55s %-10u %-10s %-15s %-10s %-15s %-10u %-10u";
 
-	while (nullptr != current_data && nullptr != data_root->first_child)
-	{
-		if (current_data->tag == tag_to_check)
-			return true;
+	double total_percent = (m_totalTime > 0) ? (100.0 * (double)node.total_time / (double)m_totalTime) : 0.0;
+	uint64_t self_time = node.total_time - node.child_time;
+	double self_percent = (m_totalTime > 0) ? (100.0 * (double)self_time / (double)m_totalTime) : 0.0;
 
-		if (nullptr != current_data->first_child)
-		{
-			current_data = current_data->first_child;
-			continue;
-		}
+	std::stringstream stream_total;
+	stream_total << std::fixed << std::setprecision(2) << total_percent << "%";
 
-		if (nullptr != current_data->next_sibling)
-		{
-			current_data = current_data->next_sibling;
-			continue;
-		}
+	std::stringstream stream_self;
+	stream_self << std::fixed << std::setprecision(2) << self_percent << "%";
 
-		if (nullptr != current_data->parent)
-		{
-			while (nullptr == current_data->parent->next_sibling)
-			{
-				current_data = current_data->parent;
-				if (nullptr == current_data->parent)
-					return false;
-			}
+	std::string data_tag = padding + ProfilerGetTagName(node.tag);
+	LogTaggedPrintf("profile", msg_format.c_str(), data_tag.c_str(), node.call_count,
+		stream_total.str().c_str(), TimeOpCountToString(node.total_time).c_str(),
+		stream_self.str().c_str(), TimeOpCountToString(self_time).c_str(),
+		node.alloc_count, node.free_count);
+}
 
-			current_data = current_data->parent->next_sibling;
-			continue;
-		}
+//------------------------------------------------------------------------
+void ProfilerReport::LogChildrenSorted(uint parent, std::string const &padding)
+{
+	std::vector<uint> children;
+	for (uint child = m_nodes[parent].first_child; REPORT_NO_NODE != child; child = m_nodes[child].next_sibling) {
+		children.push_back(child);
 	}
 
-	if (data_root->tag == tag_to_check)
-		return true;
+	std::sort(children.begin(), children.end(), [this](uint a, uint b) {
+		return TotalTimeSort(m_nodes[a], m_nodes[b]);
+	});
 
-	return false;
+	for (uint child : children) {
+		LogNode(m_nodes[child], padding);
+		LogChildrenSorted(child, padding + " ");
+	}
 }
 
-void ProfilerReport::CreateFlatView()
+//------------------------------------------------------------------------
+void ProfilerReport::Log()
 {
-	profile_node* current_node = m_nodeHead;
-	profile_data* prev_added_node = nullptr;
-	profile_data* data_added_before_branch_traversal = nullptr;
-
-	while (nullptr != current_node)
-	{
-		bool can_create_data = true;
-		if (nullptr != prev_added_node && DoesDataAlreadyExist(prev_added_node, current_node->tag))
-			can_create_data = false;
-
-		if (nullptr != current_node->last_child)
-		{
-			if (nullptr != prev_added_node)
-				data_added_before_branch_traversal = prev_added_node;
-
-			prev_added_node = nullptr;
-			current_node = current_node->last_child;
-			continue;
-		}
-
-		if (nullptr != current_node->prev_sibling)
-		{
-			profile_data* data = CreateDataFromNode(current_node);
-			m_flatList.push_back(data);
+	std::string header_format = "%-55s %-10s %-10s %-15s %-10s %-15s %-10s %-10s";
+	LogTaggedPrintf("profile", "Profile over last %u frames (%s)", m_frameCount, TimeOpCountToString(m_totalTime).c_str());
+	if (m_droppedCount > 0) {
+		LogTaggedPrintf("profile", "%u scope(s) dropped, their rings were full - times under them read low", m_droppedCount);
+	}
+	LogTaggedPrintf("profile", header_format.c_str(), " TAG NAME", "CALLS", "TOTAL%", "TOTAL TIME", "SELF%", "SELF TIME", "ALLOCS", "FREES");
 
-			if (nullptr == prev_added_node)
-			{
-				prev_added_node = data;
-			}
-			else
-			{
-				data->next_sibling = prev_added_node;
-				prev_added_node->prev_sibling = data;
-				prev_added_node = data;
-			}
+	std::string tree_padding = "  ";
+	if (FLAT_VIEW == m_style) {
+		for (report_node_t const &data : m_flatList) {
+			LogNode(data, tree_padding);
+		}
+		return;
+	}
 
-			current_node = current_node->prev_sibling;
+	for (uint root : m_roots) {
+		if (REPORT_NO_NODE == root) {
 			continue;
 		}
 
-		if (nullptr != current_node->parent)
-		{
-			profile_data* data = CreateDataFromNode(current_node);
-			m_flatList.push_back(data);
-
-			if (nullptr == prev_added_node)
-			{
-				prev_added_node = data;
-			}
-			else
-			{
-				data->next_sibling = prev_added_node;
-				prev_added_node->prev_sibling = data;
-				prev_added_node = data;
-			}
-
-			current_node = current_node->parent;
-
-			data = CreateDataFromNode(current_node);
-			m_flatList.push_back(data);
-
-			if (nullptr == prev_added_node)
-			{
-				prev_added_node = data;
-			}
-			else
-			{
-				SetSiblingsParent(prev_added_node, data);
-				data->first_child = prev_added_node;
-				prev_added_node = data;
-			}
-
-			if (nullptr != current_node)
-			{
-				profile_node* temp = current_node;
-
-				while (nullptr != temp && nullptr == temp->prev_sibling)
-				{
-					temp = temp->parent;
-
-					if (nullptr == temp)
-						break;
-
-					data = CreateDataFromNode(temp);
-					m_flatList.push_back(data);
-					data->first_child = prev_added_node;
-
-					if (nullptr == prev_added_node->parent)
-						prev_added_node->parent = data;
+		LogNode(m_nodes[root], tree_padding);
+		LogChildrenSorted(root, tree_padding + " ");
+	}
+}
 
-					if (nullptr != data_added_before_branch_traversal && nullptr != temp->parent)
-					{
-						data->next_sibling = data_added_before_branch_traversal;
-						data_added_before_branch_traversal->prev_sibling = data;
-						data_added_before_branch_traversal->parent = data->parent;
-					}
+//------------------------------------------------------------------------
+// ProfilerReport [tree_view|flat_view] [frame_count] [thread_name]
+void PrintReport(void* data)
+{
+#if defined PROFILED_BUILD
+	arguments args = *(arguments*)data;
 
-					prev_added_node = data;
-				}
+	ReportStyle style = TREE_VIEW;
+	if (args.arg_list.size() > 0) {
+		std::locale local;
+		std::string casedType = args.arg_list[0];
+		for (unsigned int i = 0; i < casedType.length(); ++i)
+			casedType[i] = std::tolower(casedType[i], local);
+
+		if (casedType == "flat_view")
+			style = FLAT_VIEW;
+	}
 
-				if (nullptr == temp)
-					break;
+	uint frame_count = 1;
+	if (args.arg_list.size() > 1) {
+		int requested = atoi(args.arg_list[1].c_str());
+		frame_count = (requested > 0) ? (uint)requested : 1;
+	}
 
-				current_node = temp->prev_sibling;
+	uint thread_index = PROFILER_INVALID_TAG;
+	if (args.arg_list.size() > 2) {
+		profile_thread_t *thread = g_profileThreads;
+		while (nullptr != thread) {
+			if (0 == _stricmp(thread->name, args.arg_list[2].c_str())) {
+				thread_index = thread->index;
+				break;
 			}
-
-			continue;
+			thread = thread->next;
 		}
 	}
 
-
-	m_head = prev_added_node;
+	ProfilerReport report(frame_count, thread_index);
+	report.CreateTree(style);
+	report.Log();
+#else
+	data;
+#endif
 }
 
-bool TotalTimeSort(profile_data* i, profile_data* j) { return (i->total_time_as_percent<j->total_time_as_percent); }
-bool SelfTimeSort(profile_data* i, profile_data* j) { return (i->self_time_as_percent<j->self_time_as_percent); }
-
-void ProfilerReport::SortByTotalTime()
+//------------------------------------------------------------------------
+// Cost of an empty scope, with recording on.  Drains its own ring between
+// batches so nothing is dropped and the history is left alone.
+void ProfilerBenchmark(uint scope_count)
 {
-	if (m_flatList.empty())
-	{
-		profile_data* current_data = m_head;
-		bool has_reached_end_of_branch = false;
-		bool is_sorting = false;
-
-		while (nullptr != current_data)
-		{
-			// Step down first child until no children
-			if (nullptr != current_data->first_child && !has_reached_end_of_branch)
-			{
-				current_data = current_data->first_child;
-				continue;
-			}
+#if defined PROFILED_BUILD
+	if (!g_profilerRunning || !g_canRecord) {
+		return;
+	}
 
-			// if has next, step to and walk down until no children
-			if (nullptr != current_data->next_sibling && !is_sorting)
-			{
-				has_reached_end_of_branch = false;
-				current_data = current_data->next_sibling;
-				continue;
-			}
+	profile_thread_t *thread = ProfilerGetThread();
+	uint const batch_size = PROFILER_RING_SIZE / 4;
 
-			// if has prev but no next, then sort siblings
-			if (nullptr != current_data->prev_sibling && nullptr == current_data->next_sibling || is_sorting)
-			{
-				// SORTING
-					// move to prev if time is less than or equal
-				profile_data* prev = current_data->prev_sibling;
-				if (nullptr != prev && prev->total_time_as_percent >= current_data->total_time_as_percent)
-				{
-					has_reached_end_of_branch = true;
-					is_sorting = true;
-					current_data = current_data->prev_sibling;
-				}
-				else if (nullptr != prev)
-				{
-					// walk list to find next that is greater than me
-					profile_data* lower_than_prev = current_data;
-					while (lower_than_prev->total_time_as_percent > prev->total_time_as_percent)
-					{
-						if (nullptr != lower_than_prev->next_sibling)
-							lower_than_prev = lower_than_prev->next_sibling;
-						else
-							break;
-					}
-
-					// Adjust Pointers
-					current_data->prev_sibling = prev->prev_sibling;
-					if (nullptr != current_data->prev_sibling)
-						current_data->prev_sibling->next_sibling = current_data;
+	uint64_t elapsed = 0;
+	uint done = 0;
+	while (done < scope_count) {
+		uint batch = ((scope_count - done) < batch_size) ? (scope_count - done) : batch_size;
 
-					if (prev->total_time_as_percent < lower_than_prev->total_time_as_percent)
-					{
-						prev->next_sibling = lower_than_prev->next_sibling;
-						prev->prev_sibling = lower_than_prev;
-						lower_than_prev->next_sibling = prev;
-					}
-					else
-					{
-						prev->next_sibling = lower_than_prev;
-						lower_than_prev->prev_sibling->next_sibling = prev;
-						prev->prev_sibling = lower_than_prev->prev_sibling;
-						lower_than_prev->prev_sibling = prev;
-					}
-				}
-				else
-				{
-					is_sorting = false;
-					current_data = current_data->parent;
+		// whatever was already in the ring goes to the next collection untouched
+		uint64_t keep = thread->write.load();
 
-					if (nullptr == current_data)
-						break;
-				}
-			}
-
-			//step up to parent next is available, else sort parents and step to grandparents
-			// if no prev and next siblings then step up to parent
-			if (nullptr == current_data->prev_sibling && nullptr == current_data->next_sibling)
-			{
-				has_reached_end_of_branch = true;
-				current_data = current_data->parent;
-				continue;
-			}
+		uint64_t start = TimeGetOpCount();
+		for (uint i = 0; i < batch; ++i) {
+			PROFILE_LOG_SCOPE("ProfilerBenchmark");
 		}
+		elapsed += TimeGetOpCount() - start;
+
+		thread->write.store(keep);
+		done += batch;
 	}
-	else
-	{
-		std::sort(m_flatList.begin(), m_flatList.end(), TotalTimeSort);
-	}
+
+	double ns_per_scope = (TimeOpCountToSeconds(elapsed) * 1000000000.0) / (double)scope_count;
+	LogPrint("ProfilerBenchmark: %u scopes, %.1f ns per scope", scope_count, ns_per_scope);
+#else
+	scope_count;
+#endif
 }
 
-void ProfilerReport::SortBySelfTime()
+//------------------------------------------------------------------------
+// Trace Export Section
+//------------------------------------------------------------------------
+struct trace_counter_sample_t
 {
-	if(m_flatList.empty())
-	{
-		profile_data* current_data = m_head;
-		bool has_reached_end_of_branch = false;
-		bool is_sorting = false;
-
-		while (nullptr != current_data)
-		{
-			// Step down first child until no children
-			if (nullptr != current_data->first_child && !has_reached_end_of_branch)
-			{
-				current_data = current_data->first_child;
-				continue;
-			}
-
-			// if has next, step to and walk down until no children
-			if (nullptr != current_data->next_sibling && !is_sorting)
-			{
-				has_reached_end_of_branch = false;
-				current_data = current_data->next_sibling;
-				continue;
-			}
+	uint64_t time;
+	uint allocs;
+	uint frees;
+};
 
-			// if has prev but no next, then sort siblings
-			if (nullptr != current_data->prev_sibling && nullptr == current_data->next_sibling || is_sorting)
-			{
-				// SORTING
-				// move to prev if time is less than or equal
-				profile_data* prev = current_data->prev_sibling;
-				if (nullptr != prev && prev->self_time_as_percent >= current_data->self_time_as_percent)
-				{
-					has_reached_end_of_branch = true;
-					is_sorting = true;
-					current_data = current_data->prev_sibling;
-				}
-				else if (nullptr != prev)
-				{
-					// walk list to find next that is greater than me
-					profile_data* lower_than_prev = current_data;
-					while (lower_than_prev->self_time_as_percent > prev->self_time_as_percent)
-					{
-						if (nullptr != lower_than_prev->next_sibling)
-							lower_than_prev = lower_than_prev->next_sibling;
-						else
-							break;
-					}
+static bool TraceCounterSort(trace_counter_sample_t const &a, trace_counter_sample_t const &b) { return a.time < b.time; }
 
-					// Adjust Pointers
-					current_data->prev_sibling = prev->prev_sibling;
-					if (nullptr != current_data->prev_sibling)
-						current_data->prev_sibling->next_sibling = current_data;
+//------------------------------------------------------------------------
+static double TraceTime_us(uint64_t time, uint64_t origin)
+{
+	if (time >= origin) {
+		return TimeOpCountToSeconds(time - origin) * 1000000.0;
+	}
 
-					if (prev->self_time_as_percent < lower_than_prev->self_time_as_percent)
-					{
-						prev->next_sibling = lower_than_prev->next_sibling;
-						prev->prev_sibling = lower_than_prev;
-						lower_than_prev->next_sibling = prev;
-					}
-					else
-					{
-						prev->next_sibling = lower_than_prev;
-						lower_than_prev->prev_sibling->next_sibling = prev;
-						prev->prev_sibling = lower_than_prev->prev_sibling;
-						lower_than_prev->prev_sibling = prev;
-					}
-				}
-				else
-				{
-					is_sorting = false;
-					current_data = current_data->parent;
-				}
-			}
+	return -TimeOpCountToSeconds(origin - time) * 1000000.0;
+}
 
-			//step up to parent next is available, else sort parents and step to grandparents
-			// if no prev and next siblings then step up to parent
-			if (nullptr == current_data->prev_sibling && nullptr == current_data->next_sibling)
-			{
-				has_reached_end_of_branch = true;
-				current_data = current_data->parent;
-				continue;
-			}
+//------------------------------------------------------------------------
+static void TraceWriteString(FILE *fh, char const *str)
+{
+	fputc('"', fh);
+	for (char const *c = str; '\0' != *c; ++c) {
+		if (('"' == *c) || ('\\' == *c)) {
+			fputc('\\', fh);
+			fputc(*c, fh);
+		}
+		else if ((unsigned char)*c >= 0x20) {
+			fputc(*c, fh);
 		}
 	}
-	else
-	{
-		std::sort(m_flatList.begin(), m_flatList.end(), SelfTimeSort);
-	}
+	fputc('"', fh);
 }
 
-void ProfilerReport::Log()
+//------------------------------------------------------------------------
+// Scopes become B/E pairs on their thread's track (tid 0 is the frame track),
+// the frame alloc/free counters become one counter track.  Pairing runs over
+// the whole capture so jobs spanning a frame boundary stay one slice.
+static void ProfilerWriteTrace(profile_trace_capture_t const &capture)
 {
-	profile_data* current_data = m_head;
-	std::string tree_padding = "  ";
-
-	std::string header_format = "%-55s %-10s %-10s %-15s %-10s %-15s %-10s %-10s";
-	LogTaggedPrintf("profile", header_format.c_str(), " TAG NAME", "CALLS", "TOTAL%", "TOTAL TIME", "SELF%", "SELF TIME", "ALLOCS", "FREES");
-
-	std::string msg_format = "%-55s %-10i %-10s %-15s %-10s %-15s %-10u %-10u";
-
-	if(m_flatList.empty())
-	{
-		std::string head_tag = tree_padding + current_data->tag;
-
-		std::string head_total_perc;
-		std::stringstream head_stream_total;
-		head_stream_total << std::fixed << std::setprecision(2) << (current_data->total_time_as_percent * 100.0f);
-		head_total_perc = head_stream_total.str();
-		head_total_perc += "%";
-
-		std::string head_self_perc;
-		std::stringstream head_stream_self;
-		head_stream_self << std::fixed << std::setprecision(2) << (current_data->self_time_as_percent * 100.0f);
-		head_self_perc = head_stream_self.str();
-		head_self_perc += "%";
-
-		LogTaggedPrintf("profile", msg_format.c_str(), head_tag.c_str(), current_data->call_count, head_total_perc.c_str(), current_data->total_time.c_str(), head_self_perc.c_str(), current_data->self_time.c_str(), current_data->alloc_count, current_data->free_count);
+	if (capture.frames.empty()) {
+		return;
+	}
 
-		while (nullptr != current_data)
-		{
-			// Add indent for each child traversal
-			// Subtract when going up by parent
-			// only log when traversing to child or sibling
+	FILE *fh = nullptr;
+	errno_t err = fopen_s(&fh, capture.filename.c_str(), "w");
+	if ((err != 0) || (nullptr == fh)) {
+		LogTaggedPrintf("profile", "ProfilerTrace: could not open %s", capture.filename.c_str());
+		return;
+	}
 
-			if (nullptr != current_data->first_child)
-			{
-				// Move down
-				current_data = current_data->first_child;
+	uint64_t const origin = capture.frames.front().start;
+	uint64_t const capture_end = capture.frames.back().end;
 
-				// Log Child
-				if (m_style == TREE_VIEW)
-					tree_padding += " ";
+	fprintf(fh, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(fh, "{\"ph\":\"M\",\"pid\":1,\"tid\":0,\"name\":\"thread_name\",\"args\":{\"name\":\"Frames\"}}");
+	fprintf(fh, ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":0,\"name\":\"thread_sort_index\",\"args\":{\"sort_index\":-1}}");
 
-				std::string data_tag = tree_padding + current_data->tag;
+	for (profile_thread_t *thread = g_profileThreads; nullptr != thread; thread = thread->next) {
+		fprintf(fh, ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":", thread->index + 1);
+		TraceWriteString(fh, thread->name);
+		fprintf(fh, "}}");
+		fprintf(fh, ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_sort_index\",\"args\":{\"sort_index\":%u}}", thread->index + 1, thread->index);
+	}
 
-				std::string total_perc;
-				std::stringstream stream_total;
-				stream_total << std::fixed << std::setprecision(2) << (current_data->total_time_as_percent * 100.0f);
-				total_perc = stream_total.str();
-				total_perc += "%";
+	std::vector<uint> depth;
+	std::vector<trace_counter_sample_t> samples;
+	uint event_count = 0;
+	uint dropped_count = 0;
 
-				std::string self_perc;
-				std::stringstream stream_self;
-				stream_self << std::fixed << std::setprecision(2) << (current_data->self_time_as_percent * 100.0f);
-				self_perc = stream_self.str();
-				self_perc += "%";
+	for (uint frame_index = 0; frame_index < capture.frames.size(); ++frame_index) {
+		profile_frame_t const &frame = capture.frames[frame_index];
+		fprintf(fh, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":0,\"name\":\"Frame %u\",\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"dropped_scopes\":%u}}",
+			frame_index, TraceTime_us(frame.start, origin), TimeOpCountToSeconds(frame.end - frame.start) * 1000000.0, frame.dropped);
+		dropped_count += frame.dropped;
 
-				LogTaggedPrintf("profile", msg_format.c_str(), data_tag.c_str(), current_data->call_count, total_perc.c_str(), current_data->total_time.c_str(), self_perc.c_str(), current_data->self_time.c_str(), current_data->alloc_count, current_data->free_count);
-				continue;
+		for (profile_span_t const &span : frame.spans) {
+			if (span.thread_index >= depth.size()) {
+				depth.resize(span.thread_index + 1, 0);
 			}
+			uint &thread_depth = depth[span.thread_index];
+			uint const tid = span.thread_index + 1;
+
+			for (uint i = 0; i < span.count; ++i) {
+				profile_event_t const &evt = frame.events[span.first + i];
+				if (0 != (evt.tag & PROFILE_END_FLAG)) {
+					// began before the capture
+					if (0 == thread_depth) {
+						continue;
+					}
 
-			if (nullptr != current_data->next_sibling)
-			{
-				current_data = current_data->next_sibling;
-				std::string data_tag = tree_padding + current_data->tag;
-				std::string total_perc;
-				std::stringstream stream_total;
-				stream_total << std::fixed << std::setprecision(2) << (current_data->total_time_as_percent * 100.0f);
-				total_perc = stream_total.str();
-				total_perc += "%";
-
-				std::string self_perc;
-				std::stringstream stream_self;
-				stream_self << std::fixed << std::setprecision(2) << (current_data->self_time_as_percent * 100.0f);
-				self_perc = stream_self.str();
-				self_perc += "%";
-
-				LogTaggedPrintf("profile", msg_format.c_str(), data_tag.c_str(), current_data->call_count, total_perc.c_str(), current_data->total_time.c_str(), self_perc.c_str(), current_data->self_time.c_str(), current_data->alloc_count, current_data->free_count);
-				continue;
-			}
-			else
-			{
-				profile_data* temp = current_data;
-				while (nullptr != temp && nullptr == temp->parent->next_sibling)
-				{
-					if (m_style == TREE_VIEW)
-						tree_padding.pop_back();
-
-					temp = temp->parent;
-
-					if (nullptr == temp->parent)
-						break;
+					--thread_depth;
+					fprintf(fh, ",\n{\"ph\":\"E\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}", tid, TraceTime_us(evt.time, origin));
 				}
-
-				if (nullptr == temp)
-					break;
-
-				if (nullptr == temp->parent)
-				{
-					current_data = temp->parent;
-					continue;
+				else {
+					++thread_depth;
+					fprintf(fh, ",\n{\"ph\":\"B\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"name\":", tid, TraceTime_us(evt.time, origin));
+					TraceWriteString(fh, ProfilerGetTagName(evt.tag));
+					fprintf(fh, ",\"cat\":");
+					TraceWriteString(fh, (PROFILER_INVALID_TAG != evt.category) ? ProfilerGetTagName(evt.category) : "profile");
+					fprintf(fh, "}");
 				}
 
-				if (m_style == TREE_VIEW)
-					tree_padding.pop_back();
-
-				current_data = temp->parent->next_sibling;
-				std::string data_tag = tree_padding + current_data->tag;
-				std::string total_perc;
-				std::stringstream stream_total;
-				stream_total << std::fixed << std::setprecision(2) << (current_data->total_time_as_percent * 100.0f);
-				total_perc = stream_total.str();
-				total_perc += "%";
-
-				std::string self_perc;
-				std::stringstream stream_self;
-				stream_self << std::fixed << std::setprecision(2) << (current_data->self_time_as_percent * 100.0f);
-				self_perc = stream_self.str();
-				self_perc += "%";
-
-				LogTaggedPrintf("profile", msg_format.c_str(), data_tag.c_str(), current_data->call_count, total_perc.c_str(), current_data->total_time.c_str(), self_perc.c_str(), current_data->self_time.c_str(), current_data->alloc_count, current_data->free_count);
-				continue;
+				trace_counter_sample_t sample;
+				sample.time = evt.time;
+				sample.allocs = evt.allocs;
+				sample.frees = evt.frees;
+				samples.push_back(sample);
+				++event_count;
 			}
+		}
+	}
 
+	// still open when the capture ended
+	for (uint thread_index = 0; thread_index < depth.size(); ++thread_index) {
+		for (uint i = 0; i < depth[thread_index]; ++i) {
+			fprintf(fh, ",\n{\"ph\":\"E\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}", thread_index + 1, TraceTime_us(capture_end, origin));
 		}
 	}
-	else
-	{
-		for (profile_data* data : m_flatList)
-		{
-			std::string data_tag = tree_padding + data->tag;
-			std::string total_perc;
-			std::stringstream stream_total;
-			stream_total << std::fixed << std::setprecision(2) << (current_data->total_time_as_percent * 100.0f);
-			total_perc = stream_total.str();
-			total_perc += "%";
-
-			std::string self_perc;
-			std::stringstream stream_self;
-			stream_self << std::fixed << std::setprecision(2) << (current_data->self_time_as_percent * 100.0f);
-			self_perc = stream_self.str();
-			self_perc += "%";
-
-			LogTaggedPrintf("profile", msg_format.c_str(), data_tag.c_str(), current_data->call_count, total_perc.c_str(), current_data->total_time.c_str(), self_perc.c_str(), current_data->self_time.c_str(), current_data->alloc_count, current_data->free_count);
+
+	std::sort(samples.begin(), samples.end(), TraceCounterSort);
+	uint last_allocs = 0xffffffff;
+	uint last_frees = 0xffffffff;
+	for (trace_counter_sample_t const &sample : samples) {
+		if ((sample.allocs == last_allocs) && (sample.frees == last_frees)) {
+			continue;
 		}
+
+		fprintf(fh, ",\n{\"ph\":\"C\",\"pid\":1,\"name\":\"Frame Memory\",\"ts\":%.3f,\"args\":{\"allocs\":%u,\"frees\":%u}}",
+			TraceTime_us(sample.time, origin), sample.allocs, sample.frees);
+		last_allocs = sample.allocs;
+		last_frees = sample.frees;
 	}
+
+	fprintf(fh, "\n]}\n");
+	fclose(fh);
+
+	LogTaggedPrintf("profile", "ProfilerTrace: wrote %u events over %u frames to %s, %u scope(s) dropped", event_count, (uint)capture.frames.size(), capture.filename.c_str(), dropped_count);
 }
 
-void ProfilerReport::CreateTree(const ReportStyle& style)
+//------------------------------------------------------------------------
+// Main thread only - the capture is advanced by ProfilerEndFrame.
+bool ProfilerCaptureTrace(uint frame_count, char const *filename)
 {
-	m_style = style;
+#if defined PROFILED_BUILD
+	if (!g_profilerRunning || (0 == frame_count)) {
+		return false;
+	}
 
-	if (TREE_VIEW == style)
-	{
-		CreateTreeView();
-		SortByTotalTime();
+	if (nullptr != g_traceCapture) {
+		LogTaggedPrintf("profile", "ProfilerTrace: capture already running, %u frames left", g_traceCapture->frames_left);
+		return false;
 	}
-	else if(FLAT_VIEW == style)
-	{
-		CreateFlatView();
-		SortBySelfTime();
+
+	if (!g_canRecord) {
+		LogTaggedPrintf("profile", "ProfilerTrace: profiler is paused, capture will be empty until resumed");
 	}
+
+	g_traceCapture = new profile_trace_capture_t();
+	g_traceCapture->frames_left = frame_count;
+	g_traceCapture->filename = filename;
+	g_traceCapture->frames.reserve(frame_count);
+	return true;
+#else
+	frame_count;
+	filename;
+	return false;
+#endif
 }
 
-void PrintReport(void* data)
+//------------------------------------------------------------------------
+// ProfilerTrace [frame_count] [filename]
+void CaptureTrace(void* data)
 {
 #if defined PROFILED_BUILD
 	arguments args = *(arguments*)data;
 
-	std::locale local;
-	std::string casedType = args.arg_list[0];
-	for (unsigned int i = 0; i < casedType.length(); ++i)
-		casedType[i] = std::tolower(casedType[i], local);
-
-
-	ProfilerReport report(g_profilerRoot);
-
-	ReportStyle style = TREE_VIEW;
-	if (casedType == "flat_view")
-		style = FLAT_VIEW;
-
+	uint frame_count = 60;
+	if (args.arg_list.size() > 0) {
+		int requested = atoi(args.arg_list[0].c_str());
+		frame_count = (requested > 0) ? (uint)requested : frame_count;
+	}
 
-	report.CreateTree(style);
+	std::string filename = "Data/Log/profile_trace.json";
+	if (args.arg_list.size() > 1) {
+		filename = args.arg_list[1];
+	}
 
-	report.Log();
+	if (ProfilerCaptureTrace(frame_count, filename.c_str())) {
+		LogTaggedPrintf("profile", "ProfilerTrace: capturing %u frames to %s", frame_count, filename.c_str());
+	}
+#else
+	data;
 #endif
 }
 
@@ -1196,5 +1081,6 @@ void RegisterProfilerCommands()
 	g_console->RegisterCommand("ProfilerPause", ProfilerPause);
 	g_console->RegisterCommand("ProfilerResume", ProfilerResume);
 	g_console->RegisterCommand("ProfilerReport", PrintReport);
+	g_console->RegisterCommand("ProfilerTrace", CaptureTrace);
 #endif
-}
\ No newline at end of file
+}
@@ -1,26 +1,63 @@
 #pragma once
 #include "Engine/Core/Time.hpp"
 #include "Engine/Core/Logging.hpp"
+#include "Engine/Core/BuildConfig.hpp"
+#include "Engine/Core/CriticalSection.hpp"
 
-#define PROFILE_LOG_SCOPE(s) ProfileLogScope __pscope_##__LINE__##(s)
+// Tag must be a string literal - it is interned once per call site, in a lambda
+// so the macro stays a single declaration.  The tag is passed in rather than
+// named inside it, where __FUNCTION__ would be the lambda's.
+// Use a ProfileLogScope directly for tags built at runtime.
+#if defined(PROFILED_BUILD)
+	#define PROFILE_INTERNED_TAG(s) ([](char const *name) -> uint { static uint const tag = ProfilerInternTag(name); return tag; }(s))
+	#define PROFILE_LOG_SCOPE(s) ProfileLogScope COMBINE(__pscope_,__LINE__)(PROFILE_INTERNED_TAG(s))
+	#define PROFILE_LOG_SCOPE_CATEGORY(s, category_tag) ProfileLogScope COMBINE(__pscope_,__LINE__)(PROFILE_INTERNED_TAG(s), category_tag)
+#else
+	#define PROFILE_LOG_SCOPE(s)
+	#define PROFILE_LOG_SCOPE_CATEGORY(s, category_tag)
+#endif
 #define PROFILE_SCOPE_FUNCTION() PROFILE_LOG_SCOPE(__FUNCTION__)
 
+// events each thread can have in flight between collections
+uint const PROFILER_RING_SIZE = 1 << 14;
 
+// frames kept for reports
+uint const PROFILER_HISTORY_SIZE = 64;
+
+uint const PROFILER_MAX_TAGS = 4096;
+uint const PROFILER_INVALID_TAG = 0xffffffff;
+
+uint ProfilerInternTag(char const *tag);
+char const* ProfilerGetTagName(uint tag);
 
 void ProfilerPush(char const *tag);
+// category is another interned tag, shown as the trace event category
+void ProfilerPushTag(uint tag, uint category_tag = PROFILER_INVALID_TAG);
 void ProfilerPop();
+void ProfilerSetThreadName(char const *name);
 
 void RegisterProfilerCommands();
+void ProfilerStartup();
 void ProfilerShutdown();
+void ProfilerEndFrame();
+void ProfilerBenchmark(uint scope_count);
+
+// records the next frame_count frames from every thread and writes them as
+// Chrome trace event json (chrome://tracing, ui.perfetto.dev) once done
+bool ProfilerCaptureTrace(uint frame_count, char const *filename);
 void SetFrameEndTime(uint64_t op_count);
 void SetFrameStartTime(uint64_t op_count);
-void ProfilerStartup();
 uint64_t GetTotalFrameTime();
 
 
 class ProfileLogScope
 {
 public:
+	ProfileLogScope(uint tag, uint category_tag = PROFILER_INVALID_TAG)
+	{
+		ProfilerPushTag(tag, category_tag);
+	}
+
 	ProfileLogScope(char const *tag)
 	{
 		ProfilerPush(tag);
@@ -1,7 +1,9 @@
 #pragma once
 #include "Engine/Core/CriticalSection.hpp"
-#include <queue>
+#include <vector>
 
+// FIFO behind a lock.  Backed by a ring that only ever grows, so once it has
+// reached its working size push/pop no longer touch the heap.
 template <typename T>
 class ThreadSafeQueue
 {
@@ -9,13 +11,18 @@ public:
 	void push(T const &v)
 	{
 		SCOPE_LOCK(&m_lock);
-		m_queue.push(v);
+		if (m_count == m_ring.size()) {
+			grow();
+		}
+
+		m_ring[(m_head + m_count) & (m_ring.size() - 1)] = v;
+		++m_count;
 	}
 
 	bool empty()
 	{
 		SCOPE_LOCK(&m_lock);
-		bool result = m_queue.empty();
+		bool result = (0 == m_count);
 
 		return result;
 	}
@@ -24,12 +31,13 @@ public:
 	{
 		SCOPE_LOCK(&m_lock);
 
-		if (m_queue.empty()) {
+		if (0 == m_count) {
 			return false;
 		}
 		else {
-			*out = m_queue.front();
-			m_queue.pop();
+			*out = std::move(m_ring[m_head]);
+			m_head = (m_head + 1) & (m_ring.size() - 1);
+			--m_count;
 			return true;
 		}
 	}
@@ -37,12 +45,28 @@ public:
 	T front()
 	{
 		SCOPE_LOCK(&m_lock);
-		T result = m_queue.front();
+		T result = m_ring[m_head];
 
 		return result;
 	}
 
+private:
+	// must hold the lock; size stays a power of two
+	void grow()
+	{
+		size_t new_size = m_ring.empty() ? 64 : (m_ring.size() * 2);
+		std::vector<T> ring(new_size);
+		for (size_t i = 0; i < m_count; ++i) {
+			ring[i] = std::move(m_ring[(m_head + i) & (m_ring.size() - 1)]);
+		}
+
+		m_ring.swap(ring);
+		m_head = 0;
+	}
+
 public:
-	std::queue<T> m_queue;
+	std::vector<T> m_ring;
+	size_t m_head = 0;
+	size_t m_count = 0;
 	CriticalSection m_lock;
 };
\ No newline at end of file
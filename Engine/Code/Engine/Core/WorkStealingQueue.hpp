@@ -0,0 +1,109 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+
+typedef unsigned int uint;
+
+//------------------------------------------------------------------------
+// Chase-Lev work stealing deque.
+// Only the owning thread may push() and pop() (LIFO end), any thread
+// may steal() (FIFO end).  Capacity is fixed and must be a power of two,
+// push() returns false when full so the caller can fall back to a shared queue.
+//------------------------------------------------------------------------
+template <typename T>
+class WorkStealingQueue
+{
+public:
+	WorkStealingQueue(uint capacity = 4096)
+		: m_top(0)
+		, m_bottom(0)
+	{
+		m_capacity = capacity;
+		m_mask = capacity - 1;
+		m_buffer = new std::atomic<T>[capacity];
+	}
+
+	~WorkStealingQueue()
+	{
+		delete[] m_buffer;
+	}
+
+	// owner only
+	bool push(T const &v)
+	{
+		int64_t b = m_bottom.load(std::memory_order_relaxed);
+		int64_t t = m_top.load(std::memory_order_acquire);
+		if ((b - t) >= (int64_t)m_capacity) {
+			return false;
+		}
+
+		m_buffer[b & m_mask].store(v, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		m_bottom.store(b + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// owner only
+	bool pop(T *out)
+	{
+		int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+		m_bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = m_top.load(std::memory_order_relaxed);
+
+		if (t > b) {
+			// was empty - restore
+			m_bottom.store(b + 1, std::memory_order_relaxed);
+			return false;
+		}
+
+		*out = m_buffer[b & m_mask].load(std::memory_order_relaxed);
+		if (t != b) {
+			// more than one item left, no race with thieves
+			return true;
+		}
+
+		// last item - race any thieves for it
+		bool won = m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		m_bottom.store(b + 1, std::memory_order_relaxed);
+		return won;
+	}
+
+	// any thread
+	bool steal(T *out)
+	{
+		int64_t t = m_top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t b = m_bottom.load(std::memory_order_acquire);
+
+		if (t >= b) {
+			return false;
+		}
+
+		T v = m_buffer[t & m_mask].load(std::memory_order_relaxed);
+		if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			// lost to the owner or another thief
+			return false;
+		}
+
+		*out = v;
+		return true;
+	}
+
+	// approximate - only exact when called by the owner with no thieves active
+	bool empty() const
+	{
+		int64_t b = m_bottom.load(std::memory_order_relaxed);
+		int64_t t = m_top.load(std::memory_order_relaxed);
+		return t >= b;
+	}
+
+public:
+	// top and bottom are hammered by different threads, keep them off the same cache line
+	std::atomic<int64_t> m_top;
+	char m_pad[64 - sizeof(std::atomic<int64_t>)];
+	std::atomic<int64_t> m_bottom;
+	std::atomic<T> *m_buffer;
+	uint m_capacity;
+	uint m_mask;
+};
@@ -0,0 +1,229 @@
+#include "Engine/Input/BitStream.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include <math.h>
+
+//------------------------------------------------------------------------
+// Quantizing
+//------------------------------------------------------------------------
+static uint32_t MaxValueForBits(uint bit_count)
+{
+	return (bit_count >= 32) ? 0xffffffffU : ((1U << bit_count) - 1U);
+}
+
+uint BitsRequired(uint32_t max_value)
+{
+	uint bits = 0;
+	while (max_value > 0) {
+		++bits;
+		max_value >>= 1;
+	}
+	return bits;
+}
+
+uint32_t QuantizeFloat(float value, float min, float max, uint bit_count)
+{
+	if (value <= min) {
+		return 0;
+	}
+
+	uint32_t max_quantized = MaxValueForBits(bit_count);
+	if (value >= max) {
+		return max_quantized;
+	}
+
+	double normalized = ((double)value - (double)min) / ((double)max - (double)min);
+	return (uint32_t)floor((normalized * (double)max_quantized) + 0.5);
+}
+
+float DequantizeFloat(uint32_t quantized, float min, float max, uint bit_count)
+{
+	double normalized = (double)quantized / (double)MaxValueForBits(bit_count);
+	return (float)((double)min + (normalized * ((double)max - (double)min)));
+}
+
+// angles wrap, so the full range is 360 degrees spread over 2^bits steps
+uint32_t QuantizeAngleDegrees(float degrees, uint bit_count)
+{
+	double turns = (double)degrees / 360.0;
+	turns -= floor(turns);
+
+	double steps = (double)(1ULL << bit_count);
+	uint64_t quantized = (uint64_t)floor((turns * steps) + 0.5);
+	return (uint32_t)(quantized & MaxValueForBits(bit_count));
+}
+
+float DequantizeAngleDegrees(uint32_t quantized, uint bit_count)
+{
+	return (float)(((double)quantized * 360.0) / (double)(1ULL << bit_count));
+}
+
+
+//------------------------------------------------------------------------
+// Writer
+//------------------------------------------------------------------------
+BitStreamWriter::BitStreamWriter(BinaryStream *stream)
+	:m_stream(stream)
+	, m_scratch(0)
+	, m_scratchBits(0)
+	, m_bitsWritten(0)
+{
+}
+
+BitStreamWriter::~BitStreamWriter()
+{
+	flush();
+}
+
+void BitStreamWriter::write_bits(uint32_t value, uint bit_count)
+{
+	ASSERT_OR_DIE(bit_count <= 32, "BitStreamWriter: at most 32 bits at a time");
+	if (bit_count == 0) {
+		return;
+	}
+
+	value &= MaxValueForBits(bit_count);
+	m_scratch |= ((uint64_t)value) << m_scratchBits;
+	m_scratchBits += bit_count;
+	m_bitsWritten += bit_count;
+
+	while (m_scratchBits >= 8) {
+		byte_t byte = (byte_t)(m_scratch & 0xff);
+		m_stream->write_bytes(&byte, 1);
+		m_scratch >>= 8;
+		m_scratchBits -= 8;
+	}
+}
+
+void BitStreamWriter::write_bool(bool value)
+{
+	write_bits(value ? 1U : 0U, 1);
+}
+
+void BitStreamWriter::write_int_range(int value, int min, int max)
+{
+	value = (value < min) ? min : ((value > max) ? max : value);
+	write_bits((uint32_t)(value - min), BitsRequired((uint32_t)(max - min)));
+}
+
+void BitStreamWriter::write_float(float value, float min, float max, uint bit_count)
+{
+	write_bits(QuantizeFloat(value, min, max, bit_count), bit_count);
+}
+
+void BitStreamWriter::write_angle(float degrees, uint bit_count)
+{
+	write_bits(QuantizeAngleDegrees(degrees, bit_count), bit_count);
+}
+
+void BitStreamWriter::write_vector2(Vector2 const &value, float min, float max, uint bit_count)
+{
+	write_float(value.x, min, max, bit_count);
+	write_float(value.y, min, max, bit_count);
+}
+
+void BitStreamWriter::flush()
+{
+	if (m_scratchBits > 0) {
+		byte_t byte = (byte_t)(m_scratch & 0xff);
+		m_stream->write_bytes(&byte, 1);
+		m_bitsWritten += 8 - m_scratchBits;
+		m_scratch = 0;
+		m_scratchBits = 0;
+	}
+}
+
+
+//------------------------------------------------------------------------
+// Reader
+//------------------------------------------------------------------------
+BitStreamReader::BitStreamReader(BinaryStream *stream)
+	:m_stream(stream)
+	, m_scratch(0)
+	, m_scratchBits(0)
+	, m_bitsRead(0)
+{
+}
+
+BitStreamReader::~BitStreamReader()
+{
+}
+
+bool BitStreamReader::read_bits(uint32_t *out, uint bit_count)
+{
+	ASSERT_OR_DIE(bit_count <= 32, "BitStreamReader: at most 32 bits at a time");
+
+	// only pull the bytes we need, so byte reads can pick up after align()
+	while (m_scratchBits < bit_count) {
+		byte_t byte;
+		if (m_stream->read_bytes(&byte, 1) != 1) {
+			return false;
+		}
+
+		m_scratch |= ((uint64_t)byte) << m_scratchBits;
+		m_scratchBits += 8;
+	}
+
+	*out = (uint32_t)(m_scratch & MaxValueForBits(bit_count));
+	m_scratch >>= bit_count;
+	m_scratchBits -= bit_count;
+	m_bitsRead += bit_count;
+	return true;
+}
+
+bool BitStreamReader::read_bool(bool *out)
+{
+	uint32_t value;
+	if (!read_bits(&value, 1)) {
+		return false;
+	}
+
+	*out = (value != 0);
+	return true;
+}
+
+bool BitStreamReader::read_int_range(int *out, int min, int max)
+{
+	uint32_t value;
+	if (!read_bits(&value, BitsRequired((uint32_t)(max - min)))) {
+		return false;
+	}
+
+	*out = min + (int)value;
+	return true;
+}
+
+bool BitStreamReader::read_float(float *out, float min, float max, uint bit_count)
+{
+	uint32_t value;
+	if (!read_bits(&value, bit_count)) {
+		return false;
+	}
+
+	*out = DequantizeFloat(value, min, max, bit_count);
+	return true;
+}
+
+bool BitStreamReader::read_angle(float *out, uint bit_count)
+{
+	uint32_t value;
+	if (!read_bits(&value, bit_count)) {
+		return false;
+	}
+
+	*out = DequantizeAngleDegrees(value, bit_count);
+	return true;
+}
+
+bool BitStreamReader::read_vector2(Vector2 *out, float min, float max, uint bit_count)
+{
+	bool read_x = read_float(&out->x, min, max, bit_count);
+	bool read_y = read_float(&out->y, min, max, bit_count);
+	return read_x && read_y;
+}
+
+void BitStreamReader::align()
+{
+	m_bitsRead += m_scratchBits % 8;
+	m_scratch = 0;
+	m_scratchBits = 0;
+}
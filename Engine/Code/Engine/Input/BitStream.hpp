@@ -0,0 +1,65 @@
+#pragma once
+#include "Engine/Input/BinaryStream.hpp"
+#include <stdint.h>
+
+// Bit packing on top of any BinaryStream.  Bits are gathered into a scratch
+// word and handed to the stream a byte at a time, low bits first; Flush/Align
+// pad out to the next byte so byte writes can follow.
+
+// quantizing helpers - values are clamped to [min, max] then spread over bit_count bits
+uint32_t QuantizeFloat(float value, float min, float max, uint bit_count);
+float DequantizeFloat(uint32_t quantized, float min, float max, uint bit_count);
+uint32_t QuantizeAngleDegrees(float degrees, uint bit_count);
+float DequantizeAngleDegrees(uint32_t quantized, uint bit_count);
+uint BitsRequired(uint32_t max_value);
+
+class BitStreamWriter
+{
+public:
+	BitStreamWriter(BinaryStream *stream);
+	~BitStreamWriter();
+
+	void write_bits(uint32_t value, uint bit_count);
+	void write_bool(bool value);
+	void write_int_range(int value, int min, int max);
+	void write_float(float value, float min, float max, uint bit_count);
+	void write_angle(float degrees, uint bit_count);
+	void write_vector2(Vector2 const &value, float min, float max, uint bit_count);
+
+	// pads to a byte boundary and pushes everything into the stream
+	void flush();
+
+	inline uint get_bits_written() const { return m_bitsWritten; }
+
+public:
+	BinaryStream* m_stream;
+	uint64_t m_scratch;
+	uint m_scratchBits;
+	uint m_bitsWritten;
+};
+
+class BitStreamReader
+{
+public:
+	BitStreamReader(BinaryStream *stream);
+	~BitStreamReader();
+
+	// false once the stream runs dry
+	bool read_bits(uint32_t *out, uint bit_count);
+	bool read_bool(bool *out);
+	bool read_int_range(int *out, int min, int max);
+	bool read_float(float *out, float min, float max, uint bit_count);
+	bool read_angle(float *out, uint bit_count);
+	bool read_vector2(Vector2 *out, float min, float max, uint bit_count);
+
+	// drops what's left of the current byte
+	void align();
+
+	inline uint get_bits_read() const { return m_bitsRead; }
+
+public:
+	BinaryStream* m_stream;
+	uint64_t m_scratch;
+	uint m_scratchBits;
+	uint m_bitsRead;
+};
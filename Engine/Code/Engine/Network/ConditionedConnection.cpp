@@ -0,0 +1,64 @@
+#include "Engine/Network/ConditionedConnection.hpp"
+#include "Engine/Network/NetMessage.hpp"
+#include "Engine/Core/Time.hpp"
+#include <string.h>
+
+ConditionedConnection::ConditionedConnection(NetConnection *inner)
+	:m_inner(inner)
+{
+	m_address = inner->m_address;
+	m_owner = inner->m_owner;
+	m_linkConditioner.SetStream(true);
+}
+
+ConditionedConnection::~ConditionedConnection()
+{
+	delete m_inner;
+	m_inner = nullptr;
+}
+
+void ConditionedConnection::Send(NetMessage *msg)
+{
+	m_inner->Send(msg);
+}
+
+bool ConditionedConnection::Receive(NetMessage **msg)
+{
+	if (!m_linkConditioner.IsActive()) {
+		return m_inner->Receive(msg);
+	}
+
+	double now = GetCurrentTimeSeconds();
+
+	// everything that's arrived goes in the conditioner, then out again when due
+	// type + payload
+	m_scratch.resize(1 + NET_MESSAGE_MAX_PAYLOAD);
+
+	NetMessage *arrived = nullptr;
+	while (m_inner->Receive(&arrived)) {
+		m_scratch[0] = arrived->m_messageTypeIndex;
+		if (arrived->m_payloadBytesUsed > 0) {
+			memcpy(&m_scratch[1], arrived->GetPayload(), arrived->m_payloadBytesUsed);
+		}
+		m_linkConditioner.Submit(&m_scratch[0], 1 + arrived->m_payloadBytesUsed, now);
+
+		delete arrived;
+		arrived = nullptr;
+	}
+
+	uint size = m_linkConditioner.Pop(now, &m_scratch[0], (uint)m_scratch.size());
+	if (size == 0) {
+		return false;
+	}
+
+	net_message_buffer_t *payload = NetMessageBufferAcquire(size - 1);
+	memcpy(payload->data, &m_scratch[1], size - 1);
+	*msg = new NetMessage(m_scratch[0], payload, 0, size - 1);
+	NetMessageBufferRelease(payload);
+	return true;
+}
+
+bool ConditionedConnection::IsDisconnected() const
+{
+	return m_inner->IsDisconnected();
+}
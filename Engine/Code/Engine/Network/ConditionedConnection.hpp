@@ -0,0 +1,26 @@
+#pragma once
+#include "Engine/Network/NetConnection.hpp"
+#include "Engine/Network/NetLinkConditioner.hpp"
+#include <vector>
+
+// Wraps any connection and runs what it receives through a NetLinkConditioner,
+// so a pair of wrapped ends (or one wrapped loopback) behaves like a bad link.
+// Sends go straight through - the far end conditions them on the way in.
+// What's wrapped is a reliable ordered stream, so it only gets slower: latency,
+// in-order jitter, the bandwidth cap, and loss as retransmit delay.
+class ConditionedConnection : public NetConnection
+{
+public:
+	ConditionedConnection(NetConnection *inner);	// takes ownership of inner
+	virtual ~ConditionedConnection();
+
+	virtual void Send(NetMessage *msg) override;
+	virtual bool Receive(NetMessage **msg) override;
+	virtual bool IsDisconnected() const override;
+	virtual net_send_stats_t* GetSendStats() override { return m_inner->GetSendStats(); }
+
+public:
+	NetConnection* m_inner;
+	NetLinkConditioner m_linkConditioner;
+	std::vector<byte_t> m_scratch;
+};
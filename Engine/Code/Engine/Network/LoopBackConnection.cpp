@@ -1,15 +1,20 @@
 #include "Engine/Network/LoopBackConnection.hpp"
+#include "Engine/Network/NetMessage.hpp"
 
 
 
 LoopBackConnection::~LoopBackConnection()
 {
-	
+	while (!m_messages.empty()) {
+		delete m_messages.front();
+		m_messages.pop();
+	}
 }
 
 void LoopBackConnection::Send(NetMessage *msg)
 {
-	m_messages.push(msg);
+	// shares msg's buffer, the caller keeps msg
+	m_messages.push(new NetMessage(*msg));
 }
 
 bool LoopBackConnection::Receive(NetMessage **msg)
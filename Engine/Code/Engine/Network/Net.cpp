@@ -2,6 +2,7 @@
 #include "Engine/Core/ErrorWarningAssert.hpp"
 #include "Engine/Network/TCPSocket.hpp"
 #include "Engine/Network/NetAddress.hpp"
+#include "Engine/Network/NetMessage.hpp"
 #include "Engine/Core/XMLUtils.hpp"
 
 
@@ -23,6 +24,7 @@ bool NetSystemStartup()
 void NetSystemShutdown()
 {
 	::WSACleanup();
+	NetMessagePoolShutdown();
 
 	s_serviceType.clear();
 	s_controlURL.clear();
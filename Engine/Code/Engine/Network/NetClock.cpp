@@ -0,0 +1,180 @@
+#include "Engine/Network/NetClock.hpp"
+#include "Engine/Network/NetObject.hpp"
+#include "Engine/Network/NetMessage.hpp"
+#include "Engine/Network/NetSession.hpp"
+#include "Engine/Network/NetConnection.hpp"
+#include "Engine/Core/Time.hpp"
+#include "Engine/EngineConfig.hpp"
+#include <math.h>
+#include <string.h>
+
+struct net_clock_sample_t
+{
+	float round_trip;
+	double offset;
+};
+
+static net_clock_sample_t s_clockSamples[NET_CLOCK_SAMPLES];
+static uint32_t s_clockSampleCount = 0;
+static uint32_t s_clockNextSample = 0;
+static double s_clockOffset = 0.0;
+static double s_clockTargetOffset = 0.0;
+static double s_lastPingTime = 0.0;
+static double s_lastSlewTime = 0.0;
+static net_clock_stats_t s_clockStats;
+
+void NetClockReset()
+{
+	s_clockSampleCount = 0;
+	s_clockNextSample = 0;
+	s_clockOffset = 0.0;
+	s_clockTargetOffset = 0.0;
+	s_lastPingTime = 0.0;
+	s_lastSlewTime = GetCurrentTimeSeconds();
+	memset(&s_clockStats, 0, sizeof(s_clockStats));
+}
+
+double NetClockGetHostTime()
+{
+	return GetCurrentTimeSeconds() + s_clockOffset;
+}
+
+bool NetClockIsSynced()
+{
+	NetSession *session = GetNetObjectSession();
+	if ((session != nullptr) && session->AmIHost())
+		return true;
+
+	return s_clockSampleCount > 0;
+}
+
+net_clock_stats_t NetClockGetStats()
+{
+	net_clock_stats_t stats = s_clockStats;
+	stats.offset = s_clockOffset;
+	stats.target_offset = s_clockTargetOffset;
+	stats.is_synced = NetClockIsSynced();
+	return stats;
+}
+
+static void SendNetClockPing(NetSession *session)
+{
+	double send_time = GetCurrentTimeSeconds();
+	NetMessage ping(PING);
+	ping.m_sender = session->m_myConnection;
+	ping.write_bytes(&send_time, sizeof(double));
+	session->m_hostConnection->Send(&ping);
+
+	s_lastPingTime = send_time;
+	++s_clockStats.pings;
+}
+
+void NetClockUpdate()
+{
+	NetSession *session = GetNetObjectSession();
+	double now = GetCurrentTimeSeconds();
+	double elapsed = now - s_lastSlewTime;
+	s_lastSlewTime = now;
+
+	if ((session == nullptr) || !session->AmIClient() || (session->m_hostConnection == nullptr))
+		return;
+
+	float ping_seconds = (s_clockSampleCount < NET_CLOCK_SAMPLES) ? NET_CLOCK_BURST_SECONDS : NET_CLOCK_PING_SECONDS;
+	if (now - s_lastPingTime >= ping_seconds)
+		SendNetClockPing(session);
+
+	if (s_clockSampleCount == 0)
+		return;
+
+	double error = s_clockTargetOffset - s_clockOffset;
+	double max_slew = elapsed * NET_CLOCK_SLEW_RATE;
+	if (fabs(error) <= max_slew)
+		s_clockOffset = s_clockTargetOffset;
+	else
+		s_clockOffset += (error > 0.0) ? max_slew : -max_slew;
+}
+
+static void OnNetClockPing(NetMessage *msg)
+{
+	NetSession *session = GetNetObjectSession();
+	if ((session == nullptr) || !session->AmIHost() || (msg->m_sender == nullptr))
+		return;
+
+	double client_time;
+	if (msg->read_bytes(&client_time, sizeof(double)) != sizeof(double))
+		return;
+
+	double host_time = GetCurrentTimeSeconds();
+	NetMessage pong(PONG);
+	pong.m_sender = session->m_myConnection;
+	pong.write_bytes(&client_time, sizeof(double));
+	pong.write_bytes(&host_time, sizeof(double));
+	msg->m_sender->Send(&pong);
+}
+
+static void OnNetClockPong(NetMessage *msg)
+{
+	double client_time;
+	double host_time;
+	if ((msg->read_bytes(&client_time, sizeof(double)) != sizeof(double)) || (msg->read_bytes(&host_time, sizeof(double)) != sizeof(double)))
+		return;
+
+	double now = GetCurrentTimeSeconds();
+	float round_trip = (float)(now - client_time);
+	if ((round_trip < 0.0f) || (client_time > s_lastPingTime))
+		return;
+
+	net_clock_sample_t &sample = s_clockSamples[s_clockNextSample];
+	sample.round_trip = round_trip;
+	sample.offset = host_time - ((client_time + now) * 0.5);
+	s_clockNextSample = (s_clockNextSample + 1) % NET_CLOCK_SAMPLES;
+	if (s_clockSampleCount < NET_CLOCK_SAMPLES)
+		++s_clockSampleCount;
+
+	++s_clockStats.pongs;
+	s_clockStats.round_trip_average += (round_trip - s_clockStats.round_trip_average) / 8.0f;
+	if (s_clockSampleCount == 1)
+		s_clockStats.round_trip_average = round_trip;
+
+	uint32_t best = 0;
+	for (uint32_t index = 1; index < s_clockSampleCount; ++index)
+	{
+		if (s_clockSamples[index].round_trip < s_clockSamples[best].round_trip)
+			best = index;
+	}
+
+	s_clockTargetOffset = s_clockSamples[best].offset;
+	s_clockStats.round_trip = s_clockSamples[best].round_trip;
+
+	if ((s_clockSampleCount == 1) || (fabs(s_clockTargetOffset - s_clockOffset) > NET_CLOCK_STEP_SECONDS))
+	{
+		s_clockOffset = s_clockTargetOffset;
+		++s_clockStats.steps;
+	}
+}
+
+void EstablishNetClockMessages()
+{
+	// a resent ping would only measure the resend
+	NetSession* session = GetNetObjectSession();
+	session->RegisterMessageDefinition(PING, OnNetClockPing, NET_CHANNEL_UNRELIABLE);
+	session->RegisterMessageDefinition(PONG, OnNetClockPong, NET_CHANNEL_UNRELIABLE);
+}
+
+//------------------------------------------------------------------------
+// Console
+//------------------------------------------------------------------------
+void NetClockStatsCmd(void*)
+{
+	net_clock_stats_t stats = NetClockGetStats();
+	g_console->ConsolePrintf(Rgba(255, 255, 255, 255), "Net clock: host time %.3f, %s",
+		NetClockGetHostTime(), stats.is_synced ? "synced" : "not synced");
+	g_console->ConsolePrintf(Rgba(255, 255, 255, 255), "  offset %.3f ms (best sample %.3f ms), round trip %.1f ms best, %.1f ms average",
+		stats.offset * 1000.0, stats.target_offset * 1000.0, stats.round_trip * 1000.0f, stats.round_trip_average * 1000.0f);
+	g_console->ConsolePrintf(Rgba(255, 255, 255, 255), "  %u pings, %u pongs, %u steps", stats.pings, stats.pongs, stats.steps);
+}
+
+void RegisterNetClockCommands()
+{
+	g_console->RegisterCommand("NetClockStats", NetClockStatsCmd);
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <stdint.h>
+
+// Keeps a client's idea of the host's clock, so both ends can run the same
+// simulation ticks off it.  Clients PING the host with their send time and the
+// host answers straight away with its own time - NTP with the host's receive
+// and send times being the same moment:
+//
+//   round trip = t_recv - t_send,   offset = t_host - (t_send + t_recv) / 2
+//
+// The offset from the fastest of the last few exchanges is the one trusted, a
+// slow one probably sat in a queue one way.  The clock we hand out slews towards
+// it rather than jumping, so ticks don't repeat or skip; only a big error steps.
+//
+//   PING: double client send time
+//   PONG: double client send time (echoed), double host time
+constexpr uint32_t NET_CLOCK_SAMPLES = 8;
+constexpr float NET_CLOCK_BURST_SECONDS = 0.1f;		// between pings until we have a full window
+constexpr float NET_CLOCK_PING_SECONDS = 1.0f;
+constexpr float NET_CLOCK_SLEW_RATE = 0.05f;			// seconds of correction per second
+constexpr float NET_CLOCK_STEP_SECONDS = 0.25f;		// further off than this and we just jump
+
+struct net_clock_stats_t
+{
+	double offset;				// what we're applying now
+	double target_offset;		// what the best sample says
+	float round_trip;			// of the best sample
+	float round_trip_average;
+	uint32_t pings;
+	uint32_t pongs;
+	uint32_t steps;
+	bool is_synced;
+};
+
+void NetClockReset();
+void EstablishNetClockMessages();
+void RegisterNetClockCommands();
+// once a frame - clients ping and slew
+void NetClockUpdate();
+
+// the host's clock, on the host it's just the local one
+double NetClockGetHostTime();
+bool NetClockIsSynced();
+net_clock_stats_t NetClockGetStats();
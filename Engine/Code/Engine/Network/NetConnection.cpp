@@ -1,11 +1,14 @@
 #include "Engine/Network/NetConnection.hpp"
+#include "Engine/Network/NetSession.hpp"
+#include <string.h>
 
 
 NetConnection::NetConnection()
-	:m_prev(nullptr)
-	, m_next(nullptr)
-	, m_owner(nullptr)
+	:m_owner(nullptr)
+	, m_connectionIndex(INVALID_CONNECTION_INDEX)
+	, m_handle(INVALID_CONNECTION_HANDLE)
 {
+	memset(&m_sendStats, 0, sizeof(m_sendStats));
 
 }
 
@@ -5,19 +5,38 @@
 class NetMessage;
 class NetSession;
 
+// connection index in the low byte, the slot's generation above it - a handle
+// kept past its connection's lifetime won't find whoever took the slot next
+typedef uint16_t net_connection_handle_t;
+constexpr net_connection_handle_t INVALID_CONNECTION_HANDLE = 0xffff;
+
+// what a connection has handed to its socket, ticks are session updates
+struct net_send_stats_t
+{
+	uint32_t ticks;
+	uint32_t messages;
+	uint32_t socket_sends;
+	uint64_t bytes_sent;
+};
+
 class NetConnection
 {
 public:
 	NetConnection();
 	virtual ~NetConnection();
 
+	// never takes msg - connections that queue it keep a copy, sharing its buffer
 	virtual void Send(NetMessage* msg) = 0;
 	virtual bool Receive(NetMessage** msg) = 0;
+	virtual bool IsDisconnected() const { return false; }
+
+	// wrappers hand back the stats of whatever they wrap
+	virtual net_send_stats_t* GetSendStats() { return &m_sendStats; }
 
 public:
-	NetConnection* m_prev;
-	NetConnection* m_next;
 	NetSession* m_owner;
 	net_address_t m_address;
 	uint8_t m_connectionIndex; // LUID 
+	net_connection_handle_t m_handle;
+	net_send_stats_t m_sendStats;
 };
\ No newline at end of file
@@ -0,0 +1,313 @@
+#include "Engine/Network/NetDefinition.hpp"
+#include "Engine/Input/BitStream.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include <math.h>
+#include <string.h>
+
+// deltas are sent as a 5 bit length then a zigzagged value that long
+constexpr uint NET_DELTA_LENGTH_BITS = 5;
+
+static uint32_t FieldMask(uint bit_count)
+{
+	return (bit_count >= 32) ? 0xffffffffU : ((1U << bit_count) - 1U);
+}
+
+static uint GetComponentCount(net_field_t const &field)
+{
+	return (field.type == NET_FIELD_VECTOR2) ? 2 : 1;
+}
+
+NetObjectTypeDefinition::NetObjectTypeDefinition()
+	:m_typeID(0)
+	, m_appendCreateInfo(nullptr)
+	, m_appendDestroyInfo(nullptr)
+	, m_processCreateInfo(nullptr)
+	, m_processDestroyInfo(nullptr)
+	, m_applySnapshot(nullptr)
+	, m_getCurrentSnapShot(nullptr)
+	, m_appendSnapshot(nullptr)
+	, m_processSnapshot(nullptr)
+	, m_getSnapShotSize(nullptr)
+	, m_priority(1.0f)
+	, m_getPosition(nullptr)
+	, m_interpolate(false)
+	, m_predictInput(nullptr)
+	, m_inputSize(0)
+	, m_quantizedCount(0)
+{
+}
+
+void NetObjectTypeDefinition::AddField(eNetFieldType type, size_t offset, float min, float max, uint8_t bit_count)
+{
+	ASSERT_OR_DIE(m_fields.size() < NET_MAX_SNAPSHOT_FIELDS, "NetObjectTypeDefinition: too many snapshot fields");
+	ASSERT_OR_DIE((bit_count > 0) && (bit_count <= NET_MAX_FIELD_BITS), "NetObjectTypeDefinition: bad field bit count");
+
+	net_field_t field;
+	field.type = type;
+	field.bit_count = bit_count;
+	field.offset = (uint16_t)offset;
+	field.min = min;
+	field.max = max;
+	m_fields.push_back(field);
+
+	m_quantizedCount += GetComponentCount(field);
+}
+
+void NetObjectTypeDefinition::AddFloatField(size_t offset, float min, float max, uint8_t bit_count)
+{
+	AddField(NET_FIELD_FLOAT, offset, min, max, bit_count);
+}
+
+void NetObjectTypeDefinition::AddAngleField(size_t offset, uint8_t bit_count)
+{
+	AddField(NET_FIELD_ANGLE, offset, 0.0f, 360.0f, bit_count);
+}
+
+void NetObjectTypeDefinition::AddVector2Field(size_t offset, float min, float max, uint8_t bit_count)
+{
+	AddField(NET_FIELD_VECTOR2, offset, min, max, bit_count);
+}
+
+void NetObjectTypeDefinition::AddIntField(size_t offset, int min, int max)
+{
+	uint bits = BitsRequired((uint32_t)(max - min));
+	AddField(NET_FIELD_INT, offset, (float)min, (float)max, (uint8_t)((bits > 0) ? bits : 1));
+}
+
+void NetObjectTypeDefinition::AddByteField(size_t offset, uint8_t min, uint8_t max)
+{
+	uint bits = BitsRequired((uint32_t)(max - min));
+	AddField(NET_FIELD_BYTE, offset, (float)min, (float)max, (uint8_t)((bits > 0) ? bits : 1));
+}
+
+void NetObjectTypeDefinition::Quantize(uint32_t *out, void const *snapshot) const
+{
+	byte_t const *base = (byte_t const*)snapshot;
+	for (net_field_t const &field : m_fields) {
+		void const *src = base + field.offset;
+		switch (field.type) {
+		case NET_FIELD_FLOAT:
+			*out++ = QuantizeFloat(*(float const*)src, field.min, field.max, field.bit_count);
+			break;
+		case NET_FIELD_ANGLE:
+			*out++ = QuantizeAngleDegrees(*(float const*)src, field.bit_count);
+			break;
+		case NET_FIELD_VECTOR2:
+			*out++ = QuantizeFloat(((float const*)src)[0], field.min, field.max, field.bit_count);
+			*out++ = QuantizeFloat(((float const*)src)[1], field.min, field.max, field.bit_count);
+			break;
+		case NET_FIELD_INT: {
+			int value = *(int const*)src;
+			int min = (int)field.min;
+			int max = (int)field.max;
+			value = (value < min) ? min : ((value > max) ? max : value);
+			*out++ = (uint32_t)(value - min);
+		} break;
+		case NET_FIELD_BYTE: {
+			int value = *(uint8_t const*)src;
+			int min = (int)field.min;
+			int max = (int)field.max;
+			value = (value < min) ? min : ((value > max) ? max : value);
+			*out++ = (uint32_t)(value - min);
+		} break;
+		}
+	}
+}
+
+void NetObjectTypeDefinition::Dequantize(void *out_snapshot, uint32_t const *quantized) const
+{
+	byte_t *base = (byte_t*)out_snapshot;
+	for (net_field_t const &field : m_fields) {
+		void *dst = base + field.offset;
+		switch (field.type) {
+		case NET_FIELD_FLOAT:
+			*(float*)dst = DequantizeFloat(*quantized++, field.min, field.max, field.bit_count);
+			break;
+		case NET_FIELD_ANGLE:
+			*(float*)dst = DequantizeAngleDegrees(*quantized++, field.bit_count);
+			break;
+		case NET_FIELD_VECTOR2:
+			((float*)dst)[0] = DequantizeFloat(*quantized++, field.min, field.max, field.bit_count);
+			((float*)dst)[1] = DequantizeFloat(*quantized++, field.min, field.max, field.bit_count);
+			break;
+		case NET_FIELD_INT:
+			*(int*)dst = (int)field.min + (int)*quantized++;
+			break;
+		case NET_FIELD_BYTE:
+			*(uint8_t*)dst = (uint8_t)((int)field.min + (int)*quantized++);
+			break;
+		}
+	}
+}
+
+uint32_t NetObjectTypeDefinition::GetDirtyMask(uint32_t const *quantized, uint32_t const *baseline) const
+{
+	uint32_t mask = 0;
+	for (uint field_index = 0; field_index < m_fields.size(); ++field_index) {
+		uint count = GetComponentCount(m_fields[field_index]);
+		if (memcmp(quantized, baseline, count * sizeof(uint32_t)) != 0) {
+			mask |= (1U << field_index);
+		}
+		quantized += count;
+		baseline += count;
+	}
+	return mask;
+}
+
+// angles wrap, so their delta is taken the short way round
+static int32_t ComponentDelta(net_field_t const &field, uint32_t value, uint32_t baseline)
+{
+	if (field.type == NET_FIELD_ANGLE) {
+		uint32_t wrapped = (value - baseline) & FieldMask(field.bit_count);
+		uint32_t half = 1U << (field.bit_count - 1);
+		return (wrapped >= half) ? ((int32_t)wrapped - (int32_t)(half << 1)) : (int32_t)wrapped;
+	}
+
+	return (int32_t)value - (int32_t)baseline;
+}
+
+static void WriteComponent(BitStreamWriter &writer, net_field_t const &field, uint32_t value, uint32_t const *baseline)
+{
+	if (baseline == nullptr) {
+		writer.write_bits(value, field.bit_count);
+		return;
+	}
+
+	int32_t delta = ComponentDelta(field, value, *baseline);
+	uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+	uint length = BitsRequired(zigzag);
+
+	// small moves go as a delta, anything bigger is cheaper sent whole
+	if ((NET_DELTA_LENGTH_BITS + length) < field.bit_count) {
+		writer.write_bool(true);
+		writer.write_bits(length, NET_DELTA_LENGTH_BITS);
+		writer.write_bits(zigzag, length);
+	}
+	else {
+		writer.write_bool(false);
+		writer.write_bits(value, field.bit_count);
+	}
+}
+
+static bool ReadComponent(BitStreamReader &reader, net_field_t const &field, uint32_t *out, uint32_t const *baseline)
+{
+	if (baseline == nullptr) {
+		return reader.read_bits(out, field.bit_count);
+	}
+
+	bool is_delta;
+	if (!reader.read_bool(&is_delta)) {
+		return false;
+	}
+
+	if (!is_delta) {
+		return reader.read_bits(out, field.bit_count);
+	}
+
+	uint32_t length;
+	uint32_t zigzag;
+	if (!reader.read_bits(&length, NET_DELTA_LENGTH_BITS) || !reader.read_bits(&zigzag, length)) {
+		return false;
+	}
+
+	int32_t delta = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+	*out = ((uint32_t)((int32_t)*baseline + delta)) & FieldMask(field.bit_count);
+	return true;
+}
+
+void NetObjectTypeDefinition::WriteFields(BitStreamWriter &writer, uint32_t const *quantized, uint32_t const *baseline) const
+{
+	uint32_t dirty = 0xffffffffU;
+	if (baseline != nullptr) {
+		dirty = GetDirtyMask(quantized, baseline);
+		writer.write_bits(dirty, (uint)m_fields.size());
+	}
+
+	for (uint field_index = 0; field_index < m_fields.size(); ++field_index) {
+		net_field_t const &field = m_fields[field_index];
+		uint count = GetComponentCount(field);
+
+		if ((dirty & (1U << field_index)) != 0) {
+			for (uint component = 0; component < count; ++component) {
+				WriteComponent(writer, field, quantized[component], (baseline != nullptr) ? (baseline + component) : nullptr);
+			}
+		}
+
+		quantized += count;
+		if (baseline != nullptr) {
+			baseline += count;
+		}
+	}
+}
+
+bool NetObjectTypeDefinition::ReadFields(BitStreamReader &reader, uint32_t *out, uint32_t const *baseline) const
+{
+	uint32_t dirty = 0xffffffffU;
+	if ((baseline != nullptr) && !reader.read_bits(&dirty, (uint)m_fields.size())) {
+		return false;
+	}
+
+	for (uint field_index = 0; field_index < m_fields.size(); ++field_index) {
+		net_field_t const &field = m_fields[field_index];
+		uint count = GetComponentCount(field);
+
+		for (uint component = 0; component < count; ++component) {
+			uint32_t const *component_baseline = (baseline != nullptr) ? (baseline + component) : nullptr;
+			if ((dirty & (1U << field_index)) != 0) {
+				if (!ReadComponent(reader, field, out + component, component_baseline)) {
+					return false;
+				}
+			}
+			else {
+				out[component] = *component_baseline;
+			}
+		}
+
+		out += count;
+		if (baseline != nullptr) {
+			baseline += count;
+		}
+	}
+
+	return true;
+}
+
+void NetObjectTypeDefinition::Interpolate(void *out_snapshot, void const *from, void const *to, float t) const
+{
+	// anything that isn't a field steps along with the ints
+	if (m_getSnapShotSize != nullptr)
+		memcpy(out_snapshot, (t < 1.0f) ? from : to, m_getSnapShotSize());
+
+	byte_t *out = (byte_t*)out_snapshot;
+	byte_t const *a = (byte_t const*)from;
+	byte_t const *b = (byte_t const*)to;
+	for (net_field_t const &field : m_fields) {
+		uint offset = field.offset;
+		switch (field.type) {
+		case NET_FIELD_FLOAT:
+			*(float*)(out + offset) = *(float const*)(a + offset) + ((*(float const*)(b + offset) - *(float const*)(a + offset)) * t);
+			break;
+		case NET_FIELD_ANGLE: {
+			float start = *(float const*)(a + offset);
+			float delta = fmodf(*(float const*)(b + offset) - start, 360.0f);
+			if (delta > 180.0f)
+				delta -= 360.0f;
+			else if (delta < -180.0f)
+				delta += 360.0f;
+			*(float*)(out + offset) = start + (delta * t);
+		} break;
+		case NET_FIELD_VECTOR2:
+			for (uint component = 0; component < 2; ++component) {
+				float start = ((float const*)(a + offset))[component];
+				((float*)(out + offset))[component] = start + ((((float const*)(b + offset))[component] - start) * t);
+			}
+			break;
+		case NET_FIELD_INT:
+			*(int*)(out + offset) = *(int const*)(((t < 1.0f) ? a : b) + offset);
+			break;
+		case NET_FIELD_BYTE:
+			*(out + offset) = *(((t < 1.0f) ? a : b) + offset);
+			break;
+		}
+	}
+}
@@ -1,8 +1,13 @@
 #pragma once
 #include <stdint.h>
+#include <stddef.h>
+#include <vector>
 
 class NetMessage;
 class NetObject;
+class BitStreamWriter;
+class BitStreamReader;
+class Vector2;
 
 typedef void(*AppendCreateInfoCB)(NetMessage*, void*);
 typedef void(*AppendDestroyInfoCB)(NetMessage*, void*);
@@ -13,9 +18,62 @@ typedef void(*GetCurrentSnapShot)(void*, void*);
 typedef void(*AppendSnapShot)(NetMessage*, void*);
 typedef void(*ProcessSnapShot)(void*, NetMessage*);
 typedef size_t(*SnapShotSize)();
+typedef Vector2(*GetNetPositionCB)(void*);
+typedef void(*PredictInputCB)(void*, void const*, float);	// local object, input command, delta seconds
+
+enum eNetFieldType : uint8_t
+{
+	NET_FIELD_FLOAT,	// float over [min, max]
+	NET_FIELD_ANGLE,	// float degrees, wraps instead of clamping
+	NET_FIELD_VECTOR2,	// Vector2, both components over [min, max]
+	NET_FIELD_INT,		// int32 clamped to [min, max]
+	NET_FIELD_BYTE,		// uint8 clamped to [min, max]
+};
+
+struct net_field_t
+{
+	eNetFieldType type;
+	uint8_t bit_count;		// per component
+	uint16_t offset;		// into the snapshot struct
+	float min;
+	float max;
+};
+
+constexpr uint32_t NET_MAX_SNAPSHOT_FIELDS = 32;		// dirty masks are a uint32
+constexpr uint8_t NET_MAX_FIELD_BITS = 30;
 
 class NetObjectTypeDefinition
 {
+public:
+	NetObjectTypeDefinition();
+
+	// Describing the snapshot struct field by field moves the type onto quantized,
+	// delta compressed updates.  m_appendSnapshot/m_processSnapshot are only used
+	// by types that don't.
+	void AddFloatField(size_t offset, float min, float max, uint8_t bit_count);
+	void AddAngleField(size_t offset, uint8_t bit_count);
+	void AddVector2Field(size_t offset, float min, float max, uint8_t bit_count);
+	void AddIntField(size_t offset, int min, int max);
+	void AddByteField(size_t offset, uint8_t min, uint8_t max);
+	inline bool HasFields() const { return !m_fields.empty(); }
+
+	// one uint32 per component, m_quantizedCount of them
+	void Quantize(uint32_t *out, void const *snapshot) const;
+	void Dequantize(void *out_snapshot, uint32_t const *quantized) const;
+	uint32_t GetDirtyMask(uint32_t const *quantized, uint32_t const *baseline) const;
+
+	// a null baseline writes every field in full, otherwise a dirty mask and
+	// each dirty component as a delta against the baseline
+	void WriteFields(BitStreamWriter &writer, uint32_t const *quantized, uint32_t const *baseline) const;
+	bool ReadFields(BitStreamReader &reader, uint32_t *out, uint32_t const *baseline) const;
+
+	// t of the way from one snapshot to the next - floats and vectors lerp,
+	// angles take the short way round, ints and bytes hold until t reaches 1
+	void Interpolate(void *out_snapshot, void const *from, void const *to, float t) const;
+
+private:
+	void AddField(eNetFieldType type, size_t offset, float min, float max, uint8_t bit_count);
+
 public:
 	uint8_t m_typeID;
 	AppendCreateInfoCB m_appendCreateInfo;
@@ -27,4 +85,24 @@ public:
 	AppendSnapShot m_appendSnapshot;
 	ProcessSnapShot m_processSnapshot;
 	SnapShotSize m_getSnapShotSize;
-};
\ No newline at end of file
+
+	// how fast a changed object climbs the send order while it waits - types
+	// with higher priority go first when an update runs out of budget
+	float m_priority;
+
+	// where the object is, for interest management - types without one are in
+	// every connection's scope
+	GetNetPositionCB m_getPosition;
+
+	// clients play snapshots back a little behind the host, blending between
+	// them, instead of applying the newest one as it lands
+	bool m_interpolate;
+
+	// the owning client runs its input through this ahead of the host, which
+	// runs the same commands when they arrive - see NetPrediction.hpp
+	PredictInputCB m_predictInput;
+	size_t m_inputSize;
+
+	std::vector<net_field_t> m_fields;
+	uint32_t m_quantizedCount;
+};
@@ -0,0 +1,371 @@
+#include "Engine/Network/NetLinkConditioner.hpp"
+#include "Engine/Core/Logging.hpp"
+#include "Engine/Config.hpp"
+#include "Engine/EngineConfig.hpp"
+#include <algorithm>
+#include <string.h>
+
+static net_link_settings_t g_linkSettings = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0, 0 };
+static uint g_linkSettingsVersion = 1;
+static net_link_stats_t g_linkTotals = { 0, 0, 0, 0, 0, 0, 0, 0 };
+static uint g_linkConditionerCount = 0;
+
+void NetLinkSetSettings(net_link_settings_t const &settings)
+{
+	g_linkSettings = settings;
+	++g_linkSettingsVersion;
+}
+
+net_link_settings_t NetLinkGetSettings()
+{
+	return g_linkSettings;
+}
+
+uint NetLinkGetSettingsVersion()
+{
+	return g_linkSettingsVersion;
+}
+
+bool NetLinkSettingsAreActive(net_link_settings_t const &settings)
+{
+	return (settings.loss > 0.0f)
+		|| (settings.latency_ms > 0.0f)
+		|| (settings.jitter_ms > 0.0f)
+		|| (settings.duplicate > 0.0f)
+		|| (settings.reorder > 0.0f)
+		|| (settings.bytes_per_second > 0);
+}
+
+net_link_stats_t NetLinkGetTotalStats()
+{
+	return g_linkTotals;
+}
+
+void NetLinkResetTotalStats()
+{
+	memset(&g_linkTotals, 0, sizeof(g_linkTotals));
+}
+
+//------------------------------------------------------------------------
+// Conditioner
+//------------------------------------------------------------------------
+NetLinkConditioner::NetLinkConditioner()
+	:m_settingsVersion(0)
+	, m_salt(g_linkConditionerCount++)
+	, m_random(1)
+	, m_isStream(false)
+	, m_nextOrder(0)
+	, m_lastReleaseTime(0.0)
+	, m_linkFreeTime(0.0)
+{
+	memset(&m_settings, 0, sizeof(m_settings));
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+NetLinkConditioner::~NetLinkConditioner()
+{
+	m_held.clear();
+}
+
+void NetLinkConditioner::SetSettings(net_link_settings_t const &settings)
+{
+	m_settings = settings;
+
+	// same seed, same salt, same traffic - same drops
+	m_random = (settings.seed * 2654435761U) ^ (m_salt * 40503U) ^ 0x9e3779b9U;
+	if (m_random == 0) {
+		m_random = 1;
+	}
+}
+
+void NetLinkConditioner::RefreshSettings()
+{
+	uint version = NetLinkGetSettingsVersion();
+	if (version != m_settingsVersion) {
+		m_settingsVersion = version;
+		SetSettings(NetLinkGetSettings());
+	}
+}
+
+bool NetLinkConditioner::IsActive()
+{
+	RefreshSettings();
+	return !m_held.empty() || NetLinkSettingsAreActive(m_settings);
+}
+
+float NetLinkConditioner::RandomZeroToOne()
+{
+	// xorshift32
+	m_random ^= m_random << 13;
+	m_random ^= m_random >> 17;
+	m_random ^= m_random << 5;
+	return (float)(m_random >> 8) / (float)(1 << 24);
+}
+
+static bool HeldPacketLater(NetLinkConditioner::held_packet_t const &a, NetLinkConditioner::held_packet_t const &b)
+{
+	if (a.release_time != b.release_time) {
+		return a.release_time > b.release_time;
+	}
+
+	return a.order > b.order;
+}
+
+void NetLinkConditioner::Hold(void const *data, uint size, double release_time)
+{
+	held_packet_t packet;
+	packet.release_time = release_time;
+	packet.order = m_nextOrder++;
+	packet.bytes.assign((byte_t const*)data, (byte_t const*)data + size);
+
+	m_held.push_back(std::move(packet));
+	std::push_heap(m_held.begin(), m_held.end(), HeldPacketLater);
+}
+
+void NetLinkConditioner::Submit(void const *data, uint size, double now)
+{
+	RefreshSettings();
+	++m_stats.submitted;
+	++g_linkTotals.submitted;
+
+	if (m_isStream) {
+		SubmitStream(data, size, now);
+		return;
+	}
+
+	if (RandomZeroToOne() < m_settings.loss) {
+		++m_stats.dropped_loss;
+		++g_linkTotals.dropped_loss;
+		return;
+	}
+
+	// time on the wire - packets queue behind each other at the cap
+	double leave_time = now;
+	if (m_settings.bytes_per_second > 0) {
+		leave_time = (m_linkFreeTime > now) ? m_linkFreeTime : now;
+		if ((leave_time - now) > NET_LINK_MAX_BACKLOG_SECONDS) {
+			++m_stats.dropped_bandwidth;
+			++g_linkTotals.dropped_bandwidth;
+			return;
+		}
+
+		m_linkFreeTime = leave_time + ((double)size / (double)m_settings.bytes_per_second);
+	}
+
+	uint copies = (RandomZeroToOne() < m_settings.duplicate) ? 2 : 1;
+	if (copies > 1) {
+		++m_stats.duplicated;
+		++g_linkTotals.duplicated;
+	}
+
+	for (uint copy = 0; copy < copies; ++copy) {
+		double delay_ms = m_settings.latency_ms + ((RandomZeroToOne() * 2.0f) - 1.0f) * m_settings.jitter_ms;
+		double release_time = leave_time + (((delay_ms > 0.0) ? delay_ms : 0.0) / 1000.0);
+
+		if (RandomZeroToOne() < m_settings.reorder) {
+			// held back past whatever comes next
+			float hold_ms = (m_settings.jitter_ms > 20.0f) ? m_settings.jitter_ms : 20.0f;
+			release_time += (1.0f + RandomZeroToOne()) * hold_ms / 1000.0;
+			++m_stats.reordered;
+			++g_linkTotals.reordered;
+		}
+		else if (release_time < m_lastReleaseTime) {
+			// jitter alone doesn't reorder, a real link keeps its queue in order
+			release_time = m_lastReleaseTime;
+		}
+		else {
+			m_lastReleaseTime = release_time;
+		}
+
+		Hold(data, size, release_time);
+	}
+}
+
+void NetLinkConditioner::SubmitStream(void const *data, uint size, double now)
+{
+	// the sender backs off rather than the link dropping, so no backlog limit
+	double leave_time = now;
+	if (m_settings.bytes_per_second > 0) {
+		leave_time = (m_linkFreeTime > now) ? m_linkFreeTime : now;
+		m_linkFreeTime = leave_time + ((double)size / (double)m_settings.bytes_per_second);
+	}
+
+	double delay_ms = m_settings.latency_ms + ((RandomZeroToOne() * 2.0f) - 1.0f) * m_settings.jitter_ms;
+	double release_time = leave_time + (((delay_ms > 0.0) ? delay_ms : 0.0) / 1000.0);
+
+	// a lost segment shows up a retransmit timeout later, each retry waiting twice as long
+	float retransmit_ms = 2.0f * (m_settings.latency_ms + m_settings.jitter_ms);
+	retransmit_ms = (retransmit_ms > NET_LINK_MIN_RETRANSMIT_MS) ? retransmit_ms : NET_LINK_MIN_RETRANSMIT_MS;
+	for (uint attempt = 0; (attempt < NET_LINK_MAX_RETRANSMITS) && (RandomZeroToOne() < m_settings.loss); ++attempt) {
+		release_time += retransmit_ms / 1000.0;
+		retransmit_ms *= 2.0f;
+		++m_stats.retransmitted;
+		++g_linkTotals.retransmitted;
+	}
+
+	// in order - everything behind a late one waits for it
+	if (release_time < m_lastReleaseTime) {
+		release_time = m_lastReleaseTime;
+	}
+	m_lastReleaseTime = release_time;
+
+	Hold(data, size, release_time);
+}
+
+uint NetLinkConditioner::Pop(double now, void *out, uint max_size)
+{
+	if (m_held.empty() || (m_held.front().release_time > now)) {
+		return 0;
+	}
+
+	std::pop_heap(m_held.begin(), m_held.end(), HeldPacketLater);
+	held_packet_t &packet = m_held.back();
+
+	uint size = (uint)packet.bytes.size();
+	size = (size < max_size) ? size : max_size;
+	memcpy(out, packet.bytes.data(), size);
+	m_held.pop_back();
+
+	++m_stats.delivered;
+	++g_linkTotals.delivered;
+	m_stats.bytes_delivered += size;
+	g_linkTotals.bytes_delivered += size;
+	return size;
+}
+
+//------------------------------------------------------------------------
+// Config & Console
+//------------------------------------------------------------------------
+// net_link_loss / duplicate / reorder are percentages, like the console
+void NetLinkLoadConfig()
+{
+	if (g_config == nullptr) {
+		return;
+	}
+
+	net_link_settings_t settings = NetLinkGetSettings();
+	float percent;
+	if (g_config->ConfigGetFloat(percent, "net_link_loss"))
+		settings.loss = percent / 100.0f;
+	if (g_config->ConfigGetFloat(percent, "net_link_duplicate"))
+		settings.duplicate = percent / 100.0f;
+	if (g_config->ConfigGetFloat(percent, "net_link_reorder"))
+		settings.reorder = percent / 100.0f;
+
+	g_config->ConfigGetFloat(settings.latency_ms, "net_link_latency_ms");
+	g_config->ConfigGetFloat(settings.jitter_ms, "net_link_jitter_ms");
+	g_config->ConfigGetUInt(settings.bytes_per_second, "net_link_bandwidth");
+	g_config->ConfigGetUInt(settings.seed, "net_link_seed");
+
+	NetLinkSetSettings(settings);
+}
+
+static float NetLinkArgAsFloat(arguments const &args, uint index, float default_value)
+{
+	return (args.arg_list.size() > index) ? (float)atof(args.arg_list[index].c_str()) : default_value;
+}
+
+static void NetLinkPrintSettings()
+{
+	net_link_settings_t settings = NetLinkGetSettings();
+	g_console->ConsolePrintf(Rgba(255, 255, 255, 255), "NetLink: loss %.1f%%, latency %.0f +/- %.0f ms, dup %.1f%%, reorder %.1f%%, %u bytes/sec, seed %u",
+		settings.loss * 100.0f, settings.latency_ms, settings.jitter_ms, settings.duplicate * 100.0f, settings.reorder * 100.0f, settings.bytes_per_second, settings.seed);
+}
+
+// NetLinkLoss <percent>
+void NetLinkLossCmd(void* data)
+{
+	arguments args = *(arguments*)data;
+	net_link_settings_t settings = NetLinkGetSettings();
+	settings.loss = NetLinkArgAsFloat(args, 0, 0.0f) / 100.0f;
+	NetLinkSetSettings(settings);
+	NetLinkPrintSettings();
+}
+
+// NetLinkLatency <ms> [jitter_ms]
+void NetLinkLatencyCmd(void* data)
+{
+	arguments args = *(arguments*)data;
+	net_link_settings_t settings = NetLinkGetSettings();
+	settings.latency_ms = NetLinkArgAsFloat(args, 0, 0.0f);
+	settings.jitter_ms = NetLinkArgAsFloat(args, 1, settings.jitter_ms);
+	NetLinkSetSettings(settings);
+	NetLinkPrintSettings();
+}
+
+// NetLinkDuplicate <percent>
+void NetLinkDuplicateCmd(void* data)
+{
+	arguments args = *(arguments*)data;
+	net_link_settings_t settings = NetLinkGetSettings();
+	settings.duplicate = NetLinkArgAsFloat(args, 0, 0.0f) / 100.0f;
+	NetLinkSetSettings(settings);
+	NetLinkPrintSettings();
+}
+
+// NetLinkReorder <percent>
+void NetLinkReorderCmd(void* data)
+{
+	arguments args = *(arguments*)data;
+	net_link_settings_t settings = NetLinkGetSettings();
+	settings.reorder = NetLinkArgAsFloat(args, 0, 0.0f) / 100.0f;
+	NetLinkSetSettings(settings);
+	NetLinkPrintSettings();
+}
+
+// NetLinkBandwidth <bytes_per_second>, 0 for unlimited
+void NetLinkBandwidthCmd(void* data)
+{
+	arguments args = *(arguments*)data;
+	net_link_settings_t settings = NetLinkGetSettings();
+	settings.bytes_per_second = (uint)NetLinkArgAsFloat(args, 0, 0.0f);
+	NetLinkSetSettings(settings);
+	NetLinkPrintSettings();
+}
+
+// NetLinkSeed <seed> - also restarts every conditioner's random sequence
+void NetLinkSeedCmd(void* data)
+{
+	arguments args = *(arguments*)data;
+	net_link_settings_t settings = NetLinkGetSettings();
+	settings.seed = (uint)NetLinkArgAsFloat(args, 0, 0.0f);
+	NetLinkSetSettings(settings);
+	NetLinkPrintSettings();
+}
+
+void NetLinkOffCmd(void*)
+{
+	net_link_settings_t settings = NetLinkGetSettings();
+	uint seed = settings.seed;
+	memset(&settings, 0, sizeof(settings));
+	settings.seed = seed;
+	NetLinkSetSettings(settings);
+	NetLinkPrintSettings();
+}
+
+// NetLinkStats [reset]
+void NetLinkStatsCmd(void* data)
+{
+	arguments args = *(arguments*)data;
+	NetLinkPrintSettings();
+
+	net_link_stats_t stats = NetLinkGetTotalStats();
+	g_console->ConsolePrintf(Rgba(255, 255, 255, 255), "NetLink: %u submitted, %u delivered (%llu bytes), %u lost, %u over bandwidth, %u duplicated, %u reordered, %u retransmitted",
+		stats.submitted, stats.delivered, (unsigned long long)stats.bytes_delivered, stats.dropped_loss, stats.dropped_bandwidth, stats.duplicated, stats.reordered, stats.retransmitted);
+
+	if ((args.arg_list.size() > 0) && (args.arg_list[0] == "reset")) {
+		NetLinkResetTotalStats();
+	}
+}
+
+void RegisterNetLinkCommands()
+{
+	g_console->RegisterCommand("NetLinkLoss", NetLinkLossCmd);
+	g_console->RegisterCommand("NetLinkLatency", NetLinkLatencyCmd);
+	g_console->RegisterCommand("NetLinkDuplicate", NetLinkDuplicateCmd);
+	g_console->RegisterCommand("NetLinkReorder", NetLinkReorderCmd);
+	g_console->RegisterCommand("NetLinkBandwidth", NetLinkBandwidthCmd);
+	g_console->RegisterCommand("NetLinkSeed", NetLinkSeedCmd);
+	g_console->RegisterCommand("NetLinkOff", NetLinkOffCmd);
+	g_console->RegisterCommand("NetLinkStats", NetLinkStatsCmd);
+}
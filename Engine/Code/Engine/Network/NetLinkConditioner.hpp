@@ -0,0 +1,96 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+typedef unsigned int uint;
+typedef unsigned char byte_t;
+
+// Simulated bad network, applied to whatever a connection sends.  All
+// chances are 0..1, a zero bandwidth is unlimited.  A stream link (TCP)
+// never loses, duplicates or reorders - loss costs a retransmit instead, and
+// everything behind it waits.
+struct net_link_settings_t
+{
+	float loss;
+	float latency_ms;
+	float jitter_ms;		// +/- on top of latency
+	float duplicate;
+	float reorder;			// chance a packet is held back so later ones overtake it
+	uint bytes_per_second;
+	uint seed;
+};
+
+struct net_link_stats_t
+{
+	uint submitted;
+	uint delivered;
+	uint dropped_loss;
+	uint dropped_bandwidth;	// backlog past NET_LINK_MAX_BACKLOG_SECONDS
+	uint duplicated;
+	uint reordered;
+	uint retransmitted;		// stream losses, delivered late instead
+	uint64_t bytes_delivered;
+};
+
+constexpr double NET_LINK_MAX_BACKLOG_SECONDS = 1.0;
+constexpr float NET_LINK_MIN_RETRANSMIT_MS = 200.0f;	// like a TCP stack's minimum RTO
+constexpr uint NET_LINK_MAX_RETRANSMITS = 8;
+
+class NetLinkConditioner
+{
+public:
+	struct held_packet_t
+	{
+		double release_time;
+		uint order;
+		std::vector<byte_t> bytes;
+	};
+
+	// each conditioner is salted by creation order, so two links sharing a
+	// seed don't drop the same packets but a rerun still does
+	NetLinkConditioner();
+	~NetLinkConditioner();
+
+	void SetSettings(net_link_settings_t const &settings);
+	inline void SetStream(bool stream) { m_isStream = stream; }
+
+	// false when the settings are all off and nothing is held, so callers can skip the copy
+	bool IsActive();
+
+	void Submit(void const *data, uint size, double now);
+
+	// next packet due by now, in release order.  Returns its size, 0 if none.
+	uint Pop(double now, void *out, uint max_size);
+
+private:
+	void RefreshSettings();
+	void SubmitStream(void const *data, uint size, double now);
+	void Hold(void const *data, uint size, double release_time);
+	float RandomZeroToOne();
+
+public:
+	net_link_settings_t m_settings;
+	net_link_stats_t m_stats;
+	uint m_settingsVersion;
+	uint m_salt;
+	uint32_t m_random;
+	bool m_isStream;
+
+	std::vector<held_packet_t> m_held;	// min heap on release time
+	uint m_nextOrder;
+	double m_lastReleaseTime;
+	double m_linkFreeTime;
+};
+
+// shared settings every conditioner follows, changed from console or config
+void NetLinkSetSettings(net_link_settings_t const &settings);
+net_link_settings_t NetLinkGetSettings();
+uint NetLinkGetSettingsVersion();
+bool NetLinkSettingsAreActive(net_link_settings_t const &settings);
+
+// totals across every conditioner
+net_link_stats_t NetLinkGetTotalStats();
+void NetLinkResetTotalStats();
+
+void NetLinkLoadConfig();
+void RegisterNetLinkCommands();
@@ -1,10 +1,173 @@
 #include "Engine/Network/NetMessage.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/EngineConfig.hpp"
+#include <stdlib.h>
+#include <string.h>
 
+constexpr uint NET_MESSAGE_POOL_MAX_FREE = 1024;		// released buffers/messages kept for reuse
+constexpr uint NET_MESSAGE_POOL_KEEP_HEAP = 4096;		// bigger heap blocks go back to the heap
 
+static net_message_buffer_t *s_freeBuffers = nullptr;
+static void *s_freeMessages = nullptr;					// free blocks link through their first pointer
+static net_message_pool_stats_t s_poolStats = {};
+static std::atomic_flag s_poolLock = ATOMIC_FLAG_INIT;		// held for a few pointer swaps at most
 
+struct net_message_pool_lock_t
+{
+	net_message_pool_lock_t() { while (s_poolLock.test_and_set(std::memory_order_acquire)) {} }
+	~net_message_pool_lock_t() { s_poolLock.clear(std::memory_order_release); }
+};
+
+
+//------------------------------------------------------------------------
+// Buffer Pool
+//------------------------------------------------------------------------
+static void NetMessageBufferFreeHeap(net_message_buffer_t *buffer)
+{
+	if (buffer->data != buffer->inline_data) {
+		free(buffer->data);
+		buffer->data = buffer->inline_data;
+		buffer->capacity = NET_MESSAGE_INLINE_SIZE;
+	}
+}
+
+net_message_buffer_t* NetMessageBufferAcquire(uint capacity)
+{
+	net_message_buffer_t *buffer = nullptr;
+	{
+		net_message_pool_lock_t lock;
+		buffer = s_freeBuffers;
+		if (buffer != nullptr) {
+			s_freeBuffers = buffer->next_free;
+			--s_poolStats.buffers_free;
+		}
+		else {
+			++s_poolStats.buffers_allocated;
+		}
+	}
+
+	if (buffer == nullptr) {
+		buffer = new net_message_buffer_t();
+		buffer->data = buffer->inline_data;
+		buffer->capacity = NET_MESSAGE_INLINE_SIZE;
+	}
+
+	buffer->ref_count = 1;
+	buffer->next_free = nullptr;
+	NetMessageBufferReserve(buffer, capacity, 0);
+	return buffer;
+}
+
+void NetMessageBufferAddRef(net_message_buffer_t *buffer)
+{
+	++buffer->ref_count;
+}
+
+void NetMessageBufferRelease(net_message_buffer_t *buffer)
+{
+	if (buffer == nullptr) {
+		return;
+	}
+
+	ASSERT_OR_DIE(buffer->ref_count > 0, "NetMessage buffer released too many times!");
+	if (--buffer->ref_count > 0) {
+		return;
+	}
 
+	if (buffer->capacity > NET_MESSAGE_POOL_KEEP_HEAP) {
+		NetMessageBufferFreeHeap(buffer);
+	}
+
+	{
+		net_message_pool_lock_t lock;
+		if (s_poolStats.buffers_free < NET_MESSAGE_POOL_MAX_FREE) {
+			buffer->next_free = s_freeBuffers;
+			s_freeBuffers = buffer;
+			++s_poolStats.buffers_free;
+			return;
+		}
+		--s_poolStats.buffers_allocated;
+	}
+
+	NetMessageBufferFreeHeap(buffer);
+	delete buffer;
+}
+
+void NetMessageBufferReserve(net_message_buffer_t *buffer, uint capacity, uint bytes_to_keep)
+{
+	if (capacity <= buffer->capacity) {
+		return;
+	}
+
+	// doubling keeps a message built a field at a time linear
+	uint new_capacity = buffer->capacity * 2;
+	if (new_capacity < capacity) {
+		new_capacity = capacity;
+	}
+
+	byte_t *data = (byte_t*)malloc(new_capacity);
+	ASSERT_OR_DIE(data != nullptr, "Out of memory growing a NetMessage!");
+	if (bytes_to_keep > 0) {
+		memcpy(data, buffer->data, bytes_to_keep);
+	}
+
+	NetMessageBufferFreeHeap(buffer);
+	buffer->data = data;
+	buffer->capacity = new_capacity;
+
+	net_message_pool_lock_t lock;
+	++s_poolStats.heap_grows;
+}
+
+net_message_pool_stats_t NetMessagePoolGetStats()
+{
+	net_message_pool_lock_t lock;
+	return s_poolStats;
+}
+
+void NetMessagePoolShutdown()
+{
+	net_message_pool_lock_t lock;
+	while (s_freeBuffers != nullptr) {
+		net_message_buffer_t *buffer = s_freeBuffers;
+		s_freeBuffers = buffer->next_free;
+		NetMessageBufferFreeHeap(buffer);
+		delete buffer;
+		--s_poolStats.buffers_allocated;
+	}
+	s_poolStats.buffers_free = 0;
+
+	while (s_freeMessages != nullptr) {
+		void *block = s_freeMessages;
+		s_freeMessages = *(void**)block;
+		::operator delete(block);
+		--s_poolStats.messages_allocated;
+	}
+	s_poolStats.messages_free = 0;
+}
+
+void NetMessagePoolStatsCmd(void*)
+{
+	net_message_pool_stats_t stats = NetMessagePoolGetStats();
+	g_console->ConsolePrintf(Rgba(255, 255, 255, 255), "NetMessage pool: %u buffers (%u free), %u messages (%u free), %u heap grows, %u copies on write",
+		stats.buffers_allocated, stats.buffers_free, stats.messages_allocated, stats.messages_free, stats.heap_grows, stats.copies_on_write);
+}
+
+void RegisterNetMessageCommands()
+{
+	g_console->RegisterCommand("NetMessagePoolStats", NetMessagePoolStatsCmd);
+}
+
+
+//------------------------------------------------------------------------
+// NetMessage
+//------------------------------------------------------------------------
 NetMessage::NetMessage()
-	:m_payloadBytesUsed(0)
+	:m_messageTypeIndex(0)
+	, m_sender(nullptr)
+	, m_buffer(nullptr)
+	, m_payloadOffset(0)
+	, m_payloadBytesUsed(0)
 	, m_readBytes(0)
 {
 
@@ -12,12 +175,147 @@ NetMessage::NetMessage()
 
 NetMessage::NetMessage(uint8_t type_index)
 	:m_messageTypeIndex(type_index)
+	, m_sender(nullptr)
+	, m_buffer(nullptr)
+	, m_payloadOffset(0)
 	, m_payloadBytesUsed(0)
 	, m_readBytes(0)
 {
 
 }
 
+NetMessage::NetMessage(uint8_t type_index, net_message_buffer_t *buffer, uint offset, uint size)
+	:m_messageTypeIndex(type_index)
+	, m_sender(nullptr)
+	, m_buffer(buffer)
+	, m_payloadOffset(offset)
+	, m_payloadBytesUsed(size)
+	, m_readBytes(0)
+{
+	ASSERT_OR_DIE(offset + size <= buffer->capacity, "NetMessage view is outside its buffer!");
+	NetMessageBufferAddRef(m_buffer);
+}
+
+NetMessage::NetMessage(NetMessage const &other)
+	:BinaryStream(other)
+	, m_messageTypeIndex(other.m_messageTypeIndex)
+	, m_sender(other.m_sender)
+	, m_buffer(other.m_buffer)
+	, m_payloadOffset(other.m_payloadOffset)
+	, m_payloadBytesUsed(other.m_payloadBytesUsed)
+	, m_readBytes(other.m_readBytes)
+{
+	if (m_buffer != nullptr) {
+		NetMessageBufferAddRef(m_buffer);
+	}
+}
+
+NetMessage& NetMessage::operator=(NetMessage const &other)
+{
+	if (this == &other) {
+		return *this;
+	}
+
+	if (other.m_buffer != nullptr) {
+		NetMessageBufferAddRef(other.m_buffer);
+	}
+	NetMessageBufferRelease(m_buffer);
+
+	BinaryStream::operator=(other);
+	m_messageTypeIndex = other.m_messageTypeIndex;
+	m_sender = other.m_sender;
+	m_buffer = other.m_buffer;
+	m_payloadOffset = other.m_payloadOffset;
+	m_payloadBytesUsed = other.m_payloadBytesUsed;
+	m_readBytes = other.m_readBytes;
+	return *this;
+}
+
+NetMessage::~NetMessage()
+{
+	NetMessageBufferRelease(m_buffer);
+	m_buffer = nullptr;
+}
+
+void* NetMessage::operator new(size_t size)
+{
+	{
+		net_message_pool_lock_t lock;
+		if ((size == sizeof(NetMessage)) && (s_freeMessages != nullptr)) {
+			void *block = s_freeMessages;
+			s_freeMessages = *(void**)block;
+			--s_poolStats.messages_free;
+			return block;
+		}
+		++s_poolStats.messages_allocated;
+	}
+
+	return ::operator new(size);
+}
+
+void NetMessage::operator delete(void *ptr)
+{
+	if (ptr == nullptr) {
+		return;
+	}
+
+	{
+		net_message_pool_lock_t lock;
+		if (s_poolStats.messages_free < NET_MESSAGE_POOL_MAX_FREE) {
+			*(void**)ptr = s_freeMessages;
+			s_freeMessages = ptr;
+			++s_poolStats.messages_free;
+			return;
+		}
+		--s_poolStats.messages_allocated;
+	}
+
+	::operator delete(ptr);
+}
+
+void NetMessage::MakeWritable(uint capacity)
+{
+	if ((m_buffer != nullptr) && (m_buffer->ref_count == 1) && (m_payloadOffset == 0)) {
+		NetMessageBufferReserve(m_buffer, capacity, m_payloadBytesUsed);
+		return;
+	}
+
+	// first write, or somebody else can see these bytes
+	net_message_buffer_t *buffer = NetMessageBufferAcquire(capacity);
+	if (m_buffer != nullptr) {
+		if (m_payloadBytesUsed > 0) {
+			memcpy(buffer->data, GetPayload(), m_payloadBytesUsed);
+		}
+		NetMessageBufferRelease(m_buffer);
+
+		net_message_pool_lock_t lock;
+		++s_poolStats.copies_on_write;
+	}
+
+	m_buffer = buffer;
+	m_payloadOffset = 0;
+}
+
+void NetMessage::Reserve(uint size)
+{
+	if (size > NET_MESSAGE_MAX_PAYLOAD) {
+		size = NET_MESSAGE_MAX_PAYLOAD;
+	}
+	MakeWritable(size);
+}
+
+void NetMessage::Clear()
+{
+	if (IsShared() || (m_payloadOffset != 0)) {
+		NetMessageBufferRelease(m_buffer);
+		m_buffer = nullptr;
+		m_payloadOffset = 0;
+	}
+
+	m_payloadBytesUsed = 0;
+	m_readBytes = 0;
+}
+
 bool NetMessage::read_byte(byte_t *out)
 {
 	return (read_bytes(out, 1) == 1);
@@ -30,28 +328,36 @@ bool NetMessage::write_byte(byte_t const &value)
 
 uint NetMessage::write_bytes(void const *data, const uint size)
 {
-	uint bytes_read = size;
-	if (size > 1024 - m_payloadBytesUsed) {
-		bytes_read = 1024 - m_payloadBytesUsed;
+	uint bytes_written = size;
+	if (size > NET_MESSAGE_MAX_PAYLOAD - m_payloadBytesUsed) {
+		ASSERT_RECOVERABLE(false, "NetMessage payload too large, truncating!");
+		bytes_written = NET_MESSAGE_MAX_PAYLOAD - m_payloadBytesUsed;
+	}
+
+	if (bytes_written == 0) {
+		return 0;
 	}
 
-	void* new_data = const_cast<void*>(data);
+	MakeWritable(m_payloadBytesUsed + bytes_written);
+
+	byte_t *dest = m_buffer->data + m_payloadBytesUsed;
+	memcpy(dest, data, bytes_written);
 	if (IsBigEndian())
-		FlipBytes(new_data, bytes_read);
+		FlipBytes(dest, bytes_written);
 
-	std::memcpy(m_payload + m_payloadBytesUsed, new_data, bytes_read);
-	m_payloadBytesUsed += bytes_read;
-	return bytes_read;
+	m_payloadBytesUsed += bytes_written;
+	return bytes_written;
 }
 
 uint NetMessage::read_bytes(void *out, const uint max_size)
 {
-	uint bytes_read = max_size;
-	if (max_size > 1024 - m_readBytes) {
-		bytes_read = 1024 - m_readBytes;
+	uint bytes_left = (m_readBytes < m_payloadBytesUsed) ? (m_payloadBytesUsed - m_readBytes) : 0;
+	uint bytes_read = (max_size < bytes_left) ? max_size : bytes_left;
+	if (bytes_read == 0) {
+		return 0;
 	}
 
-	std::memcpy(out, m_payload + m_readBytes, bytes_read);
+	memcpy(out, GetPayload() + m_readBytes, bytes_read);
 
 	if (IsBigEndian())
 		FlipBytes(out, bytes_read);
@@ -60,44 +366,48 @@ uint NetMessage::read_bytes(void *out, const uint max_size)
 	return bytes_read;
 }
 
+// uint16 length, then the characters - 0xffff for a null string
 void NetMessage::WriteString(const char* msg)
 {
-	std::string str_msg = msg;
-	uint16_t new_size = (uint16_t)str_msg.size();
-	if (new_size > 0xfffe) {
-		new_size = 0xfffe;
+	uint16_t size = 0xffff;
+	size_t length = 0;
+	if (msg != nullptr) {
+		length = strlen(msg);
+		if (length > 0xfffe) {
+			length = 0xfffe;
+		}
+		size = (uint16_t)length;
 	}
 
-	byte_t* payload_start = m_payload + m_payloadBytesUsed;
-
-	*(uint16_t*)payload_start = new_size;
-
-	if (msg == nullptr)
-		*(uint16_t*)payload_start = 0xffff;
+	write_bytes(&size, sizeof(size));
+	if (length > NET_MESSAGE_MAX_PAYLOAD - m_payloadBytesUsed) {
+		ASSERT_RECOVERABLE(false, "NetMessage payload too large, truncating!");
+		length = NET_MESSAGE_MAX_PAYLOAD - m_payloadBytesUsed;
+	}
 
-	std::memcpy((void*)((m_payload + m_payloadBytesUsed) + 2), msg, new_size);
-	m_payloadBytesUsed += new_size + 2;
+	// characters aren't byte swapped
+	if (length > 0) {
+		MakeWritable(m_payloadBytesUsed + (uint)length);
+		memcpy(m_buffer->data + m_payloadBytesUsed, msg, length);
+		m_payloadBytesUsed += (uint)length;
+	}
 }
 
 std::string NetMessage::ReadString()
 {
-	byte_t* payload_start = m_payload + m_readBytes;
-	uint16_t size_of_string = *(uint16_t*)payload_start;
-	if (size_of_string == 0xffff)
-	{
-		return nullptr;
+	uint16_t size;
+	if (read_bytes(&size, sizeof(size)) != sizeof(size)) {
+		return std::string();
 	}
 
-	char msg[0xfffe];
-	std::memcpy(msg, (void*)((m_payload + m_readBytes) + 2), size_of_string);
-	m_readBytes += size_of_string + 2;
-
-	// Fill Msg with null past payload info
-	for (uint index = size_of_string; index < 0xfffe; ++index)
-	{
-		msg[index] = NULL;
+	if (size == 0xffff) {
+		return std::string();
 	}
 
-	std::string string = msg;
-	return string;
-}
\ No newline at end of file
+	// straight out of the payload, no temporary
+	uint bytes_left = m_payloadBytesUsed - m_readBytes;
+	uint length = (size < bytes_left) ? size : bytes_left;
+	char const *start = (char const*)GetPayload() + m_readBytes;
+	m_readBytes += length;
+	return std::string(start, length);
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "Engine/Input/BinaryStream.hpp"
+#include <atomic>
 #include <string>
 
 typedef unsigned int uint;
@@ -10,19 +11,72 @@ enum eCoreNetMessage : uint8_t
 	JOIN_RESPONSE = 0,
 	PING,
 	PONG,
+	JOIN_REQUEST,
 	RCS_COMMAND = 32,
 	RCS_ECHO = 33,
 	NETOBJECT_CREATE_OBJECT,
 	NETOBJECT_DESTROY_OBJECT,
 	NET_OBJECT_UPDATE,
+	NET_OBJECT_ACK,
+	NET_INPUT_COMMANDS,
+	NET_PREDICTION_STATE,
 	NUM_CORE_MESSAGES,
 };
 
-class NetMessage :  public BinaryStream 
+// Payloads live in pooled, reference counted buffers.  Copying a message shares
+// its buffer, so a broadcast is one buffer however many connections queue it, and
+// a message can be a view into a bigger buffer (a received datagram, the tcp
+// receive ring) so receiving doesn't copy either.  Writing to a shared buffer
+// copies it first.  Small payloads fit inline, bigger ones grow onto the heap.
+// The pools and ref counts are thread safe (the tcp io thread receives into
+// buffers the main thread releases); a single message is not.
+constexpr uint NET_MESSAGE_INLINE_SIZE = 224;
+constexpr uint NET_MESSAGE_MAX_PAYLOAD = 0x7ff0;		// length prefixes are 15 bits
+
+struct net_message_buffer_t
+{
+	std::atomic<uint> ref_count;
+	uint capacity;
+	byte_t *data;						// inline_data until it outgrows it
+	net_message_buffer_t *next_free;
+	byte_t inline_data[NET_MESSAGE_INLINE_SIZE];
+};
+
+struct net_message_pool_stats_t
+{
+	uint buffers_allocated;		// ever new'd
+	uint buffers_free;
+	uint heap_grows;
+	uint messages_allocated;
+	uint messages_free;
+	uint copies_on_write;
+};
+
+net_message_buffer_t* NetMessageBufferAcquire(uint capacity);
+void NetMessageBufferAddRef(net_message_buffer_t *buffer);
+void NetMessageBufferRelease(net_message_buffer_t *buffer);
+// grows, keeping the first bytes_to_keep bytes
+void NetMessageBufferReserve(net_message_buffer_t *buffer, uint capacity, uint bytes_to_keep);
+
+net_message_pool_stats_t NetMessagePoolGetStats();
+void NetMessagePoolShutdown();
+void RegisterNetMessageCommands();
+
+class NetMessage :  public BinaryStream
 {
 public:
 	NetMessage();
 	NetMessage( uint8_t type_index );
+	// a view of size bytes at offset into buffer - shares it, doesn't copy
+	NetMessage( uint8_t type_index, net_message_buffer_t *buffer, uint offset, uint size );
+	NetMessage( NetMessage const &other );
+	NetMessage& operator=( NetMessage const &other );
+	virtual ~NetMessage();
+
+	// message objects come off a free list as well
+	static void* operator new(size_t size);
+	static void operator delete(void *ptr);
+
 	virtual bool read_byte(byte_t *out) override;
 	virtual bool write_byte(byte_t const &value) override;
 	virtual uint write_bytes( void const *data, const uint size );
@@ -30,10 +84,20 @@ public:
 	void WriteString(const char* msg);
 	std::string ReadString();
 
+	inline byte_t const* GetPayload() const { return (m_buffer != nullptr) ? (m_buffer->data + m_payloadOffset) : nullptr; }
+	inline bool IsShared() const { return (m_buffer != nullptr) && (m_buffer->ref_count > 1); }
+	void Reserve(uint size);
+	// empties the message, keeping its buffer if nobody else has it
+	void Clear();
+
+private:
+	void MakeWritable(uint capacity);
+
 public:
 	uint8_t m_messageTypeIndex;
 	NetConnection* m_sender;
-	byte_t m_payload[1024];
+	net_message_buffer_t* m_buffer;
+	uint m_payloadOffset;
 	uint m_payloadBytesUsed;
 	uint m_readBytes;
-};
\ No newline at end of file
+};
@@ -5,9 +5,17 @@
 
 class NetMessage;
 
+// how a message type travels on sessions that have a choice (UDP)
+enum eNetMessageChannel : uint8_t
+{
+	NET_CHANNEL_UNRELIABLE,			// may be lost, stale ones are dropped
+	NET_CHANNEL_RELIABLE_ORDERED,	// resent until acked, delivered in send order
+};
+
 class NetMessageDefinition
 {
 public:
 	uint8_t m_typeIndex;
+	eNetMessageChannel m_channel;
 	std::function<void(NetMessage*)> m_handler;
 };
\ No newline at end of file
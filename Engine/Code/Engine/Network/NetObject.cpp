@@ -3,49 +3,221 @@
 #include "Engine/Network/NetSession.hpp"
 #include "Engine/Core/ErrorWarningAssert.hpp"
 #include "Engine/Network/NetConnection.hpp"
+#include "Engine/Network/NetPrediction.hpp"
+#include "Engine/Network/NetClock.hpp"
 #include "Engine/Core/Interval.hpp"
 #include "Engine/Core/Time.hpp"
+#include "Engine/Input/BitStream.hpp"
+#include "Engine/EngineConfig.hpp"
+#include <algorithm>
+#include <math.h>
 #include <vector>
 
-static float s_hostRefTime = 0.0f;
-static float s_clientTime = 0.0f;
+static tick_t s_netObjectTick = 0;
+static double s_netObjectTickSeconds = 1.0 / 60.0;
 
-float GetHostTime()
+void SetNetObjectTickRate(float hertz)
 {
-	return s_hostRefTime;
+	s_netObjectTickSeconds = 1.0 / (double)hertz;
 }
 
-void SetHostTime(float time)
+void SetNetObjectTick(tick_t tick)
 {
-	s_hostRefTime = time;
+	s_netObjectTick = tick;
 }
 
-float GetClientTime()
+tick_t GetNetObjectTick()
 {
-	return s_clientTime;
+	return s_netObjectTick;
 }
 
-void SetClientTime(float time)
+static double GetNetObjectTickTime(tick_t tick)
 {
-	s_clientTime = time;
+	return (double)tick * s_netObjectTickSeconds;
 }
 
-std::vector<NetObject*> s_netObjects;
 std::vector<NetObjectTypeDefinition*> s_netObjectDefs;
 
-uint16_t NetObjectGetUnusedID()
+// Net ids index a slot table.  Freed ids go to the back of a free list so they
+// are reused as late as possible, and every release bumps the slot's generation
+// so handles kept from before (update records, scopes) stop finding it.
+// Clients register whatever ids the host sends and never allocate - a slot
+// they fill is left in the free list and skipped if it comes up.
+struct net_object_slot_t
+{
+	NetObject *object;
+	uint16_t generation;
+	uint16_t next_free;
+	bool in_free_list;
+	uint32_t live_index;		// into s_liveNetObjects
+};
+
+static std::vector<net_object_slot_t> s_netObjectSlots;
+static std::vector<NetObject*> s_liveNetObjects;			// every registered object, packed
+static uint16_t s_freeHead = INVALID_NETWORK_ID;
+static uint16_t s_freeTail = INVALID_NETWORK_ID;
+
+// Snapshots live in one arena per type.  Each object has a block of
+// NetSession::m_maxConnectionCount + 2 snapshots: its current one, then the last
+// one sent to each connection index (on a client, [0] is the last received).
+struct net_snapshot_arena_t
+{
+	size_t snapshot_size;
+	uint32_t snapshots_per_block;
+	uint32_t block_count;
+	std::vector<byte_t> bytes;
+	std::vector<uint32_t> free_blocks;
+};
+
+constexpr uint32_t NET_SNAPSHOT_NO_BLOCK = 0xffffffff;
+static std::vector<net_snapshot_arena_t> s_snapshotArenas;	// by type id
+
+struct net_object_update_record_t
+{
+	uint16_t sequence;
+	uint16_t frame;
+	bool is_valid;
+	std::vector<net_object_handle_t> objects;
+
+	// types without fields have no history, so what was sent is kept here until it's acked
+	std::vector<uint32_t> snapshot_offsets;		// per object, NET_OBJECT_NO_SNAPSHOT for field types
+	std::vector<byte_t> snapshots;
+};
+
+constexpr uint32_t NET_OBJECT_NO_SNAPSHOT = 0xffffffff;
+
+// host side, one per connection index
+struct net_object_connection_t
+{
+	net_connection_handle_t connection;
+	uint16_t next_sequence;
+	net_object_update_record_t records[NET_OBJECT_UPDATE_HISTORY];
+
+	// interest area, everything is in scope without one
+	bool has_interest;
+	Vector2 interest_center;
+	float interest_radius;
+	std::vector<net_object_handle_t> scope;	// objects it's been sent a create for, when it has an area
+
+	// stats since joining or the last NetSendStats reset
+	uint32_t updates;
+	uint32_t records_sent;
+	uint32_t records_deferred;		// changed but over budget, counted each update they wait
+	uint64_t update_bytes;
+};
+
+struct net_object_candidate_t
 {
-	for (uint16_t index = 0; index < s_netObjects.size(); ++index)
+	NetObject *nop;
+	float priority;
+};
+
+static uint16_t s_snapshotFrame = 0;
+static std::vector<net_object_connection_t> s_connectionStates;
+static std::vector<net_object_candidate_t> s_updateCandidates;
+static uint32_t s_updateBudget = NET_OBJECT_DEFAULT_UPDATE_BUDGET;
+
+// spatial hash, rebuilt each update when any connection has an interest area
+static std::vector<uint32_t> s_interestBucketStarts;
+static std::vector<NetObject*> s_interestObjects;		// positioned, by bucket
+static std::vector<NetObject*> s_globalObjects;			// no position, in every scope
+static uint32_t s_scopeStamp = 0;
+
+static void ResetNetObjectConnectionState(NetConnection *conn);
+static bool NetObjectConnectionHasInterest(NetConnection *conn);
+
+// client side - which updates we've heard, sent back to the host as acks
+static bool s_clientHasUpdate = false;
+static bool s_clientAckPending = false;
+static uint16_t s_clientNewestUpdate = 0;
+static uint32_t s_clientUpdateBits = 0;
+
+// client side - the playout clock.  Transit is arrival time less host time, so
+// it folds in the clock offset as well as the trip, and jitter is its mean deviation.
+static bool s_playoutStarted = false;
+static double s_playoutTransit = 0.0;
+static float s_playoutJitter = 0.0f;
+static float s_playoutSpacing = 0.05f;
+static double s_newestUpdateHostTime = 0.0;
+static double s_prevUpdateHostTime = 0.0;
+static uint32_t s_playoutFrames = 0;
+static uint32_t s_playoutExtrapolated = 0;
+static std::vector<uint8_t> s_playoutScratch;
+
+static void PushNetObjectPlayoutSample(NetObject *nop, double host_time, void const *snapshot);
+
+//------------------------------------------------------------------------
+// Net ID Table
+//------------------------------------------------------------------------
+static void PushFreeNetID(uint16_t net_id)
+{
+	net_object_slot_t &slot = s_netObjectSlots[net_id];
+	if (slot.in_free_list)
+		return;
+
+	slot.in_free_list = true;
+	slot.next_free = INVALID_NETWORK_ID;
+	if (s_freeTail == INVALID_NETWORK_ID)
+		s_freeHead = net_id;
+	else
+		s_netObjectSlots[s_freeTail].next_free = net_id;
+	s_freeTail = net_id;
+}
+
+static void PopFreeNetID()
+{
+	net_object_slot_t &slot = s_netObjectSlots[s_freeHead];
+	slot.in_free_list = false;
+	s_freeHead = slot.next_free;
+	if (s_freeHead == INVALID_NETWORK_ID)
+		s_freeTail = INVALID_NETWORK_ID;
+}
+
+static void ResetNetObjectTable()
+{
+	for (NetObject *nop : s_liveNetObjects)
+		delete nop;
+	s_liveNetObjects.clear();
+
+	s_netObjectSlots.assign(NET_OBJECT_MAX_COUNT, net_object_slot_t());
+	s_freeHead = INVALID_NETWORK_ID;
+	s_freeTail = INVALID_NETWORK_ID;
+	for (uint32_t net_id = 0; net_id < NET_OBJECT_MAX_COUNT; ++net_id)
 	{
-		if (!s_netObjects[index])
-			return index;
+		s_netObjectSlots[net_id].object = nullptr;
+		s_netObjectSlots[net_id].generation = 0;
+		s_netObjectSlots[net_id].in_free_list = false;
+		PushFreeNetID((uint16_t)net_id);
 	}
-	return INVALID_NETWORK_ID;
+
+	s_snapshotArenas.clear();
+	s_snapshotArenas.resize(0x100);
+}
+
+// the next id Replicate would use, without taking it
+uint16_t NetObjectGetUnusedID()
+{
+	while ((s_freeHead != INVALID_NETWORK_ID) && (s_netObjectSlots[s_freeHead].object != nullptr))
+		PopFreeNetID();
+
+	return s_freeHead;
+}
+
+static uint16_t NetObjectAllocateID()
+{
+	uint16_t net_id = NetObjectGetUnusedID();
+	if (net_id != INVALID_NETWORK_ID)
+		PopFreeNetID();
+	return net_id;
 }
 
 void ClearNetObjectList()
 {
-	s_netObjects.clear();
+	ResetNetObjectTable();
+	s_connectionStates.clear();
+	s_clientHasUpdate = false;
+	s_clientAckPending = false;
+	s_playoutStarted = false;
 }
 
 static NetSession* s_sessionRef = nullptr;
@@ -62,14 +234,14 @@ NetSession* GetNetObjectSession()
 
 void NetObjectStartup()
 {
-	s_netObjects.resize(0xffff);
-	s_netObjectDefs.resize(0xff);
+	ResetNetObjectTable();
+	s_netObjectDefs.resize(0x100);
 }
 
 void NetObjectCleanup()
 {
 	s_netObjectDefs.clear();
-	s_netObjects.clear();
+	ResetNetObjectTable();
 }
 
 NetObjectTypeDefinition* NetObjectFindDefinition(uint8_t type_id)
@@ -79,17 +251,117 @@ NetObjectTypeDefinition* NetObjectFindDefinition(uint8_t type_id)
 
 void NetObjectRegister(NetObject* obj)
 {
-	s_netObjects[obj->m_netID] = obj;
+	net_object_slot_t &slot = s_netObjectSlots[obj->m_netID];
+	ASSERT_OR_DIE(slot.object == nullptr, "Net ID is already in use!");
+
+	slot.object = obj;
+	slot.live_index = (uint32_t)s_liveNetObjects.size();
+	s_liveNetObjects.push_back(obj);
 }
 
 void NetObjectUnregister(NetObject* obj)
 {
-	s_netObjects[obj->m_netID] = nullptr;
+	net_object_slot_t &slot = s_netObjectSlots[obj->m_netID];
+	if (slot.object != obj)
+		return;
+
+	NetObject *moved = s_liveNetObjects.back();
+	s_liveNetObjects[slot.live_index] = moved;
+	s_netObjectSlots[moved->m_netID].live_index = slot.live_index;
+	s_liveNetObjects.pop_back();
+
+	slot.object = nullptr;
+	++slot.generation;
+	PushFreeNetID(obj->m_netID);
 }
 
 NetObject* NetObjectFind(uint16_t net_id)
 {
-	return s_netObjects[net_id];
+	return (net_id < s_netObjectSlots.size()) ? s_netObjectSlots[net_id].object : nullptr;
+}
+
+net_object_handle_t NetObjectGetHandle(NetObject const *nop)
+{
+	return ((net_object_handle_t)s_netObjectSlots[nop->m_netID].generation << 16) | nop->m_netID;
+}
+
+NetObject* NetObjectFindByHandle(net_object_handle_t handle)
+{
+	uint16_t net_id = (uint16_t)(handle & 0xffff);
+	if (net_id >= s_netObjectSlots.size())
+		return nullptr;
+
+	net_object_slot_t const &slot = s_netObjectSlots[net_id];
+	return (slot.generation == (uint16_t)(handle >> 16)) ? slot.object : nullptr;
+}
+
+uint32_t NetObjectGetCount()
+{
+	return (uint32_t)s_liveNetObjects.size();
+}
+
+//------------------------------------------------------------------------
+// Snapshot Arenas
+//------------------------------------------------------------------------
+static void AllocateNetObjectSnapshots(NetObject *nop)
+{
+	NetObjectTypeDefinition *defn = nop->m_definition;
+	net_snapshot_arena_t &arena = s_snapshotArenas[defn->m_typeID];
+	if (arena.snapshot_size == 0)
+	{
+		arena.snapshot_size = nop->m_snapShotSize;
+		arena.snapshots_per_block = GetNetObjectSession()->m_maxConnectionCount + 2;
+	}
+	ASSERT_OR_DIE(arena.snapshot_size == nop->m_snapShotSize, "Net Object snapshot size changed!");
+
+	size_t block_size = arena.snapshot_size * arena.snapshots_per_block;
+	if (!arena.free_blocks.empty())
+	{
+		nop->m_snapshotBlock = arena.free_blocks.back();
+		arena.free_blocks.pop_back();
+	}
+	else
+	{
+		nop->m_snapshotBlock = arena.block_count++;
+		if (arena.bytes.size() < arena.block_count * block_size)
+			arena.bytes.resize(std::max(arena.bytes.size() * 2, arena.block_count * block_size));
+	}
+
+	memset(&arena.bytes[nop->m_snapshotBlock * block_size], 0, block_size);
+}
+
+static void FreeNetObjectSnapshots(NetObject *nop)
+{
+	if (nop->m_snapshotBlock == NET_SNAPSHOT_NO_BLOCK)
+		return;
+
+	// a cleared table takes the arenas with it
+	if (nop->m_definition->m_typeID < s_snapshotArenas.size())
+	{
+		net_snapshot_arena_t &arena = s_snapshotArenas[nop->m_definition->m_typeID];
+		if (nop->m_snapshotBlock < arena.block_count)
+			arena.free_blocks.push_back(nop->m_snapshotBlock);
+	}
+	nop->m_snapshotBlock = NET_SNAPSHOT_NO_BLOCK;
+}
+
+void* NetObject::GetCurrentSnapshot() const
+{
+	if (m_snapshotBlock == NET_SNAPSHOT_NO_BLOCK)
+		return nullptr;
+
+	net_snapshot_arena_t &arena = s_snapshotArenas[m_definition->m_typeID];
+	return &arena.bytes[m_snapshotBlock * arena.snapshots_per_block * arena.snapshot_size];
+}
+
+void* NetObject::GetLastSnapshot(uint8_t connection_index) const
+{
+	if (m_snapshotBlock == NET_SNAPSHOT_NO_BLOCK)
+		return nullptr;
+
+	net_snapshot_arena_t &arena = s_snapshotArenas[m_definition->m_typeID];
+	ASSERT_OR_DIE(connection_index + 1U < arena.snapshots_per_block, "Net Object snapshot index out of range!");
+	return &arena.bytes[((m_snapshotBlock * arena.snapshots_per_block) + 1 + connection_index) * arena.snapshot_size];
 }
 
 void NetObjectSystemRegisterType(uint8_t id, NetObjectTypeDefinition& def)
@@ -109,55 +381,112 @@ NetObject* NetObjectReplicate(void *object_ptr, uint8_t type_id)
 		return nullptr;
 	}
 
+	uint16_t net_id = NetObjectAllocateID();
+	if (net_id == INVALID_NETWORK_ID) {
+		return nullptr;
+	}
+
 	NetObject *nop = new NetObject(defn);
 
 	nop->m_localObj = object_ptr;
-	nop->m_netID = NetObjectGetUnusedID();
+	nop->m_netID = net_id;
 
 	if(defn->m_getSnapShotSize)
 	{
 		nop->m_snapShotSize = defn->m_getSnapShotSize();
-
-		nop->m_currentSnapshot = ::calloc(1, nop->m_snapShotSize);
-		nop->m_lastSnapShot.resize(session->m_maxConnectionCount + 1);
-		nop->m_currHostTime = (float)GetCurrentTimeSeconds();
+		AllocateNetObjectSnapshots(nop);
+		nop->m_currHostTick = s_netObjectTick;
 	}
 
+	if (defn->HasFields())
+		nop->m_history.resize(NET_OBJECT_HISTORY * defn->m_quantizedCount);
+
+	nop->m_ackedFrames.resize(session->m_maxConnectionCount + 1, NET_OBJECT_NO_FRAME);
+
+	nop->m_sendPriorities.resize(session->m_maxConnectionCount + 1, 0.0f);
+	nop->m_inScope.resize(session->m_maxConnectionCount + 1, 0);
+
 	NetObjectRegister(nop);
 
 	NetMessage create(NETOBJECT_CREATE_OBJECT);
 	create.write_bytes(&type_id, sizeof(uint8_t));
 	create.write_bytes(&nop->m_netID, sizeof(uint16_t));
-	create.write_bytes(&nop->m_currHostTime, sizeof(float));
+	create.write_bytes(&s_netObjectTick, sizeof(tick_t));
 
 	defn->m_appendCreateInfo(&create, object_ptr);
 
-	NetSession *sp = GetNetObjectSession();
-	sp->SendMessageToOthers(create);
+	// connections with an interest area pick it up next update if it's in range
+	for (NetConnection *cp : session->m_connections)
+	{
+		if ((cp == nullptr) || (cp == session->m_myConnection) || NetObjectConnectionHasInterest(cp))
+			continue;
+
+		nop->m_inScope[cp->m_connectionIndex] = 1;
+		cp->Send(&create);
+	}
 
 	return nop;
 }
 
-void SyncNetObjects(NetConnection* conn)
+// the connection hasn't heard of it, the next update starts from a full snapshot
+static void ResetNetObjectForConnection(NetObject *nop, NetConnection *conn)
 {
-	for (NetObject* nop : s_netObjects)
-	{
-		if (!nop)
-			continue;
-		
-		if (!nop->m_definition->m_appendSnapshot)
-			continue;
+	if (!nop->m_ackedFrames.empty())
+		nop->m_ackedFrames[conn->m_connectionIndex] = NET_OBJECT_NO_FRAME;
+
+	if (!nop->m_sendPriorities.empty())
+		nop->m_sendPriorities[conn->m_connectionIndex] = 0.0f;
 
-		if(!nop->m_lastSnapShot[conn->m_connectionIndex])
-			nop->m_lastSnapShot[conn->m_connectionIndex] = ::calloc(1, nop->m_snapShotSize);
+	void *last = nop->GetLastSnapshot(conn->m_connectionIndex);
+	if (last != nullptr)
+		memset(last, 0, nop->m_snapShotSize);
+}
 
-		NetMessage create(NETOBJECT_CREATE_OBJECT);
-		create.write_bytes(&nop->m_definition->m_typeID, sizeof(uint8_t));
-		create.write_bytes(&nop->m_netID, sizeof(uint16_t));
-		float current_time = (float)GetCurrentTimeSeconds();
-		create.write_bytes(&current_time, sizeof(float));
-		nop->m_definition->m_appendSnapshot(&create, nop->m_localObj);
-		conn->Send(&create);
+static void SendNetObjectCreateTo(NetConnection *conn, NetObject *nop)
+{
+	ResetNetObjectForConnection(nop, conn);
+	nop->m_inScope[conn->m_connectionIndex] = 1;
+
+	NetMessage create(NETOBJECT_CREATE_OBJECT);
+	create.write_bytes(&nop->m_definition->m_typeID, sizeof(uint8_t));
+	create.write_bytes(&nop->m_netID, sizeof(uint16_t));
+	create.write_bytes(&s_netObjectTick, sizeof(tick_t));
+	nop->m_definition->m_appendCreateInfo(&create, nop->m_localObj);
+	conn->Send(&create);
+}
+
+static void SendNetObjectDestroyTo(NetConnection *conn, NetObject *nop)
+{
+	nop->m_inScope[conn->m_connectionIndex] = 0;
+
+	NetMessage msg(NETOBJECT_DESTROY_OBJECT);
+	msg.write_bytes(&nop->m_netID, sizeof(uint16_t));
+
+	// usually does nothing - no-op.
+	if(nop->m_definition->m_appendDestroyInfo)
+		nop->m_definition->m_appendDestroyInfo(&msg, nop->m_localObj);
+
+	conn->Send(&msg);
+}
+
+void SyncNetObjects(NetConnection* conn)
+{
+	// whoever had this slot before, the new connection starts from full snapshots
+	ResetNetObjectConnectionState(conn);
+	bool has_interest = NetObjectConnectionHasInterest(conn);
+
+	for (NetObject* nop : s_liveNetObjects)
+	{
+		// with an interest area the next update sends what's in range
+		if (has_interest)
+		{
+			ResetNetObjectForConnection(nop, conn);
+			nop->m_inScope[conn->m_connectionIndex] = 0;
+		}
+		else
+		{
+			SendNetObjectCreateTo(conn, nop);
+		}
 	}
 }
 
@@ -173,18 +502,18 @@ void NetObjectStopRelication(uint16_t net_id)
 		return;
 	}
 
-	NetObjectUnregister(nop);
-
-	// tell everyone 
-	NetMessage msg(NETOBJECT_DESTROY_OBJECT);
-	msg.write_bytes(&nop->m_netID, sizeof(uint16_t));
+	// tell everyone that has it
+	for (NetConnection *cp : session->m_connections)
+	{
+		if ((cp == nullptr) || (cp == session->m_myConnection) || !nop->m_inScope[cp->m_connectionIndex])
+			continue;
 
-	// usually does nothing - no-op.
-	if(nop->m_definition->m_appendDestroyInfo)
-		nop->m_definition->m_appendDestroyInfo(&msg, nop->m_localObj);
+		SendNetObjectDestroyTo(cp, nop);
+	}
 
-	NetSession *sp = GetNetObjectSession();
-	sp->SendMessageToOthers(msg);
+	// scopes and update records still holding its handle drop it when they next look
+	NetObjectUnregister(nop);
+	delete nop;
 }
 
 void OnReceiveNetObjectCreate(NetMessage *msg)
@@ -197,29 +526,36 @@ void OnReceiveNetObjectCreate(NetMessage *msg)
 	NetObjectTypeDefinition *defn = NetObjectFindDefinition(type_id);
 	ASSERT_OR_DIE(defn != nullptr, "Net Object Not Defined!");
 
+	// a create for an id we still have means we missed the destroy
+	NetObject *stale = NetObjectFind(net_id);
+	if (stale != nullptr) {
+		NetObjectUnregister(stale);
+		delete stale;
+	}
+
 	NetObject *nop = new NetObject(defn);
 	nop->m_netID = net_id;
 
 	if(defn->m_getSnapShotSize)
 	{
 		nop->m_snapShotSize = defn->m_getSnapShotSize();
-		nop->m_currentSnapshot = ::calloc(1, nop->m_snapShotSize);
-		nop->m_lastSnapShot.push_back(::calloc(1, nop->m_snapShotSize));
-	}
-	else
-	{
-		nop->m_currentSnapshot = nullptr;
+		AllocateNetObjectSnapshots(nop);
 	}
 
-	msg->read_bytes(&nop->m_currHostTime, sizeof(float));
+	if (defn->HasFields())
+		nop->m_history.resize(NET_OBJECT_HISTORY * defn->m_quantizedCount);
+
+	msg->read_bytes(&nop->m_currHostTick, sizeof(tick_t));
 
 	void *local_object = defn->m_processCreateInfo(msg, nop);
 	ASSERT_OR_DIE(local_object != nullptr, "Local Object Not Defined!");
 	nop->m_localObj = local_object;
 
-	//defn->m_getCurrentSnapShot(nop->m_currentSnapshot, nop->m_localObj);
 	if(defn->m_getCurrentSnapShot)
-		defn->m_getCurrentSnapShot(nop->m_lastSnapShot.back(), nop->m_localObj);
+		defn->m_getCurrentSnapShot(nop->GetLastSnapshot(0), nop->m_localObj);
+
+	if (defn->m_interpolate && defn->m_getCurrentSnapShot)
+		PushNetObjectPlayoutSample(nop, GetNetObjectTickTime(nop->m_currHostTick), nop->GetLastSnapshot(0));
 
 	NetObjectRegister(nop); // register object with system
 }
@@ -249,47 +585,449 @@ void SetNetObjectRefreshRate(float hertz)
 	s_updateInterval.SetFrequency(hertz);
 }
 
+void SetNetObjectUpdateBudget(uint32_t bytes_per_connection)
+{
+	s_updateBudget = bytes_per_connection;
+}
+
+uint32_t GetNetObjectUpdateBudget()
+{
+	return s_updateBudget;
+}
+
+//------------------------------------------------------------------------
+// Snapshot Frames & Acks
+//------------------------------------------------------------------------
+static bool NetSequenceGreaterThan(uint16_t a, uint16_t b)
+{
+	return (int16_t)(a - b) > 0;
+}
+
+static void ResetNetObjectConnectionState(NetConnection *conn)
+{
+	if (s_connectionStates.size() <= conn->m_connectionIndex)
+		s_connectionStates.resize(conn->m_connectionIndex + 1);
+
+	net_object_connection_t &state = s_connectionStates[conn->m_connectionIndex];
+
+	// an area the game set before syncing still stands
+	state.has_interest = (state.connection == conn->m_handle) && state.has_interest;
+	state.scope.clear();
+
+	state.connection = conn->m_handle;
+	state.next_sequence = 0;
+	state.updates = 0;
+	state.records_sent = 0;
+	state.records_deferred = 0;
+	state.update_bytes = 0;
+	for (net_object_update_record_t &record : state.records)
+	{
+		record.is_valid = false;
+		record.objects.clear();
+	}
+}
+
+static net_object_connection_t& GetNetObjectConnectionState(NetConnection *conn)
+{
+	if ((s_connectionStates.size() <= conn->m_connectionIndex)
+		|| (s_connectionStates[conn->m_connectionIndex].connection != conn->m_handle))
+		ResetNetObjectConnectionState(conn);
+
+	return s_connectionStates[conn->m_connectionIndex];
+}
+
+//------------------------------------------------------------------------
+// Interest Management
+//------------------------------------------------------------------------
+static bool NetObjectConnectionHasInterest(NetConnection *conn)
+{
+	return (s_connectionStates.size() > conn->m_connectionIndex)
+		&& (s_connectionStates[conn->m_connectionIndex].connection == conn->m_handle)
+		&& s_connectionStates[conn->m_connectionIndex].has_interest;
+}
+
+static int NetInterestCell(float coord)
+{
+	return (int)floorf(coord / NET_INTEREST_CELL_SIZE);
+}
+
+static uint32_t NetInterestBucket(int cell_x, int cell_y)
+{
+	return (((uint32_t)cell_x * 73856093U) ^ ((uint32_t)cell_y * 19349663U)) & (NET_INTEREST_HASH_BUCKETS - 1);
+}
+
+void NetObjectSetConnectionInterest(NetConnection *cp, Vector2 const &center, float radius)
+{
+	net_object_connection_t &state = GetNetObjectConnectionState(cp);
+	if (!state.has_interest)
+	{
+		// what it already has stays until the next update finds it out of range
+		state.scope.clear();
+		for (NetObject *nop : s_liveNetObjects)
+		{
+			if (!nop->m_inScope.empty() && nop->m_inScope[cp->m_connectionIndex])
+				state.scope.push_back(NetObjectGetHandle(nop));
+		}
+		state.has_interest = true;
+	}
+
+	state.interest_center = center;
+	state.interest_radius = radius;
+}
+
+void NetObjectClearConnectionInterest(NetConnection *cp)
+{
+	net_object_connection_t &state = GetNetObjectConnectionState(cp);
+	if (!state.has_interest)
+		return;
+
+	state.has_interest = false;
+	state.scope.clear();
+	for (NetObject *nop : s_liveNetObjects)
+	{
+		if (!nop->m_inScope.empty() && !nop->m_inScope[cp->m_connectionIndex])
+			SendNetObjectCreateTo(cp, nop);
+	}
+}
+
+// buckets every object by where it is this update
+static void BuildNetObjectInterestHash()
+{
+	s_interestBucketStarts.assign(NET_INTEREST_HASH_BUCKETS + 1, 0);
+	s_interestObjects.clear();
+	s_globalObjects.clear();
+
+	uint positioned_count = 0;
+	for (NetObject *nop : s_liveNetObjects)
+	{
+		GetNetPositionCB get_position = nop->m_definition->m_getPosition;
+		if (get_position == nullptr)
+		{
+			s_globalObjects.push_back(nop);
+			continue;
+		}
+
+		nop->m_position = get_position(nop->m_localObj);
+		nop->m_interestBucket = NetInterestBucket(NetInterestCell(nop->m_position.x), NetInterestCell(nop->m_position.y));
+		++s_interestBucketStarts[nop->m_interestBucket + 1];
+		++positioned_count;
+	}
+
+	for (uint bucket = 0; bucket < NET_INTEREST_HASH_BUCKETS; ++bucket)
+		s_interestBucketStarts[bucket + 1] += s_interestBucketStarts[bucket];
+
+	// counting sort into bucket order
+	s_interestObjects.resize(positioned_count);
+	std::vector<uint32_t> cursors(s_interestBucketStarts.begin(), s_interestBucketStarts.end() - 1);
+	for (NetObject *nop : s_liveNetObjects)
+	{
+		if (nop->m_definition->m_getPosition)
+			s_interestObjects[cursors[nop->m_interestBucket]++] = nop;
+	}
+}
+
+static void ConsiderNetObjectScope(NetConnection *cp, net_object_connection_t &state, NetObject *nop, float enter_sq, float leave_sq)
+{
+	// buckets are shared by far apart cells, so an object can turn up twice
+	if (nop->m_scopeStamp == s_scopeStamp)
+		return;
+
+	uint8_t in_scope = nop->m_inScope[cp->m_connectionIndex];
+	if (nop->m_definition->m_getPosition)
+	{
+		float distance_sq = CalcDistanceSquared(nop->m_position, state.interest_center);
+		if (distance_sq > (in_scope ? leave_sq : enter_sq))
+			return;
+	}
+
+	nop->m_scopeStamp = s_scopeStamp;
+	if (!in_scope)
+	{
+		SendNetObjectCreateTo(cp, nop);
+		state.scope.push_back(NetObjectGetHandle(nop));
+	}
+}
+
+// creates what came into range, destroys what left it
+static void UpdateNetObjectScope(NetConnection *cp, net_object_connection_t &state)
+{
+	++s_scopeStamp;
+	float leave_radius = state.interest_radius * NET_INTEREST_LEAVE_SCALE;
+	float enter_sq = state.interest_radius * state.interest_radius;
+	float leave_sq = leave_radius * leave_radius;
+
+	for (NetObject *nop : s_globalObjects)
+		ConsiderNetObjectScope(cp, state, nop, enter_sq, leave_sq);
+
+	int min_x = NetInterestCell(state.interest_center.x - leave_radius);
+	int max_x = NetInterestCell(state.interest_center.x + leave_radius);
+	int min_y = NetInterestCell(state.interest_center.y - leave_radius);
+	int max_y = NetInterestCell(state.interest_center.y + leave_radius);
+
+	if ((uint64_t)(max_x - min_x + 1) * (uint64_t)(max_y - min_y + 1) >= NET_INTEREST_HASH_BUCKETS)
+	{
+		// covers more cells than there are buckets, look at everything once
+		for (NetObject *nop : s_interestObjects)
+			ConsiderNetObjectScope(cp, state, nop, enter_sq, leave_sq);
+	}
+	else
+	{
+		for (int cell_y = min_y; cell_y <= max_y; ++cell_y)
+		{
+			for (int cell_x = min_x; cell_x <= max_x; ++cell_x)
+			{
+				uint32_t bucket = NetInterestBucket(cell_x, cell_y);
+				for (uint32_t index = s_interestBucketStarts[bucket]; index < s_interestBucketStarts[bucket + 1]; ++index)
+					ConsiderNetObjectScope(cp, state, s_interestObjects[index], enter_sq, leave_sq);
+			}
+		}
+	}
+
+	// anything in scope that wasn't just seen has left it
+	for (uint index = 0; index < state.scope.size();)
+	{
+		NetObject *nop = NetObjectFindByHandle(state.scope[index]);
+		if ((nop != nullptr) && (nop->m_scopeStamp == s_scopeStamp))
+		{
+			++index;
+			continue;
+		}
+
+		if (nop != nullptr)
+			SendNetObjectDestroyTo(cp, nop);
+
+		state.scope[index] = state.scope.back();
+		state.scope.pop_back();
+	}
+}
+
+// nearer objects climb the send order faster
+static float GetNetObjectRelevance(NetObject const *nop, net_object_connection_t const &state)
+{
+	if (!state.has_interest || (nop->m_definition->m_getPosition == nullptr) || (state.interest_radius <= 0.0f))
+		return 1.0f;
+
+	float distance = CalcDistance(nop->m_position, state.interest_center);
+	float relevance = 1.0f - (distance / state.interest_radius);
+	return (relevance > NET_INTEREST_MIN_RELEVANCE) ? relevance : NET_INTEREST_MIN_RELEVANCE;
+}
+
+void NetObjectWriteSnapshotRecord(NetMessage *msg, NetObjectTypeDefinition const *defn, uint16_t net_id,
+	uint32_t const *quantized, uint32_t const *baseline, uint16_t frames_back)
+{
+	NetMessage body;
+	BitStreamWriter writer(&body);
+	writer.write_bool(baseline != nullptr);
+	if (baseline != nullptr)
+		writer.write_bits(frames_back, NET_OBJECT_BASELINE_BITS);
+	defn->WriteFields(writer, quantized, baseline);
+	writer.flush();
+
+	ASSERT_OR_DIE(body.m_payloadBytesUsed <= 0xff, "Net Object snapshot record too large!");
+	uint8_t record_size = (uint8_t)body.m_payloadBytesUsed;
+	msg->write_bytes(&net_id, sizeof(uint16_t));
+	msg->write_bytes(&record_size, sizeof(uint8_t));
+	msg->write_bytes(body.GetPayload(), body.m_payloadBytesUsed);
+}
+
+static void BeginNetObjectUpdate(NetMessage *update_msg, net_object_connection_t &state)
+{
+	update_msg->m_messageTypeIndex = NET_OBJECT_UPDATE;
+	// the last one may still be queued on the connection, this leaves it be
+	update_msg->Clear();
+
+	update_msg->write_bytes(&state.next_sequence, sizeof(uint16_t));
+	update_msg->write_bytes(&s_snapshotFrame, sizeof(uint16_t));
+	update_msg->write_bytes(&s_netObjectTick, sizeof(tick_t));
+
+	net_object_update_record_t &record = state.records[state.next_sequence % NET_OBJECT_UPDATE_HISTORY];
+	record.sequence = state.next_sequence;
+	record.frame = s_snapshotFrame;
+	record.is_valid = true;
+	record.objects.clear();
+	record.snapshot_offsets.clear();
+	record.snapshots.clear();
+}
+
+static void FinishNetObjectUpdate(NetMessage *update_msg, net_object_connection_t &state, NetConnection *cp)
+{
+	cp->Send(update_msg);
+	state.update_bytes += update_msg->m_payloadBytesUsed;
+	++state.next_sequence;
+}
+
+// the baseline this connection is known to have, nullptr for a full snapshot
+static uint32_t const* GetNetObjectBaseline(NetObject const *nop, NetConnection const *cp, uint16_t *out_frames_back)
+{
+	*out_frames_back = 0;
+	uint32_t acked_frame = nop->m_ackedFrames[cp->m_connectionIndex];
+	if (acked_frame == NET_OBJECT_NO_FRAME)
+		return nullptr;
+
+	*out_frames_back = (uint16_t)(s_snapshotFrame - (uint16_t)acked_frame);
+	if (*out_frames_back >= NET_OBJECT_HISTORY)
+		return nullptr;
+
+	return nop->GetHistory((uint16_t)acked_frame);
+}
+
+static bool NetObjectNeedsUpdate(NetObject const *nop, NetConnection const *cp)
+{
+	NetObjectTypeDefinition const *defn = nop->m_definition;
+	if (defn->HasFields())
+	{
+		uint16_t frames_back;
+		uint32_t const *baseline = GetNetObjectBaseline(nop, cp, &frames_back);
+		return (baseline == nullptr) || (defn->GetDirtyMask(nop->GetHistory(s_snapshotFrame), baseline) != 0);
+	}
+
+	if (defn->m_appendSnapshot)
+	{
+		return memcmp(nop->GetLastSnapshot(cp->m_connectionIndex), nop->GetCurrentSnapshot(), nop->m_snapShotSize) != 0;
+	}
+
+	return false;
+}
+
+static void WriteNetObjectRecord(NetMessage *record_msg, NetObject *nop, NetConnection *cp)
+{
+	NetObjectTypeDefinition *defn = nop->m_definition;
+	if (defn->HasFields())
+	{
+		uint16_t frames_back;
+		uint32_t const *baseline = GetNetObjectBaseline(nop, cp, &frames_back);
+		NetObjectWriteSnapshotRecord(record_msg, defn, nop->m_netID, nop->GetHistory(s_snapshotFrame), baseline, frames_back);
+		return;
+	}
+
+	NetMessage body;
+	defn->m_appendSnapshot(&body, nop->GetCurrentSnapshot());
+	ASSERT_OR_DIE(body.m_payloadBytesUsed <= 0xff, "Net Object snapshot too large!");
+
+	uint8_t record_size = (uint8_t)body.m_payloadBytesUsed;
+	record_msg->write_bytes(&nop->m_netID, sizeof(uint16_t));
+	record_msg->write_bytes(&record_size, sizeof(uint8_t));
+	record_msg->write_bytes(body.GetPayload(), body.m_payloadBytesUsed);
+}
+
+// the last sent snapshot only moves on ack, so a lost update is sent again
+static void MarkNetObjectRecordSent(NetObject *nop, NetConnection *cp, net_object_update_record_t &record)
+{
+	nop->m_sendPriorities[cp->m_connectionIndex] = 0.0f;
+	record.objects.push_back(NetObjectGetHandle(nop));
+	if (nop->m_definition->HasFields())
+	{
+		record.snapshot_offsets.push_back(NET_OBJECT_NO_SNAPSHOT);
+		return;
+	}
+
+	byte_t const *current = (byte_t const*)nop->GetCurrentSnapshot();
+	record.snapshot_offsets.push_back((uint32_t)record.snapshots.size());
+	record.snapshots.insert(record.snapshots.end(), current, current + nop->m_snapShotSize);
+}
+
 void SendNetObjectUpdateTo(NetConnection *cp)
 {
-	for (NetObject *nop : s_netObjects)
+	net_object_connection_t &state = GetNetObjectConnectionState(cp);
+	uint header_size = sizeof(uint16_t) + sizeof(uint16_t) + sizeof(tick_t);
+
+	// everything in scope that changed, most overdue first
+	s_updateCandidates.clear();
+	uint object_count = state.has_interest ? (uint)state.scope.size() : (uint)s_liveNetObjects.size();
+	for (uint index = 0; index < object_count; ++index)
 	{
+		NetObject *nop = state.has_interest ? NetObjectFindByHandle(state.scope[index]) : s_liveNetObjects[index];
 		if (!nop)
 			continue;
 
-		if (!nop->m_definition->m_appendSnapshot)
+		float &priority = nop->m_sendPriorities[cp->m_connectionIndex];
+		if (!NetObjectNeedsUpdate(nop, cp))
+		{
+			priority = 0.0f;
 			continue;
+		}
 
-		if (!nop->m_lastSnapShot[cp->m_connectionIndex])
-			nop->m_lastSnapShot[cp->m_connectionIndex] = ::calloc(1, nop->m_snapShotSize);
+		priority += nop->m_definition->m_priority * GetNetObjectRelevance(nop, state);
+		net_object_candidate_t candidate = { nop, priority };
+		s_updateCandidates.push_back(candidate);
+	}
 
-		if (memcmp(nop->m_lastSnapShot[cp->m_connectionIndex], nop->m_currentSnapshot, nop->m_snapShotSize) == 0)
-			continue;
+	std::sort(s_updateCandidates.begin(), s_updateCandidates.end(), [](net_object_candidate_t const &a, net_object_candidate_t const &b) {
+		return (a.priority != b.priority) ? (a.priority > b.priority) : (a.nop->m_netID < b.nop->m_netID);
+	});
+
+	NetMessage update_msg(NET_OBJECT_UPDATE);
+	update_msg.m_sender = GetNetObjectSession()->m_myConnection;
+	BeginNetObjectUpdate(&update_msg, state);
+	++state.updates;
+
+	uint32_t bytes_used = 0;
+	uint sent_count = 0;
+	for (net_object_candidate_t const &candidate : s_updateCandidates)
+	{
+		NetObject *nop = candidate.nop;
+		NetMessage record_msg;
+		WriteNetObjectRecord(&record_msg, nop, cp);
 
-		NetMessage update_msg(NET_OBJECT_UPDATE);
-		update_msg.m_sender = GetNetObjectSession()->m_myConnection;
-		update_msg.write_bytes(&nop->m_netID, sizeof(uint16_t));
-		float current_time = (float)GetCurrentTimeSeconds();
-		update_msg.write_bytes(&current_time, sizeof(float));
-		nop->m_definition->m_appendSnapshot(&update_msg, nop->m_currentSnapshot);
-		cp->Send(&update_msg);
+		// the rest wait for next update, a bit higher up the order
+		if ((s_updateBudget > 0) && (sent_count > 0) && (bytes_used + record_msg.m_payloadBytesUsed > s_updateBudget))
+			break;
 
-		memcpy(nop->m_lastSnapShot[cp->m_connectionIndex], nop->m_currentSnapshot, nop->m_snapShotSize);
+		// pack as many objects as fit into each message
+		if (update_msg.m_payloadBytesUsed + record_msg.m_payloadBytesUsed > NET_OBJECT_UPDATE_MAX_BYTES)
+		{
+			FinishNetObjectUpdate(&update_msg, state, cp);
+			BeginNetObjectUpdate(&update_msg, state);
+		}
+
+		update_msg.write_bytes(record_msg.GetPayload(), record_msg.m_payloadBytesUsed);
+		MarkNetObjectRecordSent(nop, cp, state.records[state.next_sequence % NET_OBJECT_UPDATE_HISTORY]);
+
+		bytes_used += record_msg.m_payloadBytesUsed;
+		++sent_count;
 	}
+
+	state.records_sent += sent_count;
+	state.records_deferred += (uint32_t)s_updateCandidates.size() - sent_count;
+
+	if (update_msg.m_payloadBytesUsed > header_size)
+		FinishNetObjectUpdate(&update_msg, state, cp);
+	else
+		state.records[state.next_sequence % NET_OBJECT_UPDATE_HISTORY].is_valid = false;
 }
 
 void SendNetObjectUpdates()
 {
-	for (NetObject *nop : s_netObjects) 
+	++s_snapshotFrame;
+
+	std::vector<uint32_t> quantized;
+	for (NetObject *nop : s_liveNetObjects)
 	{
-		if (!nop)
-			continue;
 		if(nop->m_definition->m_getCurrentSnapShot)
-			nop->m_definition->m_getCurrentSnapShot(nop->m_currentSnapshot, nop->m_localObj);
+			nop->m_definition->m_getCurrentSnapShot(nop->GetCurrentSnapshot(), nop->m_localObj);
+
+		// quantized once per frame, shared by every connection
+		if (nop->m_definition->HasFields())
+		{
+			quantized.resize(nop->m_definition->m_quantizedCount);
+			nop->m_definition->Quantize(quantized.data(), nop->GetCurrentSnapshot());
+			nop->StoreHistory(s_snapshotFrame, quantized.data());
+		}
 	}
 
 
 	NetSession* session = GetNetObjectSession();
 
+	bool any_interest = false;
+	for (NetConnection *cp : session->m_connections)
+	{
+		if (cp && (cp != session->m_myConnection) && NetObjectConnectionHasInterest(cp))
+			any_interest = true;
+	}
+
+	if (any_interest)
+		BuildNetObjectInterestHash();
+
 	for(NetConnection* cp : session->m_connections)
 	{
 		if (!cp)
@@ -298,16 +1036,167 @@ void SendNetObjectUpdates()
 		if (cp == session->m_myConnection)
 			continue;
 
+		if (NetObjectConnectionHasInterest(cp))
+			UpdateNetObjectScope(cp, s_connectionStates[cp->m_connectionIndex]);
+
 		SendNetObjectUpdateTo(cp);
+		SendNetPredictionStateTo(cp);
+	}
+}
+
+static void SendNetObjectAck()
+{
+	NetSession* session = GetNetObjectSession();
+	if (session->m_hostConnection == nullptr)
+		return;
+
+	NetMessage ack(NET_OBJECT_ACK);
+	ack.m_sender = session->m_myConnection;
+	ack.write_bytes(&s_clientNewestUpdate, sizeof(uint16_t));
+	ack.write_bytes(&s_clientUpdateBits, sizeof(uint32_t));
+
+	// objects we couldn't decode - the host drops their baseline and sends them whole
+	std::vector<uint16_t> nacks;
+	for (NetObject *nop : s_liveNetObjects)
+	{
+		if (nop->m_needsFullSnapshot && (nacks.size() < NET_OBJECT_MAX_NACKS))
+			nacks.push_back(nop->m_netID);
+	}
+
+	uint8_t nack_count = (uint8_t)nacks.size();
+	ack.write_bytes(&nack_count, sizeof(uint8_t));
+	for (uint16_t net_id : nacks)
+		ack.write_bytes(&net_id, sizeof(uint16_t));
+
+	session->m_hostConnection->Send(&ack);
+	s_clientAckPending = false;
+}
+
+//------------------------------------------------------------------------
+// Playout
+//------------------------------------------------------------------------
+static void UpdateNetObjectPlayoutClock(double host_time)
+{
+	double transit = NetClockGetHostTime() - host_time;
+
+	// NetClock only jumps when it was badly out, start over from there
+	if (s_playoutStarted && (fabs(transit - s_playoutTransit) > 1.0))
+		s_playoutStarted = false;
+
+	if (!s_playoutStarted)
+	{
+		s_playoutStarted = true;
+		s_playoutTransit = transit;
+		s_playoutJitter = 0.0f;
+		s_newestUpdateHostTime = host_time;
+		s_prevUpdateHostTime = host_time;
+		return;
+	}
+
+	// late ones don't move the clock
+	if (host_time <= s_newestUpdateHostTime)
+		return;
+
+	double deviation = transit - s_playoutTransit;
+	s_playoutTransit += deviation / 16.0;
+	s_playoutJitter += ((float)fabs(deviation) - s_playoutJitter) / 16.0f;
+
+	float spacing = (float)(host_time - s_newestUpdateHostTime);
+	if (spacing < 1.0f)
+		s_playoutSpacing += (spacing - s_playoutSpacing) / 8.0f;
+
+	s_prevUpdateHostTime = s_newestUpdateHostTime;
+	s_newestUpdateHostTime = host_time;
+}
+
+static float GetNetObjectPlayoutDelay()
+{
+	float delay = (s_playoutSpacing * NET_PLAYOUT_BUFFER_UPDATES) + (s_playoutJitter * NET_PLAYOUT_JITTER_SCALE);
+	return (delay < NET_PLAYOUT_MAX_DELAY) ? delay : NET_PLAYOUT_MAX_DELAY;
+}
+
+net_playout_stats_t NetObjectGetPlayoutStats()
+{
+	net_playout_stats_t stats;
+	stats.delay = GetNetObjectPlayoutDelay();
+	stats.jitter = s_playoutJitter;
+	stats.update_spacing = s_playoutSpacing;
+	stats.frames = s_playoutFrames;
+	stats.extrapolated = s_playoutExtrapolated;
+	return stats;
+}
+
+static void PushNetObjectPlayoutSample(NetObject *nop, double host_time, void const *snapshot)
+{
+	size_t size = nop->m_snapShotSize;
+	if (nop->m_playoutSamples.empty())
+		nop->m_playoutSamples.resize(NET_OBJECT_PLAYOUT_SAMPLES * size);
+
+	if ((nop->m_playoutCount > 0) && (host_time <= nop->m_playoutTimes[nop->m_playoutNewest]))
+		return;
+
+	uint32_t slot = (nop->m_playoutCount > 0) ? ((nop->m_playoutNewest + 1) % NET_OBJECT_PLAYOUT_SAMPLES) : 0;
+	memcpy(&nop->m_playoutSamples[slot * size], snapshot, size);
+	nop->m_playoutTimes[slot] = host_time;
+	nop->m_playoutNewest = slot;
+	if (nop->m_playoutCount < NET_OBJECT_PLAYOUT_SAMPLES)
+		++nop->m_playoutCount;
+}
+
+// an object that didn't change wasn't in the updates in between, so it held
+// still until the last one - without that it would drift over the whole gap
+static void ReceiveNetObjectPlayoutSample(NetObject *nop, double host_time)
+{
+	if (nop->m_isPredicted || !nop->m_definition->m_interpolate)
+		return;
+
+	if ((nop->m_playoutCount > 0) && (nop->m_playoutTimes[nop->m_playoutNewest] < s_prevUpdateHostTime) && (s_prevUpdateHostTime < host_time))
+	{
+		uint8_t const *held = &nop->m_playoutSamples[nop->m_playoutNewest * nop->m_snapShotSize];
+		PushNetObjectPlayoutSample(nop, s_prevUpdateHostTime, held);
 	}
 
-	//for (NetObject *nop : s_netObjects)
-	//{
-	//	if (!nop)
-	//		continue;
-	//
-	//	memcpy(nop->m_lastSnapShot, nop->m_currentSnapshot, nop->m_snapShotSize);
-	//}
+	PushNetObjectPlayoutSample(nop, host_time, nop->GetLastSnapshot(0));
+}
+
+static void ApplyNetObjectPlayout(NetObject *nop, double render_time)
+{
+	NetObjectTypeDefinition *defn = nop->m_definition;
+	size_t size = nop->m_snapShotSize;
+
+	// newest back to the first sample at or before render time
+	uint32_t index = nop->m_playoutNewest;
+	uint32_t checked = 0;
+	while ((checked < nop->m_playoutCount) && (nop->m_playoutTimes[index] > render_time))
+	{
+		++checked;
+		if (checked < nop->m_playoutCount)
+			index = (index + NET_OBJECT_PLAYOUT_SAMPLES - 1) % NET_OBJECT_PLAYOUT_SAMPLES;
+	}
+
+	uint8_t *sample = &nop->m_playoutSamples[index * size];
+	if (checked == nop->m_playoutCount)
+	{
+		// hasn't caught up to the oldest one yet
+		defn->m_applySnapshot(nop->m_localObj, sample, 0.0f);
+		return;
+	}
+
+	if (index == nop->m_playoutNewest)
+	{
+		float ahead = (float)(render_time - nop->m_playoutTimes[index]);
+		++s_playoutExtrapolated;
+		defn->m_applySnapshot(nop->m_localObj, sample, (ahead < NET_PLAYOUT_MAX_EXTRAPOLATION) ? ahead : NET_PLAYOUT_MAX_EXTRAPOLATION);
+		return;
+	}
+
+	uint32_t next = (index + 1) % NET_OBJECT_PLAYOUT_SAMPLES;
+	double span = nop->m_playoutTimes[next] - nop->m_playoutTimes[index];
+	float t = (span > 0.0) ? (float)((render_time - nop->m_playoutTimes[index]) / span) : 1.0f;
+
+	s_playoutScratch.resize(size);
+	defn->Interpolate(s_playoutScratch.data(), sample, &nop->m_playoutSamples[next * size], t);
+	defn->m_applySnapshot(nop->m_localObj, s_playoutScratch.data(), 0.0f);
 }
 
 void NetObjectSystemStep()
@@ -323,36 +1212,200 @@ void NetObjectSystemStep()
 
 	if (session->AmIClient())
 	{
-		for (NetObject *nop : s_netObjects)
+		if (s_clientAckPending)
+			SendNetObjectAck();
+
+		double render_time = NetClockGetHostTime() - s_playoutTransit - GetNetObjectPlayoutDelay();
+		++s_playoutFrames;
+
+		for (NetObject *nop : s_liveNetObjects)
 		{
-			if (!nop)
+			// prediction moves that one
+			if (nop->m_isPredicted)
+				continue;
+
+			if (s_playoutStarted && nop->m_definition->m_applySnapshot && (nop->m_playoutCount > 0))
+			{
+				ApplyNetObjectPlayout(nop, render_time);
 				continue;
+			}
 
-			// Calculate Proper time to pass to apply
-			float ref_initial_time = (nop->m_currHostTime - s_hostRefTime) + s_clientTime;
-			float current_time_to_apply = (float)GetCurrentTimeSeconds() - ref_initial_time;
+			// how long ago its update's tick was, by the host's clock
+			float current_time_to_apply = (float)(NetClockGetHostTime() - s_playoutTransit - GetNetObjectTickTime(nop->m_currHostTick));
+			if (current_time_to_apply < 0.0f)
+				current_time_to_apply = 0.0f;
+			else if (current_time_to_apply > NET_PLAYOUT_MAX_EXTRAPOLATION)
+				current_time_to_apply = NET_PLAYOUT_MAX_EXTRAPOLATION;
 
 			if(nop->m_definition->m_applySnapshot)
-				nop->m_definition->m_applySnapshot(nop->m_localObj, nop->m_lastSnapShot[0], current_time_to_apply);
+				nop->m_definition->m_applySnapshot(nop->m_localObj, nop->GetLastSnapshot(0), current_time_to_apply);
 		}
 	}
 }
 
+static void ClientReceiveUpdateSequence(uint16_t sequence)
+{
+	if (!s_clientHasUpdate || NetSequenceGreaterThan(sequence, s_clientNewestUpdate))
+	{
+		uint16_t shift = (uint16_t)(sequence - s_clientNewestUpdate);
+		if (!s_clientHasUpdate || (shift > 32))
+			s_clientUpdateBits = 0;
+		else
+			s_clientUpdateBits = (shift == 32) ? (1U << 31) : ((s_clientUpdateBits << shift) | (1U << (shift - 1)));
+
+		s_clientNewestUpdate = sequence;
+		s_clientHasUpdate = true;
+	}
+	else
+	{
+		uint16_t behind = (uint16_t)(s_clientNewestUpdate - sequence);
+		if ((behind > 0) && (behind <= 32))
+			s_clientUpdateBits |= (1U << (behind - 1));
+	}
+
+	s_clientAckPending = true;
+}
+
+static void ReadNetObjectSnapshotRecord(NetObject *nop, NetMessage *update_msg, uint16_t frame, tick_t host_tick)
+{
+	NetObjectTypeDefinition *defn = nop->m_definition;
+	double host_time = GetNetObjectTickTime(host_tick);
+
+	// an older update showing up late still fills in history, it just isn't applied
+	bool is_newest = (host_tick >= nop->m_currHostTick);
+
+	if (!defn->HasFields())
+	{
+		if (is_newest)
+		{
+			nop->m_currHostTick = host_tick;
+			defn->m_processSnapshot(nop->GetLastSnapshot(0), update_msg);
+			ReceiveNetObjectPlayoutSample(nop, host_time);
+		}
+		return;
+	}
+
+	BitStreamReader reader(update_msg);
+	bool has_baseline = false;
+	uint32_t frames_back = 0;
+	if (!reader.read_bool(&has_baseline))
+		return;
+
+	uint32_t const *baseline = nullptr;
+	if (has_baseline)
+	{
+		if (!reader.read_bits(&frames_back, NET_OBJECT_BASELINE_BITS))
+			return;
+
+		baseline = nop->GetHistory((uint16_t)(frame - frames_back));
+		if (baseline == nullptr)
+		{
+			nop->m_needsFullSnapshot = true;
+			return;
+		}
+	}
+
+	std::vector<uint32_t> quantized(defn->m_quantizedCount);
+	if (!defn->ReadFields(reader, quantized.data(), baseline))
+		return;
+
+	nop->StoreHistory(frame, quantized.data());
+	nop->m_needsFullSnapshot = false;
+
+	if (is_newest)
+	{
+		nop->m_currHostTick = host_tick;
+		defn->Dequantize(nop->GetLastSnapshot(0), quantized.data());
+		ReceiveNetObjectPlayoutSample(nop, host_time);
+	}
+}
+
 void OnNetObjectUpdateRecieved(NetMessage *update_msg)
 {
-	uint16_t net_id;
-	update_msg->read_bytes(&net_id, sizeof(uint16_t));
+	uint16_t sequence;
+	uint16_t frame;
+	tick_t host_tick;
+	update_msg->read_bytes(&sequence, sizeof(uint16_t));
+	update_msg->read_bytes(&frame, sizeof(uint16_t));
+	update_msg->read_bytes(&host_tick, sizeof(tick_t));
+
+	ClientReceiveUpdateSequence(sequence);
+	UpdateNetObjectPlayoutClock(GetNetObjectTickTime(host_tick));
+
+	uint record_header_size = sizeof(uint16_t) + sizeof(uint8_t);
+	while (update_msg->m_readBytes + record_header_size <= update_msg->m_payloadBytesUsed)
+	{
+		uint16_t net_id;
+		uint8_t record_size;
+		update_msg->read_bytes(&net_id, sizeof(uint16_t));
+		update_msg->read_bytes(&record_size, sizeof(uint8_t));
+		uint record_end = update_msg->m_readBytes + record_size;
+
+		// records are skipped by size, so objects we haven't created yet don't derail the rest
+		NetObject *nop = NetObjectFind(net_id);
+		if (nop != nullptr)
+			ReadNetObjectSnapshotRecord(nop, update_msg, frame, host_tick);
+
+		update_msg->m_readBytes = record_end;
+	}
+}
 
-	NetObject *nop = NetObjectFind(net_id);
-	if (nullptr == nop) {
+void OnNetObjectAckReceived(NetMessage *ack_msg)
+{
+	NetConnection *cp = ack_msg->m_sender;
+	if ((cp == nullptr) || (cp->m_connectionIndex == INVALID_CONNECTION_INDEX))
 		return;
+
+	uint16_t newest;
+	uint32_t bits;
+	uint8_t nack_count;
+	ack_msg->read_bytes(&newest, sizeof(uint16_t));
+	ack_msg->read_bytes(&bits, sizeof(uint32_t));
+	ack_msg->read_bytes(&nack_count, sizeof(uint8_t));
+
+	net_object_connection_t &state = GetNetObjectConnectionState(cp);
+	for (uint index = 0; index <= 32; ++index)
+	{
+		if ((index > 0) && ((bits & (1U << (index - 1))) == 0))
+			continue;
+
+		uint16_t sequence = (uint16_t)(newest - index);
+		net_object_update_record_t &record = state.records[sequence % NET_OBJECT_UPDATE_HISTORY];
+		if (!record.is_valid || (record.sequence != sequence))
+			continue;
+
+		for (uint object_index = 0; object_index < record.objects.size(); ++object_index)
+		{
+			NetObject *nop = NetObjectFindByHandle(record.objects[object_index]);
+			if ((nop == nullptr) || nop->m_ackedFrames.empty())
+				continue;
+
+			// acks for older updates can come in after newer ones
+			uint32_t &acked_frame = nop->m_ackedFrames[cp->m_connectionIndex];
+			if ((acked_frame != NET_OBJECT_NO_FRAME) && !NetSequenceGreaterThan(record.frame, (uint16_t)acked_frame))
+				continue;
+
+			acked_frame = record.frame;
+			uint32_t offset = record.snapshot_offsets[object_index];
+			if (offset != NET_OBJECT_NO_SNAPSHOT)
+				memcpy(nop->GetLastSnapshot(cp->m_connectionIndex), &record.snapshots[offset], nop->m_snapShotSize);
+		}
+
+		record.is_valid = false;
+		record.objects.clear();
+		record.snapshot_offsets.clear();
+		record.snapshots.clear();
 	}
 
-	update_msg->read_bytes(&nop->m_currHostTime, sizeof(float));
+	for (uint8_t nack = 0; nack < nack_count; ++nack)
+	{
+		uint16_t net_id;
+		ack_msg->read_bytes(&net_id, sizeof(uint16_t));
 
-	// like current snapshot - we can just overwrite here
-	// so only allocate this memory once. 
-	nop->m_definition->m_processSnapshot(nop->m_lastSnapShot[0], update_msg);
+		NetObject *nop = NetObjectFind(net_id);
+		if ((nop != nullptr) && !nop->m_ackedFrames.empty())
+			nop->m_ackedFrames[cp->m_connectionIndex] = NET_OBJECT_NO_FRAME;
+	}
 }
 
 void EstablishNetObjectMessages()
@@ -360,25 +1413,316 @@ void EstablishNetObjectMessages()
 	NetSession* session = GetNetObjectSession();
 	session->RegisterMessageDefinition(NETOBJECT_CREATE_OBJECT, OnReceiveNetObjectCreate);
 	session->RegisterMessageDefinition(NETOBJECT_DESTROY_OBJECT, NetObjectReceiveDestroy);
-	session->RegisterMessageDefinition(NET_OBJECT_UPDATE, OnNetObjectUpdateRecieved);
+	session->RegisterMessageDefinition(NET_OBJECT_UPDATE, OnNetObjectUpdateRecieved, NET_CHANNEL_UNRELIABLE);
+	session->RegisterMessageDefinition(NET_OBJECT_ACK, OnNetObjectAckReceived, NET_CHANNEL_UNRELIABLE);
+}
+
+//------------------------------------------------------------------------
+// Console
+//------------------------------------------------------------------------
+// NetObjectBudget [bytes per connection per update, 0 is unlimited]
+void NetObjectBudgetCmd(void* data)
+{
+	arguments args = *(arguments*)data;
+	if (args.arg_list.size() > 0)
+		SetNetObjectUpdateBudget((uint32_t)atoi(args.arg_list[0].c_str()));
+
+	g_console->ConsolePrintf(Rgba(255, 255, 255, 255), "NetObject update budget: %u bytes per connection", s_updateBudget);
+}
+
+// NetSendStats [reset]
+void NetSendStatsCmd(void* data)
+{
+	arguments args = *(arguments*)data;
+	bool reset = (args.arg_list.size() > 0) && (args.arg_list[0] == "reset");
+
+	NetSession *session = GetNetObjectSession();
+	if (session == nullptr)
+		return;
+
+	for (NetConnection *cp : session->m_connections)
+	{
+		if ((cp == nullptr) || (cp == session->m_myConnection))
+			continue;
+
+		net_send_stats_t *stats = cp->GetSendStats();
+		float ticks = (float)((stats->ticks > 0) ? stats->ticks : 1);
+		g_console->ConsolePrintf(Rgba(255, 255, 255, 255), "Connection %u: per tick %.1f messages, %.2f socket sends, %.0f bytes (%u ticks)",
+			cp->m_connectionIndex, stats->messages / ticks, stats->socket_sends / ticks, (float)stats->bytes_sent / ticks, stats->ticks);
+
+		if ((s_connectionStates.size() > cp->m_connectionIndex) && (s_connectionStates[cp->m_connectionIndex].connection == cp->m_handle))
+		{
+			net_object_connection_t &state = s_connectionStates[cp->m_connectionIndex];
+			float updates = (float)((state.updates > 0) ? state.updates : 1);
+			g_console->ConsolePrintf(Rgba(255, 255, 255, 255), "  net objects per update: %.1f sent, %.1f deferred, %.0f bytes (%u updates)",
+				state.records_sent / updates, state.records_deferred / updates, (float)state.update_bytes / updates, state.updates);
+
+			if (reset)
+			{
+				state.updates = 0;
+				state.records_sent = 0;
+				state.records_deferred = 0;
+				state.update_bytes = 0;
+			}
+		}
+
+		if (reset)
+			memset(stats, 0, sizeof(*stats));
+	}
+}
+
+//------------------------------------------------------------------------
+// Benchmark - a host session of null connections, run against a fresh table
+//------------------------------------------------------------------------
+constexpr uint8_t NET_OBJECT_BENCH_TYPE = 0xff;
+constexpr uint NET_OBJECT_BENCH_CONNECTIONS = 8;
+
+class NetObjectBenchSession : public NetSession
+{
+public:
+	virtual void Host(uint16_t) override {}
+	virtual bool Join(net_address_t const &) override { return false; }
+	virtual void Leave() override {}
+	virtual void Update() override {}
+	virtual void ProcessMessage(NetMessage*) override {}
+};
+
+// hears every update, acks them all after each frame
+class NetObjectBenchConnection : public NetConnection
+{
+public:
+	virtual void Send(NetMessage *msg) override
+	{
+		++m_sendStats.messages;
+		m_sendStats.bytes_sent += msg->m_payloadBytesUsed;
+		if (msg->m_messageTypeIndex == NET_OBJECT_UPDATE)
+		{
+			memcpy(&m_newestUpdate, msg->GetPayload(), sizeof(uint16_t));
+			m_ackPending = true;
+		}
+	}
+	virtual bool Receive(NetMessage**) override { return false; }
+
+	void Ack()
+	{
+		if (!m_ackPending)
+			return;
+
+		uint32_t bits = 0xffffffff;
+		uint8_t nack_count = 0;
+		NetMessage ack(NET_OBJECT_ACK);
+		ack.m_sender = this;
+		ack.write_bytes(&m_newestUpdate, sizeof(uint16_t));
+		ack.write_bytes(&bits, sizeof(uint32_t));
+		ack.write_bytes(&nack_count, sizeof(uint8_t));
+		OnNetObjectAckReceived(&ack);
+		m_ackPending = false;
+	}
+
+public:
+	uint16_t m_newestUpdate = 0;
+	bool m_ackPending = false;
+};
+
+struct net_object_bench_t
+{
+	float x;
+	float y;
+	float angle;
+};
+
+static size_t NetObjectBenchSnapshotSize() { return sizeof(net_object_bench_t); }
+static void NetObjectBenchAppendCreate(NetMessage*, void*) {}
+static void NetObjectBenchGetSnapshot(void *snapshot, void *object) { memcpy(snapshot, object, sizeof(net_object_bench_t)); }
+
+static double NetObjectBenchMicroseconds(double start_time, uint count)
+{
+	return (GetCurrentTimeSeconds() - start_time) * 1000000.0 / (double)((count > 0) ? count : 1);
+}
+
+void NetObjectBenchmark(uint object_count, uint frame_count)
+{
+	object_count = std::min(std::max(object_count, 1U), NET_OBJECT_MAX_COUNT);
+
+	NetObjectBenchSession session;
+	session.m_maxConnectionCount = NET_OBJECT_BENCH_CONNECTIONS;
+	NetObjectBenchConnection connections[NET_OBJECT_BENCH_CONNECTIONS];
+	for (uint index = 0; index < NET_OBJECT_BENCH_CONNECTIONS; ++index)
+		session.JoinConnection((uint8_t)index, &connections[index]);
+	session.m_myConnection = session.m_hostConnection = &connections[0];
+
+	NetObjectTypeDefinition defn;
+	defn.m_appendCreateInfo = NetObjectBenchAppendCreate;
+	defn.m_getCurrentSnapShot = NetObjectBenchGetSnapshot;
+	defn.m_getSnapShotSize = NetObjectBenchSnapshotSize;
+	defn.AddVector2Field(offsetof(net_object_bench_t, x), -4096.0f, 4096.0f, 20);
+	defn.AddAngleField(offsetof(net_object_bench_t, angle), 10);
+	defn.m_typeID = NET_OBJECT_BENCH_TYPE;
+
+	// whatever the game has replicated sits this out
+	std::vector<net_object_slot_t> saved_slots;
+	std::vector<NetObject*> saved_live;
+	std::vector<net_snapshot_arena_t> saved_arenas;
+	std::vector<net_object_connection_t> saved_states;
+	std::swap(saved_slots, s_netObjectSlots);
+	std::swap(saved_live, s_liveNetObjects);
+	std::swap(saved_arenas, s_snapshotArenas);
+	std::swap(saved_states, s_connectionStates);
+	uint16_t saved_free_head = s_freeHead;
+	uint16_t saved_free_tail = s_freeTail;
+	NetSession *saved_session = s_sessionRef;
+	NetObjectTypeDefinition *saved_defn = s_netObjectDefs[NET_OBJECT_BENCH_TYPE];
+	uint32_t saved_budget = s_updateBudget;
+
+	ResetNetObjectTable();
+	s_sessionRef = &session;
+	s_netObjectDefs[NET_OBJECT_BENCH_TYPE] = &defn;
+	s_updateBudget = 0;
+
+	std::vector<net_object_bench_t> objects(object_count);
+	for (uint index = 0; index < object_count; ++index)
+	{
+		objects[index].x = (float)(index % 256) * 16.0f - 2048.0f;
+		objects[index].y = (float)(index / 256) * 16.0f - 2048.0f;
+		objects[index].angle = 0.0f;
+	}
+
+	double start_time = GetCurrentTimeSeconds();
+	std::vector<uint16_t> net_ids(object_count, INVALID_NETWORK_ID);
+	for (uint index = 0; index < object_count; ++index)
+	{
+		NetObject *nop = NetObjectReplicate(&objects[index], NET_OBJECT_BENCH_TYPE);
+		if (nop != nullptr)
+			net_ids[index] = nop->m_netID;
+	}
+	double replicate_us = NetObjectBenchMicroseconds(start_time, object_count);
+
+	std::vector<net_object_handle_t> handles;
+	for (NetObject *nop : s_liveNetObjects)
+		handles.push_back(NetObjectGetHandle(nop));
+
+	uint const lookup_count = 1000000;
+	uint found = 0;
+	uint32_t random = 12345;
+	start_time = GetCurrentTimeSeconds();
+	for (uint lookup = 0; lookup < lookup_count; ++lookup)
+	{
+		random = (random * 1664525U) + 1013904223U;
+		found += (NetObjectFindByHandle(handles[random % handles.size()]) != nullptr) ? 1 : 0;
+	}
+	double find_ns = NetObjectBenchMicroseconds(start_time, lookup_count) * 1000.0;
+
+	// a tenth of the objects move each frame, a tenth are swapped for new ones
+	uint churn_count = object_count / 10;
+	double update_seconds = 0.0;
+	double churn_seconds = 0.0;
+	for (uint frame = 0; frame < frame_count; ++frame)
+	{
+		for (uint index = 0; index < churn_count; ++index)
+		{
+			net_object_bench_t &object = objects[(frame * churn_count + index) % object_count];
+			object.x += 1.0f;
+			object.angle += 3.0f;
+		}
+
+		double frame_start = GetCurrentTimeSeconds();
+		SendNetObjectUpdates();
+		update_seconds += GetCurrentTimeSeconds() - frame_start;
+
+		for (NetObjectBenchConnection &connection : connections)
+			connection.Ack();
+
+		frame_start = GetCurrentTimeSeconds();
+		for (uint index = 0; index < churn_count; ++index)
+		{
+			uint slot = (frame * 7919U + index * 31U) % object_count;
+			NetObjectStopRelication(net_ids[slot]);
+			NetObject *nop = NetObjectReplicate(&objects[slot], NET_OBJECT_BENCH_TYPE);
+			net_ids[slot] = (nop != nullptr) ? nop->m_netID : INVALID_NETWORK_ID;
+		}
+		churn_seconds += GetCurrentTimeSeconds() - frame_start;
+	}
+
+	start_time = GetCurrentTimeSeconds();
+	for (uint index = 0; index < object_count; ++index)
+		NetObjectStopRelication(net_ids[index]);
+	double destroy_us = NetObjectBenchMicroseconds(start_time, object_count);
+
+	uint64_t bytes_sent = 0;
+	for (NetObjectBenchConnection const &connection : connections)
+		bytes_sent += connection.m_sendStats.bytes_sent;
+
+	g_console->ConsolePrintf(Rgba(255, 255, 255, 255), "NetObjectBench: %u objects, %u connections, %u frames (%u churned a frame)",
+		object_count, NET_OBJECT_BENCH_CONNECTIONS - 1, frame_count, churn_count);
+	g_console->ConsolePrintf(Rgba(255, 255, 255, 255), "  replicate %.2f us, find by handle %.1f ns (%u found), destroy %.2f us per object",
+		replicate_us, find_ns, found, destroy_us);
+	g_console->ConsolePrintf(Rgba(255, 255, 255, 255), "  update %.3f ms, churn %.3f ms per frame, %.0f KB sent",
+		update_seconds * 1000.0 / (double)std::max(frame_count, 1U), churn_seconds * 1000.0 / (double)std::max(frame_count, 1U), (double)bytes_sent / 1024.0);
+
+	ResetNetObjectTable();
+	std::swap(saved_slots, s_netObjectSlots);
+	std::swap(saved_live, s_liveNetObjects);
+	std::swap(saved_arenas, s_snapshotArenas);
+	std::swap(saved_states, s_connectionStates);
+	s_freeHead = saved_free_head;
+	s_freeTail = saved_free_tail;
+	s_sessionRef = saved_session;
+	s_netObjectDefs[NET_OBJECT_BENCH_TYPE] = saved_defn;
+	s_updateBudget = saved_budget;
+}
+
+// NetObjectBench [objects] [frames]
+void NetObjectBenchCmd(void* data)
+{
+	arguments args = *(arguments*)data;
+	uint object_count = (args.arg_list.size() > 0) ? (uint)atoi(args.arg_list[0].c_str()) : 10000;
+	uint frame_count = (args.arg_list.size() > 1) ? (uint)atoi(args.arg_list[1].c_str()) : 100;
+	NetObjectBenchmark(object_count, frame_count);
+}
+
+void RegisterNetObjectCommands()
+{
+	g_console->RegisterCommand("NetObjectBudget", NetObjectBudgetCmd);
+	g_console->RegisterCommand("NetSendStats", NetSendStatsCmd);
+	g_console->RegisterCommand("NetObjectBench", NetObjectBenchCmd);
 }
 
 NetObject::NetObject(NetObjectTypeDefinition *defn)
 	: m_definition(defn)
 	, m_netID(INVALID_NETWORK_ID)
+	, m_snapShotSize(0)
 	, m_localObj(nullptr)
+	, m_snapshotBlock(NET_SNAPSHOT_NO_BLOCK)
+	, m_currHostTick(0)
+	, m_interestBucket(0)
+	, m_scopeStamp(0)
+	, m_needsFullSnapshot(false)
+	, m_isPredicted(false)
+	, m_playoutCount(0)
+	, m_playoutNewest(0)
 {
-
+	for (uint index = 0; index < NET_OBJECT_HISTORY; ++index)
+		m_historyFrames[index] = NET_OBJECT_NO_FRAME;
 }
 
 NetObject::~NetObject()
 {
-	for (uint index = 0; index < m_lastSnapShot.size(); ++index)
-	{
-		::free(m_lastSnapShot[index]);
-	}
-	m_lastSnapShot.clear();
+	FreeNetObjectSnapshots(this);
+}
 
-	if(m_currentSnapshot)
-		::free(m_currentSnapshot);
-}
\ No newline at end of file
+void NetObject::StoreHistory(uint16_t frame, uint32_t const *quantized)
+{
+	uint count = m_definition->m_quantizedCount;
+	uint slot = frame % NET_OBJECT_HISTORY;
+	memcpy(&m_history[slot * count], quantized, count * sizeof(uint32_t));
+	m_historyFrames[slot] = frame;
+}
+
+uint32_t const* NetObject::GetHistory(uint16_t frame) const
+{
+	uint slot = frame % NET_OBJECT_HISTORY;
+	if (m_historyFrames[slot] != frame)
+		return nullptr;
+
+	return &m_history[slot * m_definition->m_quantizedCount];
+}
@@ -1,9 +1,64 @@
 #pragma once
 #include "Engine/Network/NetDefinition.hpp"
+#include "Engine/Math/Vector2.hpp"
+#include "Engine/Core/FixedTickLoop.hpp"
 #include <stdint.h>
 #include <vector>
 
 const uint16_t INVALID_NETWORK_ID = 0xffff;
+constexpr uint32_t NET_OBJECT_MAX_COUNT = 0xffff;			// ids 0 to 0xfffe
+
+// Net ids stay 16 bits on the wire and get reused, so anything that holds on
+// to an object across frames keeps a handle instead - the id plus the slot's
+// generation, which moves on every time the id is freed.
+typedef uint32_t net_object_handle_t;
+constexpr net_object_handle_t INVALID_NET_OBJECT_HANDLE = 0xffffffff;
+
+// Updates for types with snapshot fields are deltas against the newest frame each
+// connection has acked, so the host keeps the last NET_OBJECT_HISTORY frames of
+// every object (quantized), and the client keeps what it decoded to match.
+constexpr uint32_t NET_OBJECT_HISTORY = 32;
+constexpr uint32_t NET_OBJECT_BASELINE_BITS = 5;			// frames back to the baseline
+constexpr uint32_t NET_OBJECT_NO_FRAME = 0xffffffff;
+constexpr uint32_t NET_OBJECT_UPDATE_HISTORY = 64;		// sent updates we can still match acks to
+constexpr uint32_t NET_OBJECT_MAX_NACKS = 32;
+constexpr uint32_t NET_OBJECT_UPDATE_MAX_BYTES = 1024;		// records go in more updates past this
+
+// Changed objects wait in priority order for a per-connection byte budget each
+// update.  Every update an object waits adds its type's m_priority, sending it
+// resets to zero, so low priority objects slow down instead of flooding the link
+// but never starve.  A budget of 0 is unlimited.
+constexpr uint32_t NET_OBJECT_DEFAULT_UPDATE_BUDGET = 4096;
+
+// A connection given an interest area only hears about positioned objects
+// within its radius: they're created on it as they come into range and
+// destroyed once they're NET_INTEREST_LEAVE_SCALE past it.  Nearer objects
+// climb the send order faster.  Objects are bucketed in a spatial hash of
+// NET_INTEREST_CELL_SIZE cells once per update.
+constexpr float NET_INTEREST_CELL_SIZE = 256.0f;
+constexpr uint32_t NET_INTEREST_HASH_BUCKETS = 1024;		// power of two
+constexpr float NET_INTEREST_LEAVE_SCALE = 1.25f;
+constexpr float NET_INTEREST_MIN_RELEVANCE = 0.1f;		// priority scale at the edge of the area
+
+// Clients keep the last few snapshots of interpolated types and play them back
+// behind the host by a couple of update intervals plus however much the
+// updates' arrival jitters, so a late update still has something to blend to.
+// Past the newest sample they extrapolate for a little while.  Updates are
+// stamped with the host's simulation tick, and played out against NetClock.
+constexpr uint32_t NET_OBJECT_PLAYOUT_SAMPLES = 8;
+constexpr float NET_PLAYOUT_BUFFER_UPDATES = 2.0f;
+constexpr float NET_PLAYOUT_JITTER_SCALE = 3.0f;
+constexpr float NET_PLAYOUT_MAX_DELAY = 0.5f;
+constexpr float NET_PLAYOUT_MAX_EXTRAPOLATION = 0.25f;
+
+struct net_playout_stats_t
+{
+	float delay;
+	float jitter;
+	float update_spacing;
+	uint32_t frames;
+	uint32_t extrapolated;		// frames an object ran past its newest sample
+};
 
 class NetConnection;
 class NetObjectTypeDefinition;
@@ -13,14 +68,37 @@ class NetObject
 public:
 	NetObject(NetObjectTypeDefinition *defn);
 	~NetObject();
+
+	void StoreHistory(uint16_t frame, uint32_t const *quantized);
+	uint32_t const* GetHistory(uint16_t frame) const;	// nullptr once it's been overwritten
+
+	// in the type's snapshot arena, nullptr for types without snapshots
+	void* GetCurrentSnapshot() const;
+	void* GetLastSnapshot(uint8_t connection_index) const;	// on a client, 0 is the last received
+
 public:
 	uint16_t m_netID;
 	size_t m_snapShotSize;
 	NetObjectTypeDefinition* m_definition;
 	void* m_localObj;
-	std::vector<void*> m_lastSnapShot;
-	void* m_currentSnapshot;
-	float m_currHostTime;
+	uint32_t m_snapshotBlock;
+	tick_t m_currHostTick;
+
+	std::vector<uint32_t> m_history;			// NET_OBJECT_HISTORY slots of quantized fields
+	uint32_t m_historyFrames[NET_OBJECT_HISTORY];
+	std::vector<uint32_t> m_ackedFrames;		// host - newest frame each connection acked, by index
+	std::vector<float> m_sendPriorities;		// host - accumulated priority per connection index
+	std::vector<uint8_t> m_inScope;				// host - per connection index, has it been sent a create
+	Vector2 m_position;							// host - from m_getPosition, refreshed each update
+	uint32_t m_interestBucket;
+	uint32_t m_scopeStamp;
+	bool m_needsFullSnapshot;					// client - a delta arrived against a frame we don't have
+	bool m_isPredicted;							// client - our input drives it, host - a client's does
+
+	std::vector<uint8_t> m_playoutSamples;		// client - NET_OBJECT_PLAYOUT_SAMPLES snapshots, a ring
+	double m_playoutTimes[NET_OBJECT_PLAYOUT_SAMPLES];	// host time of each
+	uint32_t m_playoutCount;
+	uint32_t m_playoutNewest;
 };
 
 class NetMessage;
@@ -36,12 +114,26 @@ void NetObjectCleanup();
 void EstablishNetObjectMessages();
 void NetObjectSystemStep();
 void SetNetObjectRefreshRate(float hertz);
+void SetNetObjectUpdateBudget(uint32_t bytes_per_connection);
+uint32_t GetNetObjectUpdateBudget();
 void SendNetObjectUpdateTo(NetConnection *cp);
 void SendNetObjectUpdates();
 uint16_t NetObjectGetUnusedID();
+NetObject* NetObjectFind(uint16_t net_id);
+net_object_handle_t NetObjectGetHandle(NetObject const *nop);
+NetObject* NetObjectFindByHandle(net_object_handle_t handle);	// nullptr once the object is gone
+uint32_t NetObjectGetCount();
 void SyncNetObjects(NetConnection* conn);
-float GetHostTime();
-void SetHostTime(float time);
-float GetClientTime();
-void SetClientTime(float time);
-void ClearNetObjectList();
\ No newline at end of file
+// the simulation tick the host is on, updates and creates are stamped with it
+void SetNetObjectTickRate(float hertz);
+void SetNetObjectTick(tick_t tick);
+tick_t GetNetObjectTick();
+void ClearNetObjectList();
+void RegisterNetObjectCommands();
+void NetObjectSetConnectionInterest(NetConnection *cp, Vector2 const &center, float radius);
+void NetObjectClearConnectionInterest(NetConnection *cp);
+net_playout_stats_t NetObjectGetPlayoutStats();
+
+// [uint16 net_id][uint8 record bytes][has_baseline, frames back, fields...] - byte aligned
+void NetObjectWriteSnapshotRecord(NetMessage *msg, NetObjectTypeDefinition const *defn, uint16_t net_id,
+	uint32_t const *quantized, uint32_t const *baseline, uint16_t frames_back);
\ No newline at end of file
@@ -0,0 +1,425 @@
+#include "Engine/Network/NetPrediction.hpp"
+#include "Engine/Network/NetObject.hpp"
+#include "Engine/Network/NetMessage.hpp"
+#include "Engine/Network/NetSession.hpp"
+#include "Engine/Network/NetConnection.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/Time.hpp"
+#include "Engine/EngineConfig.hpp"
+#include <string.h>
+#include <vector>
+
+struct net_input_command_t
+{
+	tick_t tick;
+	float delta_seconds;
+	double submit_time;
+	uint8_t input_size;
+	uint8_t input[NET_PREDICTION_MAX_INPUT_SIZE];
+};
+
+// client side - tick 0 is never used, so an ack of 0 means nothing applied yet
+static net_input_command_t s_commands[NET_PREDICTION_COMMAND_HISTORY];
+static tick_t s_newestTick = 0;
+static tick_t s_ackedTick = 0;
+static bool s_hasState = false;
+static uint16_t s_localNetID = INVALID_NETWORK_ID;		// named by the host, not created yet
+static net_object_handle_t s_localHandle = INVALID_NET_OBJECT_HANDLE;
+
+struct net_prediction_client_stats_t
+{
+	uint32_t commands;
+	uint32_t sends;
+	uint32_t reconciles;
+	uint32_t mispredictions;	// replaying from the host's state didn't land where we'd predicted
+	uint32_t replayed;
+	float command_round_trip;	// submit to the host acking it
+};
+
+static net_prediction_client_stats_t s_clientStats;
+
+// host side, one per connection index
+struct net_prediction_connection_t
+{
+	net_connection_handle_t connection;
+	uint16_t net_id;
+	tick_t last_tick;
+
+	uint32_t applied;
+	uint32_t redundant;			// copies of commands we'd already run
+	uint32_t lost;				// ticks that never turned up
+};
+
+static std::vector<net_prediction_connection_t> s_connectionStates;
+
+static net_prediction_connection_t& GetNetPredictionConnectionState(NetConnection *cp)
+{
+	if (s_connectionStates.size() <= cp->m_connectionIndex)
+		s_connectionStates.resize(cp->m_connectionIndex + 1);
+
+	net_prediction_connection_t &state = s_connectionStates[cp->m_connectionIndex];
+	if (state.connection != cp->m_handle)
+	{
+		memset(&state, 0, sizeof(state));
+		state.connection = cp->m_handle;
+		state.net_id = INVALID_NETWORK_ID;
+	}
+
+	return state;
+}
+
+static bool CanPredict(NetObject const *nop, size_t input_size)
+{
+	return (nop != nullptr) && (nop->m_definition->m_predictInput != nullptr) && (nop->m_definition->m_inputSize == input_size);
+}
+
+void NetPredictionReset()
+{
+	s_newestTick = 0;
+	s_ackedTick = 0;
+	s_hasState = false;
+	s_localNetID = INVALID_NETWORK_ID;
+	s_localHandle = INVALID_NET_OBJECT_HANDLE;
+	memset(s_commands, 0, sizeof(s_commands));
+	memset(&s_clientStats, 0, sizeof(s_clientStats));
+	s_connectionStates.clear();
+}
+
+//------------------------------------------------------------------------
+// Client
+//------------------------------------------------------------------------
+void NetPredictionSetLocalObject(uint16_t net_id)
+{
+	NetObject *current = NetObjectFindByHandle(s_localHandle);
+	if ((current != nullptr) && (current->m_netID == net_id))
+		return;
+
+	if (current != nullptr)
+		current->m_isPredicted = false;
+
+	s_localHandle = INVALID_NET_OBJECT_HANDLE;
+	s_localNetID = net_id;
+}
+
+NetObject* NetPredictionGetLocalObject()
+{
+	NetObject *nop = NetObjectFindByHandle(s_localHandle);
+	if ((nop == nullptr) && (s_localNetID != INVALID_NETWORK_ID))
+	{
+		// the create can land after the first state that names it
+		nop = NetObjectFind(s_localNetID);
+		if ((nop == nullptr) || (nop->m_definition->m_predictInput == nullptr))
+			return nullptr;
+
+		nop->m_isPredicted = true;
+		s_localHandle = NetObjectGetHandle(nop);
+		s_localNetID = INVALID_NETWORK_ID;
+	}
+
+	return nop;
+}
+
+static void SendNetInputCommands(tick_t newest_tick, uint8_t input_size)
+{
+	NetSession *session = GetNetObjectSession();
+	if ((session == nullptr) || !session->AmIClient() || (session->m_hostConnection == nullptr))
+		return;
+
+	// everything the host hasn't acked, it costs less than waiting on a resend
+	tick_t oldest_tick = s_ackedTick + 1;
+	if (newest_tick - oldest_tick + 1 > NET_PREDICTION_MAX_COMMANDS_PER_SEND)
+		oldest_tick = newest_tick - NET_PREDICTION_MAX_COMMANDS_PER_SEND + 1;
+
+	uint8_t count = (uint8_t)(newest_tick - oldest_tick + 1);
+	NetMessage msg(NET_INPUT_COMMANDS);
+	msg.m_sender = session->m_myConnection;
+	msg.write_bytes(&count, sizeof(uint8_t));
+	msg.write_bytes(&input_size, sizeof(uint8_t));
+	msg.write_bytes(&newest_tick, sizeof(tick_t));
+
+	uint8_t blank[NET_PREDICTION_MAX_INPUT_SIZE] = {};
+	for (tick_t tick = oldest_tick; tick <= newest_tick; ++tick)
+	{
+		net_input_command_t const &command = s_commands[tick % NET_PREDICTION_COMMAND_HISTORY];
+		bool is_valid = (command.tick == tick) && (command.input_size == input_size);
+		float delta_seconds = is_valid ? command.delta_seconds : 0.0f;
+		msg.write_bytes(&delta_seconds, sizeof(float));
+		msg.write_bytes(is_valid ? command.input : blank, input_size);
+	}
+
+	session->m_hostConnection->Send(&msg);
+	++s_clientStats.sends;
+}
+
+void NetPredictionSubmitInput(tick_t tick, void const *input, size_t input_size, float delta_seconds)
+{
+	ASSERT_OR_DIE(input_size <= NET_PREDICTION_MAX_INPUT_SIZE, "Net prediction input is too big!");
+
+	// one command a tick, a clock pulled back doesn't get to run one twice -
+	// unless it stepped back further than we keep, then the ticks start over
+	if ((s_newestTick > tick) && (s_newestTick - tick > NET_PREDICTION_COMMAND_HISTORY))
+	{
+		s_newestTick = 0;
+		s_ackedTick = 0;
+		s_hasState = false;
+	}
+
+	if ((tick == 0) || (tick <= s_newestTick))
+		return;
+
+	// the host clamps the same way, or replays wouldn't match
+	if (delta_seconds > NET_PREDICTION_MAX_COMMAND_SECONDS)
+		delta_seconds = NET_PREDICTION_MAX_COMMAND_SECONDS;
+	else if (delta_seconds < 0.0f)
+		delta_seconds = 0.0f;
+
+	s_newestTick = tick;
+	net_input_command_t &command = s_commands[tick % NET_PREDICTION_COMMAND_HISTORY];
+	command.tick = tick;
+	command.delta_seconds = delta_seconds;
+	command.submit_time = GetCurrentTimeSeconds();
+	command.input_size = (uint8_t)input_size;
+	memcpy(command.input, input, input_size);
+	++s_clientStats.commands;
+
+	NetObject *nop = NetPredictionGetLocalObject();
+	if (CanPredict(nop, input_size))
+		nop->m_definition->m_predictInput(nop->m_localObj, input, delta_seconds);
+
+	SendNetInputCommands(tick, (uint8_t)input_size);
+}
+
+static bool SnapshotsDiffer(NetObjectTypeDefinition const *defn, void const *a, void const *b, size_t size)
+{
+	if (!defn->HasFields())
+		return memcmp(a, b, size) != 0;
+
+	// differences the wire couldn't carry don't count
+	std::vector<uint32_t> quantized_a(defn->m_quantizedCount);
+	std::vector<uint32_t> quantized_b(defn->m_quantizedCount);
+	defn->Quantize(quantized_a.data(), a);
+	defn->Quantize(quantized_b.data(), b);
+	return defn->GetDirtyMask(quantized_a.data(), quantized_b.data()) != 0;
+}
+
+void OnNetPredictionStateReceived(NetMessage *msg)
+{
+	uint16_t net_id;
+	tick_t tick;
+	msg->read_bytes(&net_id, sizeof(uint16_t));
+	msg->read_bytes(&tick, sizeof(tick_t));
+
+	// states are unreliable, an older one showing up late is already replayed past
+	if (s_hasState && (tick < s_ackedTick))
+		return;
+
+	NetPredictionSetLocalObject(net_id);
+	NetObject *nop = NetPredictionGetLocalObject();
+	if ((nop == nullptr) || (nop->m_definition->m_getCurrentSnapShot == nullptr) || (nop->m_definition->m_applySnapshot == nullptr))
+		return;
+
+	size_t size = nop->m_snapShotSize;
+	if (msg->m_readBytes + size > msg->m_payloadBytesUsed)
+		return;
+
+	net_input_command_t const &acked = s_commands[tick % NET_PREDICTION_COMMAND_HISTORY];
+	if ((tick > s_ackedTick) && (acked.tick == tick))
+	{
+		float round_trip = (float)(GetCurrentTimeSeconds() - acked.submit_time);
+		s_clientStats.command_round_trip += (round_trip - s_clientStats.command_round_trip) / 8.0f;
+	}
+
+	s_ackedTick = tick;
+	s_hasState = true;
+
+	NetObjectTypeDefinition *defn = nop->m_definition;
+	std::vector<uint8_t> authoritative(size);
+	std::vector<uint8_t> predicted(size);
+	std::vector<uint8_t> replayed(size);
+	msg->read_bytes(authoritative.data(), (uint)size);
+	defn->m_getCurrentSnapShot(predicted.data(), nop->m_localObj);
+
+	// rewind to what the host had, then run what it hadn't seen yet
+	defn->m_applySnapshot(nop->m_localObj, authoritative.data(), 0.0f);
+	tick_t first_tick = tick + 1;
+	if (s_newestTick - tick > NET_PREDICTION_COMMAND_HISTORY)
+		first_tick = s_newestTick - NET_PREDICTION_COMMAND_HISTORY + 1;
+
+	for (tick_t replay_tick = first_tick; replay_tick <= s_newestTick; ++replay_tick)
+	{
+		net_input_command_t const &command = s_commands[replay_tick % NET_PREDICTION_COMMAND_HISTORY];
+		if ((command.tick != replay_tick) || !CanPredict(nop, command.input_size))
+			continue;
+
+		defn->m_predictInput(nop->m_localObj, command.input, command.delta_seconds);
+		++s_clientStats.replayed;
+	}
+
+	defn->m_getCurrentSnapShot(replayed.data(), nop->m_localObj);
+	++s_clientStats.reconciles;
+	if (SnapshotsDiffer(defn, predicted.data(), replayed.data(), size))
+		++s_clientStats.mispredictions;
+}
+
+//------------------------------------------------------------------------
+// Host
+//------------------------------------------------------------------------
+void NetPredictionSetControlledObject(NetConnection *cp, uint16_t net_id)
+{
+	net_prediction_connection_t &state = GetNetPredictionConnectionState(cp);
+	NetObject *previous = NetObjectFind(state.net_id);
+	if (previous != nullptr)
+		previous->m_isPredicted = false;
+
+	// the client's ticks carry on, so commands from before don't land on the new one
+	state.net_id = net_id;
+	NetObject *nop = NetObjectFind(net_id);
+	if (nop != nullptr)
+		nop->m_isPredicted = true;
+}
+
+bool NetPredictionIsInputDriven(uint16_t net_id)
+{
+	NetObject *nop = NetObjectFind(net_id);
+	return (nop != nullptr) && nop->m_isPredicted;
+}
+
+void OnNetInputCommandsReceived(NetMessage *msg)
+{
+	NetConnection *cp = msg->m_sender;
+	if ((cp == nullptr) || (cp->m_connectionIndex == INVALID_CONNECTION_INDEX))
+		return;
+
+	uint8_t count;
+	uint8_t input_size;
+	tick_t newest_tick;
+	msg->read_bytes(&count, sizeof(uint8_t));
+	msg->read_bytes(&input_size, sizeof(uint8_t));
+	msg->read_bytes(&newest_tick, sizeof(tick_t));
+	if ((count == 0) || (input_size > NET_PREDICTION_MAX_INPUT_SIZE) || (newest_tick < count))
+		return;
+
+	net_prediction_connection_t &state = GetNetPredictionConnectionState(cp);
+	if ((state.last_tick > newest_tick) && (state.last_tick - newest_tick > NET_PREDICTION_COMMAND_HISTORY))
+		state.last_tick = 0;
+
+	NetObject *nop = NetObjectFind(state.net_id);
+	bool can_predict = CanPredict(nop, input_size) && nop->m_isPredicted;
+
+	uint8_t input[NET_PREDICTION_MAX_INPUT_SIZE];
+	for (tick_t tick = newest_tick - count + 1; tick <= newest_tick; ++tick)
+	{
+		float delta_seconds;
+		if ((msg->read_bytes(&delta_seconds, sizeof(float)) != sizeof(float)) || (msg->read_bytes(input, input_size) != input_size))
+			return;
+
+		if (tick <= state.last_tick)
+		{
+			++state.redundant;
+			continue;
+		}
+
+		if (state.last_tick != 0)
+			state.lost += (uint32_t)(tick - state.last_tick - 1);
+		state.last_tick = tick;
+
+		if (!can_predict)
+			continue;
+
+		if (delta_seconds > NET_PREDICTION_MAX_COMMAND_SECONDS)
+			delta_seconds = NET_PREDICTION_MAX_COMMAND_SECONDS;
+		else if (!(delta_seconds >= 0.0f))
+			delta_seconds = 0.0f;
+
+		nop->m_definition->m_predictInput(nop->m_localObj, input, delta_seconds);
+		++state.applied;
+	}
+}
+
+void SendNetPredictionStateTo(NetConnection *cp)
+{
+	if ((s_connectionStates.size() <= cp->m_connectionIndex) || (s_connectionStates[cp->m_connectionIndex].connection != cp->m_handle))
+		return;
+
+	net_prediction_connection_t const &state = s_connectionStates[cp->m_connectionIndex];
+	NetObject *nop = NetObjectFind(state.net_id);
+	if ((nop == nullptr) || !nop->m_isPredicted || (nop->GetCurrentSnapshot() == nullptr))
+		return;
+
+	// the snapshot this update just took, exactly - no quantizing to replay from
+	NetMessage msg(NET_PREDICTION_STATE);
+	msg.m_sender = GetNetObjectSession()->m_myConnection;
+	msg.write_bytes(&nop->m_netID, sizeof(uint16_t));
+	msg.write_bytes(&state.last_tick, sizeof(tick_t));
+	msg.write_bytes(nop->GetCurrentSnapshot(), (uint)nop->m_snapShotSize);
+	cp->Send(&msg);
+}
+
+void EstablishNetPredictionMessages()
+{
+	NetSession* session = GetNetObjectSession();
+	session->RegisterMessageDefinition(NET_INPUT_COMMANDS, OnNetInputCommandsReceived, NET_CHANNEL_UNRELIABLE);
+	session->RegisterMessageDefinition(NET_PREDICTION_STATE, OnNetPredictionStateReceived, NET_CHANNEL_UNRELIABLE);
+}
+
+//------------------------------------------------------------------------
+// Console
+//------------------------------------------------------------------------
+// NetPredictionStats [reset]
+void NetPredictionStatsCmd(void* data)
+{
+	arguments args = *(arguments*)data;
+	bool reset = (args.arg_list.size() > 0) && (args.arg_list[0] == "reset");
+
+	NetSession *session = GetNetObjectSession();
+	if (session == nullptr)
+		return;
+
+	if (session->AmIClient())
+	{
+		net_prediction_client_stats_t const &stats = s_clientStats;
+		float reconciles = (float)((stats.reconciles > 0) ? stats.reconciles : 1);
+		uint32_t unacked = (uint32_t)(s_newestTick - ((s_ackedTick > 0) ? s_ackedTick : s_newestTick));
+		g_console->ConsolePrintf(Rgba(255, 255, 255, 255), "Prediction: tick %llu, %u unacked, command round trip %.1f ms",
+			(unsigned long long)s_newestTick, unacked, stats.command_round_trip * 1000.0f);
+		g_console->ConsolePrintf(Rgba(255, 255, 255, 255), "  %u commands in %u sends, %u reconciles replaying %.1f each, %u mispredicted",
+			stats.commands, stats.sends, stats.reconciles, stats.replayed / reconciles, stats.mispredictions);
+
+		net_playout_stats_t playout = NetObjectGetPlayoutStats();
+		float frames = (float)((playout.frames > 0) ? playout.frames : 1);
+		g_console->ConsolePrintf(Rgba(255, 255, 255, 255), "Playout: %.1f ms behind the host (updates every %.1f ms, jitter %.1f ms), %.2f extrapolations a frame",
+			playout.delay * 1000.0f, playout.update_spacing * 1000.0f, playout.jitter * 1000.0f, playout.extrapolated / frames);
+
+		if (reset)
+		{
+			memset(&s_clientStats, 0, sizeof(s_clientStats));
+			s_clientStats.command_round_trip = stats.command_round_trip;
+		}
+		return;
+	}
+
+	for (NetConnection *cp : session->m_connections)
+	{
+		if ((cp == nullptr) || (cp == session->m_myConnection))
+			continue;
+
+		if ((s_connectionStates.size() <= cp->m_connectionIndex) || (s_connectionStates[cp->m_connectionIndex].connection != cp->m_handle))
+			continue;
+
+		net_prediction_connection_t &state = s_connectionStates[cp->m_connectionIndex];
+		g_console->ConsolePrintf(Rgba(255, 255, 255, 255), "Connection %u: object %u at tick %llu, %u applied, %u redundant, %u lost",
+			cp->m_connectionIndex, state.net_id, (unsigned long long)state.last_tick, state.applied, state.redundant, state.lost);
+
+		if (reset)
+		{
+			state.applied = 0;
+			state.redundant = 0;
+			state.lost = 0;
+		}
+	}
+}
+
+void RegisterNetPredictionCommands()
+{
+	g_console->RegisterCommand("NetPredictionStats", NetPredictionStatsCmd);
+}
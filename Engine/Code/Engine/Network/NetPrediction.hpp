@@ -0,0 +1,42 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "Engine/Core/FixedTickLoop.hpp"
+
+// Client side prediction for the object a client controls.  Every simulation
+// tick the client stamps its input with the tick, runs it on its own copy of the
+// object straight away and sends the host every command it hasn't had acked.
+// Ticks are the FixedTickLoop's, run off NetClock, so they're the host's too.
+// The host runs commands through the same NetObjectTypeDefinition::m_predictInput
+// as they arrive, and with each net object update sends the client the object's
+// exact state along with the newest tick that went into it.  The client rewinds
+// to that state and replays the commands the host hadn't seen yet, so its own
+// object answers input the frame it's pressed whatever the round trip is.
+//
+//   NET_INPUT_COMMANDS:   uint8 count, uint8 input size, uint64 newest tick,
+//                         then count x (float delta seconds, input), oldest first
+//   NET_PREDICTION_STATE: uint16 net id, uint64 newest tick applied, snapshot
+constexpr uint32_t NET_PREDICTION_COMMAND_HISTORY = 256;		// commands kept for replay
+constexpr uint32_t NET_PREDICTION_MAX_COMMANDS_PER_SEND = 16;	// unacked ones, newest first
+constexpr uint32_t NET_PREDICTION_MAX_INPUT_SIZE = 64;
+constexpr float NET_PREDICTION_MAX_COMMAND_SECONDS = 0.1f;		// longer frames are clamped, on both ends
+
+class NetConnection;
+class NetMessage;
+class NetObject;
+
+// forgets every tick and controlled object, for a new session
+void NetPredictionReset();
+void EstablishNetPredictionMessages();
+void RegisterNetPredictionCommands();
+
+// client - runs one tick of input on the local object and queues it for the host
+void NetPredictionSubmitInput(tick_t tick, void const *input, size_t input_size, float delta_seconds);
+// client - which object our input drives, the host's state messages say so too
+void NetPredictionSetLocalObject(uint16_t net_id);
+NetObject* NetPredictionGetLocalObject();
+
+// host - whose input drives which object, INVALID_NETWORK_ID for nothing
+void NetPredictionSetControlledObject(NetConnection *cp, uint16_t net_id);
+bool NetPredictionIsInputDriven(uint16_t net_id);		// so the game doesn't also move it
+void SendNetPredictionStateTo(NetConnection *cp);
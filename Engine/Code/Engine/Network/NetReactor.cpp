@@ -0,0 +1,311 @@
+#include "Engine/Network/NetReactor.hpp"
+#include <unordered_map>
+
+#if defined(_WIN32)
+#include "Engine/Network/Net.hpp"
+#else
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+constexpr uint NET_REACTOR_MAX_EVENTS = 256;		// per epoll_wait, the rest come next call
+
+#if defined(_WIN32)
+//------------------------------------------------------------------------
+// WSAPoll - one array for the whole set, kept dense so removal is a swap
+//------------------------------------------------------------------------
+struct net_reactor_backend_t
+{
+	std::vector<WSAPOLLFD> fds;
+	std::vector<void*> user_data;
+	std::unordered_map<void*, uint> indices;
+	SOCKET wake_socket;		// connected to itself, a byte sent to it ends the poll
+};
+
+// what the wakeup is known as in user_data, never handed out
+static void* const NET_REACTOR_WAKE_DATA = (void*)&NET_REACTOR_MAX_EVENTS;
+
+static SOCKET NetReactorCreateWakeSocket()
+{
+	SOCKET sock = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock == INVALID_SOCKET) {
+		return INVALID_SOCKET;
+	}
+
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = 0;
+
+	int address_size = sizeof(address);
+	if ((::bind(sock, (sockaddr*)&address, address_size) == SOCKET_ERROR)
+		|| (::getsockname(sock, (sockaddr*)&address, &address_size) == SOCKET_ERROR)
+		|| (::connect(sock, (sockaddr*)&address, address_size) == SOCKET_ERROR)) {
+		::closesocket(sock);
+		return INVALID_SOCKET;
+	}
+
+	u_long non_blocking = 1;
+	::ioctlsocket(sock, FIONBIO, &non_blocking);
+	return sock;
+}
+
+static SHORT NetReactorPollEvents(uint interest)
+{
+	SHORT events = 0;
+	if (interest & NET_READABLE)
+		events |= POLLRDNORM;
+	if (interest & NET_WRITABLE)
+		events |= POLLWRNORM;
+	return events;
+}
+
+NetReactor::NetReactor()
+	:m_backend(new net_reactor_backend_t())
+{
+	m_backend->wake_socket = NetReactorCreateWakeSocket();
+	if (m_backend->wake_socket != INVALID_SOCKET) {
+		Add((void*)m_backend->wake_socket, NET_REACTOR_WAKE_DATA, NET_READABLE);
+	}
+}
+
+NetReactor::~NetReactor()
+{
+	if (m_backend->wake_socket != INVALID_SOCKET) {
+		::closesocket(m_backend->wake_socket);
+	}
+
+	delete m_backend;
+	m_backend = nullptr;
+}
+
+void NetReactor::Wake()
+{
+	char byte = 0;
+	::send(m_backend->wake_socket, &byte, 1, 0);
+}
+
+bool NetReactor::Add(void *socket, void *user_data, uint interest)
+{
+	if (m_backend->indices.find(socket) != m_backend->indices.end()) {
+		return false;
+	}
+
+	WSAPOLLFD fd;
+	fd.fd = (SOCKET)socket;
+	fd.events = NetReactorPollEvents(interest);
+	fd.revents = 0;
+
+	m_backend->indices[socket] = (uint)m_backend->fds.size();
+	m_backend->fds.push_back(fd);
+	m_backend->user_data.push_back(user_data);
+	return true;
+}
+
+void NetReactor::SetInterest(void *socket, uint interest)
+{
+	auto found = m_backend->indices.find(socket);
+	if (found != m_backend->indices.end()) {
+		m_backend->fds[found->second].events = NetReactorPollEvents(interest);
+	}
+}
+
+void NetReactor::Remove(void *socket)
+{
+	auto found = m_backend->indices.find(socket);
+	if (found == m_backend->indices.end()) {
+		return;
+	}
+
+	uint index = found->second;
+	uint last = (uint)m_backend->fds.size() - 1;
+	if (index != last) {
+		m_backend->fds[index] = m_backend->fds[last];
+		m_backend->user_data[index] = m_backend->user_data[last];
+		m_backend->indices[(void*)m_backend->fds[index].fd] = index;
+	}
+
+	m_backend->fds.pop_back();
+	m_backend->user_data.pop_back();
+	m_backend->indices.erase(found);
+}
+
+uint NetReactor::Wait(std::vector<net_reactor_event_t> *out_events, int timeout_ms)
+{
+	out_events->clear();
+	if (m_backend->fds.empty()) {
+		return 0;
+	}
+
+	int ready = ::WSAPoll(m_backend->fds.data(), (ULONG)m_backend->fds.size(), timeout_ms);
+	if (ready <= 0) {
+		return 0;
+	}
+
+	uint found = 0;
+	for (uint index = 0; (index < m_backend->fds.size()) && (found < (uint)ready); ++index) {
+		SHORT revents = m_backend->fds[index].revents;
+		if (revents == 0) {
+			continue;
+		}
+
+		++found;
+		if (m_backend->user_data[index] == NET_REACTOR_WAKE_DATA) {
+			char drain[64];
+			while (::recv(m_backend->wake_socket, drain, sizeof(drain), 0) > 0) {}
+			continue;
+		}
+
+		net_reactor_event_t event;
+		event.user_data = m_backend->user_data[index];
+		event.readiness = 0;
+		if (revents & (POLLRDNORM | POLLRDBAND))
+			event.readiness |= NET_READABLE;
+		if (revents & POLLWRNORM)
+			event.readiness |= NET_WRITABLE;
+		if (revents & (POLLHUP | POLLERR | POLLNVAL))
+			event.readiness |= NET_HANGUP;
+		out_events->push_back(event);
+	}
+
+	return (uint)out_events->size();
+}
+
+uint NetReactor::GetSocketCount() const
+{
+	uint wake_count = (m_backend->wake_socket != INVALID_SOCKET) ? 1 : 0;
+	return (uint)m_backend->fds.size() - wake_count;
+}
+
+#else
+//------------------------------------------------------------------------
+// epoll - the kernel keeps the set, Wait only costs what's ready
+//------------------------------------------------------------------------
+struct net_reactor_backend_t
+{
+	int epoll_fd;
+	int wake_fd;		// an eventfd, written to end the wait
+	std::unordered_map<void*, void*> user_data;
+	epoll_event events[NET_REACTOR_MAX_EVENTS];
+};
+
+// what the wakeup is known as in user_data, never handed out
+static void* const NET_REACTOR_WAKE_DATA = (void*)&NET_REACTOR_MAX_EVENTS;
+
+static uint32_t NetReactorEpollEvents(uint interest)
+{
+	uint32_t events = 0;
+	if (interest & NET_READABLE)
+		events |= EPOLLIN;
+	if (interest & NET_WRITABLE)
+		events |= EPOLLOUT;
+	return events;
+}
+
+NetReactor::NetReactor()
+	:m_backend(new net_reactor_backend_t())
+{
+	m_backend->epoll_fd = ::epoll_create1(0);
+	m_backend->wake_fd = ::eventfd(0, EFD_NONBLOCK);
+	if (m_backend->wake_fd >= 0) {
+		epoll_event event;
+		event.events = EPOLLIN;
+		event.data.ptr = NET_REACTOR_WAKE_DATA;
+		::epoll_ctl(m_backend->epoll_fd, EPOLL_CTL_ADD, m_backend->wake_fd, &event);
+	}
+}
+
+NetReactor::~NetReactor()
+{
+	if (m_backend->wake_fd >= 0) {
+		::close(m_backend->wake_fd);
+	}
+
+	if (m_backend->epoll_fd >= 0) {
+		::close(m_backend->epoll_fd);
+	}
+
+	delete m_backend;
+	m_backend = nullptr;
+}
+
+void NetReactor::Wake()
+{
+	uint64_t one = 1;
+	ssize_t written = ::write(m_backend->wake_fd, &one, sizeof(one));
+	(void)written;
+}
+
+bool NetReactor::Add(void *socket, void *user_data, uint interest)
+{
+	if (m_backend->user_data.find(socket) != m_backend->user_data.end()) {
+		return false;
+	}
+
+	epoll_event event;
+	event.events = NetReactorEpollEvents(interest);
+	event.data.ptr = user_data;
+	if (::epoll_ctl(m_backend->epoll_fd, EPOLL_CTL_ADD, (int)(intptr_t)socket, &event) != 0) {
+		return false;
+	}
+
+	m_backend->user_data[socket] = user_data;
+	return true;
+}
+
+void NetReactor::SetInterest(void *socket, uint interest)
+{
+	auto found = m_backend->user_data.find(socket);
+	if (found != m_backend->user_data.end()) {
+		epoll_event event;
+		event.events = NetReactorEpollEvents(interest);
+		event.data.ptr = found->second;
+		::epoll_ctl(m_backend->epoll_fd, EPOLL_CTL_MOD, (int)(intptr_t)socket, &event);
+	}
+}
+
+void NetReactor::Remove(void *socket)
+{
+	auto found = m_backend->user_data.find(socket);
+	if (found != m_backend->user_data.end()) {
+		::epoll_ctl(m_backend->epoll_fd, EPOLL_CTL_DEL, (int)(intptr_t)socket, nullptr);
+		m_backend->user_data.erase(found);
+	}
+}
+
+uint NetReactor::Wait(std::vector<net_reactor_event_t> *out_events, int timeout_ms)
+{
+	out_events->clear();
+
+	int ready = ::epoll_wait(m_backend->epoll_fd, m_backend->events, (int)NET_REACTOR_MAX_EVENTS, timeout_ms);
+	for (int index = 0; index < ready; ++index) {
+		uint32_t events = m_backend->events[index].events;
+		if (m_backend->events[index].data.ptr == NET_REACTOR_WAKE_DATA) {
+			uint64_t count;
+			ssize_t drained = ::read(m_backend->wake_fd, &count, sizeof(count));
+			(void)drained;
+			continue;
+		}
+
+		net_reactor_event_t event;
+		event.user_data = m_backend->events[index].data.ptr;
+		event.readiness = 0;
+		if (events & EPOLLIN)
+			event.readiness |= NET_READABLE;
+		if (events & EPOLLOUT)
+			event.readiness |= NET_WRITABLE;
+		if (events & (EPOLLHUP | EPOLLERR | EPOLLRDHUP))
+			event.readiness |= NET_HANGUP;
+		out_events->push_back(event);
+	}
+
+	return (uint)out_events->size();
+}
+
+uint NetReactor::GetSocketCount() const
+{
+	return (uint)m_backend->user_data.size();
+}
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+typedef unsigned int uint;
+
+// Readiness for a set of sockets in one call, instead of asking every socket
+// every frame.  WSAPoll on Windows, epoll on Linux.  Sockets are the same
+// void* handles TCPSocket/UDPSocket keep.  Not thread safe - whoever pumps
+// the reactor owns it - except Wake, which any thread can call to end a Wait
+// early.  The wakeup is a loopback UDP socket on Windows, an eventfd on Linux,
+// kept in the set and never reported.
+enum eNetReadiness : uint
+{
+	NET_READABLE = (1 << 0),
+	NET_WRITABLE = (1 << 1),
+	NET_HANGUP = (1 << 2),		// closed or errored, always reported
+};
+
+struct net_reactor_event_t
+{
+	void *user_data;
+	uint readiness;
+};
+
+struct net_reactor_backend_t;
+
+class NetReactor
+{
+public:
+	NetReactor();
+	~NetReactor();
+
+	bool Add(void *socket, void *user_data, uint interest);
+	void SetInterest(void *socket, uint interest);
+	void Remove(void *socket);
+
+	// waits up to timeout_ms (0 just checks) and fills out_events with whatever is ready
+	uint Wait(std::vector<net_reactor_event_t> *out_events, int timeout_ms);
+	void Wake();
+	uint GetSocketCount() const;		// not counting the wakeup
+
+public:
+	net_reactor_backend_t *m_backend;
+};
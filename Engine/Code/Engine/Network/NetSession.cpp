@@ -7,7 +7,6 @@
 NetSession::NetSession()
 	:m_myConnection(nullptr)
 	, m_hostConnection(nullptr)
-	, m_connectionList(nullptr)
 	, m_maxConnectionCount(8)
 {
 	m_messageDefintions.resize(256);
@@ -18,12 +17,13 @@ NetSession::~NetSession()
 	m_messageDefintions.clear();
 }
 
-bool NetSession::RegisterMessageDefinition(uint8_t msg_id, std::function<void(NetMessage*)> const &handler)
+bool NetSession::RegisterMessageDefinition(uint8_t msg_id, std::function<void(NetMessage*)> const &handler, eNetMessageChannel channel)
 {
 	if (!m_messageDefintions[msg_id])
 	{
 		NetMessageDefinition* defn = new NetMessageDefinition();
 		defn->m_typeIndex = msg_id;
+		defn->m_channel = channel;
 		defn->m_handler = handler;
 		m_messageDefintions[msg_id] = defn;
 		return true;
@@ -60,6 +60,7 @@ uint8_t NetSession::GetFreeConnectionIndex() const
 void NetSession::JoinConnection(uint8_t idx, NetConnection* conn)
 {
 	conn->m_connectionIndex = idx;
+	conn->m_owner = this;
 
 	std::string error_msg = "Could not Join Connection at: " + NetAddressToString(conn->m_address);
 	ASSERT_OR_DIE((idx >= m_connections.size()) || (m_connections[idx] == nullptr), error_msg.c_str());
@@ -106,14 +107,24 @@ NetConnection* NetSession::GetConnection(uint8_t idx)
 	return nullptr;
 }
 
+NetConnection* NetSession::GetConnectionByHandle(net_connection_handle_t handle) const
+{
+	uint8_t idx = (uint8_t)(handle & 0xff);
+	if ((idx >= m_connections.size()) || (m_connections[idx] == nullptr)) {
+		return nullptr;
+	}
+
+	return (m_connections[idx]->m_handle == handle) ? m_connections[idx] : nullptr;
+}
+
 void NetSession::SendMessageToOthers(NetMessage const &msg)
 {
-	NetConnection *cp = m_connectionList;
-	while (cp != nullptr) {
-		if (cp != m_myConnection) {
-			cp->Send(new NetMessage(msg));
+	// connections keep copies, which all share msg's buffer
+	NetMessage shared(msg);
+	for (NetConnection *cp : m_connections) {
+		if ((cp != nullptr) && (cp != m_myConnection)) {
+			cp->Send(&shared);
 		}
-		cp = cp->m_next;
 	}
 }
 
@@ -124,44 +135,18 @@ void NetSession::SetState(const eSessionState& new_state)
 
 void NetSession::AppendConnection(NetConnection* conn)
 {
-	if (!m_connectionList)
-	{
-		m_connectionList = conn;
-		return;
-	}
-
-	NetConnection* tracker = m_connectionList;
-	while (tracker->m_next)
-	{
-		tracker = tracker->m_next;
+	uint8_t idx = conn->m_connectionIndex;
+	if (idx >= m_connectionGenerations.size()) {
+		m_connectionGenerations.resize(idx + 1, 0);
 	}
 
-	tracker->m_next = conn;
-	conn->m_prev = tracker;
+	// index 0xff is never joined, so this never makes INVALID_CONNECTION_HANDLE
+	uint8_t generation = ++m_connectionGenerations[idx];
+	conn->m_handle = (net_connection_handle_t)((generation << 8) | idx);
 }
 
 void NetSession::RemoveConnection(NetConnection* conn)
 {
-	NetConnection* tracker = m_connectionList;
-	if (!tracker)
-		return;
-
-	while (tracker)
-	{
-		if (tracker == conn)
-		{
-			if(tracker->m_next)
-				tracker->m_next->m_prev = tracker->m_prev;
-
-			if(tracker->m_prev)
-				tracker->m_prev->m_next = tracker->m_next;
-		}
-		tracker = tracker->m_next;
-	}
-
-	if (conn == m_connectionList)
-		m_connectionList = nullptr;
-
-	conn = nullptr;
+	conn->m_handle = INVALID_CONNECTION_HANDLE;
 }
 
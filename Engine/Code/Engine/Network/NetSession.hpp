@@ -1,11 +1,11 @@
 #pragma once
 #include "Engine/Network/NetAddress.hpp"
+#include "Engine/Network/NetConnection.hpp"
+#include "Engine/Network/NetMessageDefinition.hpp"
 #include <stdint.h>
 #include <vector>
 #include <functional>
 
-class NetMessageDefinition;
-class NetConnection;
 class NetMessage;
 
 enum eSessionState
@@ -31,7 +31,7 @@ public:
 	virtual void ProcessMessage(NetMessage* msg) = 0;
 
 public:
-	bool RegisterMessageDefinition(uint8_t msg_id, std::function<void(NetMessage*)> const &handler);
+	bool RegisterMessageDefinition(uint8_t msg_id, std::function<void(NetMessage*)> const &handler, eNetMessageChannel channel = NET_CHANNEL_RELIABLE_ORDERED);
 	NetMessageDefinition* GetMessageDefinition(uint8_t id) const;
 	inline bool AmIHost() const { return (m_myConnection == m_hostConnection) && (m_hostConnection != nullptr); };
 	inline bool AmIClient() const { return (m_myConnection != m_hostConnection) && (m_myConnection != nullptr); };
@@ -41,8 +41,10 @@ public:
 	void JoinConnection(uint8_t idx, NetConnection* conn);
 	void DestroyConnection(NetConnection *cp);
 	NetConnection* GetConnection(uint8_t idx);
+	NetConnection* GetConnectionByHandle(net_connection_handle_t handle) const;	// nullptr once it's gone
 	void SendMessageToOthers(NetMessage const &msg);
 	void SetState(const eSessionState& new_state);
+	// hand out and retire the connection's handle
 	void AppendConnection(NetConnection* conn);
 	void RemoveConnection(NetConnection* conn);
 
@@ -52,7 +54,7 @@ public:
 	NetConnection* m_myConnection;		// helpers
 	NetConnection* m_hostConnection; 	// 
 	eSessionState m_state;
-	NetConnection* m_connectionList;
+	std::vector<uint8_t> m_connectionGenerations;	// by index, bumped every join
 	uint m_maxConnectionCount;
 
 	// message data;
@@ -1,68 +1,202 @@
 #include "Engine/Network/TCPConnection.hpp"
+#include "Engine/Network/TCPSession.hpp"
 #include "Engine/Network/TCPSocket.hpp"
 #include "Engine/Network/NetMessage.hpp"
+#include "Engine/Core/CriticalSection.hpp"
+#include <string.h>
+
+// only locks while the session has an io thread
+struct tcp_io_lock_t
+{
+	tcp_io_lock_t(CriticalSection *cs) : m_cs(cs) { if (m_cs) m_cs->Lock(); }
+	~tcp_io_lock_t() { if (m_cs) m_cs->Unlock(); }
+	CriticalSection *m_cs;
+};
 
 TCPConnection::TCPConnection()
-	:m_lastIndex(0)
+	:m_socket(nullptr)
+	, m_session(nullptr)
+	, m_reactorHandle(nullptr)
+	, m_ioLock(nullptr)
+	, m_wantsWritable(false)
+	, m_receivePaused(false)
+	, m_receiveBuffer(nullptr)
+	, m_receiveUsed(0)
+	, m_receiveRead(0)
+	, m_sendOffset(0)
 {
 	
 }
 
 TCPConnection::~TCPConnection()
 {
+	if (m_session != nullptr) {
+		m_session->UnwatchConnection(this);
+	}
+
+	NetMessageBufferRelease(m_receiveBuffer);
+	m_receiveBuffer = nullptr;
 
+	delete m_socket;
+	m_socket = nullptr;
 }
 
 void TCPConnection::Send(NetMessage *msg)
 {
+	tcp_io_lock_t lock(m_ioLock);
+	++m_sendStats.messages;
+
 	uint16_t package_size = (uint16_t)(msg->m_payloadBytesUsed + 1);
-	m_socket->Send(&(package_size), 2);
-	m_socket->Send(&msg->m_messageTypeIndex, 1);
-	if(msg->m_payloadBytesUsed > 0)
-		m_socket->Send(msg->m_payload, msg->m_payloadBytesUsed);
+	size_t start = m_sendBuffer.size();
+	m_sendBuffer.resize(start + sizeof(uint16_t) + 1 + msg->m_payloadBytesUsed);
+
+	byte_t *dest = &m_sendBuffer[start];
+	memcpy(dest, &package_size, sizeof(uint16_t));
+	dest[sizeof(uint16_t)] = msg->m_messageTypeIndex;
+	if (msg->m_payloadBytesUsed > 0)
+		memcpy(dest + sizeof(uint16_t) + 1, msg->GetPayload(), msg->m_payloadBytesUsed);
+
+	// nobody is going to flush us
+	if (m_session == nullptr)
+		FlushSend();
 }
 
-bool TCPConnection::Receive(NetMessage **msg)
+bool TCPConnection::FlushSend()
 {
-	if(m_lastIndex < 2)
-		m_lastIndex += m_socket->Receive(m_buffer + m_lastIndex, 2 - m_lastIndex);
-	
-	if (m_lastIndex < 2)
+	if (!HasPendingSend()) {
+		return true;
+	}
+
+	if ((m_socket == nullptr) || !m_socket->IsValid()) {
 		return false;
+	}
 
-	NetMessage byte_check;
+	uint pending = (uint)m_sendBuffer.size() - m_sendOffset;
+	uint sent = m_socket->Send(&m_sendBuffer[m_sendOffset], pending);
+	m_sendOffset += sent;
+	++m_sendStats.socket_sends;
+	m_sendStats.bytes_sent += sent;
 
-	uint16_t bytes_to_read = *(uint16_t*)m_buffer;
-	if (byte_check.IsBigEndian())
-		byte_check.FlipBytes(&bytes_to_read, 2);
+	if (m_sendOffset == m_sendBuffer.size()) {
+		m_sendBuffer.clear();
+		m_sendOffset = 0;
+		return true;
+	}
 
-	uint16_t total_bytes = bytes_to_read + 2;
+	// the socket is full - keep the rest at the front for next time
+	if (m_sendOffset > (m_sendBuffer.size() / 2)) {
+		m_sendBuffer.erase(m_sendBuffer.begin(), m_sendBuffer.begin() + m_sendOffset);
+		m_sendOffset = 0;
+	}
+	return false;
+}
 
-	if(m_lastIndex < total_bytes)
-		m_lastIndex += m_socket->Receive(m_buffer + m_lastIndex, total_bytes - m_lastIndex);
+bool TCPConnection::Receive(NetMessage **msg)
+{
+	// recv happens in the session's io pump, this only decodes what's arrived
+	tcp_io_lock_t lock(m_ioLock);
+	return DecodeMessage(msg);
+}
 
-	if (m_lastIndex < total_bytes)
+bool TCPConnection::DecodeMessage(NetMessage **msg)
+{
+	uint available = m_receiveUsed - m_receiveRead;
+	if (available < sizeof(uint16_t)) {
 		return false;
+	}
+
+	byte_t const *start = m_receiveBuffer->data + m_receiveRead;
+	uint16_t package_size;
+	memcpy(&package_size, start, sizeof(package_size));
 
+	NetMessage byte_check;
 	if (byte_check.IsBigEndian())
-		byte_check.FlipBytes(m_buffer, 1027);
-	
-	*msg = new NetMessage();
-	NetMessage* ptr_to_msg = *msg;
+		byte_check.FlipBytes(&package_size, sizeof(package_size));
+
+	if (package_size == 0) {
+		// nothing we ever send, skip it rather than underflow
+		m_receiveRead += sizeof(uint16_t);
+		return DecodeMessage(msg);
+	}
+
+	if (available < sizeof(uint16_t) + package_size) {
+		return false;
+	}
 
-	ptr_to_msg->m_payloadBytesUsed = bytes_to_read - 1;
-	ptr_to_msg->m_messageTypeIndex = m_buffer[2];
-	std::memcpy(ptr_to_msg->m_payload, m_buffer + 3, ptr_to_msg->m_payloadBytesUsed);
-	m_lastIndex = 0;
+	uint payload_offset = m_receiveRead + sizeof(uint16_t) + 1;
+	*msg = new NetMessage(start[sizeof(uint16_t)], m_receiveBuffer, payload_offset, package_size - 1);
+	m_receiveRead += sizeof(uint16_t) + package_size;
 	return true;
 }
 
+bool TCPConnection::FillReceiveBuffer()
+{
+	if (m_socket == nullptr) {
+		return false;
+	}
+
+	uint pending = GetUndecodedSize();
+	if (pending >= TCP_MAX_UNDECODED_RECEIVE) {
+		// the main thread is behind - leave the rest in the socket, the session stops watching for reads
+		m_receivePaused = true;
+		return false;
+	}
+
+	uint wanted = TCP_RECEIVE_BUFFER_SIZE;
+	if (pending >= sizeof(uint16_t)) {
+		// a partial message bigger than the buffer needs room to finish
+		uint16_t package_size;
+		memcpy(&package_size, m_receiveBuffer->data + m_receiveRead, sizeof(package_size));
+		NetMessage byte_check;
+		if (byte_check.IsBigEndian())
+			byte_check.FlipBytes(&package_size, sizeof(package_size));
+
+		if (sizeof(uint16_t) + package_size > wanted) {
+			wanted = sizeof(uint16_t) + package_size;
+		}
+	}
+
+	// a buffer grown past the default can hold more than that undecoded, and recv always needs some room
+	if (pending + TCP_MIN_RECEIVE_SIZE > wanted) {
+		wanted = pending + TCP_MIN_RECEIVE_SIZE;
+	}
+
+	if (m_receiveBuffer == nullptr) {
+		m_receiveBuffer = NetMessageBufferAcquire(wanted);
+		m_receiveUsed = 0;
+		m_receiveRead = 0;
+	}
+	else if ((m_receiveBuffer->capacity - m_receiveUsed < TCP_MIN_RECEIVE_SIZE)
+		|| (m_receiveRead + wanted > m_receiveBuffer->capacity)
+		|| ((pending == 0) && (m_receiveRead > 0) && (m_receiveBuffer->ref_count == 1))) {
+		if (m_receiveBuffer->ref_count == 1) {
+			// nobody's looking at what's been decoded, slide the rest down
+			memmove(m_receiveBuffer->data, m_receiveBuffer->data + m_receiveRead, pending);
+			NetMessageBufferReserve(m_receiveBuffer, wanted, pending);
+		}
+		else {
+			// messages still point into this one, leave it to them
+			net_message_buffer_t *fresh = NetMessageBufferAcquire(wanted);
+			memcpy(fresh->data, m_receiveBuffer->data + m_receiveRead, pending);
+			NetMessageBufferRelease(m_receiveBuffer);
+			m_receiveBuffer = fresh;
+		}
+
+		m_receiveUsed = pending;
+		m_receiveRead = 0;
+	}
+
+	uint received = m_socket->Receive(m_receiveBuffer->data + m_receiveUsed, m_receiveBuffer->capacity - m_receiveUsed);
+	m_receiveUsed += received;
+	return (received > 0);
+}
+
 bool TCPConnection::Connect(const net_address_t& address)
 {
 	return m_socket->Join(address);
 }
 
-bool TCPConnection::IsDisconnected()
+bool TCPConnection::IsDisconnected() const
 {
 	if ((m_socket == nullptr) || (m_socket && !m_socket->IsValid())) {
 		return true;
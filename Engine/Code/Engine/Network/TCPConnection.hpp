@@ -2,7 +2,20 @@
 #include "Engine/Network/NetConnection.hpp"
 #include <vector>
 
+typedef unsigned char byte_t;
+
 class TCPSocket;
+class TCPSession;
+class CriticalSection;
+struct net_message_buffer_t;
+
+// recv lands in a pooled buffer and messages are handed out as views into it,
+// [uint16 length][uint8 type][payload] with length counting the type byte.
+// Sends are framed into one outgoing buffer that goes out in a single send
+// when the session flushes.
+constexpr uint TCP_RECEIVE_BUFFER_SIZE = 4096;
+constexpr uint TCP_MIN_RECEIVE_SIZE = 256;		// less room than this and we compact first
+constexpr uint TCP_MAX_UNDECODED_RECEIVE = 128 * 1024;	// past this the socket waits for the main thread to decode, always holds a whole message
 
 class TCPConnection : public NetConnection
 {
@@ -12,10 +25,29 @@ public:
 	virtual void Send(NetMessage *msg) override;
 	virtual bool Receive(NetMessage **msg) override;
 	bool Connect(const net_address_t& address);
-	bool IsDisconnected();
+	virtual bool IsDisconnected() const override;
+
+	// the session's io pump calls these when the reactor says the socket is ready
+	bool FillReceiveBuffer();
+	bool FlushSend();		// true once nothing is left waiting
+	inline bool HasPendingSend() const { return m_sendOffset < (uint)m_sendBuffer.size(); }
+	inline uint GetUndecodedSize() const { return m_receiveUsed - m_receiveRead; }
+
+private:
+	bool DecodeMessage(NetMessage **msg);
 
 public:
 	TCPSocket* m_socket;
-	unsigned char m_buffer[1027];
-	uint m_lastIndex;
-};
\ No newline at end of file
+	TCPSession* m_session;		// set once the session's reactor is watching m_socket
+	void* m_reactorHandle;		// what the reactor knows m_socket as, it outlives a close
+	CriticalSection* m_ioLock;	// the session's, while an io thread pumps it
+	bool m_wantsWritable;
+	bool m_receivePaused;		// too much undecoded, not reading until it's under half again
+
+	net_message_buffer_t* m_receiveBuffer;
+	uint m_receiveUsed;		// bytes recv'd into it
+	uint m_receiveRead;		// bytes decoded out of it
+
+	std::vector<byte_t> m_sendBuffer;
+	uint m_sendOffset;		// bytes of it already sent
+};
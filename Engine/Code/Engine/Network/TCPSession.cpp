@@ -3,18 +3,59 @@
 #include "Engine/Network/NetMessage.hpp"
 #include "Engine/Network/NetMessageDefinition.hpp"
 #include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/Logging.hpp"
+#include "Engine/Core/Time.hpp"
 #include "Engine/Network/TCPSocket.hpp"
 #include "Engine/Network/TCPConnection.hpp"
+#include "Engine/Network/ConditionedConnection.hpp"
+#include "Engine/EngineConfig.hpp"
+#include <algorithm>
+
+static TCPConnection* GetTCPConnection(NetConnection *cp)
+{
+	ConditionedConnection *conditioned = dynamic_cast<ConditionedConnection*>(cp);
+	if (conditioned)
+		cp = conditioned->m_inner;
+
+	return dynamic_cast<TCPConnection*>(cp);
+}
+
+static void TCPSessionIOThread(TCPSession *session)
+{
+	while (session->m_ioThreadRunning) {
+		{
+			SCOPE_LOCK(&session->m_ioLock);
+			session->ApplyReactorChanges();
+			session->FlushSends();
+		}
+
+		// unlocked, so the main thread can queue sends - it wakes the reactor when it has
+		session->m_reactor.Wait(&session->m_readyEvents, TCP_IO_THREAD_WAIT_MS);
+
+		{
+			SCOPE_LOCK(&session->m_ioLock);
+			session->HandleReadyEvents();
+		}
+	}
+}
 
 TCPSession::TCPSession()
 	:m_listenSocket(nullptr)
+	, m_ioThread(INVALID_THREAD_HANDLE)
+	, m_ioThreadRunning(false)
 {
 	RegisterMessageDefinition((uint8_t)JOIN_RESPONSE, [=](NetMessage* msg) {this->OnJoinResponse(msg); });
 }
 
 TCPSession::~TCPSession()
 {
+	SetIOThreaded(false);
+	Leave();
 
+	for (TCPSocket *socket : m_acceptedSockets) {
+		delete socket;
+	}
+	m_acceptedSockets.clear();
 }
 
 void TCPSession::Host(uint16_t port)
@@ -34,15 +75,15 @@ void TCPSession::Host(uint16_t port)
 
 bool TCPSession::Join(net_address_t const &addr)
 {
-	TCPConnection *host = new TCPConnection();
-	host->m_address = addr;
-
 	if (m_connections.size() == m_maxConnectionCount)
 		return false;
 
-	JoinConnection(0, host); // 0 for this class; 
+	TCPConnection *host = new TCPConnection();
+	host->m_address = addr;
+
+	NetConnection *host_link = new ConditionedConnection(host);
+	JoinConnection(0, host_link); // 0 for this class; 
 	host->m_socket = new TCPSocket();
-	host->m_socket->SetBlocking(false);
 
 	// Try to connect to host
 	if (!host->Connect(addr)) {
@@ -50,7 +91,11 @@ bool TCPSession::Join(net_address_t const &addr)
 		return false;
 	}
 
-	m_hostConnection = host;
+	host->m_socket->SetBlocking(false);
+	host->m_socket->EnableNagle(false);
+	WatchConnection(host);
+
+	m_hostConnection = host_link;
 	m_myConnection = new LoopBackConnection();
 	m_myConnection->m_address = GetMyAddress(addr.port);
 
@@ -75,25 +120,9 @@ void TCPSession::Leave()
 
 void TCPSession::Update()
 {
-	if (IsListening()) {
-		TCPSocket *socket = m_listenSocket->Accept();
-		if (socket != nullptr) {
-			TCPConnection *new_guy = new TCPConnection();
-			new_guy->m_socket = socket;
-			new_guy->m_socket->SetBlocking(false);
-			new_guy->m_socket->EnableNagle(false);
-
-			uint8_t conn_idx = GetFreeConnectionIndex();
-			if (conn_idx == INVALID_CONNECTION_INDEX) {
-				delete new_guy;
-				new_guy = nullptr;
-			}
-			else {
-				new_guy->m_address = socket->m_netAddr;
-				JoinConnection(conn_idx, new_guy);
-				SendJoinInfo(new_guy);
-			}
-		}
+	if (!IsIOThreaded()) {
+		SCOPE_LOCK(&m_ioLock);
+		PumpIO(0);
 	}
 
 	// Already Did It
@@ -103,11 +132,6 @@ void TCPSession::Update()
 			continue;
 
 		NetMessage* msg = nullptr;
-
-		TCPConnection* tcp_conn = dynamic_cast<TCPConnection*>(m_connections[index]);
-		if(tcp_conn)
-			tcp_conn->m_socket->SetBlocking(false);
-
 		while(m_connections[index]->Receive(&msg))
 		{
 			msg->m_sender = m_connections[index];
@@ -120,21 +144,223 @@ void TCPSession::Update()
 		} 
 	}
 
-	for (uint i = 0; i < m_connections.size(); ++i) {
-		NetConnection *cp = m_connections[i];
-		if ((cp != nullptr) && (cp != m_myConnection)) {
-			TCPConnection *tcp_connection = (TCPConnection*)cp;
-			if (tcp_connection->IsDisconnected()) {
-				DestroyConnection(tcp_connection);
+	{
+		SCOPE_LOCK(&m_ioLock);
+		for (uint i = 0; i < m_connections.size(); ++i) {
+			NetConnection *cp = m_connections[i];
+			if ((cp != nullptr) && (cp != m_myConnection)) {
+				if (cp->IsDisconnected()) {
+					DestroyConnection(cp);
+				}
+				else {
+					++cp->GetSendStats()->ticks;
+				}
 			}
 		}
+
+		// after the dead are gone, so a reused socket handle can't clash in the reactor
+		JoinAcceptedSockets();
+
+		if (!IsIOThreaded())
+			FlushSends();
 	}
 
+	if (IsIOThreaded())
+		m_reactor.Wake();
+
 	if (m_hostConnection == nullptr) {
 		Leave();
 	}
 }
 
+void TCPSession::PumpIO(int timeout_ms)
+{
+	ApplyReactorChanges();
+	m_reactor.Wait(&m_readyEvents, timeout_ms);
+	HandleReadyEvents();
+}
+
+void TCPSession::ApplyReactorChanges()
+{
+	for (tcp_reactor_change_t const &change : m_reactorChanges) {
+		if (change.add) {
+			m_reactor.Add(change.handle, change.user_data, NET_READABLE);
+		}
+		else {
+			m_reactor.Remove(change.handle);
+		}
+	}
+
+	m_reactorChanges.clear();
+}
+
+void TCPSession::HandleReadyEvents()
+{
+	for (net_reactor_event_t const &event : m_readyEvents) {
+		// the wait may have been unlocked - skip anything closed since
+		if (event.user_data == nullptr) {
+			if (m_listenSocket != nullptr) {
+				AcceptSockets();
+			}
+			continue;
+		}
+
+		TCPConnection *tcp = (TCPConnection*)event.user_data;
+		if (std::find(m_watchedConnections.begin(), m_watchedConnections.end(), tcp) == m_watchedConnections.end()) {
+			continue;
+		}
+
+		if ((event.readiness & (NET_READABLE | NET_HANGUP)) && !tcp->m_receivePaused) {
+			// until the socket's empty or the buffer's full of undecoded messages
+			while (tcp->FillReceiveBuffer()) {}
+
+			// readiness is level triggered, a socket left unread would wake us straight back up
+			if (tcp->m_receivePaused) {
+				RefreshInterest(tcp);
+			}
+		}
+
+		if ((event.readiness & NET_WRITABLE) && tcp->FlushSend()) {
+			tcp->m_wantsWritable = false;
+			RefreshInterest(tcp);
+		}
+	}
+
+	m_readyEvents.clear();
+}
+
+void TCPSession::FlushSends()
+{
+	for (TCPConnection *tcp : m_watchedConnections) {
+		// the main thread has decoded enough since reading paused
+		if (tcp->m_receivePaused && (tcp->GetUndecodedSize() < (TCP_MAX_UNDECODED_RECEIVE / 2))) {
+			tcp->m_receivePaused = false;
+			RefreshInterest(tcp);
+			while (tcp->FillReceiveBuffer()) {}
+		}
+
+		if (!tcp->HasPendingSend() || tcp->m_wantsWritable) {
+			continue;
+		}
+
+		// whatever doesn't fit waits for the reactor to say there's room
+		if (!tcp->FlushSend()) {
+			tcp->m_wantsWritable = true;
+			RefreshInterest(tcp);
+		}
+	}
+}
+
+void TCPSession::RefreshInterest(TCPConnection *tcp)
+{
+	uint interest = 0;
+	if (!tcp->m_receivePaused)
+		interest |= NET_READABLE;
+	if (tcp->m_wantsWritable)
+		interest |= NET_WRITABLE;
+
+	m_reactor.SetInterest(tcp->m_reactorHandle, interest);
+}
+
+void TCPSession::AcceptSockets()
+{
+	TCPSocket *socket = m_listenSocket->Accept();
+	while (socket != nullptr) {
+		socket->SetBlocking(false);
+		socket->EnableNagle(false);
+		m_acceptedSockets.push_back(socket);
+
+		socket = m_listenSocket->Accept();
+	}
+}
+
+void TCPSession::JoinAcceptedSockets()
+{
+	for (TCPSocket *socket : m_acceptedSockets) {
+		uint8_t conn_idx = GetFreeConnectionIndex();
+		if (conn_idx == INVALID_CONNECTION_INDEX) {
+			delete socket;
+			continue;
+		}
+
+		TCPConnection *new_guy = new TCPConnection();
+		new_guy->m_socket = socket;
+		new_guy->m_address = socket->m_netAddr;
+		WatchConnection(new_guy);
+
+		NetConnection *new_link = new ConditionedConnection(new_guy);
+		JoinConnection(conn_idx, new_link);
+		SendJoinInfo(new_link);
+	}
+
+	m_acceptedSockets.clear();
+}
+
+void TCPSession::QueueReactorChange(void *handle, void *user_data, bool add)
+{
+	tcp_reactor_change_t change;
+	change.handle = handle;
+	change.user_data = user_data;
+	change.add = add;
+	m_reactorChanges.push_back(change);
+
+	if (IsIOThreaded()) {
+		m_reactor.Wake();
+	}
+}
+
+void TCPSession::WatchConnection(TCPConnection *tcp)
+{
+	SCOPE_LOCK(&m_ioLock);
+	tcp->m_session = this;
+	tcp->m_reactorHandle = tcp->m_socket->m_socket;
+	tcp->m_ioLock = IsIOThreaded() ? &m_ioLock : nullptr;
+
+	QueueReactorChange(tcp->m_reactorHandle, tcp, true);
+	m_watchedConnections.push_back(tcp);
+}
+
+void TCPSession::UnwatchConnection(TCPConnection *tcp)
+{
+	SCOPE_LOCK(&m_ioLock);
+	QueueReactorChange(tcp->m_reactorHandle, tcp, false);
+
+	auto found = std::find(m_watchedConnections.begin(), m_watchedConnections.end(), tcp);
+	if (found != m_watchedConnections.end()) {
+		*found = m_watchedConnections.back();
+		m_watchedConnections.pop_back();
+	}
+
+	tcp->m_session = nullptr;
+	tcp->m_ioLock = nullptr;
+}
+
+void TCPSession::SetIOThreaded(bool threaded)
+{
+	if (threaded == IsIOThreaded()) {
+		return;
+	}
+
+	if (threaded) {
+		for (TCPConnection *tcp : m_watchedConnections) {
+			tcp->m_ioLock = &m_ioLock;
+		}
+
+		m_ioThreadRunning = true;
+		m_ioThread = ThreadCreate(TCPSessionIOThread, this);
+	}
+	else {
+		m_ioThreadRunning = false;
+		m_reactor.Wake();
+		ThreadJoin(m_ioThread);
+		m_ioThread = INVALID_THREAD_HANDLE;
+
+		for (TCPConnection *tcp : m_watchedConnections) {
+			tcp->m_ioLock = nullptr;
+		}
+	}
+}
+
 void TCPSession::ProcessMessage(NetMessage* msg)
 {
 	if (!msg)
@@ -147,10 +373,10 @@ void TCPSession::ProcessMessage(NetMessage* msg)
 
 void TCPSession::SendJoinInfo(NetConnection *cp)
 {
-	NetMessage *msg = new NetMessage(JOIN_RESPONSE);
-	msg->write(cp->m_connectionIndex);
+	NetMessage msg(JOIN_RESPONSE);
+	msg.write(cp->m_connectionIndex);
 
-	cp->Send(msg);
+	cp->Send(&msg);
 }
 
 void TCPSession::OnJoinResponse(NetMessage *msg)
@@ -172,9 +398,11 @@ bool TCPSession::StartListening()
 		return true;
 	}
 
+	SCOPE_LOCK(&m_ioLock);
 	m_listenSocket = new TCPSocket();
 	if (m_listenSocket->Listen(m_myConnection->m_address.port)) {
 		m_listenSocket->SetBlocking(false);
+		QueueReactorChange(m_listenSocket->m_socket, nullptr, true);
 		return true;
 	}
 	else {
@@ -186,7 +414,9 @@ bool TCPSession::StartListening()
 
 void TCPSession::StopListening()
 {
+	SCOPE_LOCK(&m_ioLock);
 	if (IsListening()) {
+		QueueReactorChange(m_listenSocket->m_socket, nullptr, false);
 		delete m_listenSocket;
 		m_listenSocket = nullptr;
 	}
@@ -196,3 +426,132 @@ bool TCPSession::IsListening() const
 {
 	return (nullptr != m_listenSocket);
 }
+
+//------------------------------------------------------------------------
+// Benchmark - one host and a client session per connection, over loopback
+//------------------------------------------------------------------------
+constexpr uint8_t TCP_BENCH_MESSAGE = 0xf2;
+constexpr uint TCP_BENCH_PAYLOAD_SIZE = 32;
+constexpr uint TCP_BENCH_BATCH = 4;		// messages per client per frame
+
+static float TCPBenchPercentile(std::vector<float> const &sorted, float percent)
+{
+	if (sorted.empty()) {
+		return 0.0f;
+	}
+
+	size_t index = (size_t)((sorted.size() - 1) * percent / 100.0f);
+	return sorted[index];
+}
+
+void TCPSessionBenchmark(uint16_t port, uint connection_count, uint messages_per_connection, bool threaded)
+{
+	// the last connection index is INVALID_CONNECTION_INDEX, and the host has 0
+	connection_count = std::min(std::max(connection_count, 1U), (uint)INVALID_CONNECTION_INDEX - 1);
+
+	std::vector<float> latencies_us;
+	latencies_us.reserve(connection_count * messages_per_connection);
+
+	TCPSession host;
+	host.m_maxConnectionCount = connection_count + 1;
+	host.RegisterMessageDefinition(TCP_BENCH_MESSAGE, [&](NetMessage* msg) {
+		double sent_time = 0.0;
+		msg->read<double>(&sent_time);
+		latencies_us.push_back((float)((GetCurrentTimeSeconds() - sent_time) * 1000000.0));
+	});
+
+	host.Host(port);
+	if (!host.IsRunning() || !host.StartListening()) {
+		LogPrint("TCPBench: could not host on port %u", (uint)port);
+		return;
+	}
+	host.SetIOThreaded(threaded);
+
+	std::vector<TCPSession*> clients;
+	for (uint index = 0; index < connection_count; ++index) {
+		TCPSession *client = new TCPSession();
+		client->RegisterMessageDefinition(TCP_BENCH_MESSAGE, [](NetMessage*) {});
+		if (!client->Join(GetMyAddress(port))) {
+			delete client;
+			break;
+		}
+		clients.push_back(client);
+		host.Update();
+	}
+
+	double join_start = GetCurrentTimeSeconds();
+	uint ready_count = 0;
+	while ((ready_count < clients.size()) && ((GetCurrentTimeSeconds() - join_start) < 5.0)) {
+		host.Update();
+		ready_count = 0;
+		for (TCPSession *client : clients) {
+			client->Update();
+			ready_count += client->IsReady() ? 1 : 0;
+		}
+	}
+
+	uint total_messages = ready_count * messages_per_connection;
+	double start_time = GetCurrentTimeSeconds();
+	uint sent = 0;
+	uint frames = 0;
+	while ((latencies_us.size() < total_messages) && ((GetCurrentTimeSeconds() - start_time) < 30.0)) {
+		for (TCPSession *client : clients) {
+			if (!client->IsReady()) {
+				continue;
+			}
+
+			uint client_sent = frames * TCP_BENCH_BATCH;
+			for (uint batch = 0; (batch < TCP_BENCH_BATCH) && (client_sent + batch < messages_per_connection); ++batch) {
+				NetMessage msg(TCP_BENCH_MESSAGE);
+				msg.write<double>(GetCurrentTimeSeconds());
+				byte_t padding[TCP_BENCH_PAYLOAD_SIZE - sizeof(double)] = {};
+				msg.write_bytes(padding, sizeof(padding));
+				client->m_hostConnection->Send(&msg);
+				++sent;
+			}
+			client->Update();
+		}
+
+		host.Update();
+		++frames;
+	}
+	double elapsed = GetCurrentTimeSeconds() - start_time;
+
+	// what a frame costs the host with every connection idle
+	uint const idle_frames = 200;
+	double idle_start = GetCurrentTimeSeconds();
+	for (uint frame = 0; frame < idle_frames; ++frame) {
+		host.Update();
+	}
+	double idle_us = (GetCurrentTimeSeconds() - idle_start) * 1000000.0 / idle_frames;
+
+	std::sort(latencies_us.begin(), latencies_us.end());
+	LogPrint("TCPBench: %u connections (%s io), %u/%u messages in %.3f s = %.0f msgs/sec",
+		ready_count, threaded ? "threaded" : "main thread", (uint)latencies_us.size(), total_messages, elapsed,
+		(elapsed > 0.0) ? ((double)latencies_us.size() / elapsed) : 0.0);
+	LogPrint("TCPBench: latency us p50 %.0f, p99 %.0f, p99.9 %.0f, max %.0f; idle host update %.1f us",
+		TCPBenchPercentile(latencies_us, 50.0f), TCPBenchPercentile(latencies_us, 99.0f),
+		TCPBenchPercentile(latencies_us, 99.9f), TCPBenchPercentile(latencies_us, 100.0f), idle_us);
+
+	for (TCPSession *client : clients) {
+		delete client;
+	}
+	host.SetIOThreaded(false);
+}
+
+// TCPBench [connections] [messages_per_connection] [threaded] [port]
+void TCPSessionBenchmarkCmd(void* data)
+{
+	arguments args = *(arguments*)data;
+	uint connection_count = (args.arg_list.size() > 0) ? (uint)atoi(args.arg_list[0].c_str()) : 64;
+	uint message_count = (args.arg_list.size() > 1) ? (uint)atoi(args.arg_list[1].c_str()) : 1000;
+	bool threaded = (args.arg_list.size() > 2) && (atoi(args.arg_list[2].c_str()) != 0);
+	uint16_t port = (args.arg_list.size() > 3) ? (uint16_t)atoi(args.arg_list[3].c_str()) : 8930;
+	TCPSessionBenchmark(port, connection_count, message_count, threaded);
+	g_console->ConsolePrintf(Rgba(255, 255, 255, 255), "TCPBench finished, results are in the log", "");
+}
+
+void RegisterTCPSessionCommands()
+{
+	g_console->RegisterCommand("TCPBench", TCPSessionBenchmarkCmd);
+}
@@ -1,7 +1,27 @@
 #pragma  once
 #include "Engine/Network/NetSession.hpp"
+#include "Engine/Network/NetReactor.hpp"
+#include "Engine/Core/CriticalSection.hpp"
+#include <atomic>
 
 class TCPSocket;
+class TCPConnection;
+
+constexpr uint TCP_IO_THREAD_WAIT_MS = 100;		// io thread blocks in the reactor this long at most, only bounds how long stopping takes
+
+// Sockets are only touched when the reactor says they're ready: the listen
+// socket accepts everything queued, readable connections recv into their
+// receive buffers, and queued sends go out once per connection per flush.
+// With an io thread all of that happens off the main thread, and Update just
+// decodes and dispatches what has arrived.  The io thread sleeps in the
+// reactor and is woken through it for sends, so only the thread pumping the
+// reactor ever touches it - everyone else queues their adds and removes.
+struct tcp_reactor_change_t
+{
+	void *handle;
+	void *user_data;
+	bool add;
+};
 
 class TCPSession : public NetSession
 {
@@ -30,6 +50,39 @@ public:
 	bool StartListening();
 	void StopListening();
 	bool IsListening() const;
+
+	void SetIOThreaded(bool threaded);
+	inline bool IsIOThreaded() const { return m_ioThread != INVALID_THREAD_HANDLE; }
+
+	// reactor bookkeeping for TCPConnection
+	void WatchConnection(TCPConnection *tcp);
+	void UnwatchConnection(TCPConnection *tcp);
+
+	// hold m_ioLock when there's an io thread
+	void PumpIO(int timeout_ms);
+	void ApplyReactorChanges();
+	void HandleReadyEvents();
+	void FlushSends();
+
+private:
+	void QueueReactorChange(void *handle, void *user_data, bool add);
+	void RefreshInterest(TCPConnection *tcp);
+	void AcceptSockets();
+	void JoinAcceptedSockets();
+
 public:
 	TCPSocket* m_listenSocket;
-};
\ No newline at end of file
+
+	NetReactor m_reactor;
+	std::vector<net_reactor_event_t> m_readyEvents;
+	std::vector<TCPConnection*> m_watchedConnections;
+	std::vector<TCPSocket*> m_acceptedSockets;	// accepted, waiting for the main thread to join them
+	std::vector<tcp_reactor_change_t> m_reactorChanges;	// applied by whoever pumps the reactor next
+
+	CriticalSection m_ioLock;
+	thread_handle m_ioThread;
+	std::atomic<bool> m_ioThreadRunning;
+};
+
+void TCPSessionBenchmark(uint16_t port, uint connection_count, uint messages_per_connection, bool threaded);
+void RegisterTCPSessionCommands();
@@ -113,8 +113,8 @@ bool TCPSocket::Listen(uint16_t port)
 		return false;
 	}
 
-	// max line to be accepted
-	int max_queued = 8;
+	// max line to be accepted - connections wait here until the session accepts them
+	int max_queued = SOMAXCONN;
 	result = ::listen(listen_socket, (int)max_queued);
 	if (result == SOCKET_ERROR)
 	{
@@ -223,13 +223,19 @@ uint TCPSocket::Send(const void* payload, uint size_bytes)
 
 	if (byte_sent <= 0)
 	{
+		// a full send buffer on a non-blocking socket isn't an error, try again later
 		int error_val = WSAGetLastError();
+		if (error_val == WSAEWOULDBLOCK)
+		{
+			return 0;
+		}
+
 		LogPrint("Socket failed with error: %u", error_val);
 		Close();
 		return 0;
 	}
 
-	ASSERT_OR_DIE((uint)byte_sent == size_bytes, "Bytes sent to socket do not match!");
+	// non-blocking sockets can take part of it, the caller keeps the rest
 	return byte_sent;
 }
 
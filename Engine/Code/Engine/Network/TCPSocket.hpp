@@ -24,6 +24,7 @@ public:
 	TCPSocket* Accept();
 
 	//BOTH
+	// bytes actually sent, may be short (or 0) on a non-blocking socket
 	uint Send(const void* payload, uint size_bytes);
 	uint Receive(void* payload, uint max_size);
 	void SetBlocking(bool blocking);
@@ -0,0 +1,456 @@
+#include "Engine/Network/UDPConnection.hpp"
+#include "Engine/Network/UDPSession.hpp"
+#include "Engine/Network/NetMessage.hpp"
+#include "Engine/Network/NetMessageDefinition.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/Time.hpp"
+#include <string.h>
+
+static void PacketWrite(byte_t *packet, uint *used, void const *data, uint size)
+{
+	if (size > 0) {
+		memcpy(packet + *used, data, size);
+	}
+	*used += size;
+}
+
+static bool PacketRead(byte_t const *packet, uint size, uint *cursor, void *out, uint out_size)
+{
+	if (*cursor + out_size > size) {
+		return false;
+	}
+
+	memcpy(out, packet + *cursor, out_size);
+	*cursor += out_size;
+	return true;
+}
+
+UDPConnection::UDPConnection(UDPSession* session, net_address_t const &addr)
+	:m_session(session)
+	, m_nextSequence(0)
+	, m_nextReliableID(0)
+	, m_lastSendTime(0.0)
+	, m_ackPending(false)
+	, m_hasReceived(false)
+	, m_remoteAck(0)
+	, m_remoteAckBits(0)
+	, m_nextExpectedReliableID(0)
+	, m_lastReceiveTime(GetCurrentTimeSeconds())
+	, m_roundTripTime(0.0)
+	, m_packetsSent(0)
+	, m_packetsReceived(0)
+	, m_packetsAcked(0)
+	, m_reliablesResent(0)
+{
+	m_address = addr;
+	m_owner = session;
+	m_connectionIndex = INVALID_CONNECTION_INDEX;
+
+	memset(m_sentPackets, 0, sizeof(m_sentPackets));
+	memset(m_reliableBuffer, 0, sizeof(m_reliableBuffer));
+}
+
+UDPConnection::~UDPConnection()
+{
+	for (udp_reliable_t &reliable : m_reliables) {
+		delete reliable.message;
+	}
+	m_reliables.clear();
+
+	for (NetMessage *msg : m_unreliables) {
+		delete msg;
+	}
+	m_unreliables.clear();
+
+	for (uint index = 0; index < UDP_RELIABLE_WINDOW; ++index) {
+		delete m_reliableBuffer[index];
+		m_reliableBuffer[index] = nullptr;
+	}
+
+	while (!m_received.empty()) {
+		delete m_received.front();
+		m_received.pop();
+	}
+}
+
+bool UDPConnection::IsReliable(NetMessage const *msg) const
+{
+	// anything the session doesn't know about errs on the safe side
+	NetMessageDefinition *defn = m_session->GetMessageDefinition(msg->m_messageTypeIndex);
+	return (defn == nullptr) || (defn->m_channel == NET_CHANNEL_RELIABLE_ORDERED);
+}
+
+void UDPConnection::Send(NetMessage *msg)
+{
+	// messages don't span datagrams
+	if (msg->m_payloadBytesUsed > UDP_MESSAGE_MAX_PAYLOAD) {
+		ASSERT_RECOVERABLE(false, "NetMessage too big for a UDP packet, dropping!");
+		return;
+	}
+
+	++m_sendStats.messages;
+	if (IsReliable(msg)) {
+		udp_reliable_t reliable;
+		reliable.message = new NetMessage(*msg);
+		reliable.reliable_id = m_nextReliableID++;
+		reliable.last_send_time = -1.0;
+		m_reliables.push_back(reliable);
+	}
+	else {
+		m_unreliables.push_back(new NetMessage(*msg));
+	}
+}
+
+bool UDPConnection::Receive(NetMessage **msg)
+{
+	if (m_received.empty())
+		return false;
+
+	*msg = m_received.front();
+	m_received.pop();
+	return true;
+}
+
+bool UDPConnection::MarkSequenceReceived(uint16_t sequence, bool *out_is_newest)
+{
+	*out_is_newest = false;
+
+	if (!m_hasReceived) {
+		m_hasReceived = true;
+		m_remoteAck = sequence;
+		m_remoteAckBits = 0;
+		*out_is_newest = true;
+		return true;
+	}
+
+	if (UDPSequenceGreaterThan(sequence, m_remoteAck)) {
+		uint16_t diff = sequence - m_remoteAck;
+		if (diff > 32) {
+			m_remoteAckBits = 0;
+		}
+		else {
+			// the old ack becomes bit (diff - 1)
+			m_remoteAckBits = ((diff < 32) ? (m_remoteAckBits << diff) : 0) | (1U << (diff - 1));
+		}
+
+		m_remoteAck = sequence;
+		*out_is_newest = true;
+		return true;
+	}
+
+	if (sequence == m_remoteAck) {
+		return false;
+	}
+
+	uint16_t diff = m_remoteAck - sequence;
+	if (diff > 32) {
+		return false;
+	}
+
+	uint32_t bit = 1U << (diff - 1);
+	if ((m_remoteAckBits & bit) != 0) {
+		return false;
+	}
+
+	m_remoteAckBits |= bit;
+	return true;
+}
+
+void UDPConnection::ReceiveAck(uint16_t ack, uint32_t ack_bits)
+{
+	AckPacket(ack);
+	for (uint bit = 0; bit < 32; ++bit) {
+		if ((ack_bits & (1U << bit)) != 0) {
+			AckPacket((uint16_t)(ack - 1 - bit));
+		}
+	}
+}
+
+void UDPConnection::AckPacket(uint16_t sequence)
+{
+	udp_sent_packet_t &packet = m_sentPackets[sequence % UDP_SENT_PACKET_HISTORY];
+	if (!packet.is_valid || (packet.sequence != sequence)) {
+		return;
+	}
+
+	packet.is_valid = false;
+	++m_packetsAcked;
+
+	double rtt = GetCurrentTimeSeconds() - packet.send_time;
+	m_roundTripTime = (m_roundTripTime <= 0.0) ? rtt : (m_roundTripTime * 0.9 + rtt * 0.1);
+
+	for (uint index = 0; index < packet.reliable_count; ++index) {
+		RemoveReliable(packet.reliable_ids[index]);
+	}
+}
+
+void UDPConnection::RemoveReliable(uint16_t reliable_id)
+{
+	for (uint index = 0; index < m_reliables.size(); ++index) {
+		if (m_reliables[index].reliable_id == reliable_id) {
+			delete m_reliables[index].message;
+			m_reliables.erase(m_reliables.begin() + index);
+			return;
+		}
+	}
+}
+
+void UDPConnection::ReceiveReliable(uint16_t reliable_id, NetMessage *msg)
+{
+	int16_t diff = (int16_t)(reliable_id - m_nextExpectedReliableID);
+	if ((diff < 0) || (diff >= (int16_t)UDP_RELIABLE_WINDOW)) {
+		// already delivered
+		delete msg;
+		return;
+	}
+
+	if (diff > 0) {
+		NetMessage *&slot = m_reliableBuffer[reliable_id % UDP_RELIABLE_WINDOW];
+		if (slot != nullptr) {
+			delete msg;
+		}
+		else {
+			slot = msg;
+		}
+		return;
+	}
+
+	m_received.push(msg);
+	++m_nextExpectedReliableID;
+
+	// release whatever was waiting on this one
+	while (true) {
+		NetMessage *&slot = m_reliableBuffer[m_nextExpectedReliableID % UDP_RELIABLE_WINDOW];
+		if (slot == nullptr) {
+			break;
+		}
+
+		m_received.push(slot);
+		slot = nullptr;
+		++m_nextExpectedReliableID;
+	}
+}
+
+void UDPConnection::ProcessPacket(net_message_buffer_t *datagram, uint size)
+{
+	byte_t const *packet = datagram->data;
+	uint cursor = 0;
+
+	uint16_t sequence;
+	uint16_t ack;
+	uint32_t ack_bits;
+	uint8_t message_count;
+	if (!PacketRead(packet, size, &cursor, &sequence, sizeof(sequence))
+		|| !PacketRead(packet, size, &cursor, &ack, sizeof(ack))
+		|| !PacketRead(packet, size, &cursor, &ack_bits, sizeof(ack_bits))
+		|| !PacketRead(packet, size, &cursor, &message_count, sizeof(message_count))) {
+		return;
+	}
+
+	bool is_newest;
+	if (!MarkSequenceReceived(sequence, &is_newest)) {
+		return;
+	}
+
+	++m_packetsReceived;
+	m_lastReceiveTime = GetCurrentTimeSeconds();
+	ReceiveAck(ack, ack_bits);
+
+	// acking an ack or a heartbeat would have idle peers trading empty packets every frame
+	if (message_count > 0) {
+		m_ackPending = true;
+	}
+
+	for (uint index = 0; index < message_count; ++index) {
+		uint16_t length;
+		uint8_t type;
+		if (!PacketRead(packet, size, &cursor, &length, sizeof(length))) {
+			return;
+		}
+
+		bool is_reliable = (length & UDP_MESSAGE_RELIABLE_BIT) != 0;
+		length &= ~UDP_MESSAGE_RELIABLE_BIT;
+
+		uint header_size = sizeof(type) + (is_reliable ? sizeof(uint16_t) : 0);
+		if ((length < header_size) || (cursor + length > size)) {
+			return;
+		}
+
+		uint end = cursor + length;
+		uint16_t reliable_id = 0;
+		PacketRead(packet, size, &cursor, &type, sizeof(type));
+		if (is_reliable) {
+			PacketRead(packet, size, &cursor, &reliable_id, sizeof(reliable_id));
+		}
+
+		// an older snapshot than one we already have is no use
+		if (!is_reliable && !is_newest) {
+			cursor = end;
+			continue;
+		}
+
+		// a view into the datagram, which lives until its last message does
+		NetMessage *msg = new NetMessage(type, datagram, cursor, end - cursor);
+		msg->m_sender = this;
+		cursor = end;
+
+		if (is_reliable) {
+			ReceiveReliable(reliable_id, msg);
+		}
+		else {
+			m_received.push(msg);
+		}
+	}
+}
+
+uint16_t UDPConnection::GetOldestUnackedReliableID() const
+{
+	return m_reliables.empty() ? m_nextReliableID : m_reliables.front().reliable_id;
+}
+
+bool UDPConnection::IsReliableDueForSend(udp_reliable_t const &reliable, double now) const
+{
+	if (reliable.last_send_time < 0.0) {
+		return true;
+	}
+
+	// no rtt sample yet - be patient rather than flood
+	double resend_time = (m_roundTripTime > 0.0) ? (m_roundTripTime * 1.5) : 0.2;
+	if (resend_time < UDP_MIN_RESEND_SECONDS) {
+		resend_time = UDP_MIN_RESEND_SECONDS;
+	}
+
+	return (now - reliable.last_send_time) >= resend_time;
+}
+
+void UDPConnection::Flush()
+{
+	double now = GetCurrentTimeSeconds();
+	uint16_t oldest_reliable = GetOldestUnackedReliableID();
+	uint reliable_cursor = 0;
+	uint unreliable_cursor = 0;
+
+	while (true) {
+		byte_t packet[UDP_PACKET_MTU];
+		uint used = UDP_PACKET_HEADER_SIZE;
+		uint8_t message_count = 0;
+
+		udp_sent_packet_t record;
+		record.sequence = m_nextSequence;
+		record.is_valid = true;
+		record.send_time = now;
+		record.reliable_count = 0;
+
+		// reliables first, oldest first, resends mixed in with new ones
+		while ((reliable_cursor < m_reliables.size()) && (record.reliable_count < UDP_MAX_RELIABLES_PER_PACKET) && (message_count < 0xff)) {
+			udp_reliable_t &reliable = m_reliables[reliable_cursor];
+			if ((uint16_t)(reliable.reliable_id - oldest_reliable) >= UDP_RELIABLE_WINDOW) {
+				// the rest are newer still, they wait for acks
+				reliable_cursor = (uint)m_reliables.size();
+				break;
+			}
+
+			if (!IsReliableDueForSend(reliable, now)) {
+				++reliable_cursor;
+				continue;
+			}
+
+			NetMessage *msg = reliable.message;
+			uint16_t length = (uint16_t)(sizeof(uint8_t) + sizeof(uint16_t) + msg->m_payloadBytesUsed);
+			if (used + sizeof(length) + length > UDP_PACKET_MTU) {
+				break;
+			}
+
+			uint16_t length_field = length | UDP_MESSAGE_RELIABLE_BIT;
+			PacketWrite(packet, &used, &length_field, sizeof(length_field));
+			PacketWrite(packet, &used, &msg->m_messageTypeIndex, sizeof(uint8_t));
+			PacketWrite(packet, &used, &reliable.reliable_id, sizeof(uint16_t));
+			PacketWrite(packet, &used, msg->GetPayload(), msg->m_payloadBytesUsed);
+
+			if (reliable.last_send_time >= 0.0) {
+				++m_reliablesResent;
+			}
+			reliable.last_send_time = now;
+			record.reliable_ids[record.reliable_count++] = reliable.reliable_id;
+			++message_count;
+			++reliable_cursor;
+		}
+
+		while ((unreliable_cursor < m_unreliables.size()) && (message_count < 0xff)) {
+			NetMessage *msg = m_unreliables[unreliable_cursor];
+			uint16_t length = (uint16_t)(sizeof(uint8_t) + msg->m_payloadBytesUsed);
+			if (used + sizeof(length) + length > UDP_PACKET_MTU) {
+				break;
+			}
+
+			PacketWrite(packet, &used, &length, sizeof(length));
+			PacketWrite(packet, &used, &msg->m_messageTypeIndex, sizeof(uint8_t));
+			PacketWrite(packet, &used, msg->GetPayload(), msg->m_payloadBytesUsed);
+			++message_count;
+			++unreliable_cursor;
+		}
+
+		// empty packets only go out to carry acks or keep the connection alive
+		bool needs_heartbeat = m_ackPending || ((now - m_lastSendTime) >= UDP_HEARTBEAT_SECONDS);
+		if ((message_count == 0) && !needs_heartbeat) {
+			break;
+		}
+
+		uint header_used = 0;
+		PacketWrite(packet, &header_used, &m_nextSequence, sizeof(m_nextSequence));
+		PacketWrite(packet, &header_used, &m_remoteAck, sizeof(m_remoteAck));
+		PacketWrite(packet, &header_used, &m_remoteAckBits, sizeof(m_remoteAckBits));
+		PacketWrite(packet, &header_used, &message_count, sizeof(message_count));
+
+		m_sentPackets[m_nextSequence % UDP_SENT_PACKET_HISTORY] = record;
+		SendDatagram(packet, used, now);
+
+		++m_nextSequence;
+		++m_packetsSent;
+		m_lastSendTime = now;
+		m_ackPending = false;
+
+		if ((message_count == 0)
+			|| ((reliable_cursor >= m_reliables.size()) && (unreliable_cursor >= m_unreliables.size()))) {
+			break;
+		}
+	}
+
+	// unreliables get one shot
+	for (NetMessage *msg : m_unreliables) {
+		delete msg;
+	}
+	m_unreliables.clear();
+
+	ReleaseConditionedDatagrams(now);
+}
+
+// whole datagrams are conditioned, so loss and reordering hit the reliability
+// layer exactly like a real link would
+void UDPConnection::SendDatagram(void const *data, uint size, double now)
+{
+	if (m_linkConditioner.IsActive()) {
+		m_linkConditioner.Submit(data, size, now);
+	}
+	else {
+		m_session->SendPacket(m_address, data, size);
+		++m_sendStats.socket_sends;
+		m_sendStats.bytes_sent += size;
+	}
+}
+
+void UDPConnection::ReleaseConditionedDatagrams(double now)
+{
+	byte_t packet[UDP_PACKET_MTU];
+	uint size;
+	while ((size = m_linkConditioner.Pop(now, packet, UDP_PACKET_MTU)) > 0) {
+		m_session->SendPacket(m_address, packet, size);
+		++m_sendStats.socket_sends;
+		m_sendStats.bytes_sent += size;
+	}
+}
+
+bool UDPConnection::IsDisconnected() const
+{
+	return (GetCurrentTimeSeconds() - m_lastReceiveTime) > UDP_CONNECTION_TIMEOUT_SECONDS;
+}
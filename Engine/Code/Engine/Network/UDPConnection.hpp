@@ -0,0 +1,110 @@
+#pragma once
+#include "Engine/Network/NetConnection.hpp"
+#include "Engine/Network/NetLinkConditioner.hpp"
+#include <vector>
+#include <queue>
+
+class UDPSession;
+struct net_message_buffer_t;
+
+// Every datagram carries a packet header, then the messages packed into it.
+//   header:  uint16 sequence, uint16 ack, uint32 ack_bits, uint8 message_count
+//   message: uint16 length (high bit set when reliable), uint8 type,
+//            [uint16 reliable id], payload
+// ack is the newest sequence we've heard, bit n of ack_bits is (ack - 1 - n).
+constexpr uint UDP_PACKET_MTU = 1232;
+constexpr uint UDP_PACKET_HEADER_SIZE = 9;
+constexpr uint UDP_MESSAGE_HEADER_SIZE = 3;
+constexpr uint16_t UDP_MESSAGE_RELIABLE_BIT = 0x8000;
+constexpr uint UDP_MESSAGE_MAX_PAYLOAD = UDP_PACKET_MTU - UDP_PACKET_HEADER_SIZE - UDP_MESSAGE_HEADER_SIZE - sizeof(uint16_t);
+
+constexpr uint UDP_SENT_PACKET_HISTORY = 256;		// sent packets we can still match acks to
+constexpr uint UDP_MAX_RELIABLES_PER_PACKET = 32;
+constexpr uint16_t UDP_RELIABLE_WINDOW = 128;		// reliables in flight before new ones wait
+
+constexpr double UDP_HEARTBEAT_SECONDS = 0.1;
+constexpr double UDP_MIN_RESEND_SECONDS = 0.05;
+constexpr double UDP_CONNECTION_TIMEOUT_SECONDS = 10.0;
+
+struct udp_sent_packet_t
+{
+	uint16_t sequence;
+	bool is_valid;
+	double send_time;
+	uint reliable_count;
+	uint16_t reliable_ids[UDP_MAX_RELIABLES_PER_PACKET];
+};
+
+struct udp_reliable_t
+{
+	NetMessage* message;
+	uint16_t reliable_id;
+	double last_send_time; // negative until first sent
+};
+
+// sequence math that survives wrapping
+inline bool UDPSequenceGreaterThan(uint16_t a, uint16_t b)
+{
+	return (int16_t)(a - b) > 0;
+}
+
+class UDPConnection : public NetConnection
+{
+public:
+	UDPConnection(UDPSession* session, net_address_t const &addr);
+	virtual ~UDPConnection();
+
+	// Send copies the message into the channel its definition asks for
+	virtual void Send(NetMessage *msg) override;
+	virtual bool Receive(NetMessage **msg) override;
+
+	// unpacks a datagram from this connection's address, messages share its buffer
+	void ProcessPacket(net_message_buffer_t *datagram, uint size);
+
+	// packs everything queued into as few datagrams as fit
+	void Flush();
+
+	virtual bool IsDisconnected() const override;
+	inline double GetRoundTripTime() const { return m_roundTripTime; }
+
+private:
+	bool IsReliable(NetMessage const *msg) const;
+	void ReceiveAck(uint16_t ack, uint32_t ack_bits);
+	void AckPacket(uint16_t sequence);
+	void RemoveReliable(uint16_t reliable_id);
+	bool MarkSequenceReceived(uint16_t sequence, bool *out_is_newest);
+	void ReceiveReliable(uint16_t reliable_id, NetMessage *msg);
+	uint16_t GetOldestUnackedReliableID() const;
+	bool IsReliableDueForSend(udp_reliable_t const &reliable, double now) const;
+	void SendDatagram(void const *data, uint size, double now);
+	void ReleaseConditionedDatagrams(double now);
+
+public:
+	UDPSession* m_session;
+
+	// sending
+	uint16_t m_nextSequence;
+	uint16_t m_nextReliableID;
+	udp_sent_packet_t m_sentPackets[UDP_SENT_PACKET_HISTORY];
+	std::vector<udp_reliable_t> m_reliables;		// oldest first, unacked and unsent
+	std::vector<NetMessage*> m_unreliables;
+	double m_lastSendTime;
+	bool m_ackPending;
+	NetLinkConditioner m_linkConditioner;	// simulated lag, off unless NetLink settings say so
+
+	// receiving
+	bool m_hasReceived;
+	uint16_t m_remoteAck;
+	uint32_t m_remoteAckBits;
+	uint16_t m_nextExpectedReliableID;
+	NetMessage* m_reliableBuffer[UDP_RELIABLE_WINDOW];	// out of order arrivals, by id
+	std::queue<NetMessage*> m_received;
+	double m_lastReceiveTime;
+
+	// stats
+	double m_roundTripTime;
+	uint m_packetsSent;
+	uint m_packetsReceived;
+	uint m_packetsAcked;
+	uint m_reliablesResent;
+};
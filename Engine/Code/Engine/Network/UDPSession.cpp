@@ -0,0 +1,378 @@
+#include "Engine/Network/UDPSession.hpp"
+#include "Engine/Network/UDPConnection.hpp"
+#include "Engine/Network/UDPSocket.hpp"
+#include "Engine/Network/LoopBackConnection.hpp"
+#include "Engine/Network/NetMessage.hpp"
+#include "Engine/Network/NetMessageDefinition.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/Logging.hpp"
+#include "Engine/Core/Time.hpp"
+#include "Engine/EngineConfig.hpp"
+
+UDPSession::UDPSession()
+	:m_socket(nullptr)
+	, m_isListening(false)
+	, m_joinStartTime(0.0)
+{
+	m_state = SESSION_DISCONNECTED;
+	RegisterMessageDefinition((uint8_t)JOIN_REQUEST, [=](NetMessage* msg) {this->OnJoinRequest(msg); });
+	RegisterMessageDefinition((uint8_t)JOIN_RESPONSE, [=](NetMessage* msg) {this->OnJoinResponse(msg); });
+}
+
+UDPSession::~UDPSession()
+{
+	Leave();
+}
+
+void UDPSession::Host(uint16_t port)
+{
+	ASSERT_OR_DIE(!IsRunning(), "Connection is already Running!");
+
+	m_socket = new UDPSocket();
+	if (!m_socket->Bind(port)) {
+		delete m_socket;
+		m_socket = nullptr;
+		return;
+	}
+	m_socket->SetBlocking(false);
+
+	m_myConnection = new LoopBackConnection();
+	m_myConnection->m_address = m_socket->m_netAddr;
+
+	JoinConnection(0, m_myConnection);
+	m_hostConnection = m_myConnection;
+
+	SetState(SESSION_CONNECTED);
+}
+
+bool UDPSession::Join(net_address_t const &addr)
+{
+	if (m_connections.size() == m_maxConnectionCount)
+		return false;
+
+	// nothing to wait for if the host would be us and the port is free
+	if (addr.address == GetMyAddress(addr.port).address) {
+		UDPSocket probe;
+		if (probe.Bind(addr.port)) {
+			return false;
+		}
+	}
+
+	m_socket = new UDPSocket();
+	if (!m_socket->Bind(0)) {
+		delete m_socket;
+		m_socket = nullptr;
+		return false;
+	}
+	m_socket->SetBlocking(false);
+
+	UDPConnection *host = new UDPConnection(this, addr);
+	JoinConnection(0, host); // 0 for this class; 
+	m_hostConnection = host;
+
+	m_myConnection = new LoopBackConnection();
+	m_myConnection->m_address = m_socket->m_netAddr;
+
+	// reliable, so it gets resent until the host hears it
+	NetMessage request(JOIN_REQUEST);
+	host->Send(&request);
+
+	m_joinStartTime = GetCurrentTimeSeconds();
+	SetState(SESSION_CONNECTING);
+	return true;
+}
+
+void UDPSession::Leave()
+{
+	DestroyConnection(m_myConnection);
+	DestroyConnection(m_hostConnection);
+
+	for (uint i = 0; i < m_connections.size(); ++i) {
+		DestroyConnection(m_connections[i]);
+	}
+
+	StopListening();
+
+	delete m_socket;
+	m_socket = nullptr;
+
+	SetState(SESSION_DISCONNECTED);
+}
+
+void UDPSession::Update()
+{
+	if (m_socket == nullptr) {
+		return;
+	}
+
+	ReceivePackets();
+
+	for (uint index = 0; index < m_connections.size(); ++index)
+	{
+		if (m_connections[index] == nullptr)
+			continue;
+
+		NetMessage* msg = nullptr;
+		while (m_connections[index]->Receive(&msg))
+		{
+			msg->m_sender = m_connections[index];
+			ProcessMessage(msg);
+			delete msg;
+			msg = nullptr;
+
+			if (!m_connections[index])
+				break;
+		}
+	}
+
+	for (uint i = 0; i < m_connections.size(); ++i) {
+		NetConnection *cp = m_connections[i];
+		if ((cp != nullptr) && (cp != m_myConnection)) {
+			UDPConnection *udp_connection = (UDPConnection*)cp;
+			if (udp_connection->IsDisconnected()) {
+				DestroyConnection(udp_connection);
+			}
+			else {
+				udp_connection->Flush();
+				++udp_connection->m_sendStats.ticks;
+			}
+		}
+	}
+
+	if ((m_state == SESSION_CONNECTING) && ((GetCurrentTimeSeconds() - m_joinStartTime) > UDP_JOIN_TIMEOUT_SECONDS)) {
+		Leave();
+		return;
+	}
+
+	if (m_hostConnection == nullptr) {
+		Leave();
+	}
+}
+
+void UDPSession::ProcessMessage(NetMessage* msg)
+{
+	if (!msg)
+		return;
+
+	NetMessageDefinition* def = GetMessageDefinition(msg->m_messageTypeIndex);
+	if (def)
+		def->m_handler(msg);
+}
+
+bool UDPSession::StartListening()
+{
+	if (!AmIHost()) {
+		return false;
+	}
+
+	m_isListening = true;
+	return true;
+}
+
+void UDPSession::StopListening()
+{
+	m_isListening = false;
+}
+
+bool UDPSession::IsListening() const
+{
+	return m_isListening;
+}
+
+void UDPSession::SendPacket(net_address_t const &addr, void const *data, uint size)
+{
+	if (m_socket != nullptr) {
+		m_socket->SendTo(addr, data, size);
+	}
+}
+
+UDPConnection* UDPSession::FindConnection(net_address_t const &addr) const
+{
+	for (NetConnection *cp : m_connections) {
+		if ((cp == nullptr) || (cp == m_myConnection)) {
+			continue;
+		}
+
+		if ((cp->m_address.address == addr.address) && (cp->m_address.port == addr.port)) {
+			return (UDPConnection*)cp;
+		}
+	}
+
+	return nullptr;
+}
+
+void UDPSession::ReceivePackets()
+{
+	net_address_t from;
+
+	// each datagram gets a pooled buffer that its messages point into
+	while (true) {
+		net_message_buffer_t *datagram = NetMessageBufferAcquire(UDP_PACKET_MTU);
+		uint size = m_socket->ReceiveFrom(&from, datagram->data, UDP_PACKET_MTU);
+		if (size == 0) {
+			NetMessageBufferRelease(datagram);
+			break;
+		}
+
+		UDPConnection *cp = FindConnection(from);
+		if (cp != nullptr) {
+			cp->ProcessPacket(datagram, size);
+		}
+		else if (AmIHost() && IsListening()) {
+			AcceptConnection(from, datagram, size);
+		}
+
+		NetMessageBufferRelease(datagram);
+	}
+}
+
+void UDPSession::AcceptConnection(net_address_t const &addr, net_message_buffer_t *datagram, uint size)
+{
+	// strangers only get in with a join request, which is always a client's first message
+	uint const type_offset = UDP_PACKET_HEADER_SIZE + sizeof(uint16_t);
+	if ((size <= type_offset) || (datagram->data[type_offset] != JOIN_REQUEST)) {
+		return;
+	}
+
+	uint8_t conn_idx = GetFreeConnectionIndex();
+	if (conn_idx == INVALID_CONNECTION_INDEX) {
+		return;
+	}
+
+	UDPConnection *new_guy = new UDPConnection(this, addr);
+	JoinConnection(conn_idx, new_guy);
+	new_guy->ProcessPacket(datagram, size);
+}
+
+void UDPSession::SendJoinInfo(NetConnection *cp)
+{
+	NetMessage msg(JOIN_RESPONSE);
+	msg.write(cp->m_connectionIndex);
+
+	cp->Send(&msg);
+}
+
+void UDPSession::OnJoinRequest(NetMessage *msg)
+{
+	if (AmIHost()) {
+		SendJoinInfo(msg->m_sender);
+	}
+}
+
+void UDPSession::OnJoinResponse(NetMessage *msg)
+{
+	if (m_state != SESSION_CONNECTING) {
+		return;
+	}
+
+	uint8_t my_conn_index;
+	msg->read<uint8_t>(&my_conn_index);
+
+	JoinConnection(my_conn_index, m_myConnection);
+	SetState(SESSION_CONNECTED);
+}
+
+//------------------------------------------------------------------------
+// Self test - a host and a client in this process, talking over loopback
+//------------------------------------------------------------------------
+constexpr uint8_t UDP_TEST_RELIABLE = 0xf0;
+constexpr uint8_t UDP_TEST_UNRELIABLE = 0xf1;
+
+struct udp_test_stats_t
+{
+	uint reliable_received;
+	uint reliable_out_of_order;
+	uint unreliable_received;
+};
+
+void UDPSessionTest(uint16_t port, uint message_count)
+{
+	udp_test_stats_t stats = { 0, 0, 0 };
+
+	UDPSession host;
+	UDPSession client;
+	host.RegisterMessageDefinition(UDP_TEST_RELIABLE, [&](NetMessage* msg) {
+		uint value = 0;
+		msg->read<uint>(&value);
+		if (value != stats.reliable_received) {
+			++stats.reliable_out_of_order;
+		}
+		++stats.reliable_received;
+	});
+	host.RegisterMessageDefinition(UDP_TEST_UNRELIABLE, [&](NetMessage*) { ++stats.unreliable_received; }, NET_CHANNEL_UNRELIABLE);
+	client.RegisterMessageDefinition(UDP_TEST_RELIABLE, [](NetMessage*) {});
+	client.RegisterMessageDefinition(UDP_TEST_UNRELIABLE, [](NetMessage*) {}, NET_CHANNEL_UNRELIABLE);
+
+	host.Host(port);
+	if (!host.IsRunning() || !host.StartListening()) {
+		LogPrint("UDPSessionTest: could not host on port %u", (uint)port);
+		return;
+	}
+
+	double start_time = GetCurrentTimeSeconds();
+	if (!client.Join(GetMyAddress(port))) {
+		LogPrint("UDPSessionTest: could not join port %u", (uint)port);
+		return;
+	}
+
+	while (!client.IsReady() && ((GetCurrentTimeSeconds() - start_time) < 2.0)) {
+		client.Update();
+		host.Update();
+	}
+
+	if (!client.IsReady()) {
+		LogPrint("UDPSessionTest: join timed out");
+		return;
+	}
+
+	// a batch per "frame", so several messages share each datagram
+	uint sent = 0;
+	while (sent < message_count) {
+		for (uint batch = 0; (batch < 32) && (sent < message_count); ++batch, ++sent) {
+			NetMessage reliable(UDP_TEST_RELIABLE);
+			reliable.write<uint>(sent);
+			client.m_hostConnection->Send(&reliable);
+
+			NetMessage unreliable(UDP_TEST_UNRELIABLE);
+			unreliable.write<uint>(sent);
+			client.m_hostConnection->Send(&unreliable);
+		}
+
+		client.Update();
+		host.Update();
+	}
+
+	while ((stats.reliable_received < message_count) && ((GetCurrentTimeSeconds() - start_time) < 10.0)) {
+		client.Update();
+		host.Update();
+	}
+
+	UDPConnection *link = (UDPConnection*)client.m_hostConnection;
+	LogPrint("UDPSessionTest: %u/%u reliable (%u out of order), %u/%u unreliable, %u packets sent, %u acked, %u resends, rtt %.3f ms",
+		stats.reliable_received, message_count, stats.reliable_out_of_order,
+		stats.unreliable_received, message_count,
+		link->m_packetsSent, link->m_packetsAcked, link->m_reliablesResent, link->GetRoundTripTime() * 1000.0);
+
+	// NetLink* settings apply here too, so the same run can be repeated against a bad link
+	net_link_stats_t const &conditioned = link->m_linkConditioner.m_stats;
+	if (conditioned.submitted > 0) {
+		LogPrint("UDPSessionTest: conditioned link took %.3f s, client sent %u datagrams, %u lost, %u over bandwidth, %u duplicated, %u reordered",
+			GetCurrentTimeSeconds() - start_time, conditioned.submitted, conditioned.dropped_loss,
+			conditioned.dropped_bandwidth, conditioned.duplicated, conditioned.reordered);
+	}
+}
+
+// UDPTest [port] [message_count]
+void UDPSessionTestCmd(void* data)
+{
+	arguments args = *(arguments*)data;
+	uint16_t port = (args.arg_list.size() > 0) ? (uint16_t)atoi(args.arg_list[0].c_str()) : 8920;
+	uint message_count = (args.arg_list.size() > 1) ? (uint)atoi(args.arg_list[1].c_str()) : 1000;
+	UDPSessionTest(port, message_count);
+	g_console->ConsolePrintf(Rgba(255, 255, 255, 255), "UDPTest finished, results are in the log", "");
+}
+
+void RegisterUDPSessionCommands()
+{
+	g_console->RegisterCommand("UDPTest", UDPSessionTestCmd);
+}
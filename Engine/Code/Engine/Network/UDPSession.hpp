@@ -0,0 +1,55 @@
+#pragma once
+#include "Engine/Network/NetSession.hpp"
+
+class UDPSocket;
+class UDPConnection;
+struct net_message_buffer_t;
+
+constexpr double UDP_JOIN_TIMEOUT_SECONDS = 5.0;
+
+// Connectionless transport - joining is a JOIN_REQUEST on the reliable
+// channel, the host answers with JOIN_RESPONSE like TCPSession does.
+class UDPSession : public NetSession
+{
+public:
+	UDPSession();
+	virtual ~UDPSession();
+
+public:
+	// bind the port, my connection is a loopback and I am the host
+	virtual void Host(uint16_t port) override;
+
+	// false straight away if the address is this machine and nobody has the port,
+	// otherwise connecting until the host answers or UDP_JOIN_TIMEOUT_SECONDS pass
+	virtual bool Join(net_address_t const &addr) override;
+
+	virtual void Leave() override;
+
+	// receive, process, then flush every connection
+	virtual void Update() override;
+
+	virtual void ProcessMessage(NetMessage* msg) override;
+
+	// hosts take new connections while listening
+	bool StartListening();
+	void StopListening();
+	bool IsListening() const;
+
+	void SendPacket(net_address_t const &addr, void const *data, uint size);
+	UDPConnection* FindConnection(net_address_t const &addr) const;
+
+private:
+	void ReceivePackets();
+	void AcceptConnection(net_address_t const &addr, net_message_buffer_t *datagram, uint size);
+	void SendJoinInfo(NetConnection *cp);
+	void OnJoinRequest(NetMessage *msg);
+	void OnJoinResponse(NetMessage *msg);
+
+public:
+	UDPSocket* m_socket;
+	bool m_isListening;
+	double m_joinStartTime;
+};
+
+void UDPSessionTest(uint16_t port, uint message_count);
+void RegisterUDPSessionCommands();
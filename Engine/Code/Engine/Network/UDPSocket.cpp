@@ -0,0 +1,145 @@
+#include "Engine/Network/UDPSocket.hpp"
+#include "Engine/Network/NetAddress.hpp"
+#include "Engine/Network/Net.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+
+UDPSocket::UDPSocket()
+	:m_socket((void*)INVALID_SOCKET)
+{
+	m_netAddr.address = 0;
+	m_netAddr.port = 0;
+}
+
+UDPSocket::~UDPSocket()
+{
+	Close();
+}
+
+bool UDPSocket::Bind(uint16_t port)
+{
+	if (IsValid())
+	{
+		return false;
+	}
+
+	std::vector<net_address_t> addresses = GetAddressFromHostName("", port, true);
+	if (addresses.empty())
+	{
+		return false;
+	}
+
+	SOCKET sock = ::socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock == INVALID_SOCKET)
+	{
+		return false;
+	}
+
+	sockaddr_storage bind_address;
+	int addr_size = 0;
+	SocketAddressFromNetAddress((sockaddr*)&bind_address, &addr_size, addresses[0]);
+
+	int result = ::bind(sock, (sockaddr*)&bind_address, addr_size);
+	if (result == SOCKET_ERROR)
+	{
+		::closesocket(sock);
+		return false;
+	}
+
+	// find out which port we got when asking for any
+	sockaddr_storage bound_address;
+	int bound_size = sizeof(bound_address);
+	if (::getsockname(sock, (sockaddr*)&bound_address, &bound_size) == SOCKET_ERROR)
+	{
+		::closesocket(sock);
+		return false;
+	}
+
+	net_address_t bound;
+	NetAddressFromSocketAddress(&bound, (sockaddr*)&bound_address);
+
+	m_socket = (void*)sock;
+	m_netAddr = GetMyAddress(bound.port);
+	return true;
+}
+
+void UDPSocket::Close()
+{
+	if (IsValid())
+	{
+		::closesocket((SOCKET)m_socket);
+		m_socket = (void*)INVALID_SOCKET;
+	}
+}
+
+bool UDPSocket::IsValid() const
+{
+	return (m_socket != (void*)INVALID_SOCKET);
+}
+
+uint UDPSocket::SendTo(const net_address_t& addr, const void* payload, uint size_bytes)
+{
+	if (!IsValid() || (payload == nullptr) || (size_bytes == 0))
+	{
+		return 0;
+	}
+
+	sockaddr_storage to_address;
+	int addr_size = 0;
+	SocketAddressFromNetAddress((sockaddr*)&to_address, &addr_size, addr);
+
+	int bytes_sent = ::sendto((SOCKET)m_socket, (const char*)payload, (int)size_bytes, 0, (sockaddr*)&to_address, addr_size);
+	if (bytes_sent == SOCKET_ERROR)
+	{
+		// datagrams are allowed to go missing - a full send buffer is just loss
+		return 0;
+	}
+
+	return (uint)bytes_sent;
+}
+
+uint UDPSocket::ReceiveFrom(net_address_t* out_addr, void* payload, uint max_size)
+{
+	if (!IsValid() || (max_size == 0))
+	{
+		return 0;
+	}
+
+	ASSERT_OR_DIE(payload != nullptr, "Payload was null!");
+
+	while (true)
+	{
+		sockaddr_storage from_address;
+		int from_size = sizeof(from_address);
+		int bytes_read = ::recvfrom((SOCKET)m_socket, (char*)payload, (int)max_size, 0, (sockaddr*)&from_address, &from_size);
+
+		if (bytes_read == SOCKET_ERROR)
+		{
+			// ICMP port unreachable from an earlier send shows up here, skip it
+			int error = WSAGetLastError();
+			if ((error == WSAECONNRESET) || (error == WSAEMSGSIZE))
+			{
+				continue;
+			}
+
+			return 0;
+		}
+
+		if (!NetAddressFromSocketAddress(out_addr, (sockaddr*)&from_address))
+		{
+			continue;
+		}
+
+		return (uint)bytes_read;
+	}
+}
+
+void UDPSocket::SetBlocking(bool blocking)
+{
+	if (!IsValid())
+	{
+		return;
+	}
+
+	u_long non_blocking = blocking ? 0 : 1;
+	::ioctlsocket((SOCKET)m_socket, FIONBIO, &non_blocking);
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "Engine/Network/NetAddress.hpp"
+#include <stdint.h>
+
+class UDPSocket
+{
+public:
+	void* m_socket;
+	net_address_t m_netAddr;
+
+public:
+	UDPSocket();
+	~UDPSocket();
+
+	// port 0 lets the OS pick, m_netAddr holds the port we ended up with
+	bool Bind(uint16_t port);
+	void Close();
+	bool IsValid() const;
+
+	uint SendTo(const net_address_t& addr, const void* payload, uint size_bytes);
+
+	// returns 0 when nothing is waiting
+	uint ReceiveFrom(net_address_t* out_addr, void* payload, uint max_size);
+	void SetBlocking(bool blocking);
+};
@@ -310,12 +310,6 @@ void LoadTextureFromImageJob(void* data)
 	}
 }
 
-void CleanupJob(void *ptr)
-{
-	// job is just here to cleanup resources when we're done
-	delete ptr;
-}
-
 void CallLoadTextureCallbackJob(void* data)
 {
 	load_texture_callback_t* call_back = (load_texture_callback_t*)data;
@@ -342,25 +336,26 @@ Texture2D* LoadTextureAsync(char const *filename, SimpleRenderer* renderer, on_t
 		job_data->filename = filename;
 		job_data->texture = tex;
 
-		// I'm using some existing helpers for parameter passing.  
-		Job *load_image = JobCreate(JOB_GENERIC, LoadImageFromFileJob, job_data);
-		Job *image_to_texture = JobCreate(JOB_RENDER, LoadTextureFromImageJob, job_data);
-		image_to_texture->dependent_on(load_image);
-
-		// who frees are resources in this scheme?
-		// no one - jobs are generic, so we need a cleanup job that will
-		// free the job_data 
+		// the lambdas are stored inside the jobs, so only job_data touches the heap.
+		Job *load_image = JobCreate(JOB_GENERIC, [job_data]() { 
+			LoadImageFromFileJob(job_data); 
+		});
 
-		Job *cleanup = JobCreate(JOB_GENERIC, CleanupJob, job_data);
-		cleanup->dependent_on(image_to_texture); // after this job, no one uses anything in job_data
-		JobDispatchAndRelease(cleanup);
+		// last user of job_data, so it frees it - no separate cleanup job needed
+		Job *image_to_texture = JobCreate(JOB_RENDER, [job_data]() { 
+			LoadTextureFromImageJob(job_data);
+			delete job_data;
+		});
+		image_to_texture->dependent_on(load_image);
 
 		if (cb != nullptr) {
-			load_texture_callback_t* call_back = new load_texture_callback_t();
-			call_back->cb = cb;
-			call_back->user_args = user_arg;
-			call_back->texture = tex;
-			Job *cb_job = JobCreate(JOB_MAIN, CallLoadTextureCallbackJob, call_back);
+			Job *cb_job = JobCreate(JOB_MAIN, [cb, user_arg, tex]() {
+				load_texture_callback_t call_back;
+				call_back.cb = cb;
+				call_back.user_args = user_arg;
+				call_back.texture = tex;
+				CallLoadTextureCallbackJob(&call_back);
+			});
 			cb_job->dependent_on(image_to_texture);
 
 			// we dispatch immediately - it won't actually 
@@ -49,10 +49,12 @@ void Motion::Evaluate(Pose *out, float time, ePlayMode playMode /*= FORWARD_LOOP
 	int firstFrame = CalculateFirstFrameIndexFromEvaluatedFrameTime(evalFrame, playMode, time);
 	int lastFrame = CalculateLastFrameIndexFromEvaluatedFrameTime(evalFrame, playMode, time);
 
-	Pose first = m_poses[firstFrame]; 
-	Pose last = m_poses[lastFrame];
+	// references - copying a pose copies its transform array
+	Pose const &first = m_poses[firstFrame]; 
+	Pose const &last = m_poses[lastFrame];
 
 	float interVal = CalculateInterpolationValue(evalFrame, firstFrame, time, playMode);
+	out->m_localTransforms.reserve(out->m_localTransforms.size() + first.m_localTransforms.size());
 
 	for(unsigned int index = 0; (index < first.m_localTransforms.size()) || (index < last.m_localTransforms.size()); ++index)
 	{
@@ -3,10 +3,13 @@
 #include "Engine/EngineConfig.hpp"
 #include "Engine/Render/SimpleRenderer.hpp"
 #include "Engine/Math/MathUtils.hpp"
+#include "Engine/Core/Job.hpp"
 #include <stdarg.h>
 
 #define EVER (;;)
 
+static int const PARTICLE_UPDATE_GRAIN = 64;
+
 
 Particle* ParticleSystem::CreateOrGetParticle(std::string& name, SimpleRenderer* renderer /*= nullptr*/, 
 	const char* mat_filePath /*= ""*/, const char* mesh_xml_file_path /*= ""*/, bool can_billboard /*= false*/, 
@@ -336,8 +339,10 @@ void ParticleEmitter::Update(float deltaSeconds)
 	BubbleSortParticlesByLifeSpan();
 	RemoveDeadParticles();
 	
-	for (auto iterate : m_particles)
+	// every particle owns its mesh, so they can all update in parallel
+	JobParallelFor(0, (int)m_particles.size(), PARTICLE_UPDATE_GRAIN, [&](int index)
 	{
+		Particle* iterate = m_particles[index];
 		if (m_isAfffectedByGravity)
 			iterate->m_acceleration += Vector3(0.0f, m_gravity, 0.0f);
 
@@ -353,7 +358,7 @@ void ParticleEmitter::Update(float deltaSeconds)
 		}
 
 		iterate->Update(deltaSeconds);
-	}
+	});
 }
 
 void ParticleEmitter::Render(SimpleRenderer* renderer) const
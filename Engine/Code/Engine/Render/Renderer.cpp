@@ -12,6 +12,7 @@
 #include <gl/GLU.h>
 #include "ThirdParty/OpenGL/glext.h"
 #include "ThirdParty/OpenGL/wglExt.h"
+#include <string.h>
 
 
 unsigned int PRIMITIVE_QUADS = GL_QUADS;
@@ -248,6 +249,44 @@ Texture* Renderer::CreateOrGetTexture(const std::string& imageFilePath)
 	return texture;
 }
 
+//-----------------------------------------------------------------------------------------------
+// One sprite of a sprite sheet as its own texture.  Textures wrap, so texcoords
+// past 1 repeat the sprite instead of running into its neighbors on the sheet.
+Texture* Renderer::CreateOrGetSpriteTexture(const std::string& imageFilePath, const IntVector2& spriteCoords, const IntVector2& spriteLayout)
+{
+	std::string spriteName = Stringf("%s#%i,%i", imageFilePath.c_str(), spriteCoords.x, spriteCoords.y);
+	Texture* texture = GetTexture(spriteName);
+	if (texture)
+		return texture;
+
+	int width = 0;
+	int height = 0;
+	int bytesPerTexel = 0;
+	unsigned char* imageTexelBytes = stbi_load(imageFilePath.c_str(), &width, &height, &bytesPerTexel, 0);
+	GUARANTEE_OR_DIE(imageTexelBytes != nullptr, Stringf("Failed to load image file \"%s\" - file not found!", imageFilePath.c_str()));
+	GUARANTEE_OR_DIE(bytesPerTexel == 3 || bytesPerTexel == 4, Stringf("Failed to load image file \"%s\" - image had unsupported %i bytes per texel (must be 3 or 4)", imageFilePath.c_str(), bytesPerTexel));
+
+	int spriteWidth = width / spriteLayout.x;
+	int spriteHeight = height / spriteLayout.y;
+	int spriteRowBytes = spriteWidth * bytesPerTexel;
+	std::vector<unsigned char> spriteTexelBytes(spriteRowBytes * spriteHeight);
+	for (int row = 0; row < spriteHeight; ++row)
+	{
+		int imageRow = (spriteCoords.y * spriteHeight) + row;
+		const unsigned char* source = imageTexelBytes + (((imageRow * width) + (spriteCoords.x * spriteWidth)) * bytesPerTexel);
+		memcpy(&spriteTexelBytes[row * spriteRowBytes], source, spriteRowBytes);
+	}
+	stbi_image_free(imageTexelBytes);
+
+	texture = new Texture();
+	texture->m_textureID = CreateOpenGLTexture(&spriteTexelBytes[0], spriteWidth, spriteHeight, bytesPerTexel);
+	texture->m_imageFilePath = spriteName;
+	texture->m_texelDimensions.SetXY(spriteWidth, spriteHeight);
+
+	m_alreadyLoadedTextures.push_back(texture);
+	return texture;
+}
+
 void Renderer::DrawTexturedQuad3D(const Vertex3_PCT& vertA, const Vertex3_PCT& vertB, const Vertex3_PCT& vertC, const Vertex3_PCT& vertD, Texture& texture)
 {
 	Vertex3_PCT vertexes[4];
@@ -480,6 +519,38 @@ void Renderer::UpdateVBO(unsigned int vboID, Vertex3_PCT* vertexArray, int numVe
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
+// Index buffers are plain buffer objects too, make them with CreateVBOID/DestroyVBO
+void Renderer::UpdateIBO(unsigned int iboID, const unsigned int* indexArray, int numIndexes)
+{
+	size_t indexNumBytes = numIndexes * sizeof(unsigned int);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboID);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexNumBytes, indexArray, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void Renderer::DrawIndexedVBO3D_PCT(unsigned int vboID, unsigned int iboID, int firstIndex, int numIndexes, unsigned int drawMode)
+{
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vboID);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboID);
+
+	glVertexPointer(3, GL_FLOAT, sizeof(Vertex3_PCT), (const GLvoid*) offsetof(Vertex3_PCT, m_position));
+	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex3_PCT), (const GLvoid*) offsetof(Vertex3_PCT, m_color));
+	glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex3_PCT),	(const GLvoid*) offsetof(Vertex3_PCT, m_texCoords));
+
+	glDrawElements(drawMode, numIndexes, GL_UNSIGNED_INT, (const GLvoid*) (firstIndex * sizeof(unsigned int)));
+
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
 void Renderer::DrawVertexArray3D_PC(const Vertex3_PC* vertexArray, int numVertexes, unsigned int drawMode) 
 {
 	glEnableClientState(GL_VERTEX_ARRAY);
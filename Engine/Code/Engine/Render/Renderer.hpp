@@ -46,6 +46,7 @@ public:
 	void SetPointToDraw2D(Vector2& point);
 	void SetPointToDraw3D(Vector3& point);
 	Texture* CreateOrGetTexture(const std::string& imageFilePath);
+	Texture* CreateOrGetSpriteTexture(const std::string& imageFilePath, const IntVector2& spriteCoords, const IntVector2& spriteLayout);
 	void DrawTexturedQuad3D(const Vertex3_PCT& vertA, const Vertex3_PCT& vertB, const Vertex3_PCT& vertC, const Vertex3_PCT& vertD, Texture& texture);
 	void DrawTexturedSprite(const AABB2D& worldBounds, Texture& texture, const AABB2D& texBounds, const Rgba& tint, bool useBlending);
 	void DrawCircle2D(const Vector2& center, float radius, const Rgba& lineColor);
@@ -56,6 +57,8 @@ public:
 	unsigned int CreateVBOID();
 	void DestroyVBO(unsigned int vboID);
 	void UpdateVBO(unsigned int vboID, Vertex3_PCT* vertexArray, int numVertexes);
+	void DrawIndexedVBO3D_PCT(unsigned int vboID, unsigned int iboID, int firstIndex, int numIndexes, unsigned int drawMode);
+	void UpdateIBO(unsigned int iboID, const unsigned int* indexArray, int numIndexes);
 	void DrawVertexArray3D_PC(const Vertex3_PC* vertexArray, int numVertexes, unsigned int drawMode);
 	void SetPointSize(float pointSize);
 	IntVector2 GetDimensionsOfImage(const Texture& texture);
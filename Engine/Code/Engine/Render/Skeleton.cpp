@@ -4,6 +4,7 @@
 #include "Engine/RHI/RHI.hpp"
 #include "Engine/Render/Pose.hpp"
 #include "Engine/Input/BinaryStream.hpp"
+#include "Engine/Core/FrameAllocator.hpp"
 
 Skeleton::Skeleton()
 {
@@ -93,7 +94,9 @@ void Skeleton::CalculateSkinMatrix(RHIDeviceContext* context, Pose* pose)
 {
 	unsigned int jointCount = GetJointCount();
 
-	std::vector<Matrix4> skinMatrices;
+	// only needed until the upload below, hand the space straight back
+	FRAME_ALLOC_SCOPE();
+	FrameVector<Matrix4> skinMatrices(FrameStlAllocator<Matrix4>());
 	skinMatrices.reserve(jointCount);
 
 	for (unsigned int index = 0; index < jointCount; ++index)
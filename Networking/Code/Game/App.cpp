@@ -1,15 +1,18 @@
 #include "Game/App.hpp"
 #include "Engine/Input/Input.hpp"
 #include "Engine/Core/Time.hpp"
+#include "Engine/Core/Profiling.hpp"
 #include "Game/Game.hpp"
 #include "Game/GameCommons.hpp"
 #include "Engine/Audio/AudioSystem.hpp"
 #include "Engine/Render/SimpleRenderer.hpp"
 #include "Engine/EngineConfig.hpp"
 #include "Engine/Math/MathUtils.hpp"
-#include "Engine/Network/TCPSession.hpp"
+#include "Engine/Network/UDPSession.hpp"
 #include "Engine/Network/NetConnection.hpp"
 #include "Engine/Network/NetObject.hpp"
+#include "Engine/Network/NetPrediction.hpp"
+#include "Engine/Network/NetClock.hpp"
 #include "Game/Player.hpp"
 
 
@@ -62,6 +65,7 @@ App::~App()
 
 void App::Update(float deltaSeconds)
 {
+	PROFILE_SCOPE_FUNCTION();
 	if (g_theAudioSystem != nullptr)
 		g_theAudioSystem->Update();
 
@@ -88,6 +92,7 @@ void App::Update(float deltaSeconds)
 
 void App::Render()
 {
+	PROFILE_SCOPE_FUNCTION();
 	if (g_theGame != nullptr)
 		g_theGame->Render();
 
@@ -191,9 +196,12 @@ void App::OnKeyUp(unsigned char keyCode)
 			g_theApp->m_infoMenuSelectIndex = 0;
 			g_theApp->m_tryingToConnect = false;
 			delete g_theGame->m_gameSession;
-			g_theGame->m_gameSession = new TCPSession();
+			g_theGame->m_gameSession = new UDPSession();
 			RegisterNetObjectSession(g_theGame->m_gameSession);
 			ClearNetObjectList();
+			NetPredictionReset();
+			NetClockReset();
+			g_theGame->m_simLoop.Reset();
 			g_theGame->m_playerList.clear();
 			g_theGame->m_ships.clear();
 			g_theGame->m_playerList.resize(g_theGame->m_gameSession->m_maxConnectionCount + 1);
@@ -15,13 +15,21 @@
 #include "Engine/Network/TCPSocket.hpp"
 #include "Engine/Network/TCPConnection.hpp"
 #include "Engine/Network/TCPSession.hpp"
+#include "Engine/Network/UDPSession.hpp"
+#include "Engine/Network/NetLinkConditioner.hpp"
 #include "Engine/Network/NetMessage.hpp"
 #include "Engine/Network/NetConnection.hpp"
 #include "Engine/Network/NetMessageDefinition.hpp"
 #include "Engine/Network/RemoteCommandService.hpp"
 #include "Engine/Network/NetObject.hpp"
+#include "Engine/Network/NetPrediction.hpp"
+#include "Engine/Network/NetClock.hpp"
+#include "Engine/Network/UDPConnection.hpp"
+#include "Engine/Input/BitStream.hpp"
 #include "Engine/Math/Disc2D.hpp"
 #include "Engine/Core/Time.hpp"
+#include "Engine/Core/Profiling.hpp"
+#include "Engine/Core/BuildConfig.hpp"
 #include "Game/Bullet.hpp"
 #include "Game/Player.hpp"
 #include "Game/Asteroid.hpp"
@@ -32,6 +40,7 @@
 #include "Engine/Render/SpriteAnimation.hpp"
 #include <sstream>
 #include <iomanip>
+#include <cstddef>
 
 
 Game* g_theGame = nullptr;
@@ -107,9 +116,10 @@ Game::Game()
 	, m_worldDimensions(3000.0f, 1500.0f)
 	, m_zoom(1.0f)
 	, m_hostCameraValue(0)
+	, m_netInterestRadius(NET_INTEREST_RADIUS)
 	, m_hostState(ASTEROIDS)
 {	
-	m_gameSession = new TCPSession();
+	m_gameSession = new UDPSession();
 	m_playerList.resize(m_gameSession->m_maxConnectionCount + 1);
 	m_ships.resize(m_gameSession->m_maxConnectionCount + 1);
 	SetUpGameMessages();
@@ -202,46 +212,34 @@ void Game::Update(float deltaSeconds)
 			}
 		}
 
-		NetObjectSystemStep();
-		
-		if (m_gameSession->AmIClient()) 
-		{
+		if (m_gameSession->AmIClient())
 			m_myPlayer->Update(deltaSeconds);
 
-			for (uint index = 0; index < m_ships.size(); ++index)
-			{
-				if (!m_ships[index])
-					continue;
-
-				m_ships[index]->Update(deltaSeconds);
-				CorrectPlayerOnWorldEdge(index);
-			}
-
-			for (uint index = 0; index < m_bullets.size(); ++index)
+		// gameplay runs in fixed ticks off the host's clock, so both ends agree on
+		// tick numbers - a client waits for its clock to sync before starting
+		NetClockUpdate();
+		if (NetClockIsSynced())
+		{
+			m_simLoop.Update(NetClockGetHostTime());
+			while (!g_IsTheGamePaused && m_simLoop.CheckAndStep())
 			{
-				m_bullets[index]->Update(deltaSeconds);
+				UpdateTick(m_simLoop.tick_seconds);
+				SetNetObjectTick(m_simLoop.tick);
 			}
+		}
+		else
+			m_simLoop.Reset();
 
-			UpdateAsteroids(deltaSeconds);
-			UpdateLandmines(deltaSeconds);
-			UpdatePowerups(deltaSeconds);
-
-			SmoothShips(deltaSeconds);
-			SmoothBullets();
-			SmoothAsteroids(deltaSeconds);
+		NetObjectSystemStep();
+		
+		if (m_gameSession->AmIClient()) 
+		{
 			UpdateExplosions(deltaSeconds);
 			UpdateClientCamera();
 		}
 		else if (m_gameSession->AmIHost())
 		{
-			HostManageRespawns();
-			UpdatePlayers(deltaSeconds);
 			UpdateCamera(deltaSeconds);
-			UpdateBullets(deltaSeconds);
-			UpdateAsteroids(deltaSeconds);
-			UpdateShips(deltaSeconds);
-			UpdateLandmines(deltaSeconds);
-			UpdatePowerups(deltaSeconds);
 			UpdateExplosions(deltaSeconds);
 		}
 	}
@@ -251,6 +249,31 @@ void Game::Update(float deltaSeconds)
 
 }
 
+void Game::UpdateTick(float tickSeconds)
+{
+	if (m_gameSession->AmIClient())
+	{
+		// our own ship moves on our input now, everything else is played out
+		// from the host's updates by NetObjectSystemStep
+		NetPredictionSubmitInput(m_simLoop.tick, &m_myPlayer->m_input, sizeof(InputState), tickSeconds);
+		if (m_myPlayer->m_ship)
+			m_myPlayer->m_ship->m_timeSinceFired += tickSeconds;
+
+		UpdateLandmines(tickSeconds);
+		UpdatePowerups(tickSeconds);
+	}
+	else if (m_gameSession->AmIHost())
+	{
+		HostManageRespawns();
+		UpdatePlayers(tickSeconds);
+		UpdateBullets(tickSeconds);
+		UpdateAsteroids(tickSeconds);
+		UpdateShips(tickSeconds);
+		UpdateLandmines(tickSeconds);
+		UpdatePowerups(tickSeconds);
+	}
+}
+
 void Game::CreateExplosion(Vector2 pos, float radius)
 {
 	Explosion* explosion = new Explosion();
@@ -300,153 +323,6 @@ void Game::RenderExplosions() const
 	}
 }
 
-void Game::SmoothShips(float deltaSeconds)
-{
-	if (!g_theGame->m_gameSession->AmIClient())
-		return;
-
-	Ship* my_ship = m_ships[m_myPlayer->m_connectionIndex];
-
-	for (Ship* ship : m_ships)
-	{
-		if (!ship)
-			continue;
-
-		float max_distance_to_teleport;
-		float acceptance_for_position;
-		float acceptance_for_angle;
-		float max_angle_to_teleport;
-
-		if (ship == my_ship)
-		{
-			//be lenient
-			max_distance_to_teleport = 100.0f;
-			acceptance_for_position = 0.1f;
-			acceptance_for_angle = 1.0f;
-			max_angle_to_teleport = 90.0f;
-		}
-		else
-		{
-			//be more strict
-			max_distance_to_teleport = 50.0f;
-			acceptance_for_position = 0.01f;
-			acceptance_for_angle = 0.5f;
-			max_angle_to_teleport = 15.0f;
-		}
-
-		// Check if too far away
-		float distance_to_position = (ship->m_deadReckon.position - ship->m_position).CalcLength();
-		if (distance_to_position > max_distance_to_teleport)
-		{
-			ship->m_position = ship->m_deadReckon.position;
-		}
-		else
-		{
-			Vector2 ship_pos = ship->m_position;
-			ship_pos.Normalize();
-			Vector2 dead_rek_pos = ship->m_deadReckon.position;
-			dead_rek_pos.Normalize();
-
-			float interp_val = DotProduct(ship_pos, dead_rek_pos);
-
-			if (IsEquivalent(interp_val, 1.0f, acceptance_for_position))
-				break;
-
-			ship->m_position = Interpolate(ship->m_position, ship->m_deadReckon.position, interp_val);
-		}
-
-		if (IsEquivalent(ship->m_deadReckon.orientation_in_degrees, ship->m_orientationInDegrees, acceptance_for_angle))
-			continue;
-		else if (!IsEquivalent(ship->m_deadReckon.orientation_in_degrees, ship->m_orientationInDegrees, max_angle_to_teleport))
-		{
-			ship->m_orientationInDegrees = ship->m_deadReckon.orientation_in_degrees;
-			continue;
-		}
-
-		//float interp_angle = ship->m_orientationInDegrees / ship->m_deadReckon.orientation_in_degrees;
-		ship->m_orientationInDegrees = LERP(ship->m_orientationInDegrees, ship->m_deadReckon.orientation_in_degrees, 0.5f * deltaSeconds);
-	}
-}
-
-void Game::SmoothAsteroids(float deltaSeconds)
-{
-	if (!g_theGame->m_gameSession->AmIClient())
-		return;
-
-	for (Asteroid* asteroid : m_asteroids)
-	{
-		float max_distance_to_teleport = 100.0f;
-		float acceptance_for_position = 0.1f;
-		float acceptance_for_angle = 0.5f;
-		float max_angle_to_teleport = 90.0f;
-
-
-		// Check if too far away
-		float distance_to_position = (asteroid->m_deadReckon.position - asteroid->m_position).CalcLength();
-		if (distance_to_position > max_distance_to_teleport)
-		{
-			asteroid->m_position = asteroid->m_deadReckon.position;
-		}
-		else
-		{
-			Vector2 asteroid_pos = asteroid->m_position;
-			asteroid_pos.Normalize();
-			Vector2 dead_rek_pos = asteroid->m_deadReckon.position;
-			dead_rek_pos.Normalize();
-
-			float interp_val = DotProduct(asteroid_pos, dead_rek_pos);
-
-			if (IsEquivalent(interp_val, 1.0f, acceptance_for_position))
-				break;
-
-			asteroid->m_position = Interpolate(asteroid->m_position, asteroid->m_deadReckon.position, interp_val);
-		}
-
-		if (IsEquivalent(asteroid->m_deadReckon.orientation_in_degrees, asteroid->m_orientationInDegrees, acceptance_for_angle))
-			continue;
-		else if (!IsEquivalent(asteroid->m_deadReckon.orientation_in_degrees, asteroid->m_orientationInDegrees, max_angle_to_teleport))
-		{
-			asteroid->m_orientationInDegrees = asteroid->m_deadReckon.orientation_in_degrees;
-			continue;
-		}
-
-		//float interp_angle = ship->m_orientationInDegrees / ship->m_deadReckon.orientation_in_degrees;
-		asteroid->m_orientationInDegrees = LERP(asteroid->m_orientationInDegrees, asteroid->m_deadReckon.orientation_in_degrees, 0.5f * deltaSeconds);
-	}
-}
-
-void Game::SmoothBullets()
-{
-	if (!g_theGame->m_gameSession->AmIClient())
-		return;
-
-	for (Bullet* bullet : m_bullets)
-	{
-		if (!bullet)
-			continue;
-
-		// Check if too far away
-		float distance_to_position = (bullet->m_deadReckon.position - bullet->m_position).CalcLength();
-		if (distance_to_position > 200.0f)
-		{
-			bullet->m_position = bullet->m_deadReckon.position;
-			continue;
-		}
-
-		Vector2 bullet_pos = bullet->m_position;
-		bullet_pos.Normalize();
-		Vector2 dead_rek_pos = bullet->m_deadReckon.position;
-		dead_rek_pos.Normalize();
-
-		float interp_val = DotProduct(bullet_pos, dead_rek_pos);
-
-		if (IsEquivalent(interp_val, 1.0f, 0.01f))
-			continue;
-
-		bullet->m_position = Interpolate(bullet->m_position, bullet->m_deadReckon.position, interp_val);
-	}
-}
-
 void Game::HostManageRespawns()
 {
 	for (uint index = 0; index < m_playerList.size(); ++index)
@@ -482,6 +358,13 @@ void Game::UpdateShips(float deltaSeconds)
 		}
 
 		Ship* current = m_ships[index];
+		if (NetPredictionIsInputDriven(current->m_netID))
+		{
+			// its client's input commands move it
+			current->m_timeSinceFired += deltaSeconds;
+			continue;
+		}
+
 		current->Update(deltaSeconds);
 	}
 }
@@ -993,6 +876,16 @@ void Game::UpdatePlayers(float deltaSeconds)
 		m_playerList[index]->Update(deltaSeconds);
 
 		CorrectPlayerOnWorldEdge(index);
+
+		// each client only hears about what's around its ship, dead ones keep the last area
+		NetConnection *cp = m_gameSession->m_connections[conn_index];
+		if (cp == m_gameSession->m_myConnection)
+			continue;
+
+		if (m_netInterestRadius <= 0.0f)
+			NetObjectClearConnectionInterest(cp);
+		else if (m_playerList[index]->m_ship)
+			NetObjectSetConnectionInterest(cp, m_playerList[index]->m_ship->m_position, m_netInterestRadius);
 	}
 }
 
@@ -1385,6 +1278,8 @@ void FollowShip(void* data)
 	g_theGame->m_hostCameraValue = index;
 }
 
+void NetSnapshotReport(void* data);
+
 void SetNetUpdateRate(void* data)
 {
 	if (!g_theGame->m_gameSession->AmIHost())
@@ -1401,6 +1296,19 @@ void SetNetUpdateRate(void* data)
 	SetNetObjectRefreshRate(hertz);
 }
 
+void SetNetInterestRadius(void* data)
+{
+	arguments args = *(arguments*)data;
+
+	float radius;
+	if (args.arg_list.empty())
+		radius = NET_INTEREST_RADIUS;
+	else
+		radius = std::stof(args.arg_list[0]);
+
+	g_theGame->m_netInterestRadius = radius;
+}
+
 void Game::InitializeConsole()
 {
 	m_font = CreateOrGetKerningFont("Data/Fonts/trebuchetMS32.fnt");
@@ -1418,6 +1326,17 @@ void Game::InitializeConsole()
 	g_console->RegisterCommand("reset_name", ResetName, Rgba(255, 255, 255, 255), "Change your name.", " ");
 	g_console->RegisterCommand("follow", FollowShip, Rgba(255, 255, 255, 255), "Given an index will follow that player, 0 to reset.", " ");
 	g_console->RegisterCommand("net_rate", SetNetUpdateRate, Rgba(255, 255, 255, 255), "Host Will Set Net Refresh Rate to given hertz value.", " ");
+	g_console->RegisterCommand("net_interest", SetNetInterestRadius, Rgba(255, 255, 255, 255), "Radius clients hear about objects within, 0 for everything.", " ");
+	g_console->RegisterCommand("net_snapshot_report", NetSnapshotReport, Rgba(255, 255, 255, 255), "Bytes/sec of full vs delta snapshots. [seconds] [ships] [asteroids] [bullets]", " ");
+	RegisterProfilerCommands();
+	RegisterMemoryCommands();
+	RegisterUDPSessionCommands();
+	RegisterNetLinkCommands();
+	RegisterNetMessageCommands();
+	RegisterTCPSessionCommands();
+	RegisterNetObjectCommands();
+	RegisterNetPredictionCommands();
+	RegisterNetClockCommands();
 
 	g_console->SetFontShader("Font", "Data/HLSL/font_shader.hlsl");
 	g_console->SetBackDropShader("Console Back", "Data/HLSL/shadow_box.hlsl"); 
@@ -1504,7 +1423,7 @@ void Game::UpdateGameSession()
 		g_theApp->m_tryingToConnect = false;
 		NetObjectCleanup();
 		delete m_gameSession;
-		m_gameSession = new TCPSession();
+		m_gameSession = new UDPSession();
 		m_playerList.clear();
 		m_ships.clear();
 		m_playerList.resize(m_gameSession->m_maxConnectionCount + 1);
@@ -1650,8 +1569,6 @@ void OnNameReceive(NetMessage* msg)
 	{
 		NetMessage join(INIT_JOIN);
 		join.m_sender = g_theGame->m_gameSession->m_myConnection;
-		float conn_time = (float)GetCurrentTimeSeconds();
-		join.write_bytes(&conn_time, sizeof(float));
 		msg->m_sender->Send(&join);
 
 
@@ -1826,12 +1743,9 @@ void OnInitJoin(NetMessage* msg)
 	if (!g_theGame->m_gameSession->AmIClient())
 		return;
 
-	float host_time;
-	msg->read_bytes(&host_time, sizeof(float));
-	SetHostTime(host_time);
-
-	float client_time = (float)GetCurrentTimeSeconds();
-	SetClientTime(client_time);
+	// NetClock syncs to the host over PING/PONG from here, start it afresh
+	NetClockReset();
+	g_theGame->m_simLoop.Reset();
 }
 
 void Game::SetUpGameMessages()
@@ -1980,11 +1894,19 @@ Ship* Game::HostCreateShipToReplicate(uint8_t player_idx)
 	ship->m_orientationInDegrees = GetRandomFloatInRange(0.0f, 360.0f);
 	ship->m_position.x = GetRandomFloatInRange(-(g_theGame->m_worldDimensions.x * 0.5f), (g_theGame->m_worldDimensions.x * 0.5f));
 	ship->m_position.y = GetRandomFloatInRange(-(g_theGame->m_worldDimensions.y * 0.5f), (g_theGame->m_worldDimensions.y * 0.5f));
+	ship->m_lastTickPosition = ship->m_position;
+	ship->m_lastTickOrientation = ship->m_orientationInDegrees;
 
 	NetObject *nop = NetObjectReplicate(ship, NETOBJECT_SHIP);
 	if(nop)
+	{
 		ship->m_netID = nop->m_netID;
 
+		NetConnection *owner = m_gameSession->GetConnection(player_idx);
+		if (owner && (owner != m_gameSession->m_myConnection))
+			NetPredictionSetControlledObject(owner, nop->m_netID);
+	}
+
 	return ship;
 }
 
@@ -2134,13 +2056,18 @@ void* ShipProcessCreateInfo(NetMessage *msg, NetObject *nop)
 	ship->m_playerID = player_idx;
 	ship->m_position = pos;
 	ship->m_orientationInDegrees = angle;
+	ship->m_lastTickPosition = pos;
+	ship->m_lastTickOrientation = angle;
 	ship->m_netID = nop->m_netID;
 
 	g_theGame->m_ships[player_idx] = ship;
 	g_theGame->m_playerList[player_idx]->m_ship = ship;
 
 	if (g_theGame->m_myPlayer->m_connectionIndex == player_idx)
+	{
 		g_theGame->m_camera->m_position = Vector3(pos.x, pos.y, 0.0f);
+		NetPredictionSetLocalObject(nop->m_netID);
+	}
 
 	return ship;
 }
@@ -2157,6 +2084,13 @@ void ShipProcessDestroyInfo(NetMessage *msg, void *ship_ptr)
 	delete ship;
 }
 
+void ShipPredictInput(void *ship_ptr, void const *input, float delta_time)
+{
+	Ship *ship = (Ship*)ship_ptr;
+	ship->Simulate(*(InputState const*)input, delta_time);
+	g_theGame->CorrectPlayerOnWorldEdge(ship->m_playerID);
+}
+
 // Bullets
 void BulletAppendCreateInfo(NetMessage *msg, void *bullet_ptr)
 {
@@ -2395,6 +2329,10 @@ void PickupProcessDestroyInfo(NetMessage* msg, void* pwr_ptr)
 // Network Update
 //////////////////////////////////////////////////////////////////////////
 
+// The Append/ProcessSnapShot functions are the old full, unquantized format.
+// Updates go out as quantized deltas now (see the Add*SnapshotFields below),
+// net_snapshot_report still uses them to measure what that saves.
+
 // Ships
 struct net_ship_snapshot_t
 {
@@ -2409,9 +2347,15 @@ void ShipApplySnapShot(void* local_obj, void* last_snap, float delta_time)
 	Ship* ship = (Ship*)local_obj;
 	net_ship_snapshot_t* snap_shot = (net_ship_snapshot_t*)last_snap;
 
-	ship->m_deadReckon.position = snap_shot->position + (snap_shot->velocity * delta_time);
-	float turn_rate = g_theGame->m_playerList[ship->m_playerID]->m_input.steering_angle;
-	ship->m_deadReckon.orientation_in_degrees = snap_shot->angle + (turn_rate * delta_time);
+	// playout has already smoothed it, delta_time is only ever a short extrapolation
+	ship->m_deadReckon.position = snap_shot->position;
+	ship->m_deadReckon.orientation_in_degrees = snap_shot->angle;
+
+	float turn_rate = g_theGame->m_playerList[ship->m_playerID]->m_input.steering_angle * 180.0f;
+	ship->m_position = snap_shot->position + (snap_shot->velocity * delta_time);
+	ship->m_orientationInDegrees = snap_shot->angle + (turn_rate * delta_time);
+	ship->m_lastTickPosition = ship->m_position;
+	ship->m_lastTickOrientation = ship->m_orientationInDegrees;
 	ship->m_velocity = snap_shot->velocity;
 	ship->m_health = snap_shot->health;
 }
@@ -2473,7 +2417,9 @@ void BulletApplySnapShot(void* local_obj, void* last_snap, float delta_time)
 	Bullet* bullet = (Bullet*)local_obj;
 	net_bullet_snapshot_t* snap_shot = (net_bullet_snapshot_t*)last_snap;
 
-	bullet->m_deadReckon.position = snap_shot->position + (snap_shot->velocity * delta_time);
+	bullet->m_deadReckon.position = snap_shot->position;
+	bullet->m_deadReckon.orientation_in_degrees = snap_shot->angle;
+	bullet->m_position = snap_shot->position + (snap_shot->velocity * delta_time);
 	bullet->m_velocity = snap_shot->velocity;
 	bullet->m_orientationInDegrees = snap_shot->angle;
 	bullet->m_ownerID = snap_shot->ownerID;
@@ -2536,9 +2482,11 @@ void AsteroidApplySnapshot(void* local_obj, void* last_snap, float delta_time)
 	Asteroid* asteroid = (Asteroid*)local_obj;
 	net_asteroid_snapshot_t* snap_shot = (net_asteroid_snapshot_t*)last_snap;
 
-	asteroid->m_deadReckon.position = snap_shot->position + (snap_shot->velocity * delta_time);
+	asteroid->m_deadReckon.position = snap_shot->position;
+	asteroid->m_deadReckon.orientation_in_degrees = snap_shot->angle;
+	asteroid->m_position = snap_shot->position + (snap_shot->velocity * delta_time);
 	asteroid->m_velocity = snap_shot->velocity;
-	asteroid->m_deadReckon.orientation_in_degrees = snap_shot->angle + (asteroid->m_spin * delta_time);
+	asteroid->m_orientationInDegrees = snap_shot->angle + (asteroid->m_spin * delta_time);
 	asteroid->m_health = snap_shot->health;
 }
 
@@ -2585,6 +2533,61 @@ size_t AsteroidSnapShotSize()
 	return sizeof(net_asteroid_snapshot_t);
 }
 
+// Snapshot quantization - the world is 3000x1500 around the origin, with room for
+// things drifting off the edge
+const float NET_POSITION_MIN = -2048.0f;
+const float NET_POSITION_MAX = 2048.0f;
+const uint8_t NET_POSITION_BITS = 18;	// ~0.016 units
+const float NET_VELOCITY_LIMIT = 2048.0f;
+const uint8_t NET_VELOCITY_BITS = 16;	// ~0.06 units/sec
+const uint8_t NET_ANGLE_BITS = 12;		// ~0.09 degrees
+
+// where things are for interest management - ships aren't positioned, so every
+// client always has every ship
+Vector2 BulletGetNetPosition(void* bullet_ptr)
+{
+	return ((Bullet*)bullet_ptr)->m_position;
+}
+
+Vector2 AsteroidGetNetPosition(void* asteroid_ptr)
+{
+	return ((Asteroid*)asteroid_ptr)->m_position;
+}
+
+Vector2 LandmineGetNetPosition(void* mine_ptr)
+{
+	return ((Landmine*)mine_ptr)->m_position;
+}
+
+Vector2 PickupGetNetPosition(void* pwr_ptr)
+{
+	return ((Powerup*)pwr_ptr)->m_position;
+}
+
+void AddShipSnapshotFields(NetObjectTypeDefinition& defn)
+{
+	defn.AddVector2Field(offsetof(net_ship_snapshot_t, position), NET_POSITION_MIN, NET_POSITION_MAX, NET_POSITION_BITS);
+	defn.AddVector2Field(offsetof(net_ship_snapshot_t, velocity), -NET_VELOCITY_LIMIT, NET_VELOCITY_LIMIT, NET_VELOCITY_BITS);
+	defn.AddAngleField(offsetof(net_ship_snapshot_t, angle), NET_ANGLE_BITS);
+	defn.AddIntField(offsetof(net_ship_snapshot_t, health), -16, 15);
+}
+
+void AddBulletSnapshotFields(NetObjectTypeDefinition& defn)
+{
+	defn.AddVector2Field(offsetof(net_bullet_snapshot_t, position), NET_POSITION_MIN, NET_POSITION_MAX, NET_POSITION_BITS);
+	defn.AddVector2Field(offsetof(net_bullet_snapshot_t, velocity), -NET_VELOCITY_LIMIT, NET_VELOCITY_LIMIT, NET_VELOCITY_BITS);
+	defn.AddAngleField(offsetof(net_bullet_snapshot_t, angle), NET_ANGLE_BITS);
+	defn.AddByteField(offsetof(net_bullet_snapshot_t, ownerID), 0, 255);
+}
+
+void AddAsteroidSnapshotFields(NetObjectTypeDefinition& defn)
+{
+	defn.AddVector2Field(offsetof(net_asteroid_snapshot_t, position), NET_POSITION_MIN, NET_POSITION_MAX, NET_POSITION_BITS);
+	defn.AddVector2Field(offsetof(net_asteroid_snapshot_t, velocity), -NET_VELOCITY_LIMIT, NET_VELOCITY_LIMIT, NET_VELOCITY_BITS);
+	defn.AddAngleField(offsetof(net_asteroid_snapshot_t, angle), NET_ANGLE_BITS);
+	defn.AddIntField(offsetof(net_asteroid_snapshot_t, health), -16, 15);
+}
+
 void Game::NetSetup()
 {
 	NetObjectStartup();
@@ -2597,9 +2600,14 @@ void Game::NetSetup()
 	ship_defn.m_processDestroyInfo = ShipProcessDestroyInfo;
 	ship_defn.m_applySnapshot = ShipApplySnapShot;
 	ship_defn.m_getCurrentSnapShot = ShipGetCurrentSnapShot;
-	ship_defn.m_appendSnapshot = ShipAppendSnapShot;
-	ship_defn.m_processSnapshot = ShipProcessSnapShot;
+	ship_defn.m_appendSnapshot = nullptr;
+	ship_defn.m_processSnapshot = nullptr;
 	ship_defn.m_getSnapShotSize = ShipSnapShotSize;
+	ship_defn.m_priority = 4.0f;
+	ship_defn.m_interpolate = true;
+	ship_defn.m_predictInput = ShipPredictInput;
+	ship_defn.m_inputSize = sizeof(InputState);
+	AddShipSnapshotFields(ship_defn);
 	NetObjectSystemRegisterType(NETOBJECT_SHIP, ship_defn);
 
 	NetObjectTypeDefinition bullet_defn;
@@ -2609,9 +2617,13 @@ void Game::NetSetup()
 	bullet_defn.m_processDestroyInfo = BulletProcessDestroyInfo;
 	bullet_defn.m_applySnapshot = BulletApplySnapShot;
 	bullet_defn.m_getCurrentSnapShot = BulletGetCurrentSnapShot;
-	bullet_defn.m_appendSnapshot = BulletAppendSnapShot;
-	bullet_defn.m_processSnapshot = BulletProcessSnapShot;
+	bullet_defn.m_appendSnapshot = nullptr;
+	bullet_defn.m_processSnapshot = nullptr;
 	bullet_defn.m_getSnapShotSize = BulletSnapShotSize; 
+	bullet_defn.m_priority = 2.0f;
+	bullet_defn.m_interpolate = true;
+	bullet_defn.m_getPosition = BulletGetNetPosition;
+	AddBulletSnapshotFields(bullet_defn);
 	NetObjectSystemRegisterType(NETOBJECT_BULLET, bullet_defn);
 
 	NetObjectTypeDefinition asteroid_defn;
@@ -2621,9 +2633,12 @@ void Game::NetSetup()
 	asteroid_defn.m_processDestroyInfo = AsteroidProcessDestroyInfo;
 	asteroid_defn.m_applySnapshot = AsteroidApplySnapshot;
 	asteroid_defn.m_getCurrentSnapShot = AsteroidGetCurrentSnapShot;
-	asteroid_defn.m_appendSnapshot = AsteroidAppendSnapShot;
-	asteroid_defn.m_processSnapshot = AsteroidProcessSnapShot;
+	asteroid_defn.m_appendSnapshot = nullptr;
+	asteroid_defn.m_processSnapshot = nullptr;
 	asteroid_defn.m_getSnapShotSize = AsteroidSnapShotSize;
+	asteroid_defn.m_getPosition = AsteroidGetNetPosition;
+	asteroid_defn.m_interpolate = true;
+	AddAsteroidSnapshotFields(asteroid_defn);
 	NetObjectSystemRegisterType(NETOBJECT_ASTEROID, asteroid_defn);
 
 	NetObjectTypeDefinition mine_defn;
@@ -2636,6 +2651,7 @@ void Game::NetSetup()
 	mine_defn.m_appendSnapshot = nullptr;
 	mine_defn.m_processSnapshot = nullptr;
 	mine_defn.m_getSnapShotSize = nullptr;
+	mine_defn.m_getPosition = LandmineGetNetPosition;
 	NetObjectSystemRegisterType(NETOBJECT_MINE, mine_defn);
 
 	NetObjectTypeDefinition pwr_defn;
@@ -2648,8 +2664,325 @@ void Game::NetSetup()
 	pwr_defn.m_appendSnapshot = nullptr;
 	pwr_defn.m_processSnapshot = nullptr;
 	pwr_defn.m_getSnapShotSize = nullptr;
+	pwr_defn.m_getPosition = PickupGetNetPosition;
 	NetObjectSystemRegisterType(NETOBJECT_PICKUP, pwr_defn);
 
 	EstablishNetObjectMessages();
 	SetNetObjectRefreshRate(20.0f);
-}
\ No newline at end of file
+	SetNetObjectTickRate(GAME_TICK_RATE);
+	m_simLoop.SetTickRate(GAME_TICK_RATE);
+
+	NetClockReset();
+	EstablishNetClockMessages();
+
+	NetPredictionReset();
+	EstablishNetPredictionMessages();
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// Snapshot Bandwidth Report
+//////////////////////////////////////////////////////////////////////////
+
+// Runs made up ships, asteroids and bullets through both the old full snapshot
+// path and the delta path the host uses now, and compares bytes per second.
+// big enough for any of the net_*_snapshot_t above
+const uint NET_REPORT_SNAPSHOT_FLOATS = 8;
+
+struct net_report_object_t
+{
+	uint8_t type;
+	uint16_t net_id;
+	Vector2 position;
+	Vector2 velocity;
+	float angle;
+	float spin;
+	float thrust;
+	int health;
+	float lifetime;
+
+	float snapshot[NET_REPORT_SNAPSHOT_FLOATS];
+	float last_full_sent[NET_REPORT_SNAPSHOT_FLOATS];
+	bool has_sent_full;
+
+	std::vector<uint32_t> history;			// host side ring, like NetObject::m_history
+	std::vector<uint32_t> client_history;	// what the "client" decoded
+	uint32_t history_frames[NET_OBJECT_HISTORY];
+	uint32_t client_history_frames[NET_OBJECT_HISTORY];
+	uint32_t acked_frame;
+};
+
+struct net_report_ack_t
+{
+	uint arrive_frame;
+	uint object_index;
+	uint16_t net_id;
+	uint16_t frame;
+};
+
+enum eNetReportCategory
+{
+	NET_REPORT_SHIPS,
+	NET_REPORT_ASTEROIDS,
+	NET_REPORT_BULLETS,
+	NUM_NET_REPORT_CATEGORIES,
+};
+
+static void NetReportSpawn(net_report_object_t& obj, uint8_t type, uint16_t net_id, uint quantized_count)
+{
+	obj.type = type;
+	obj.net_id = net_id;
+	obj.position = Vector2(GetRandomFloatInRange(-1400.0f, 1400.0f), GetRandomFloatInRange(-700.0f, 700.0f));
+	obj.angle = GetRandomFloatInRange(0.0f, 360.0f);
+	obj.spin = (type == NETOBJECT_ASTEROID) ? GetRandomFloatInRange(-90.0f, 90.0f) : 0.0f;
+	obj.thrust = 0.0f;
+	obj.health = (type == NETOBJECT_SHIP) ? 10 : 5;
+	obj.lifetime = 2.0f;
+
+	float speed = (type == NETOBJECT_BULLET) ? 500.0f : ((type == NETOBJECT_ASTEROID) ? 100.0f : 0.0f);
+	obj.velocity = Vector2(speed * CosInDegrees(obj.angle), speed * SinInDegrees(obj.angle));
+
+	memset(obj.snapshot, 0, sizeof(obj.snapshot));
+	obj.has_sent_full = false;
+	obj.history.assign(NET_OBJECT_HISTORY * quantized_count, 0);
+	obj.client_history.assign(NET_OBJECT_HISTORY * quantized_count, 0);
+	for (uint index = 0; index < NET_OBJECT_HISTORY; ++index)
+	{
+		obj.history_frames[index] = NET_OBJECT_NO_FRAME;
+		obj.client_history_frames[index] = NET_OBJECT_NO_FRAME;
+	}
+	obj.acked_frame = NET_OBJECT_NO_FRAME;
+}
+
+static void NetReportStep(net_report_object_t& obj, float delta_seconds)
+{
+	if (obj.type == NETOBJECT_SHIP)
+	{
+		// players change their minds every second or so
+		if (GetRandomFloatZeroToOne() < delta_seconds)
+		{
+			obj.spin = GetRandomFloatInRange(-1.0f, 1.0f) * 180.0f;
+			obj.thrust = (GetRandomFloatZeroToOne() < 0.6f) ? 200.0f : 0.0f;
+		}
+		if (GetRandomFloatZeroToOne() < (delta_seconds * 0.1f))
+			--obj.health;
+
+		obj.velocity += Vector2(CosInDegrees(obj.angle), SinInDegrees(obj.angle)) * (obj.thrust * delta_seconds);
+	}
+
+	obj.angle += obj.spin * delta_seconds;
+	obj.position += obj.velocity * delta_seconds;
+	obj.lifetime -= delta_seconds;
+
+	if ((obj.position.x < -1500.0f) || (obj.position.x > 1500.0f))
+		obj.velocity.x *= -1.0f;
+	if ((obj.position.y < -750.0f) || (obj.position.y > 750.0f))
+		obj.velocity.y *= -1.0f;
+
+	switch (obj.type)
+	{
+	case NETOBJECT_SHIP: {
+		net_ship_snapshot_t* ship = (net_ship_snapshot_t*)obj.snapshot;
+		ship->position = obj.position;
+		ship->velocity = obj.velocity;
+		ship->angle = obj.angle;
+		ship->health = obj.health;
+	} break;
+	case NETOBJECT_BULLET: {
+		net_bullet_snapshot_t* bullet = (net_bullet_snapshot_t*)obj.snapshot;
+		bullet->position = obj.position;
+		bullet->velocity = obj.velocity;
+		bullet->angle = obj.angle;
+		bullet->ownerID = 0;
+	} break;
+	case NETOBJECT_ASTEROID: {
+		net_asteroid_snapshot_t* asteroid = (net_asteroid_snapshot_t*)obj.snapshot;
+		asteroid->position = obj.position;
+		asteroid->velocity = obj.velocity;
+		asteroid->angle = obj.angle;
+		asteroid->health = obj.health;
+	} break;
+	}
+}
+
+void NetSnapshotReport(void* data)
+{
+	arguments args = *(arguments*)data;
+	float seconds = (args.arg_list.size() > 0) ? std::stof(args.arg_list[0]) : 10.0f;
+	uint ship_count = (args.arg_list.size() > 1) ? (uint)std::stoi(args.arg_list[1]) : 8;
+	uint asteroid_count = (args.arg_list.size() > 2) ? (uint)std::stoi(args.arg_list[2]) : 30;
+	uint bullet_count = (args.arg_list.size() > 3) ? (uint)std::stoi(args.arg_list[3]) : 40;
+
+	const float hertz = 20.0f;
+	const uint ack_delay_frames = 2;	// ~100ms round trip at 20hz
+	const float delta_seconds = 1.0f / hertz;
+	uint frame_count = (uint)(seconds * hertz);
+
+	NetObjectTypeDefinition defns[NUM_NET_REPORT_CATEGORIES];
+	AddShipSnapshotFields(defns[NET_REPORT_SHIPS]);
+	AddAsteroidSnapshotFields(defns[NET_REPORT_ASTEROIDS]);
+	AddBulletSnapshotFields(defns[NET_REPORT_BULLETS]);
+	AppendSnapShot full_appends[NUM_NET_REPORT_CATEGORIES] = { ShipAppendSnapShot, AsteroidAppendSnapShot, BulletAppendSnapShot };
+	uint8_t types[NUM_NET_REPORT_CATEGORIES] = { NETOBJECT_SHIP, NETOBJECT_ASTEROID, NETOBJECT_BULLET };
+	uint counts[NUM_NET_REPORT_CATEGORIES] = { ship_count, asteroid_count, bullet_count };
+
+	std::vector<net_report_object_t> objects;
+	std::vector<uint> categories;
+	uint16_t next_net_id = 0;
+	for (uint category = 0; category < NUM_NET_REPORT_CATEGORIES; ++category)
+	{
+		for (uint index = 0; index < counts[category]; ++index)
+		{
+			objects.push_back(net_report_object_t());
+			categories.push_back(category);
+			NetReportSpawn(objects.back(), types[category], next_net_id++, defns[category].m_quantizedCount);
+		}
+	}
+
+	uint64_t full_bytes[NUM_NET_REPORT_CATEGORIES] = { 0, 0, 0 };
+	uint64_t delta_bytes[NUM_NET_REPORT_CATEGORIES] = { 0, 0, 0 };
+	uint64_t full_total = 0;
+	uint64_t delta_total = 0;
+	uint decode_errors = 0;
+	std::vector<net_report_ack_t> acks;
+	std::vector<uint32_t> quantized;
+	std::vector<uint32_t> decoded;
+
+	uint header_size = sizeof(uint16_t) + sizeof(uint16_t) + sizeof(float);
+	NetMessage update_msg(NET_OBJECT_UPDATE);
+	update_msg.m_payloadBytesUsed = header_size;
+
+	for (uint frame = 1; frame <= frame_count; ++frame)
+	{
+		uint16_t net_frame = (uint16_t)frame;
+
+		// acks for updates sent ack_delay_frames ago come back
+		for (uint ack_index = 0; ack_index < acks.size();)
+		{
+			net_report_ack_t ack = acks[ack_index];
+			if (ack.arrive_frame > frame)
+			{
+				++ack_index;
+				continue;
+			}
+
+			net_report_object_t& obj = objects[ack.object_index];
+			if ((obj.net_id == ack.net_id) && ((obj.acked_frame == NET_OBJECT_NO_FRAME) || ((int16_t)(ack.frame - (uint16_t)obj.acked_frame) > 0)))
+				obj.acked_frame = ack.frame;
+
+			acks[ack_index] = acks.back();
+			acks.pop_back();
+		}
+
+		for (uint index = 0; index < objects.size(); ++index)
+		{
+			net_report_object_t& obj = objects[index];
+			uint category = categories[index];
+			NetObjectTypeDefinition& defn = defns[category];
+
+			// bullets die and new ones (new ids, no baseline) take their place
+			if ((obj.type == NETOBJECT_BULLET) && (obj.lifetime <= 0.0f))
+				NetReportSpawn(obj, obj.type, next_net_id++, defn.m_quantizedCount);
+
+			NetReportStep(obj, delta_seconds);
+
+			// old path - whole snapshot in its own message whenever anything changed
+			if (!obj.has_sent_full || (memcmp(obj.last_full_sent, obj.snapshot, sizeof(obj.snapshot)) != 0))
+			{
+				float host_time = (float)frame * delta_seconds;
+				NetMessage full_msg(NET_OBJECT_UPDATE);
+				full_msg.write_bytes(&obj.net_id, sizeof(uint16_t));
+				full_msg.write_bytes(&host_time, sizeof(float));
+				full_appends[category](&full_msg, obj.snapshot);
+
+				uint bytes = UDP_MESSAGE_HEADER_SIZE + full_msg.m_payloadBytesUsed;
+				full_bytes[category] += bytes;
+				full_total += bytes;
+				memcpy(obj.last_full_sent, obj.snapshot, sizeof(obj.snapshot));
+				obj.has_sent_full = true;
+			}
+
+			// new path - quantized, delta against the newest acked frame
+			uint count = defn.m_quantizedCount;
+			quantized.resize(count);
+			decoded.resize(count);
+			defn.Quantize(quantized.data(), obj.snapshot);
+			uint slot = frame % NET_OBJECT_HISTORY;
+			memcpy(&obj.history[slot * count], quantized.data(), count * sizeof(uint32_t));
+			obj.history_frames[slot] = net_frame;
+
+			uint32_t const* baseline = nullptr;
+			uint16_t frames_back = 0;
+			if (obj.acked_frame != NET_OBJECT_NO_FRAME)
+			{
+				frames_back = (uint16_t)(net_frame - (uint16_t)obj.acked_frame);
+				uint baseline_slot = obj.acked_frame % NET_OBJECT_HISTORY;
+				if ((frames_back < NET_OBJECT_HISTORY) && (obj.history_frames[baseline_slot] == obj.acked_frame))
+					baseline = &obj.history[baseline_slot * count];
+			}
+
+			if ((baseline != nullptr) && (defn.GetDirtyMask(quantized.data(), baseline) == 0))
+				continue;
+
+			NetMessage record_msg;
+			NetObjectWriteSnapshotRecord(&record_msg, &defn, obj.net_id, quantized.data(), baseline, frames_back);
+			delta_bytes[category] += record_msg.m_payloadBytesUsed;
+
+			// read it back the way a client would, against the client's own copy of the baseline
+			record_msg.m_readBytes = sizeof(uint16_t) + sizeof(uint8_t);
+			BitStreamReader reader(&record_msg);
+			bool has_baseline = false;
+			uint32_t read_back = 0;
+			reader.read_bool(&has_baseline);
+			uint32_t const* client_baseline = nullptr;
+			if (has_baseline)
+			{
+				reader.read_bits(&read_back, NET_OBJECT_BASELINE_BITS);
+				uint16_t baseline_frame = (uint16_t)(net_frame - read_back);
+				uint baseline_slot = baseline_frame % NET_OBJECT_HISTORY;
+				if (obj.client_history_frames[baseline_slot] == baseline_frame)
+					client_baseline = &obj.client_history[baseline_slot * count];
+			}
+
+			if ((has_baseline && (client_baseline == nullptr))
+				|| !defn.ReadFields(reader, decoded.data(), client_baseline)
+				|| (memcmp(decoded.data(), quantized.data(), count * sizeof(uint32_t)) != 0))
+			{
+				++decode_errors;
+			}
+			memcpy(&obj.client_history[slot * count], decoded.data(), count * sizeof(uint32_t));
+			obj.client_history_frames[slot] = net_frame;
+
+			if (update_msg.m_payloadBytesUsed + record_msg.m_payloadBytesUsed > NET_OBJECT_UPDATE_MAX_BYTES)
+			{
+				delta_total += UDP_MESSAGE_HEADER_SIZE + update_msg.m_payloadBytesUsed;
+				update_msg.m_payloadBytesUsed = header_size;
+			}
+			update_msg.m_payloadBytesUsed += record_msg.m_payloadBytesUsed;
+
+			net_report_ack_t ack = { frame + ack_delay_frames, index, obj.net_id, net_frame };
+			acks.push_back(ack);
+		}
+
+		if (update_msg.m_payloadBytesUsed > header_size)
+		{
+			delta_total += UDP_MESSAGE_HEADER_SIZE + update_msg.m_payloadBytesUsed;
+			update_msg.m_payloadBytesUsed = header_size;
+		}
+	}
+
+	char const* names[NUM_NET_REPORT_CATEGORIES] = { "ships", "asteroids", "bullets" };
+	g_console->ConsolePrintf(Rgba(255, 255, 255, 255), "net_snapshot_report: %.0f s at %.0f hz, acks after %u frames", seconds, hertz, ack_delay_frames);
+	for (uint category = 0; category < NUM_NET_REPORT_CATEGORIES; ++category)
+	{
+		float full_rate = (float)full_bytes[category] / seconds;
+		float delta_rate = (float)delta_bytes[category] / seconds;
+		g_console->ConsolePrintf(Rgba(255, 255, 255, 255), "  %3u %-9s full %8.0f B/s  delta %8.0f B/s  (%.1f%%)",
+			counts[category], names[category], full_rate, delta_rate, (full_rate > 0.0f) ? (100.0f * delta_rate / full_rate) : 0.0f);
+	}
+
+	float full_total_rate = (float)full_total / seconds;
+	float delta_total_rate = (float)delta_total / seconds;
+	g_console->ConsolePrintf(Rgba(255, 255, 255, 255), "  total per client: full %8.0f B/s  delta %8.0f B/s  (%.1f%%), %u decode errors",
+		full_total_rate, delta_total_rate, (full_total_rate > 0.0f) ? (100.0f * delta_total_rate / full_total_rate) : 0.0f, decode_errors);
+}
@@ -6,13 +6,14 @@
 #include "Engine/Core/CommandSystem.hpp"
 #include "Engine/Network/NetAddress.hpp"
 #include "Engine/Network/NetMessage.hpp"
+#include "Engine/Core/FixedTickLoop.hpp"
 #include <vector>
 
 class Texture2D;
 class Sampler;
 class KerningFont;
 class TCPSocket;
-class TCPSession;
+class UDPSession;
 class RemoteCommandService;
 class Player;
 class Bullet;
@@ -75,12 +76,10 @@ public:
 	Game();
 	~Game();
 	void Update(float deltaSeconds);
+	void UpdateTick(float tickSeconds);
 	void CreateExplosion(Vector2 pos, float radius);
 	void UpdateExplosions(float deltaSeconds);
 	void RenderExplosions() const;
-	void SmoothShips(float deltaSeconds);
-	void SmoothAsteroids(float deltaSeconds);
-	void SmoothBullets();
 	void HostManageRespawns();
 	void UpdateShips(float deltaSeconds);
 	void UpdateBullets(float deltaSeconds);
@@ -152,10 +151,11 @@ public:
 
 	//Network
 	RemoteCommandService* m_rcs;
-	TCPSession* m_gameSession;
+	UDPSession* m_gameSession;
 
 	// Syncing
 	uint m_prevConnectionCount;
+	FixedTickLoop m_simLoop;
 
 	//Game Play
 	std::vector<Player*> m_playerList;
@@ -173,6 +173,7 @@ public:
 	Vector2 m_worldDimensions;
 	float m_zoom;
 	uint m_hostCameraValue;
+	float m_netInterestRadius;
 	Texture2D* m_background;
 	Mesh* m_backQuad;
 	eDMState m_hostState;
@@ -5,6 +5,8 @@
 const int WORLD_HEIGHT = 900;
 const int WORLD_WIDTH = 1600;
 const float Z_DEPTH_FROM_CAMERA = 50.0f;
+const float NET_INTEREST_RADIUS = 1200.0f;	// a little past the corners of a client's view
+const float GAME_TICK_RATE = 60.0f;			// host and clients simulate the same ticks at this rate
 
 extern bool g_canWeDrawCosmeticCircle;
 extern bool g_canWeDrawPhysicsCircle;
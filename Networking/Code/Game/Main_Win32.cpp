@@ -2,6 +2,9 @@
 #include "Engine/Core/StringUtils.hpp"
 #include "Engine/Core/ErrorWarningAssert.hpp"
 #include "Engine/Core/Time.hpp"
+#include "Engine/Core/FrameAllocator.hpp"
+#include "Engine/Core/Profiling.hpp"
+#include "Engine/Core/BuildConfig.hpp"
 #include "Engine/Window.hpp"
 #include "Game/GameCommons.hpp"
 #include "Engine/Config.hpp"
@@ -10,7 +13,8 @@
 #include "Engine/EngineConfig.hpp"
 #include "Engine/Render/SimpleRenderer.hpp"
 #include "Engine/Input/Input.hpp"
-#include "Engine/Network/TCPSession.hpp"
+#include "Engine/Network/UDPSession.hpp"
+#include "Engine/Network/NetLinkConditioner.hpp"
 #include "Engine/Network/NetConnection.hpp"
 #include "Engine/Network/Net.hpp"
 #include "Game/Game.hpp"
@@ -73,9 +77,12 @@ void Initialize(HINSTANCE applicationInstanceHandle)
 	g_config->ConfigList();
 	UNUSED(applicationInstanceHandle);
 	SetProcessDPIAware();
+	FrameAllocatorStartup();
+	ProfilerStartup();
 
 	bool net_startup = NetSystemStartup();
 	ASSERT_RECOVERABLE(net_startup, "Failed to Start Network System!");
+	NetLinkLoadConfig();
 
 	g_theApp = new App();
 
@@ -100,6 +107,9 @@ void Shutdown()
 
 	delete g_theApp;
 	g_theApp = nullptr;
+
+	FrameAllocatorShutdown();
+	ProfilerShutdown();
 }
 
 
@@ -112,6 +122,9 @@ int WINAPI WinMain(HINSTANCE applicationInstanceHandle, HINSTANCE, LPSTR command
 
 	while (!g_theApp->IsQuitting())
 	{
+		ResetFrameMemoryTracking();
+		ProfilerEndFrame();
+		FrameAllocatorBeginFrame();
 		g_theApp->RunFrame();
 		g_simpleRenderer->Present();
 	}
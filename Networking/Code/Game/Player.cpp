@@ -7,7 +7,7 @@
 #include "Engine/Math/MathUtils.hpp"
 #include "Game/Game.hpp"
 #include "Engine/Network/NetMessage.hpp"
-#include "Engine/Network/TCPSession.hpp"
+#include "Engine/Network/UDPSession.hpp"
 #include "Engine/Network/NetObject.hpp"
 
 
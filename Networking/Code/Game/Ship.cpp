@@ -7,7 +7,7 @@
 #include "Game/Game.hpp"
 #include "Game/Player.hpp"
 #include "Engine/Network/NetMessage.hpp"
-#include "Engine/Network/TCPSession.hpp"
+#include "Engine/Network/UDPSession.hpp"
 
 
 Ship::Ship()
@@ -16,6 +16,7 @@ Ship::Ship()
 	, m_health(10)
 	, m_timeSinceFired(0.0f)
 	, m_orientationInDegrees(0.0f)
+	, m_lastTickOrientation(0.0f)
 	, m_netID(0)
 	, m_playerID(0)
 	, m_fireState(NORMAL_SHOT)
@@ -38,9 +39,17 @@ void Ship::Update(float deltaSeconds)
 
 	m_timeSinceFired += deltaSeconds;
 
-	m_orientationInDegrees += g_theGame->m_playerList[m_playerID]->m_input.steering_angle * 180.0f * deltaSeconds;
-	m_acceleration.x = g_theGame->m_playerList[m_playerID]->m_input.thrust * CosInDegrees(m_orientationInDegrees);
-	m_acceleration.y = g_theGame->m_playerList[m_playerID]->m_input.thrust * SinInDegrees(m_orientationInDegrees);
+	Simulate(g_theGame->m_playerList[m_playerID]->m_input, deltaSeconds);
+}
+
+void Ship::Simulate(InputState const &input, float deltaSeconds)
+{
+	m_lastTickPosition = m_position;
+	m_lastTickOrientation = m_orientationInDegrees;
+
+	m_orientationInDegrees += input.steering_angle * 180.0f * deltaSeconds;
+	m_acceleration.x = input.thrust * CosInDegrees(m_orientationInDegrees);
+	m_acceleration.y = input.thrust * SinInDegrees(m_orientationInDegrees);
 
 	m_velocity += m_acceleration * deltaSeconds;
 	m_position += m_velocity * deltaSeconds;
@@ -67,10 +76,14 @@ void Ship::Render() const
 
 	g_simpleRenderer->MakeModelMatrixIdentity();
 
+	float alpha = g_theGame->m_simLoop.GetAlpha();
+	Vector2 position = Interpolate(m_lastTickPosition, m_position, alpha);
+	float orientation = LERP(m_lastTickOrientation, m_orientationInDegrees, alpha);
+
 	float text_height = g_theGame->m_font->GetTextHeight(g_theGame->m_playerList[m_playerID]->m_name, 0.75f) + 15.0f;
 
 	Matrix4 name_trans;
-	name_trans.Translate(Vector3(0.0f + m_position.x, text_height + m_position.y + m_radius, 0.0f));
+	name_trans.Translate(Vector3(0.0f + position.x, text_height + position.y + m_radius, 0.0f));
 	g_simpleRenderer->SetModelMatrix(name_trans);
 
 	g_simpleRenderer->EnableBlend(BLEND_SRC_ALPHA, BLEND_INV_SRC_ALPHA);
@@ -80,8 +93,8 @@ void Ship::Render() const
 
 	g_simpleRenderer->MakeModelMatrixIdentity();
 	Matrix4 transform;
-	transform.RotateDegreesAboutZ(m_orientationInDegrees - 90.0f);
-	transform.Translate(m_position);
+	transform.RotateDegreesAboutZ(orientation - 90.0f);
+	transform.Translate(position);
 	g_simpleRenderer->SetModelMatrix(transform);
 
 	unsigned char chnl = RangeMapUnsignedChar(1, 10, 0, 255, (unsigned char)m_health);
@@ -5,6 +5,7 @@
 
 class Sampler;
 class ShaderProgram;
+struct InputState;
 
 struct Dead_Reckon_Ship
 {
@@ -26,6 +27,8 @@ public:
 	Ship();
 	~Ship();
 	void Update(float deltaSeconds);
+	// just the movement, shared with net prediction so both ends move the same
+	void Simulate(InputState const &input, float deltaSeconds);
 	void Render() const;
 public:
 	//ID
@@ -47,4 +50,8 @@ public:
 
 	// Dead Reckoning
 	Dead_Reckon_Ship m_deadReckon;
+
+	// where the tick before this one left it, rendering blends from there by the tick alpha
+	Vector2 m_lastTickPosition;
+	float m_lastTickOrientation;
 };
\ No newline at end of file
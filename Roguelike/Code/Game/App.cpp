@@ -1,6 +1,7 @@
 #include "Game/App.hpp"
 #include "Engine/Input/Input.hpp"
 #include "Engine/Core/Time.hpp"
+#include "Engine/Core/Profiling.hpp"
 #include "Game/Game.hpp"
 #include "Game/GameCommons.hpp"
 #include "Engine/Audio/AudioSystem.hpp"
@@ -47,6 +48,7 @@ App::~App()
 
 void App::Update(float deltaSeconds)
 {
+	PROFILE_SCOPE_FUNCTION();
 	if (g_theAudioSystem != nullptr)
 		g_theAudioSystem->Update();
 
@@ -62,6 +64,7 @@ void App::Update(float deltaSeconds)
 
 void App::Render()
 {
+	PROFILE_SCOPE_FUNCTION();
 	if (g_theGame != nullptr)
 		g_theGame->Render();
 }
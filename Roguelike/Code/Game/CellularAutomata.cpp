@@ -1,5 +1,7 @@
 #include "Game/CellularAutomata.hpp"
 #include "Engine/Math/MathUtils.hpp"
+#include "Engine/Core/Job.hpp"
+#include <algorithm>
 
 CellularAutomata::CellularAutomata()
 {
@@ -39,11 +41,23 @@ CellularAutomata::~CellularAutomata()
 
 void CellularAutomata::GenerateTiles(std::vector<Tile>& tilesToCheck)
 {
+	int halfWidth = m_dimensions.x / 2;
+	int halfHeight = m_dimensions.y / 2;
+	std::vector<float> randomRolls(tilesToCheck.size());
+	std::vector<const std::string*> replacements(tilesToCheck.size());
+
 	for(unsigned int iterationCount = 0; iterationCount < m_numberOfPasses; ++iterationCount)
 	{
-		for (int rowIndex = -(m_dimensions.y / 2); rowIndex < (m_dimensions.y / 2); ++rowIndex)
+		// Rolls are made up front so the pass doesn't depend on which thread ran which row
+		for (unsigned int rollIndex = 0; rollIndex < randomRolls.size(); ++rollIndex)
+			randomRolls[rollIndex] = GetRandomFloatInRange(0.0f, 1.0f);
+
+		std::fill(replacements.begin(), replacements.end(), nullptr);
+
+		// Deciding only reads last pass, so rows can run in parallel
+		JobParallelFor(-halfHeight, halfHeight, 1, [&](int rowIndex)
 		{
-			for (int columnIndex = -(m_dimensions.x / 2); columnIndex < (m_dimensions.x / 2); ++columnIndex)
+			for (int columnIndex = -halfWidth; columnIndex < halfWidth; ++columnIndex)
 			{
 				IntVector2 pos(columnIndex, rowIndex);
 				int index = GetTileIndexForTileCoords(pos);
@@ -55,7 +69,7 @@ void CellularAutomata::GenerateTiles(std::vector<Tile>& tilesToCheck)
 					continue;
 
 				std::string tileToCompareName = iterate->first;
-				float random = GetRandomFloatInRange(0.0f, 1.0f);
+				float random = randomRolls[index];
 				float chance = m_chancesToRun.find(tileToCompareName)->second;
 				if (chance < random)
 					break;
@@ -65,11 +79,22 @@ void CellularAutomata::GenerateTiles(std::vector<Tile>& tilesToCheck)
 				int max = m_tileMinMaxs.find(tileToCompareName)->second.y;
 
 				if (neighborCount >= min && neighborCount < max)
-				{
-					std::string newTileName = m_tilesToReplace.find(tileToCompareName)->second;
-					m_tiles[index] = TileDescription::s_tileDefRegistry[newTileName];
-					m_tiles[index].SetPositionInMap(pos);
-				}
+					replacements[index] = &m_tilesToReplace.find(tileToCompareName)->second;
+			}
+		});
+
+		// Building tiles goes through the renderer, keep that on this thread
+		for (int rowIndex = -halfHeight; rowIndex < halfHeight; ++rowIndex)
+		{
+			for (int columnIndex = -halfWidth; columnIndex < halfWidth; ++columnIndex)
+			{
+				IntVector2 pos(columnIndex, rowIndex);
+				int index = GetTileIndexForTileCoords(pos);
+				if (replacements[index] == nullptr)
+					continue;
+
+				m_tiles[index] = TileDescription::s_tileDefRegistry[*replacements[index]];
+				m_tiles[index].SetPositionInMap(pos);
 			}
 		}
 
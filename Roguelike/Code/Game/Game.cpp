@@ -19,6 +19,10 @@
 #include "Game/MapDescription.hpp"
 #include "Game/Behavior.hpp"
 #include "Engine/Core/XMLUtils.hpp"
+#include "Engine/Core/Profiling.hpp"
+#include "Engine/Core/BuildConfig.hpp"
+#include "Engine/Core/Job.hpp"
+#include "Engine/Core/Logging.hpp"
 #include "Game/Player.hpp"
 #include "Game/NPC.hpp"
 #include "Game/Adventure.hpp"
@@ -819,6 +823,10 @@ void Game::InitializeConsole()
 	g_console->RegisterCommand("clear", ConsoleClear);
 	g_console->RegisterCommand("help", ConsoleHelp);
 	g_console->RegisterCommand("quit", ConsoleQuit);
+	RegisterProfilerCommands();
+	RegisterMemoryCommands();
+	RegisterJobCommands();
+	RegisterLogCommands();
 
 	m_fontBackDrop = new Mesh();
 	m_fontBackDrop->CreateOneSidedQuad(Vector3((float)WORLD_WIDTH * 0.5f, (float)WORLD_HEIGHT * 0.01f, 0.0f), Vector3((float)WORLD_WIDTH * 0.5f, (float)WORLD_HEIGHT * 0.98f, 0.0f), Rgba(0, 0, 0, 128));
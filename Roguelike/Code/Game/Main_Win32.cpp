@@ -2,6 +2,11 @@
 #include "Engine/Core/StringUtils.hpp"
 #include "Engine/Core/ErrorWarningAssert.hpp"
 #include "Engine/Core/Time.hpp"
+#include "Engine/Core/Job.hpp"
+#include "Engine/Core/FrameAllocator.hpp"
+#include "Engine/Core/Profiling.hpp"
+#include "Engine/Core/Logging.hpp"
+#include "Engine/Core/BuildConfig.hpp"
 #include "Engine/Window.hpp"
 #include "Game/GameCommons.hpp"
 #include "Engine/Config.hpp"
@@ -60,6 +65,10 @@ void Initialize(HINSTANCE applicationInstanceHandle)
 	g_config->ConfigList();
 	UNUSED(applicationInstanceHandle);
 	SetProcessDPIAware();
+	JobSystemStartup(JOB_TYPE_COUNT);
+	LogStartup();
+	FrameAllocatorStartup();
+	ProfilerStartup();
 
 	g_theApp = new App();
 
@@ -84,6 +93,11 @@ void Shutdown()
 
 	delete g_theApp;
 	g_theApp = nullptr;
+
+	FrameAllocatorShutdown();
+	LogShutdown();
+	JobSystemShutdown();
+	ProfilerShutdown();
 }
 
 
@@ -96,6 +110,9 @@ int WINAPI WinMain(HINSTANCE applicationInstanceHandle, HINSTANCE, LPSTR command
 
 	while (!g_theApp->IsQuitting())
 	{
+		ResetFrameMemoryTracking();
+		ProfilerEndFrame();
+		FrameAllocatorBeginFrame();
 		g_theApp->RunFrame();
 		g_simpleRenderer->Present();
 	}
@@ -2,6 +2,7 @@
 #include "Engine/Input/Input.hpp"
 #include "Engine/Render/Renderer.hpp"
 #include "Engine/Core/Time.hpp"
+#include "Engine/Core/Profiling.hpp"
 #include "Game/Game.hpp"
 #include "Game/GameCommons.hpp"
 #include "Engine/Audio/AudioSystem.hpp"
@@ -41,6 +42,7 @@ App::~App()
 
 void App::Update(float deltaSeconds)
 {
+	PROFILE_SCOPE_FUNCTION();
 	if (g_theAudioSystem != nullptr)
 		g_theAudioSystem->Update();
 
@@ -53,6 +55,7 @@ void App::Update(float deltaSeconds)
 
 void App::Render()
 {
+	PROFILE_SCOPE_FUNCTION();
 	if (g_theGame != nullptr)
 		g_theGame->Render();
 }
@@ -1,4 +1,5 @@
 #include "Game/BlockDefinition.hpp"
+#include "Engine/Render/Renderer.hpp"
 
 BlockDefinition::BlockDefinition()
 	:m_blockType(AIR)
@@ -330,4 +331,57 @@ unsigned char GetLightAndFlagsForBlockType(BlockType blockType)
 		return 0b01110000;
 	
 	return 0b01110000;
-}
\ No newline at end of file
+}
+
+static BlockFaceSprites s_blockFaceSprites[NUM_BLOCKS];
+static Texture* s_blockSpriteTextures[NUM_BLOCK_ATLAS_SPRITES];
+static Texture* s_debugBlockSpriteTextures[NUM_BLOCK_ATLAS_SPRITES];
+
+static unsigned char GetSpriteIndexForFace(const Face& face)
+{
+	// m_vTwo is the sprite's mins corner
+	Vector2 texCoordMins = face.m_vTwo.m_texCoords;
+	int spriteX = (int)((texCoordMins.x * (float)BLOCK_ATLAS_SPRITES_X) + 0.5f);
+	int spriteY = (int)((texCoordMins.y * (float)BLOCK_ATLAS_SPRITES_Y) + 0.5f);
+	return (unsigned char)(spriteX + (spriteY * BLOCK_ATLAS_SPRITES_X));
+}
+
+void InitializeBlockFaceTable()
+{
+	IntVector2 spriteLayout(BLOCK_ATLAS_SPRITES_X, BLOCK_ATLAS_SPRITES_Y);
+	for (int blockTypeIndex = 0; blockTypeIndex < NUM_BLOCKS; ++blockTypeIndex)
+	{
+		BlockDefinition blockDef((unsigned char)blockTypeIndex);
+		BlockFaceSprites& faceSprites = s_blockFaceSprites[blockTypeIndex];
+		faceSprites.m_spriteIndex[BLOCK_FACE_TOP] = GetSpriteIndexForFace(blockDef.m_top);
+		faceSprites.m_spriteIndex[BLOCK_FACE_BOTTOM] = GetSpriteIndexForFace(blockDef.m_bottom);
+		faceSprites.m_spriteIndex[BLOCK_FACE_WEST] = GetSpriteIndexForFace(blockDef.m_front);
+		faceSprites.m_spriteIndex[BLOCK_FACE_EAST] = GetSpriteIndexForFace(blockDef.m_back);
+		faceSprites.m_spriteIndex[BLOCK_FACE_NORTH] = GetSpriteIndexForFace(blockDef.m_left);
+		faceSprites.m_spriteIndex[BLOCK_FACE_SOUTH] = GetSpriteIndexForFace(blockDef.m_right);
+
+		for (int face = 0; face < NUM_BLOCK_FACES; ++face)
+		{
+			int spriteIndex = faceSprites.m_spriteIndex[face];
+			if (s_blockSpriteTextures[spriteIndex] != nullptr)
+				continue;
+
+			IntVector2 spriteCoords(spriteIndex % BLOCK_ATLAS_SPRITES_X, spriteIndex / BLOCK_ATLAS_SPRITES_X);
+			s_blockSpriteTextures[spriteIndex] = g_myRenderer->CreateOrGetSpriteTexture("Data/Images/SimpleMinerAtlas.png", spriteCoords, spriteLayout);
+			s_debugBlockSpriteTextures[spriteIndex] = g_myRenderer->CreateOrGetSpriteTexture("Data/Images/DebugBlockAtlas.png", spriteCoords, spriteLayout);
+		}
+	}
+}
+
+const BlockFaceSprites& GetBlockFaceSprites(unsigned char blockTypeIndex)
+{
+	return s_blockFaceSprites[blockTypeIndex];
+}
+
+Texture* GetBlockSpriteTexture(int spriteIndex, bool useDebugAtlas)
+{
+	if (useDebugAtlas)
+		return s_debugBlockSpriteTextures[spriteIndex];
+
+	return s_blockSpriteTextures[spriteIndex];
+}
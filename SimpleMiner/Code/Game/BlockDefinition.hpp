@@ -23,6 +23,22 @@ enum BlockType {
 	NUM_BLOCKS
 };
 
+// Faces in the order the mesher walks them, named by which way they face
+enum eBlockFace
+{
+	BLOCK_FACE_TOP,		// +Z
+	BLOCK_FACE_BOTTOM,	// -Z
+	BLOCK_FACE_WEST,	// -X, the definition's front
+	BLOCK_FACE_EAST,	// +X, back
+	BLOCK_FACE_NORTH,	// +Y, left
+	BLOCK_FACE_SOUTH,	// -Y, right
+	NUM_BLOCK_FACES
+};
+
+const int BLOCK_ATLAS_SPRITES_X = 16;
+const int BLOCK_ATLAS_SPRITES_Y = 16;
+const int NUM_BLOCK_ATLAS_SPRITES = BLOCK_ATLAS_SPRITES_X * BLOCK_ATLAS_SPRITES_Y;
+
 
 class BlockDefinition
 {
@@ -62,4 +78,15 @@ public:
 	friend unsigned char GetLightAndFlagsForBlockType(BlockType blockType);
 };
 
-unsigned char GetLightAndFlagsForBlockType(BlockType blockType);
\ No newline at end of file
+unsigned char GetLightAndFlagsForBlockType(BlockType blockType);
+
+// Which atlas sprite each face of each block type shows.  Built once on the main
+// thread from the definitions so meshing never has to construct one.
+struct BlockFaceSprites
+{
+	unsigned char m_spriteIndex[NUM_BLOCK_FACES];
+};
+
+void InitializeBlockFaceTable();	// main thread, makes the sprite textures
+const BlockFaceSprites& GetBlockFaceSprites(unsigned char blockTypeIndex);
+Texture* GetBlockSpriteTexture(int spriteIndex, bool useDebugAtlas);
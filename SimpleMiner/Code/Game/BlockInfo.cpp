@@ -88,7 +88,7 @@ bool BlockInfo::IsBlockOpaque() // 0b00X00000
 	if (m_chunk == nullptr)
 		return false;
 
-	unsigned char lightAndFlags = m_chunk->m_blocks[m_blockIndex].m_lightAndFlags;
+	unsigned char lightAndFlags = m_chunk->GetBlock(m_blockIndex).m_lightAndFlags;
 	return (lightAndFlags & BLOCK_OPAQUE_MASK) == BLOCK_OPAQUE_MASK;
 }
 
@@ -97,7 +97,7 @@ bool BlockInfo::IsBlockSkyBlock() // 0bX0000000
 	if (m_chunk == nullptr)
 		return false;
 
-	unsigned char lightAndFlags = m_chunk->m_blocks[m_blockIndex].m_lightAndFlags;
+	unsigned char lightAndFlags = m_chunk->GetBlock(m_blockIndex).m_lightAndFlags;
 	return (lightAndFlags & BLOCK_SKY_MASK) == BLOCK_SKY_MASK;
 }
 
@@ -106,7 +106,7 @@ bool BlockInfo::IsBlockSolid() // 0b000X0000
 	if (m_chunk == nullptr)
 		return false;
 
-	unsigned char lightAndFlags = m_chunk->m_blocks[m_blockIndex].m_lightAndFlags;
+	unsigned char lightAndFlags = m_chunk->GetBlock(m_blockIndex).m_lightAndFlags;
 	return (lightAndFlags & BLOCK_SOLID_MASK) == BLOCK_SOLID_MASK;
 }
 
@@ -115,7 +115,7 @@ bool BlockInfo::IsBlockDirty() // 0b0X000000
 	if (m_chunk == nullptr)
 		return false;
 
-	unsigned char lightAndFlags = m_chunk->m_blocks[m_blockIndex].m_lightAndFlags;
+	unsigned char lightAndFlags = m_chunk->GetBlock(m_blockIndex).m_lightAndFlags;
 	return (lightAndFlags & BLOCK_DIRTY_MASK) == BLOCK_DIRTY_MASK;
 }
 
@@ -124,80 +124,80 @@ unsigned char BlockInfo::GetLightValueForBlock()
 	if (m_chunk == nullptr)
 		return 0;
 
-	return m_chunk->m_blocks[m_blockIndex].m_lightAndFlags & BLOCK_LIGHT_MASK;
+	return m_chunk->GetBlock(m_blockIndex).m_lightAndFlags & BLOCK_LIGHT_MASK;
 }
 
 void BlockInfo::SetLightValueForBlock(unsigned char new_LightValue)
 {
 	unsigned char valueToAdd = new_LightValue & BLOCK_LIGHT_MASK;
-	m_chunk->m_blocks[m_blockIndex].m_lightAndFlags |= valueToAdd;
+	m_chunk->GetMutableBlock(m_blockIndex).m_lightAndFlags |= valueToAdd;
 }
 
 void BlockInfo::SetDirtyFlagAsTrue()
 {
 	if (IsBlockDirty() || m_chunk == nullptr)
 		return;
-	m_chunk->m_blocks[m_blockIndex].m_lightAndFlags |= BLOCK_DIRTY_MASK;
+	m_chunk->GetMutableBlock(m_blockIndex).m_lightAndFlags |= BLOCK_DIRTY_MASK;
 }
 
 void BlockInfo::SetDirtyFlagAsFalse()
 {
 	if (!IsBlockDirty())
 		return;
-	m_chunk->m_blocks[m_blockIndex].m_lightAndFlags &= ~BLOCK_DIRTY_MASK;
+	m_chunk->GetMutableBlock(m_blockIndex).m_lightAndFlags &= ~BLOCK_DIRTY_MASK;
 }
 
 void BlockInfo::SetSkyFlagAsTrue()
 {
 	if (IsBlockSkyBlock())
 		return;
-	m_chunk->m_blocks[m_blockIndex].m_lightAndFlags |= BLOCK_SKY_MASK;
+	m_chunk->GetMutableBlock(m_blockIndex).m_lightAndFlags |= BLOCK_SKY_MASK;
 }
 
 void BlockInfo::SetSkyFlagAsFalse()
 {
 	if (!IsBlockSkyBlock())
 		return;
-	m_chunk->m_blocks[m_blockIndex].m_lightAndFlags &= ~BLOCK_SKY_MASK;
+	m_chunk->GetMutableBlock(m_blockIndex).m_lightAndFlags &= ~BLOCK_SKY_MASK;
 }
 
 void BlockInfo::SetSolidFlagAsTrue()
 {
 	if (IsBlockSolid())
 		return;
-	m_chunk->m_blocks[m_blockIndex].m_lightAndFlags |= BLOCK_SOLID_MASK;
+	m_chunk->GetMutableBlock(m_blockIndex).m_lightAndFlags |= BLOCK_SOLID_MASK;
 }
 
 void BlockInfo::SetSolidFlagAsFalse()
 {
 	if (!IsBlockSolid())
 		return;
-	m_chunk->m_blocks[m_blockIndex].m_lightAndFlags &= ~BLOCK_SOLID_MASK;
+	m_chunk->GetMutableBlock(m_blockIndex).m_lightAndFlags &= ~BLOCK_SOLID_MASK;
 }
 
 void BlockInfo::SetOpaqueFlagAsTrue()
 {
 	if (IsBlockOpaque())
 		return;
-	m_chunk->m_blocks[m_blockIndex].m_lightAndFlags |= BLOCK_OPAQUE_MASK;
+	m_chunk->GetMutableBlock(m_blockIndex).m_lightAndFlags |= BLOCK_OPAQUE_MASK;
 }
 
 void BlockInfo::SetOpaqueFlagAsFalse()
 {
 	if (!IsBlockOpaque())
 		return;
-	m_chunk->m_blocks[m_blockIndex].m_lightAndFlags &= ~BLOCK_OPAQUE_MASK;
+	m_chunk->GetMutableBlock(m_blockIndex).m_lightAndFlags &= ~BLOCK_OPAQUE_MASK;
 }
 
 BlockType BlockInfo::GetBlockType()
 {
-	unsigned char blockType = m_chunk->m_blocks[m_blockIndex].m_blockTypeIndex;
+	unsigned char blockType = m_chunk->GetBlock(m_blockIndex).m_blockTypeIndex;
 	return BlockDefinition(blockType).m_blockType;
 }
 
 BlockDefinition BlockInfo::GetBlockDefinition()
 {
-	unsigned char blockType = m_chunk->m_blocks[m_blockIndex].m_blockTypeIndex;
+	unsigned char blockType = m_chunk->GetBlock(m_blockIndex).m_blockTypeIndex;
 	return BlockDefinition(blockType);
 }
 
@@ -216,7 +216,7 @@ Vector3 BlockInfo::GetBlockWorldPosition()
 
 Block* BlockInfo::GetBlockPointer()
 {
-	return &m_chunk->m_blocks[m_blockIndex];
+	return &m_chunk->GetMutableBlock(m_blockIndex);
 }
 
 void BlockInfo::SetAllNeighborsDirtyFlagAsTrue()
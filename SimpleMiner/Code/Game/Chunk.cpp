@@ -5,16 +5,23 @@
 #include "Engine/Core/ErrorWarningAssert.hpp"
 #include "Engine/Math/Noise.hpp"
 #include "Game/BlockInfo.hpp"
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Core/Time.hpp"
+#include <math.h>
+#include <string.h>
 
 Chunk::Chunk( const IntVector2& chunkCoords )
 	:m_worldBounds( 0.f, 0.f, 0.f, 0.f, 0.f, 0.f )
 	, m_chunkCoords(chunkCoords)
 	, m_isVertexArrayDirty(true)
+	, m_state(CHUNK_REQUESTED)
+	, m_hasSectionsToCompact(false)
+	, m_evictionBucket(-1)
+	, m_evictionSlot(-1)
 	, m_northNeighbor(nullptr)
 	, m_eastNeighbor(nullptr)
 	, m_southNeighbor(nullptr)
 	, m_westNeighbor(nullptr)
-	, m_vboID(0)
 {
 
 	m_worldBounds.mins.x = (float)chunkCoords.x * (float)CHUNK_WIDTH_X;
@@ -23,16 +30,19 @@ Chunk::Chunk( const IntVector2& chunkCoords )
 	m_worldBounds.maxs.x = m_worldBounds.mins.x + (float)CHUNK_WIDTH_X;
 	m_worldBounds.maxs.y = m_worldBounds.mins.y + (float)CHUNK_DEPTH_Y;
 	m_worldBounds.maxs.z = m_worldBounds.mins.z + (float)CHUNK_HEIGHT_Z;
-
-	memset(&m_blocks[0], 0, sizeof(m_blocks));
-	
-	m_vboID = g_myRenderer->CreateVBOID();
-
 }
 
 Chunk::~Chunk()
 {
-	g_myRenderer->DestroyVBO(m_vboID);
+	for (int sectionIndex = 0; sectionIndex < NUM_CHUNK_SECTIONS; ++sectionIndex)
+	{
+		ChunkSection& section = m_sections[sectionIndex];
+		if (section.m_vboID != 0)
+		{
+			g_myRenderer->DestroyVBO(section.m_vboID);
+			g_myRenderer->DestroyVBO(section.m_iboID);
+		}
+	}
 }
 
 void Chunk::Update()
@@ -44,39 +54,277 @@ void Chunk::Update()
 	}
 }
 
-void Chunk::Render() const
+void Chunk::Render(bool useDebugAtlas) const
 {
 	g_myRenderer->StartManipulatingTheDrawnObject();
 	g_myRenderer->TranslateDrawing3D(m_worldBounds.mins);
-	if(m_numVertexes > 0)
-		g_myRenderer->DrawVBO3D_PCT(m_vboID, m_numVertexes, PRIMITIVE_QUADS);
+	for (int sectionIndex = 0; sectionIndex < NUM_CHUNK_SECTIONS; ++sectionIndex)
+	{
+		const ChunkSection& section = m_sections[sectionIndex];
+		for (int batchIndex = 0; batchIndex < (int)section.m_drawBatches.size(); ++batchIndex)
+		{
+			const ChunkMeshBatch& batch = section.m_drawBatches[batchIndex];
+			g_myRenderer->BindTexture(GetBlockSpriteTexture(batch.m_spriteIndex, useDebugAtlas));
+			g_myRenderer->DrawIndexedVBO3D_PCT(section.m_vboID, section.m_iboID, batch.m_firstIndex, batch.m_numIndexes, PRIMITIVE_TRIANGLES);
+		}
+	}
 	g_myRenderer->EndManipulationOfDrawing();
 }
 
 void Chunk::GenerateChunk()
 {
-	for (int z = 0; z < CHUNK_HEIGHT_Z; z++)
+	Block* blocks = new Block[NUM_BLOCKS_PER_CHUNK];
+	GenerateChunkBlocks(m_chunkCoords, blocks);
+	SetAllBlocks(blocks);
+	delete[] blocks;
+}
+
+//-----------------------------------------------------------------------------------------------
+// Light and flag changes only - a type change has to go through SetBlock to keep
+// the non-air count right.  A uniform section gets its own blocks the first time
+// one is written and keeps them from then on, a mesh job might be reading them.
+Block& Chunk::GetMutableBlock(int blockIndex)
+{
+	ChunkSection& section = m_sections[blockIndex >> SECTION_BITS];
+	if (section.m_blocks == nullptr)
+	{
+		Block* blocks = new Block[BLOCKS_PER_SECTION];
+		for (int sectionBlockIndex = 0; sectionBlockIndex < BLOCKS_PER_SECTION; ++sectionBlockIndex)
+			blocks[sectionBlockIndex] = section.m_uniformBlock;
+		section.m_blocks = blocks;
+	}
+
+	return section.m_blocks[blockIndex & SECTION_BLOCK_MASK];
+}
+
+// Main thread only, and dirties just the sections whose faces could change
+void Chunk::SetBlock(int blockIndex, const Block& block)
+{
+	int sectionIndex = blockIndex >> SECTION_BITS;
+	ChunkSection& section = m_sections[sectionIndex];
+	Block& oldBlock = GetMutableBlock(blockIndex);
+	if (oldBlock.m_blockTypeIndex != AIR)
+		--section.m_numNonAirBlocks;
+	if (block.m_blockTypeIndex != AIR)
+		++section.m_numNonAirBlocks;
+
+	oldBlock = block;
+	DirtySectionsAroundBlock(blockIndex);
+
+	// only a section that's all air or has no air left can have gone uniform
+	if (section.m_numNonAirBlocks == 0 || section.m_numNonAirBlocks == BLOCKS_PER_SECTION)
+	{
+		section.m_mayBeUniform = true;
+		m_hasSectionsToCompact = true;
+		if (!IsMeshJobInFlightHereOrNextDoor())
+			CompactSections();
+	}
+}
+
+// Main thread only, and never while a mesh job here or next door is running -
+// they read m_blocks as they go, so it can't change under them.
+void Chunk::MakeSectionUniformIfSame(int sectionIndex)
+{
+	ChunkSection& section = m_sections[sectionIndex];
+	section.m_mayBeUniform = false;
+	if (section.m_blocks == nullptr)
+		return;
+
+	const Block& firstBlock = section.m_blocks[0];
+	for (int sectionBlockIndex = 1; sectionBlockIndex < BLOCKS_PER_SECTION; ++sectionBlockIndex)
+	{
+		const Block& block = section.m_blocks[sectionBlockIndex];
+		if (block.m_blockTypeIndex != firstBlock.m_blockTypeIndex || block.m_lightAndFlags != firstBlock.m_lightAndFlags)
+			return;
+	}
+
+	section.m_uniformBlock = firstBlock;
+	delete[] section.m_blocks;
+	section.m_blocks = nullptr;
+}
+
+// Meshing reads this chunk's blocks and its neighbors' borders
+bool Chunk::IsMeshJobInFlightHereOrNextDoor() const
+{
+	if (m_state == CHUNK_MESHING)
+		return true;
+
+	const Chunk* neighbors[4] = { m_westNeighbor, m_eastNeighbor, m_southNeighbor, m_northNeighbor };
+	for (int neighborIndex = 0; neighborIndex < 4; ++neighborIndex)
+	{
+		if (neighbors[neighborIndex] != nullptr && neighbors[neighborIndex]->m_state == CHUNK_MESHING)
+			return true;
+	}
+	return false;
+}
+
+// Edits made while a mesh job was running leave their sections for later
+void Chunk::CompactSections()
+{
+	for (int sectionIndex = 0; sectionIndex < NUM_CHUNK_SECTIONS; ++sectionIndex)
+	{
+		if (m_sections[sectionIndex].m_mayBeUniform)
+			MakeSectionUniformIfSame(sectionIndex);
+	}
+	m_hasSectionsToCompact = false;
+}
+
+// Takes NUM_BLOCKS_PER_CHUNK blocks and stores only the sections that aren't all
+// one block.  For loading and generating, before anything else can see the chunk.
+void Chunk::SetAllBlocks(const Block* blocks)
+{
+	for (int sectionIndex = 0; sectionIndex < NUM_CHUNK_SECTIONS; ++sectionIndex)
+	{
+		ChunkSection& section = m_sections[sectionIndex];
+		const Block* sectionBlocks = blocks + (sectionIndex << SECTION_BITS);
+		const Block& firstBlock = sectionBlocks[0];
+
+		int numNonAirBlocks = 0;
+		bool isUniform = true;
+		for (int sectionBlockIndex = 0; sectionBlockIndex < BLOCKS_PER_SECTION; ++sectionBlockIndex)
+		{
+			const Block& block = sectionBlocks[sectionBlockIndex];
+			numNonAirBlocks += (block.m_blockTypeIndex != AIR) ? 1 : 0;
+			isUniform &= (block.m_blockTypeIndex == firstBlock.m_blockTypeIndex) && (block.m_lightAndFlags == firstBlock.m_lightAndFlags);
+		}
+
+		section.m_numNonAirBlocks = numNonAirBlocks;
+		section.m_uniformBlock = firstBlock;
+		if (isUniform)
+		{
+			delete[] section.m_blocks;
+			section.m_blocks = nullptr;
+		}
+		else
+		{
+			if (section.m_blocks == nullptr)
+				section.m_blocks = new Block[BLOCKS_PER_SECTION];
+			memcpy(section.m_blocks, sectionBlocks, sizeof(Block) * BLOCKS_PER_SECTION);
+		}
+	}
+
+	SetVertexArrayDirty();
+}
+
+void Chunk::GetAllBlocks(Block* out_blocks) const
+{
+	for (int sectionIndex = 0; sectionIndex < NUM_CHUNK_SECTIONS; ++sectionIndex)
 	{
-		for (int y = 0; y < CHUNK_DEPTH_Y; y++)
+		const ChunkSection& section = m_sections[sectionIndex];
+		Block* sectionBlocks = out_blocks + (sectionIndex << SECTION_BITS);
+		if (section.m_blocks != nullptr)
 		{
-			for (int x = 0; x < CHUNK_WIDTH_X; x++)
+			memcpy(sectionBlocks, section.m_blocks, sizeof(Block) * BLOCKS_PER_SECTION);
+			continue;
+		}
+
+		for (int sectionBlockIndex = 0; sectionBlockIndex < BLOCKS_PER_SECTION; ++sectionBlockIndex)
+			sectionBlocks[sectionBlockIndex] = section.m_uniformBlock;
+	}
+}
+
+int Chunk::GetNumStoredSections() const
+{
+	int numStoredSections = 0;
+	for (int sectionIndex = 0; sectionIndex < NUM_CHUNK_SECTIONS; ++sectionIndex)
+	{
+		if (m_sections[sectionIndex].m_blocks != nullptr)
+			++numStoredSections;
+	}
+	return numStoredSections;
+}
+
+void ComputeChunkGroundHeights(const IntVector2& chunkCoords, int* out_groundHeights)
+{
+	const float MESA_RARE = 0.35f;
+	const float CANYON_RARE = 0.25f;
+
+	float chunkMinX = (float)chunkCoords.x * (float)CHUNK_WIDTH_X;
+	float chunkMinY = (float)chunkCoords.y * (float)CHUNK_DEPTH_Y;
+
+	for (int y = 0; y < CHUNK_DEPTH_Y; y++)
+	{
+		for (int x = 0; x < CHUNK_WIDTH_X; x++)
+		{
+			float columnX = chunkMinX + (float)x;
+			float columnY = chunkMinY + (float)y;
+			float variance = 10.f * Compute2dPerlinNoise(columnX, columnY, 60.f, 5, 0.3f, 2.f, true, 0);
+			float mesaNess = Compute2dPerlinNoise(columnX, columnY, 100.f, 3, 0.6f, 2.f, true, 0);
+			int groundHeight = SEA_LEVEL_HEIGHT + (int)variance + 20;
+
+			if (mesaNess > MESA_RARE)
+			{
+				float mesaHeight = RangeMapFloat(MESA_RARE, 1.f, 0.f, 1.f, mesaNess);
+				for (int smoothing = 0; smoothing < 7; smoothing++)
+					mesaHeight = SmoothStop(mesaHeight);
+				groundHeight = (int)((float)groundHeight + 20.f * mesaHeight);
+			}
+			else if (mesaNess < -CANYON_RARE)
 			{
-				int blockIndex = GetBlockIndexForLocalCoords(IntVector3(x, y, z));
-				GenerateBlock(blockIndex);
+				float mesaHeight = RangeMapFloat(CANYON_RARE, 1.f, 0.f, 1.f, -mesaNess);
+				for (int smoothing = 0; smoothing < 5; smoothing++)
+					mesaHeight = SmoothStop(mesaHeight);
+				groundHeight = (int)((float)groundHeight - 20.f * mesaHeight);
 			}
+
+			out_groundHeights[x | (y << CHUNK_BITS_X)] = groundHeight;
 		}
 	}
-	CreateSandBlocks();
 }
 
-void Chunk::GenerateBlock(int blockIndex)
+// fills [minZ, maxZ) of the column starting at columnBlocks, a layer apart
+static void FillColumnRun(Block* columnBlocks, int minZ, int maxZ, const Block& block)
+{
+	if (minZ < 0)
+		minZ = 0;
+	if (maxZ > CHUNK_HEIGHT_Z)
+		maxZ = CHUNK_HEIGHT_Z;
+
+	for (int z = minZ; z < maxZ; z++)
+		columnBlocks[z << CHUNK_BITS_XY] = block;
+}
+
+void GenerateChunkBlocks(const IntVector2& chunkCoords, Block* out_blocks)
+{
+	const Block stone(STONE, 0b01110000);
+	const Block dirt(DIRT, 0b01110000);
+	const Block grass(GRASS, 0b01110000);
+	const Block sand(SAND, 0b01110000);
+	const Block water(WATER, 0b01000000);
+	const Block air(AIR, 0b01000000);
+
+	int groundHeights[BLOCKS_PER_LAYER];
+	ComputeChunkGroundHeights(chunkCoords, groundHeights);
+
+	for (int columnIndex = 0; columnIndex < BLOCKS_PER_LAYER; columnIndex++)
+	{
+		int groundHeight = groundHeights[columnIndex];
+		Block* columnBlocks = out_blocks + columnIndex;
+
+		// ground right at sea level is a beach all the way down its topsoil, and
+		// the top of ground under water is sand
+		bool isBeach = (groundHeight == SEA_LEVEL_HEIGHT);
+		bool isSeaBed = (groundHeight < SEA_LEVEL_HEIGHT);
+		int airMinHeight = (groundHeight + 1 > SEA_LEVEL_HEIGHT + 1) ? groundHeight + 1 : SEA_LEVEL_HEIGHT + 1;
+
+		FillColumnRun(columnBlocks, 0, groundHeight - 4, stone);
+		FillColumnRun(columnBlocks, groundHeight - 4, groundHeight, isBeach ? sand : dirt);
+		FillColumnRun(columnBlocks, groundHeight, groundHeight + 1, (isBeach || isSeaBed) ? sand : grass);
+		FillColumnRun(columnBlocks, groundHeight + 1, SEA_LEVEL_HEIGHT + 1, water);
+		FillColumnRun(columnBlocks, airMinHeight, CHUNK_HEIGHT_Z, air);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------
+// The block at a time generator the column one replaced, only kept to check and time it against
+static void GenerateBlockPerBlock(const Vector3& chunkMins, Block* blocks, int blockIndex)
 {
 	const float MESA_RARE = 0.35f;
 	const float CANYON_RARE = 0.25f;
 
- 	IntVector3 blockCoords = GetBlockCoordsForIndex(blockIndex);
- 
- 	Vector3 blockWorldMins = Vector3(m_worldBounds.mins.x + (float)blockCoords.x, m_worldBounds.mins.y + (float)blockCoords.y, m_worldBounds.mins.z);
+	IntVector3 blockCoords((blockIndex & CHUNK_X_MASK), (blockIndex & CHUNK_Y_MASK) >> CHUNK_BITS_X, (blockIndex & CHUNK_Z_MASK) >> CHUNK_BITS_XY);
+
+	Vector3 blockWorldMins = Vector3(chunkMins.x + (float)blockCoords.x, chunkMins.y + (float)blockCoords.y, chunkMins.z);
 	float variance = 10.f * Compute2dPerlinNoise(blockWorldMins.x, blockWorldMins.y, 60.f, 5, 0.3f, 2.f, true, 0);
 	float mesaNess = Compute2dPerlinNoise(blockWorldMins.x, blockWorldMins.y, 100.f, 3, 0.6f, 2.f, true, 0);
 	int groundHeight = SEA_LEVEL_HEIGHT + (int)variance + 20;
@@ -112,53 +360,189 @@ void Chunk::GenerateBlock(int blockIndex)
 	{
 		if (blockCoords.z <= SEA_LEVEL_HEIGHT)
 		{
-			m_blocks[blockIndex] = Block(WATER, 0b01000000);
+			blocks[blockIndex] = Block(WATER, 0b01000000);
 		}
 		else
 		{
-			m_blocks[blockIndex] = Block(AIR, 0b01000000);
+			blocks[blockIndex] = Block(AIR, 0b01000000);
 		} 
 	}
 	else if (blockCoords.z >= grassMinHeight)
 	{
-		m_blocks[blockIndex] = Block(GRASS, 0b01110000); 
+		blocks[blockIndex] = Block(GRASS, 0b01110000); 
 	}
 	else if (blockCoords.z >= dirtMinHeight)
 	{
-		m_blocks[blockIndex] = Block(DIRT, 0b01110000);
+		blocks[blockIndex] = Block(DIRT, 0b01110000);
 	}
 	else 
 	{
-		m_blocks[blockIndex] = Block(STONE, 0b01110000);
+		blocks[blockIndex] = Block(STONE, 0b01110000);
 	}
 
 	if (groundHeight == SEA_LEVEL_HEIGHT)
 	{
-		BlockDefinition blockDef = BlockDefinition(m_blocks[blockIndex].m_blockTypeIndex);
+		BlockDefinition blockDef = BlockDefinition(blocks[blockIndex].m_blockTypeIndex);
 		if (blockDef.m_blockType == DIRT || blockDef.m_blockType == GRASS)
 		{
-			m_blocks[blockIndex] = Block(SAND, 0b01110000);
+			blocks[blockIndex] = Block(SAND, 0b01110000);
 		}
 	}
 }
 
-void Chunk::CreateSandBlocks()
+static void CreateSandBlocksPerBlock(Block* blocks)
 {
 	for (int blockIndex = 0; blockIndex < NUM_BLOCKS_PER_CHUNK; ++blockIndex)
 	{
-		IntVector3 blockCoords = GetBlockCoordsForIndex(blockIndex);
-		if (blockCoords.z > SEA_LEVEL_HEIGHT)
+		int z = (blockIndex & CHUNK_Z_MASK) >> CHUNK_BITS_XY;
+		if (z > SEA_LEVEL_HEIGHT)
 			return;
 
-		int blockAbove = GetBlockIndexForLocalCoords(blockCoords + IntVector3(0, 0, 1));
-		BlockType currentType = BlockDefinition(m_blocks[blockIndex].m_blockTypeIndex).m_blockType;
-		BlockType blockAboveType = BlockDefinition(m_blocks[blockAbove].m_blockTypeIndex).m_blockType;
+		int blockAbove = blockIndex + BLOCKS_PER_LAYER;
+		BlockType currentType = BlockDefinition(blocks[blockIndex].m_blockTypeIndex).m_blockType;
+		BlockType blockAboveType = BlockDefinition(blocks[blockAbove].m_blockTypeIndex).m_blockType;
 
 		if ((currentType == GRASS || currentType == DIRT) && blockAboveType == WATER)
-			m_blocks[blockIndex] = Block(SAND, 0b01110000);
+			blocks[blockIndex] = Block(SAND, 0b01110000);
 	}
 }
 
+void GenerateChunkBlocksPerBlock(const IntVector2& chunkCoords, Block* out_blocks)
+{
+	Vector3 chunkMins((float)chunkCoords.x * (float)CHUNK_WIDTH_X, (float)chunkCoords.y * (float)CHUNK_DEPTH_Y, 0.f);
+	for (int blockIndex = 0; blockIndex < NUM_BLOCKS_PER_CHUNK; blockIndex++)
+		GenerateBlockPerBlock(chunkMins, out_blocks, blockIndex);
+	CreateSandBlocksPerBlock(out_blocks);
+}
+
+void BenchmarkChunkGeneration(int numChunks)
+{
+	Block* perBlockBlocks = new Block[NUM_BLOCKS_PER_CHUNK];
+	Block* columnBlocks = new Block[NUM_BLOCKS_PER_CHUNK];
+	double perBlockSeconds = 0.0;
+	double columnSeconds = 0.0;
+	int mismatchedChunks = 0;
+
+	// a square of chunks around the origin, so mesas, canyons and sea all turn up
+	int chunksPerSide = (int)ceil(sqrt((float)numChunks));
+	for (int chunkIndex = 0; chunkIndex < numChunks; chunkIndex++)
+	{
+		IntVector2 chunkCoords((chunkIndex % chunksPerSide) - (chunksPerSide / 2), (chunkIndex / chunksPerSide) - (chunksPerSide / 2));
+
+		double startSeconds = GetCurrentTimeSeconds();
+		GenerateChunkBlocksPerBlock(chunkCoords, perBlockBlocks);
+		double perBlockEndSeconds = GetCurrentTimeSeconds();
+		GenerateChunkBlocks(chunkCoords, columnBlocks);
+		double columnEndSeconds = GetCurrentTimeSeconds();
+
+		perBlockSeconds += perBlockEndSeconds - startSeconds;
+		columnSeconds += columnEndSeconds - perBlockEndSeconds;
+		if (memcmp(perBlockBlocks, columnBlocks, sizeof(Block) * NUM_BLOCKS_PER_CHUNK) != 0)
+			mismatchedChunks++;
+	}
+
+	delete[] perBlockBlocks;
+	delete[] columnBlocks;
+
+	DebuggerPrintf("Chunk generation, %d chunks: per block %.1f chunks/s, by column %.1f chunks/s (%.1fx), %d chunks differ\n",
+		numChunks, (double)numChunks / perBlockSeconds, (double)numChunks / columnSeconds, perBlockSeconds / columnSeconds, mismatchedChunks);
+}
+
+void BenchmarkChunkMeshing(int chunksPerSide)
+{
+	// the border ring is only there so the middle chunks have all their neighbors
+	int gridSide = chunksPerSide + 2;
+	std::vector<Chunk*> grid(gridSide * gridSide);
+	for (int y = 0; y < gridSide; y++)
+	{
+		for (int x = 0; x < gridSide; x++)
+		{
+			Chunk* chunk = new Chunk(IntVector2(x - (gridSide / 2), y - (gridSide / 2)));
+			chunk->GenerateChunk();
+			grid[x + (y * gridSide)] = chunk;
+		}
+	}
+
+	for (int y = 0; y < gridSide; y++)
+	{
+		for (int x = 0; x < gridSide; x++)
+		{
+			Chunk* chunk = grid[x + (y * gridSide)];
+			chunk->m_westNeighbor = (x > 0) ? grid[(x - 1) + (y * gridSide)] : nullptr;
+			chunk->m_eastNeighbor = (x < gridSide - 1) ? grid[(x + 1) + (y * gridSide)] : nullptr;
+			chunk->m_southNeighbor = (y > 0) ? grid[x + ((y - 1) * gridSide)] : nullptr;
+			chunk->m_northNeighbor = (y < gridSide - 1) ? grid[x + ((y + 1) * gridSide)] : nullptr;
+		}
+	}
+
+	std::vector<Vertex3_PCT> perBlockVertexes;
+	double perBlockSeconds = 0.0;
+	double greedySeconds = 0.0;
+	int perBlockNumVertexes = 0;
+	int greedyNumVertexes = 0;
+	int greedyNumIndexes = 0;
+	int numStoredSections = 0;
+	for (int y = 1; y <= chunksPerSide; y++)
+	{
+		for (int x = 1; x <= chunksPerSide; x++)
+		{
+			Chunk* chunk = grid[x + (y * gridSide)];
+
+			double startSeconds = GetCurrentTimeSeconds();
+			chunk->BuildVertexArrayPerBlock(perBlockVertexes);
+			double perBlockEndSeconds = GetCurrentTimeSeconds();
+			chunk->QueueDirtySectionsForMeshing();
+			chunk->BuildVertexArray();
+			double greedyEndSeconds = GetCurrentTimeSeconds();
+
+			perBlockSeconds += perBlockEndSeconds - startSeconds;
+			greedySeconds += greedyEndSeconds - perBlockEndSeconds;
+			perBlockNumVertexes += (int)perBlockVertexes.size();
+			for (int sectionIndex = 0; sectionIndex < NUM_CHUNK_SECTIONS; sectionIndex++)
+			{
+				greedyNumVertexes += (int)chunk->m_sections[sectionIndex].m_mesh.m_vertexes.size();
+				greedyNumIndexes += (int)chunk->m_sections[sectionIndex].m_mesh.m_indexes.size();
+			}
+			numStoredSections += chunk->GetNumStoredSections();
+		}
+	}
+
+	int numChunks = chunksPerSide * chunksPerSide;
+	DebuggerPrintf("Chunk meshing, %d chunks: per block %d vertexes %.3f ms per chunk, greedy %d vertexes %d indexes %.3f ms per chunk (%.1fx fewer vertexes, %.1fx faster)\n",
+		numChunks, perBlockNumVertexes / numChunks, 1000.0 * perBlockSeconds / (double)numChunks,
+		greedyNumVertexes / numChunks, greedyNumIndexes / numChunks, 1000.0 * greedySeconds / (double)numChunks,
+		(double)perBlockNumVertexes / (double)greedyNumVertexes, perBlockSeconds / greedySeconds);
+	DebuggerPrintf("Chunk blocks: %.1f of %d sections stored, %d KB per chunk (%d KB unsectioned)\n",
+		(double)numStoredSections / (double)numChunks, NUM_CHUNK_SECTIONS,
+		(numStoredSections * BLOCKS_PER_SECTION * (int)sizeof(Block)) / (numChunks * 1024), (NUM_BLOCKS_PER_CHUNK * (int)sizeof(Block)) / 1024);
+
+	// dig out the top block of a column in the middle chunk and remesh what that dirtied
+	Chunk* middleChunk = grid[(gridSide / 2) + ((gridSide / 2) * gridSide)];
+	for (int sectionIndex = 0; sectionIndex < NUM_CHUNK_SECTIONS; sectionIndex++)
+	{
+		middleChunk->m_sections[sectionIndex].m_isDirty = false;
+		middleChunk->m_sections[sectionIndex].m_isMeshQueued = false;
+	}
+
+	int digIndex = (NUM_BLOCKS_PER_CHUNK - BLOCKS_PER_LAYER) + (CHUNK_WIDTH_X / 2) + ((CHUNK_DEPTH_Y / 2) * CHUNK_WIDTH_X);
+	while (digIndex >= BLOCKS_PER_LAYER && middleChunk->GetBlock(digIndex).m_blockTypeIndex == AIR)
+		digIndex -= BLOCKS_PER_LAYER;
+	middleChunk->SetBlock(digIndex, Block(AIR, GetLightAndFlagsForBlockType(AIR)));
+
+	int numDirtySections = 0;
+	for (int sectionIndex = 0; sectionIndex < NUM_CHUNK_SECTIONS; sectionIndex++)
+		numDirtySections += middleChunk->m_sections[sectionIndex].m_isDirty ? 1 : 0;
+
+	double digStartSeconds = GetCurrentTimeSeconds();
+	middleChunk->QueueDirtySectionsForMeshing();
+	middleChunk->BuildVertexArray();
+	double digSeconds = GetCurrentTimeSeconds() - digStartSeconds;
+	DebuggerPrintf("Digging one block remeshed %d of %d sections in %.3f ms\n", numDirtySections, NUM_CHUNK_SECTIONS, 1000.0 * digSeconds);
+
+	for (int gridIndex = 0; gridIndex < (int)grid.size(); gridIndex++)
+		delete grid[gridIndex];
+}
+
 int Chunk::GetBlockInFrontIndex(int blockIndex)
 {
 	int frontIndex;
@@ -268,30 +652,514 @@ IntVector3 Chunk::GetBlockCoordsForIndex(int blockIndex)
 	return IntVector3(x, y, z);
 }
 
+// Main thread only, the synchronous path - no job in between
 void Chunk::PopulateVertexArray()
 {
-	std::vector<Vertex3_PCT> vertexes;
+	QueueDirtySectionsForMeshing();
+	BuildVertexArray();
+	UploadVertexArray();
+}
+
+//-----------------------------------------------------------------------------------------------
+// Greedy meshing, a section at a time.  The section's blocks plus a one block
+// border from the sections around it are copied into a padded scratch volume,
+// then each face direction is swept a slice at a time and visible faces of the
+// same type and light are grown into the biggest rectangles they fill.  Each
+// sprite is its own wrapping texture, so a merged face's texcoords run 0..size
+// and the sprite repeats once per block.
+
+const int MESH_PADDED_X = CHUNK_WIDTH_X + 2;
+const int MESH_PADDED_Y = CHUNK_DEPTH_Y + 2;
+const int MESH_PADDED_Z = SECTION_HEIGHT_Z + 2;
+const int MESH_PADDED_LAYER = MESH_PADDED_X * MESH_PADDED_Y;
+const int NUM_MESH_PADDED_BLOCKS = MESH_PADDED_LAYER * MESH_PADDED_Z;
+const int MESH_PADDED_ORIGIN = 1 + MESH_PADDED_X + MESH_PADDED_LAYER;	// where local 0,0,0 is
+const int MAX_MESH_SLICE_BLOCKS = CHUNK_WIDTH_X * SECTION_HEIGHT_Z;		// an x or y slice, the biggest
+
+static const int SECTION_SIZE_ON_AXIS[3] = { CHUNK_WIDTH_X, CHUNK_DEPTH_Y, SECTION_HEIGHT_Z };
+static const int MESH_PADDED_STRIDE_ON_AXIS[3] = { 1, MESH_PADDED_X, MESH_PADDED_LAYER };
+
+// How a face sits in its slice.  Corners are in the old mesher's vertex order, as
+// 0/1 along the slice's A and B axes, so merged faces wind and texture the same.
+struct BlockFaceLayout
+{
+	int m_normalAxis;
+	int m_normalSign;
+	int m_axisA;
+	int m_axisB;
+	bool m_isUAlongA;
+	int m_cornerA[4];
+	int m_cornerB[4];
+};
+
+static const BlockFaceLayout BLOCK_FACE_LAYOUTS[NUM_BLOCK_FACES] =
+{
+	{ 2,  1, 0, 1, false, { 0, 1, 1, 0 }, { 0, 0, 1, 1 } },	// top
+	{ 2, -1, 0, 1, false, { 1, 0, 0, 1 }, { 0, 0, 1, 1 } },	// bottom
+	{ 0, -1, 1, 2, true,  { 0, 0, 1, 1 }, { 0, 1, 1, 0 } },	// west
+	{ 0,  1, 1, 2, true,  { 1, 1, 0, 0 }, { 0, 1, 1, 0 } },	// east
+	{ 1,  1, 0, 2, true,  { 0, 0, 1, 1 }, { 0, 1, 1, 0 } },	// north
+	{ 1, -1, 0, 2, true,  { 1, 1, 0, 0 }, { 0, 1, 1, 0 } },	// south
+};
+static const int FACE_CORNER_U[4] = { 0, 0, 1, 1 };
+static const int FACE_CORNER_V[4] = { 1, 0, 0, 1 };
+
+struct ChunkMeshQuad
+{
+	unsigned char m_face;
+	unsigned char m_spriteIndex;
+	unsigned char m_lightLevel;
+	unsigned char m_slice;
+	unsigned char m_minA;
+	unsigned char m_minB;
+	unsigned char m_sizeA;
+	unsigned char m_sizeB;
+};
+
+struct ChunkMeshScratch
+{
+	unsigned char m_types[NUM_MESH_PADDED_BLOCKS];
+	unsigned char m_isHidden[NUM_MESH_PADDED_BLOCKS];	// faces against it aren't drawn - opaque, or nothing loaded there
+	int m_minBlockOnAxis[3];		// the box around the section's non-air blocks, max exclusive
+	int m_maxBlockOnAxis[3];
+	int m_sliceKeys[MAX_MESH_SLICE_BLOCKS];
+	int m_spriteQuadCursor[NUM_BLOCK_ATLAS_SPRITES];
+	std::vector<ChunkMeshQuad> m_quads;
+};
+
+// one per thread that meshes, never freed
+static thread_local ChunkMeshScratch* t_meshScratch = nullptr;
+
+static inline bool IsBlockOpaque(const Block& block)
+{
+	return (block.m_lightAndFlags & BLOCK_OPAQUE_MASK) == BLOCK_OPAQUE_MASK;
+}
+
+static inline bool IsSectionSolid(const ChunkSection& section)
+{
+	return section.m_blocks == nullptr && IsBlockOpaque(section.m_uniformBlock);
+}
+
+// Nothing in it can show a face - all air, or all opaque with only opaque
+// sections or unloaded chunks around it
+static bool IsSectionWithoutFaces(const Chunk& chunk, int sectionIndex)
+{
+	const ChunkSection& section = chunk.m_sections[sectionIndex];
+	if (section.m_numNonAirBlocks == 0)
+		return true;
+
+	if (!IsSectionSolid(section))
+		return false;
+
+	if (sectionIndex > 0 && !IsSectionSolid(chunk.m_sections[sectionIndex - 1]))
+		return false;
+	if (sectionIndex < NUM_CHUNK_SECTIONS - 1 && !IsSectionSolid(chunk.m_sections[sectionIndex + 1]))
+		return false;
+
+	const Chunk* neighbors[4] = { chunk.m_westNeighbor, chunk.m_eastNeighbor, chunk.m_southNeighbor, chunk.m_northNeighbor };
+	for (int neighborIndex = 0; neighborIndex < 4; ++neighborIndex)
+	{
+		if (neighbors[neighborIndex] != nullptr && !IsSectionSolid(neighbors[neighborIndex]->m_sections[sectionIndex]))
+			return false;
+	}
+	return true;
+}
+
+static void CopyBorderFromNeighbor(const Chunk* neighbor, int sectionIndex, int paddedStart, int paddedStride, int neighborStart, int neighborStride, int count, ChunkMeshScratch& scratch)
+{
+	if (neighbor == nullptr)
+		return;
+
+	const ChunkSection& section = neighbor->m_sections[sectionIndex];
+	if (section.m_blocks == nullptr)
+	{
+		unsigned char isHidden = IsBlockOpaque(section.m_uniformBlock) ? 1 : 0;
+		for (int z = 0; z < SECTION_HEIGHT_Z; ++z)
+		{
+			int padded = paddedStart + (z * MESH_PADDED_LAYER);
+			for (int step = 0; step < count; ++step, padded += paddedStride)
+				scratch.m_isHidden[padded] = isHidden;
+		}
+		return;
+	}
+
+	for (int z = 0; z < SECTION_HEIGHT_Z; ++z)
+	{
+		int padded = paddedStart + (z * MESH_PADDED_LAYER);
+		int sectionBlockIndex = neighborStart + (z * BLOCKS_PER_LAYER);
+		for (int step = 0; step < count; ++step)
+		{
+			scratch.m_isHidden[padded] = IsBlockOpaque(section.m_blocks[sectionBlockIndex]) ? 1 : 0;
+			padded += paddedStride;
+			sectionBlockIndex += neighborStride;
+		}
+	}
+}
+
+// the layer of the section above or below that touches this one
+static void CopyBorderFromSection(const ChunkSection& section, int paddedStart, int firstSectionBlock, ChunkMeshScratch& scratch)
+{
+	for (int y = 0; y < CHUNK_DEPTH_Y; ++y)
+	{
+		int padded = paddedStart + (y * MESH_PADDED_X);
+		int sectionBlockIndex = firstSectionBlock + (y * CHUNK_WIDTH_X);
+		for (int x = 0; x < CHUNK_WIDTH_X; ++x, ++padded, ++sectionBlockIndex)
+		{
+			const Block& block = (section.m_blocks != nullptr) ? section.m_blocks[sectionBlockIndex] : section.m_uniformBlock;
+			scratch.m_isHidden[padded] = IsBlockOpaque(block) ? 1 : 0;
+		}
+	}
+}
+
+static void FillMeshScratch(const Chunk& chunk, int sectionIndex, ChunkMeshScratch& scratch)
+{
+	// the border starts hidden, which is also what stops faces at the top and bottom of the world
+	memset(scratch.m_types, AIR, sizeof(scratch.m_types));
+	memset(scratch.m_isHidden, 1, sizeof(scratch.m_isHidden));
+
+	// only the layers with something in them get swept
+	const ChunkSection& section = chunk.m_sections[sectionIndex];
+	int minZ = 0;
+	int maxZ = SECTION_HEIGHT_Z;
+	if (section.m_blocks == nullptr)
+	{
+		unsigned char blockType = section.m_uniformBlock.m_blockTypeIndex;
+		unsigned char isHidden = IsBlockOpaque(section.m_uniformBlock) ? 1 : 0;
+		for (int z = 0; z < SECTION_HEIGHT_Z; ++z)
+		{
+			for (int y = 0; y < CHUNK_DEPTH_Y; ++y)
+			{
+				int padded = MESH_PADDED_ORIGIN + (z * MESH_PADDED_LAYER) + (y * MESH_PADDED_X);
+				memset(&scratch.m_types[padded], blockType, CHUNK_WIDTH_X);
+				memset(&scratch.m_isHidden[padded], isHidden, CHUNK_WIDTH_X);
+			}
+		}
+	}
+	else
+	{
+		minZ = SECTION_HEIGHT_Z;
+		maxZ = 0;
+		int sectionBlockIndex = 0;
+		for (int z = 0; z < SECTION_HEIGHT_Z; ++z)
+		{
+			bool isLayerAir = true;
+			for (int y = 0; y < CHUNK_DEPTH_Y; ++y)
+			{
+				int padded = MESH_PADDED_ORIGIN + (z * MESH_PADDED_LAYER) + (y * MESH_PADDED_X);
+				for (int x = 0; x < CHUNK_WIDTH_X; ++x, ++sectionBlockIndex, ++padded)
+				{
+					const Block& block = section.m_blocks[sectionBlockIndex];
+					scratch.m_types[padded] = block.m_blockTypeIndex;
+					scratch.m_isHidden[padded] = IsBlockOpaque(block) ? 1 : 0;
+					isLayerAir &= (block.m_blockTypeIndex == AIR);
+				}
+			}
+
+			if (!isLayerAir)
+			{
+				minZ = (z < minZ) ? z : minZ;
+				maxZ = z + 1;
+			}
+		}
+	}
+
+	scratch.m_minBlockOnAxis[0] = 0;
+	scratch.m_minBlockOnAxis[1] = 0;
+	scratch.m_minBlockOnAxis[2] = minZ;
+	scratch.m_maxBlockOnAxis[0] = CHUNK_WIDTH_X;
+	scratch.m_maxBlockOnAxis[1] = CHUNK_DEPTH_Y;
+	scratch.m_maxBlockOnAxis[2] = maxZ;
+
+	if (sectionIndex > 0)
+		CopyBorderFromSection(chunk.m_sections[sectionIndex - 1], MESH_PADDED_ORIGIN - MESH_PADDED_LAYER, BLOCKS_PER_SECTION - BLOCKS_PER_LAYER, scratch);
+	if (sectionIndex < NUM_CHUNK_SECTIONS - 1)
+		CopyBorderFromSection(chunk.m_sections[sectionIndex + 1], MESH_PADDED_ORIGIN + (SECTION_HEIGHT_Z * MESH_PADDED_LAYER), 0, scratch);
+
+	int westBorder = MESH_PADDED_ORIGIN - 1;
+	int eastBorder = MESH_PADDED_ORIGIN + CHUNK_WIDTH_X;
+	int southBorder = MESH_PADDED_ORIGIN - MESH_PADDED_X;
+	int northBorder = MESH_PADDED_ORIGIN + (CHUNK_DEPTH_Y * MESH_PADDED_X);
+	CopyBorderFromNeighbor(chunk.m_westNeighbor, sectionIndex, westBorder, MESH_PADDED_X, CHUNK_X_MASK, CHUNK_WIDTH_X, CHUNK_DEPTH_Y, scratch);
+	CopyBorderFromNeighbor(chunk.m_eastNeighbor, sectionIndex, eastBorder, MESH_PADDED_X, 0, CHUNK_WIDTH_X, CHUNK_DEPTH_Y, scratch);
+	CopyBorderFromNeighbor(chunk.m_southNeighbor, sectionIndex, southBorder, 1, CHUNK_Y_MASK, 1, CHUNK_WIDTH_X, scratch);
+	CopyBorderFromNeighbor(chunk.m_northNeighbor, sectionIndex, northBorder, 1, 0, 1, CHUNK_WIDTH_X, scratch);
+}
+
+static void AddGreedyQuadsForFace(int face, ChunkMeshScratch& scratch)
+{
+	const BlockFaceLayout& layout = BLOCK_FACE_LAYOUTS[face];
+	int minSlice = scratch.m_minBlockOnAxis[layout.m_normalAxis];
+	int maxSlice = scratch.m_maxBlockOnAxis[layout.m_normalAxis];
+	int minA = scratch.m_minBlockOnAxis[layout.m_axisA];
+	int maxA = scratch.m_maxBlockOnAxis[layout.m_axisA];
+	int minB = scratch.m_minBlockOnAxis[layout.m_axisB];
+	int maxB = scratch.m_maxBlockOnAxis[layout.m_axisB];
+	int sizeA = SECTION_SIZE_ON_AXIS[layout.m_axisA];
+	int sliceStride = MESH_PADDED_STRIDE_ON_AXIS[layout.m_normalAxis];
+	int strideA = MESH_PADDED_STRIDE_ON_AXIS[layout.m_axisA];
+	int strideB = MESH_PADDED_STRIDE_ON_AXIS[layout.m_axisB];
+	int neighborOffset = layout.m_normalSign * sliceStride;
+	int* keys = scratch.m_sliceKeys;
+	for (int slice = minSlice; slice < maxSlice; ++slice)
+	{
+		// key each visible face by light and type, 0 where there's nothing to draw
+		for (int b = minB; b < maxB; ++b)
+		{
+			int padded = MESH_PADDED_ORIGIN + (slice * sliceStride) + (minA * strideA) + (b * strideB);
+			for (int a = minA; a < maxA; ++a, padded += strideA)
+			{
+				unsigned char blockType = scratch.m_types[padded];
+				int lightLevel = MAX_LEVEL;		// lighting is off, see the old mesher
+				bool isVisible = blockType != AIR && !scratch.m_isHidden[padded + neighborOffset];
+				keys[a + (b * sizeA)] = isVisible ? ((lightLevel << 8) | blockType) : 0;
+			}
+		}
+
+		// grow each face along A, then along B while whole rows match, clearing what it takes
+		for (int b = minB; b < maxB; ++b)
+		{
+			for (int a = minA; a < maxA; )
+			{
+				int key = keys[a + (b * sizeA)];
+				if (key == 0)
+				{
+					++a;
+					continue;
+				}
+
+				int width = 1;
+				while (a + width < maxA && keys[a + width + (b * sizeA)] == key)
+					++width;
+
+				int height = 1;
+				for (; b + height < maxB; ++height)
+				{
+					int* row = &keys[a + ((b + height) * sizeA)];
+					int step = 0;
+					while (step < width && row[step] == key)
+						++step;
+					if (step < width)
+						break;
+				}
+
+				for (int clearB = b; clearB < b + height; ++clearB)
+					memset(&keys[a + (clearB * sizeA)], 0, width * sizeof(int));
+
+				ChunkMeshQuad quad;
+				quad.m_face = (unsigned char)face;
+				quad.m_spriteIndex = GetBlockFaceSprites((unsigned char)(key & 0xff)).m_spriteIndex[face];
+				quad.m_lightLevel = (unsigned char)(key >> 8);
+				quad.m_slice = (unsigned char)slice;
+				quad.m_minA = (unsigned char)a;
+				quad.m_minB = (unsigned char)b;
+				quad.m_sizeA = (unsigned char)width;
+				quad.m_sizeB = (unsigned char)height;
+				scratch.m_quads.push_back(quad);
+
+				a += width;
+			}
+		}
+	}
+}
+
+static void BuildSectionMesh(Chunk& chunk, int sectionIndex, ChunkMeshScratch& scratch)
+{
+	ChunkMesh& mesh = chunk.m_sections[sectionIndex].m_mesh;
+	if (IsSectionWithoutFaces(chunk, sectionIndex))
+	{
+		mesh.m_vertexes.clear();
+		mesh.m_indexes.clear();
+		mesh.m_batches.clear();
+		return;
+	}
+
+	FillMeshScratch(chunk, sectionIndex, scratch);
+	scratch.m_quads.clear();
+	for (int face = 0; face < NUM_BLOCK_FACES; ++face)
+		AddGreedyQuadsForFace(face, scratch);
+
+	// one batch per sprite, quads sorted into them by counting
+	int numQuads = (int)scratch.m_quads.size();
+	memset(scratch.m_spriteQuadCursor, 0, sizeof(scratch.m_spriteQuadCursor));
+	for (int quadIndex = 0; quadIndex < numQuads; ++quadIndex)
+		++scratch.m_spriteQuadCursor[scratch.m_quads[quadIndex].m_spriteIndex];
+
+	mesh.m_batches.clear();
+	int firstQuad = 0;
+	for (int spriteIndex = 0; spriteIndex < NUM_BLOCK_ATLAS_SPRITES; ++spriteIndex)
+	{
+		int spriteQuads = scratch.m_spriteQuadCursor[spriteIndex];
+		if (spriteQuads == 0)
+			continue;
+
+		ChunkMeshBatch batch;
+		batch.m_spriteIndex = spriteIndex;
+		batch.m_firstIndex = firstQuad * 6;
+		batch.m_numIndexes = spriteQuads * 6;
+		mesh.m_batches.push_back(batch);
+
+		scratch.m_spriteQuadCursor[spriteIndex] = firstQuad;
+		firstQuad += spriteQuads;
+	}
+
+	float sectionMinZ = (float)(sectionIndex * SECTION_HEIGHT_Z);
+	mesh.m_vertexes.resize(numQuads * 4);
+	mesh.m_indexes.resize(numQuads * 6);
+	for (int quadIndex = 0; quadIndex < numQuads; ++quadIndex)
+	{
+		const ChunkMeshQuad& quad = scratch.m_quads[quadIndex];
+		const BlockFaceLayout& layout = BLOCK_FACE_LAYOUTS[quad.m_face];
+		int quadSlot = scratch.m_spriteQuadCursor[quad.m_spriteIndex]++;
+		Rgba color = chunk.GetVertexColorForLightLevel(quad.m_lightLevel);
+		float sizeU = layout.m_isUAlongA ? (float)quad.m_sizeA : (float)quad.m_sizeB;
+		float sizeV = layout.m_isUAlongA ? (float)quad.m_sizeB : (float)quad.m_sizeA;
+
+		Vertex3_PCT* vertexes = &mesh.m_vertexes[quadSlot * 4];
+		for (int corner = 0; corner < 4; ++corner)
+		{
+			float position[3];
+			position[layout.m_normalAxis] = (float)(quad.m_slice + (layout.m_normalSign > 0 ? 1 : 0));
+			position[layout.m_axisA] = (float)(quad.m_minA + (layout.m_cornerA[corner] * quad.m_sizeA));
+			position[layout.m_axisB] = (float)(quad.m_minB + (layout.m_cornerB[corner] * quad.m_sizeB));
+
+			vertexes[corner].m_position = Vector3(position[0], position[1], position[2] + sectionMinZ);
+			vertexes[corner].m_color = color;
+			vertexes[corner].m_texCoords = Vector2((float)FACE_CORNER_U[corner] * sizeU, (float)FACE_CORNER_V[corner] * sizeV);
+		}
+
+		// the quad as two triangles, same winding as the old GL_QUADS
+		unsigned int firstVertex = (unsigned int)(quadSlot * 4);
+		unsigned int* indexes = &mesh.m_indexes[quadSlot * 6];
+		indexes[0] = firstVertex;
+		indexes[1] = firstVertex + 1;
+		indexes[2] = firstVertex + 2;
+		indexes[3] = firstVertex;
+		indexes[4] = firstVertex + 2;
+		indexes[5] = firstVertex + 3;
+	}
+}
+
+// Main thread only.  Hands the dirty sections to the next BuildVertexArray.
+void Chunk::QueueDirtySectionsForMeshing()
+{
+	for (int sectionIndex = 0; sectionIndex < NUM_CHUNK_SECTIONS; ++sectionIndex)
+	{
+		ChunkSection& section = m_sections[sectionIndex];
+		if (!section.m_isDirty)
+			continue;
+
+		section.m_isDirty = false;
+		section.m_isMeshQueued = true;
+		section.m_queuedGeneration = section.m_generation;
+	}
+	m_isVertexArrayDirty = false;
+}
+
+// Builds just the queued sections.  Only reads this chunk and its neighbors, safe
+// to run on a job thread.
+void Chunk::BuildVertexArray()
+{
+	if (t_meshScratch == nullptr)
+		t_meshScratch = new ChunkMeshScratch();
+	ChunkMeshScratch& scratch = *t_meshScratch;
+
+	for (int sectionIndex = 0; sectionIndex < NUM_CHUNK_SECTIONS; ++sectionIndex)
+	{
+		if (m_sections[sectionIndex].m_isMeshQueued)
+			BuildSectionMesh(*this, sectionIndex, scratch);
+	}
+}
+
+// The old mesher, a quad per visible block face on the shared atlas.  Kept for
+// BenchmarkChunkMeshing to measure against.
+void Chunk::BuildVertexArrayPerBlock(std::vector<Vertex3_PCT>& vertexes)
+{
+	vertexes.clear();
 	for (int blockIndex = 0; blockIndex < NUM_BLOCKS_PER_CHUNK; ++blockIndex)
 	{
 		AddBlockVertexes(blockIndex, vertexes);
 	}
-	g_myRenderer->UpdateVBO(m_vboID, &vertexes[0], vertexes.size());
-	m_numVertexes = vertexes.size();
+}
+
+// Touches GL, main thread only.  A section edited while its mesh was building has
+// a newer generation, it's still dirty and the stale mesh is thrown away.
+void Chunk::UploadVertexArray()
+{
+	for (int sectionIndex = 0; sectionIndex < NUM_CHUNK_SECTIONS; ++sectionIndex)
+	{
+		ChunkSection& section = m_sections[sectionIndex];
+		if (!section.m_isMeshQueued)
+			continue;
+
+		section.m_isMeshQueued = false;
+		if (section.m_queuedGeneration != section.m_generation)
+			continue;
+
+		section.m_drawBatches = section.m_mesh.m_batches;
+		if (section.m_mesh.m_vertexes.empty())
+			continue;
+
+		if (section.m_vboID == 0)
+		{
+			section.m_vboID = g_myRenderer->CreateVBOID();
+			section.m_iboID = g_myRenderer->CreateVBOID();
+		}
+		g_myRenderer->UpdateVBO(section.m_vboID, &section.m_mesh.m_vertexes[0], section.m_mesh.m_vertexes.size());
+		g_myRenderer->UpdateIBO(section.m_iboID, &section.m_mesh.m_indexes[0], section.m_mesh.m_indexes.size());
+	}
+}
+
+// Main thread only
+void Chunk::SetVertexArrayDirty()
+{
+	for (int sectionIndex = 0; sectionIndex < NUM_CHUNK_SECTIONS; ++sectionIndex)
+		SetSectionDirty(sectionIndex);
+}
+
+void Chunk::SetSectionDirty(int sectionIndex)
+{
+	ChunkSection& section = m_sections[sectionIndex];
+	section.m_isDirty = true;
+	++section.m_generation;
+	m_isVertexArrayDirty = true;
+}
+
+// The block's own section, plus any section across a face it's on
+void Chunk::DirtySectionsAroundBlock(int blockIndex)
+{
+	IntVector3 blockCoords = GetBlockCoordsForIndex(blockIndex);
+	int sectionIndex = blockIndex >> SECTION_BITS;
+	int sectionZ = blockCoords.z & (SECTION_HEIGHT_Z - 1);
+	SetSectionDirty(sectionIndex);
+
+	if (sectionZ == 0 && sectionIndex > 0)
+		SetSectionDirty(sectionIndex - 1);
+	if (sectionZ == SECTION_HEIGHT_Z - 1 && sectionIndex < NUM_CHUNK_SECTIONS - 1)
+		SetSectionDirty(sectionIndex + 1);
+
+	if (blockCoords.x == 0 && m_westNeighbor != nullptr)
+		m_westNeighbor->SetSectionDirty(sectionIndex);
+	if (blockCoords.x == CHUNK_WIDTH_X - 1 && m_eastNeighbor != nullptr)
+		m_eastNeighbor->SetSectionDirty(sectionIndex);
+	if (blockCoords.y == 0 && m_southNeighbor != nullptr)
+		m_southNeighbor->SetSectionDirty(sectionIndex);
+	if (blockCoords.y == CHUNK_DEPTH_Y - 1 && m_northNeighbor != nullptr)
+		m_northNeighbor->SetSectionDirty(sectionIndex);
 }
 
 void Chunk::DirtyNeighbors()
 {
 	if (m_northNeighbor != nullptr)
-		m_northNeighbor->m_isVertexArrayDirty = true;
+		m_northNeighbor->SetVertexArrayDirty();
 
 	if (m_southNeighbor != nullptr)
-		m_southNeighbor->m_isVertexArrayDirty = true;
+		m_southNeighbor->SetVertexArrayDirty();
 
 	if (m_westNeighbor != nullptr)
-		m_westNeighbor->m_isVertexArrayDirty = true;
+		m_westNeighbor->SetVertexArrayDirty();
 
 	if (m_eastNeighbor != nullptr)
-		m_eastNeighbor->m_isVertexArrayDirty = true;
+		m_eastNeighbor->SetVertexArrayDirty();
 }
 
 Rgba Chunk::GetVertexColorForLightLevel(int lightLevel)
@@ -303,7 +1171,7 @@ Rgba Chunk::GetVertexColorForLightLevel(int lightLevel)
 
 void Chunk::AddBlockVertexes(int blockIndex, std::vector<Vertex3_PCT>& vertexes)
 {
-	Block& block = m_blocks[blockIndex];
+	const Block& block = GetBlock(blockIndex);
 	if (block.m_blockTypeIndex == AIR)
 		return;
 
@@ -6,33 +6,109 @@
 #include "Game/GameCommons.hpp"
 #include "Engine/Render/Vertex.hpp"
 #include <vector>
+#include <atomic>
 
 
 const int MAX_LEVEL = 15;
 const int NUM_BLOCKS_PER_CHUNK = BLOCKS_PER_LAYER * CHUNK_HEIGHT_Z;
 const int SEA_LEVEL_HEIGHT = CHUNK_HEIGHT_Z / 4;
 
+const int SECTION_BITS_Z = 4;
+const int SECTION_BITS = CHUNK_BITS_XY + SECTION_BITS_Z;
+const int SECTION_HEIGHT_Z = 1 << SECTION_BITS_Z;
+const int BLOCKS_PER_SECTION = 1 << SECTION_BITS;
+const int NUM_CHUNK_SECTIONS = CHUNK_HEIGHT_Z / SECTION_HEIGHT_Z;
+const int SECTION_BLOCK_MASK = BLOCKS_PER_SECTION - 1;
+
+// Where a chunk is in the World's job pipeline.  Requested and generating chunks
+// aren't linked into the world yet.  From ready on it has blocks and is linked;
+// meshing ones have a mesh job reading it and its neighbors, so nothing there
+// can be removed.  Which of its sections are out of date is on the sections.
+enum eChunkState
+{
+	CHUNK_REQUESTED,
+	CHUNK_GENERATING,
+	CHUNK_READY,
+	CHUNK_MESHING,
+	CHUNK_MESHED,
+};
+
+// One atlas sprite's run of a chunk's triangles, drawn with that sprite's texture
+struct ChunkMeshBatch
+{
+	int m_spriteIndex;
+	int m_firstIndex;
+	int m_numIndexes;
+};
+
+// What a mesh job builds, kept on the section so it doesn't reallocate
+struct ChunkMesh
+{
+	std::vector<Vertex3_PCT> m_vertexes;
+	std::vector<unsigned int> m_indexes;
+	std::vector<ChunkMeshBatch> m_batches;
+};
+
+// A 16x16x16 slice of a chunk's height, blocks in the chunk's own x, y, z order.
+// A section whose blocks are all the same keeps just that one block - most of
+// the stone underground and the air over it.  Each section is meshed and drawn
+// on its own, so an edit only rebuilds the sections it touches.
+struct ChunkSection
+{
+	ChunkSection()
+		: m_blocks(nullptr)
+		, m_uniformBlock(0, 0)			// air, as a new chunk always was
+		, m_numNonAirBlocks(0)
+		, m_isDirty(true)
+		, m_isMeshQueued(false)
+		, m_mayBeUniform(false)
+		, m_generation(0)
+		, m_queuedGeneration(0)
+		, m_vboID(0)
+		, m_iboID(0)
+	{
+	};
+
+	~ChunkSection()
+	{
+		delete[] m_blocks;
+	};
+
+	Block* m_blocks;					// BLOCKS_PER_SECTION, or nullptr while they're all m_uniformBlock
+	Block m_uniformBlock;
+	int m_numNonAirBlocks;
+	bool m_isDirty;
+	bool m_isMeshQueued;				// the chunk's mesh job is building m_mesh
+	bool m_mayBeUniform;				// an edit left it all air or all solid, check once no mesh job can be reading it
+	unsigned int m_generation;			// bumped whenever its mesh goes out of date
+	unsigned int m_queuedGeneration;	// m_generation when it was queued
+	unsigned int m_vboID;				// made on its first upload
+	unsigned int m_iboID;
+	ChunkMesh m_mesh;
+	std::vector<ChunkMeshBatch> m_drawBatches;	// what's in the buffers now
+};
+
 class Chunk  
 {
 public:
 	AABB3D m_worldBounds;
 	IntVector2 m_chunkCoords;
-	Block m_blocks[NUM_BLOCKS_PER_CHUNK];
-	unsigned int m_vboID;
-	int m_numVertexes;
-	bool m_isVertexArrayDirty;
+	ChunkSection m_sections[NUM_CHUNK_SECTIONS];
+	bool m_isVertexArrayDirty;			// some section is
+	std::atomic<eChunkState> m_state;	// the generate job moves it up to ready
+	int m_evictionBucket;				// where the World's eviction buckets have it
+	int m_evictionSlot;
 	Chunk* m_northNeighbor;
 	Chunk* m_eastNeighbor;
 	Chunk* m_southNeighbor;
 	Chunk* m_westNeighbor;
+	bool m_hasSectionsToCompact;		// some section may be uniform again
 
 	Chunk( const IntVector2& chunkCoords);
 	~Chunk();
 	void Update();
-	void Render() const;
+	void Render(bool useDebugAtlas) const;
 	void GenerateChunk();
-	void GenerateBlock(int blockIndex);
-	void CreateSandBlocks();
 	int GetBlockInFrontIndex(int blockIndex);
 	int GetBlockBehindIndex(int blockIndex);
 	int GetBlockToLeftIndex(int blockIndex);
@@ -43,8 +119,46 @@ public:
 	IntVector3 GetBlockCoordsForIndex(int blockIndex);
 	int GetBlockIndexForLocalCoords(const IntVector3& blockCoords) const;
 	IntVector3 GetBlockCoordsForIndex(int blockIndex) const;
+	inline const Block& GetBlock(int blockIndex) const;
+	Block& GetMutableBlock(int blockIndex);
+	void SetBlock(int blockIndex, const Block& block);
+	void SetAllBlocks(const Block* blocks);
+	void GetAllBlocks(Block* out_blocks) const;
+	int GetNumStoredSections() const;
+	void MakeSectionUniformIfSame(int sectionIndex);
+	bool IsMeshJobInFlightHereOrNextDoor() const;
+	void CompactSections();
 	void PopulateVertexArray();
+	void QueueDirtySectionsForMeshing();
+	void BuildVertexArray();
+	void BuildVertexArrayPerBlock(std::vector<Vertex3_PCT>& vertexes);
+	void UploadVertexArray();
+	void SetVertexArrayDirty();
+	void SetSectionDirty(int sectionIndex);
+	void DirtySectionsAroundBlock(int blockIndex);
 	void DirtyNeighbors();
 	Rgba GetVertexColorForLightLevel(int lightLevel);
 	void AddBlockVertexes(int blockIndex, std::vector<Vertex3_PCT>& vertexes);
 };
+
+inline const Block& Chunk::GetBlock(int blockIndex) const
+{
+	const ChunkSection& section = m_sections[blockIndex >> SECTION_BITS];
+	if (section.m_blocks == nullptr)
+		return section.m_uniformBlock;
+
+	return section.m_blocks[blockIndex & SECTION_BLOCK_MASK];
+}
+
+// Terrain only depends on a block's column, so the noise is sampled once per
+// column and each column is written as runs of stone, dirt, grass, water and air.
+// Pure - no chunk or renderer - so it can run anywhere.
+void ComputeChunkGroundHeights(const IntVector2& chunkCoords, int* out_groundHeights);	// BLOCKS_PER_LAYER of them
+void GenerateChunkBlocks(const IntVector2& chunkCoords, Block* out_blocks);				// NUM_BLOCKS_PER_CHUNK of them
+// the old block at a time generator, to check the column one against
+void GenerateChunkBlocksPerBlock(const IntVector2& chunkCoords, Block* out_blocks);
+// times both generators over numChunks chunks and prints chunks/s and any that differ
+void BenchmarkChunkGeneration(int numChunks);
+// meshes the middle chunksPerSide x chunksPerSide of a generated grid with the
+// greedy and the old block at a time mesher, prints vertexes and ms per chunk
+void BenchmarkChunkMeshing(int chunksPerSide);
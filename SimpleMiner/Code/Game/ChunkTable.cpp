@@ -0,0 +1,114 @@
+#include "Game/ChunkTable.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+
+const int CHUNK_TABLE_START_CAPACITY = 2048;		// MAX_NUM_CHUNKS fits without growing
+
+ChunkTable::ChunkTable()
+	: m_slots(nullptr)
+	, m_capacity(CHUNK_TABLE_START_CAPACITY)
+	, m_count(0)
+{
+	m_slots = new ChunkTableSlot[m_capacity];
+	for (int slot = 0; slot < m_capacity; ++slot)
+	{
+		m_slots[slot].m_key = 0;
+		m_slots[slot].m_chunk = nullptr;
+	}
+}
+
+ChunkTable::~ChunkTable()
+{
+	delete[] m_slots;
+	m_slots = nullptr;
+}
+
+int ChunkTable::GetHomeSlot(uint64_t key) const
+{
+	// fibonacci hashing, the upper half is the well mixed part
+	uint64_t hash = key * 0x9E3779B97F4A7C15ULL;
+	return (int)(hash >> 32) & (m_capacity - 1);
+}
+
+// the slot holding key, or the empty slot it would go in
+int ChunkTable::FindSlot(uint64_t key) const
+{
+	int mask = m_capacity - 1;
+	int slot = GetHomeSlot(key);
+	while (m_slots[slot].m_chunk != nullptr && m_slots[slot].m_key != key)
+	{
+		slot = (slot + 1) & mask;
+	}
+	return slot;
+}
+
+Chunk* ChunkTable::Find(const ChunkCoords& chunkCoords) const
+{
+	return m_slots[FindSlot(PackChunkCoords(chunkCoords))].m_chunk;
+}
+
+void ChunkTable::Insert(const ChunkCoords& chunkCoords, Chunk* chunk)
+{
+	ASSERT_OR_DIE(chunk != nullptr, "Chunk was null!");
+	if ((m_count + 1) * 2 > m_capacity)
+		Grow();
+
+	uint64_t key = PackChunkCoords(chunkCoords);
+	int slot = FindSlot(key);
+	if (m_slots[slot].m_chunk == nullptr)
+		++m_count;
+
+	m_slots[slot].m_key = key;
+	m_slots[slot].m_chunk = chunk;
+}
+
+Chunk* ChunkTable::Remove(const ChunkCoords& chunkCoords)
+{
+	int mask = m_capacity - 1;
+	int hole = FindSlot(PackChunkCoords(chunkCoords));
+	Chunk* removed = m_slots[hole].m_chunk;
+	if (removed == nullptr)
+		return nullptr;
+
+	// pull back anything further down the run that could live in the hole
+	int next = (hole + 1) & mask;
+	while (m_slots[next].m_chunk != nullptr)
+	{
+		int home = GetHomeSlot(m_slots[next].m_key);
+		if (((next - home) & mask) >= ((next - hole) & mask))
+		{
+			m_slots[hole] = m_slots[next];
+			hole = next;
+		}
+		next = (next + 1) & mask;
+	}
+
+	m_slots[hole].m_key = 0;
+	m_slots[hole].m_chunk = nullptr;
+	--m_count;
+	return removed;
+}
+
+void ChunkTable::Grow()
+{
+	ChunkTableSlot* oldSlots = m_slots;
+	int oldCapacity = m_capacity;
+
+	m_capacity *= 2;
+	m_slots = new ChunkTableSlot[m_capacity];
+	for (int slot = 0; slot < m_capacity; ++slot)
+	{
+		m_slots[slot].m_key = 0;
+		m_slots[slot].m_chunk = nullptr;
+	}
+
+	for (int slot = 0; slot < oldCapacity; ++slot)
+	{
+		if (oldSlots[slot].m_chunk == nullptr)
+			continue;
+
+		int newSlot = FindSlot(oldSlots[slot].m_key);
+		m_slots[newSlot] = oldSlots[slot];
+	}
+
+	delete[] oldSlots;
+}
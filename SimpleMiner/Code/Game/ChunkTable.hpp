@@ -0,0 +1,45 @@
+#pragma once
+#include "Game/GameCommons.hpp"
+#include <stdint.h>
+
+class Chunk;
+
+// Chunks by coords in one flat array - open addressing, linear probing, keyed by
+// the packed coords.  Kept at most half full, and removing shifts the rest of the
+// probe run back so there are never tombstones to skip.
+// Walk it with GetSlotCount/GetChunkInSlot, empty slots are nullptr.
+class ChunkTable
+{
+public:
+	ChunkTable();
+	~ChunkTable();
+
+	Chunk* Find(const ChunkCoords& chunkCoords) const;
+	void Insert(const ChunkCoords& chunkCoords, Chunk* chunk);
+	Chunk* Remove(const ChunkCoords& chunkCoords);
+	inline bool Contains(const ChunkCoords& chunkCoords) const { return Find(chunkCoords) != nullptr; }
+	inline int GetCount() const { return m_count; }
+	inline int GetSlotCount() const { return m_capacity; }
+	inline Chunk* GetChunkInSlot(int slot) const { return m_slots[slot].m_chunk; }
+
+private:
+	struct ChunkTableSlot
+	{
+		uint64_t m_key;
+		Chunk* m_chunk;
+	};
+
+	int GetHomeSlot(uint64_t key) const;
+	int FindSlot(uint64_t key) const;
+	void Grow();
+
+private:
+	ChunkTableSlot* m_slots;
+	int m_capacity;			// power of two
+	int m_count;
+};
+
+inline uint64_t PackChunkCoords(const ChunkCoords& chunkCoords)
+{
+	return ((uint64_t)(uint32_t)chunkCoords.x << 32) | (uint64_t)(uint32_t)chunkCoords.y;
+}
@@ -610,6 +610,16 @@ void Game::KeyDown(unsigned char keyThatWasJustPressed)
 		g_IsPlayerWalking = !g_IsPlayerWalking;
 	}
 
+	if (keyThatWasJustPressed == KEY_F7)
+	{
+		BenchmarkChunkGeneration(256);
+	}
+
+	if (keyThatWasJustPressed == KEY_F8)
+	{
+		BenchmarkChunkMeshing(8);
+	}
+
 	g_theInputSystem->OnKeyDown(keyThatWasJustPressed);
 }
 
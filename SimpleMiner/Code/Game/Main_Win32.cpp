@@ -2,6 +2,11 @@
 #include "Engine/Core/StringUtils.hpp"
 #include "Engine/Core/ErrorWarningAssert.hpp"
 #include "Engine/Core/Time.hpp"
+#include "Engine/Core/Job.hpp"
+#include "Engine/Core/FrameAllocator.hpp"
+#include "Engine/Core/Profiling.hpp"
+#include "Engine/Core/Logging.hpp"
+#include "Engine/Core/BuildConfig.hpp"
 #include "Game/GameCommons.hpp"
 #include "Engine/Input/Input.hpp"
 #define WIN32_LEAN_AND_MEAN
@@ -192,6 +197,10 @@ void CreateOpenGLWindow(HINSTANCE applicationInstanceHandle)
 void Initialize(HINSTANCE applicationInstanceHandle)
 {
 	SetProcessDPIAware();
+	JobSystemStartup(JOB_TYPE_COUNT);
+	LogStartup();
+	FrameAllocatorStartup();
+	ProfilerStartup();
 	CreateOpenGLWindow(applicationInstanceHandle);
 	g_theApp = new App();
 }
@@ -202,6 +211,11 @@ void Shutdown()
 {
 	delete g_theApp;
 	g_theApp = nullptr;
+
+	FrameAllocatorShutdown();
+	LogShutdown();
+	JobSystemShutdown();
+	ProfilerShutdown();
 }
 
 
@@ -213,6 +227,9 @@ int WINAPI WinMain(HINSTANCE applicationInstanceHandle, HINSTANCE, LPSTR command
 
 	while (!g_theApp->IsQuitting())
 	{
+		ResetFrameMemoryTracking();
+		ProfilerEndFrame();
+		FrameAllocatorBeginFrame();
 		g_theApp->RunFrame();
 		SwapBuffers(g_displayDeviceContext);
 	}
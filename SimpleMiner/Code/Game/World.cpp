@@ -12,20 +12,54 @@
 #include "Game/Player.hpp"
 #include"Game/HookShot.hpp"
 #include "Engine/Audio/AudioSystem.hpp"
+#include "Engine/Core/Job.hpp"
+#include <algorithm>
 
 World::World()
+	: m_numChunkJobsInFlight(0)
+	, m_playerChunkCoords(0, 0)
+	, m_hasPlayerChunkCoords(false)
+	, m_activationCursor(0)
+	, m_activationRangeSquared(0)
 {
+	InitializeBlockFaceTable();
+
+	// offsets to every chunk whose center is within CHUNK_MAX_RANGE of the player's chunk's, nearest first
+	float chunkRange = CHUNK_MAX_RANGE / (float)CHUNK_WIDTH_X;
+	int chunkRangeCeiling = (int)ceil(chunkRange);
+	m_activationRangeSquared = (int)(chunkRange * chunkRange);
+	for (int offsetY = -chunkRangeCeiling; offsetY <= chunkRangeCeiling; ++offsetY)
+	{
+		for (int offsetX = -chunkRangeCeiling; offsetX <= chunkRangeCeiling; ++offsetX)
+		{
+			ChunkCoords offset(offsetX, offsetY);
+			if (offset.CalcLengthSquared() <= m_activationRangeSquared)
+				m_activationOffsets.push_back(offset);
+		}
+	}
+
+	std::stable_sort(m_activationOffsets.begin(), m_activationOffsets.end(), [](const ChunkCoords& a, const ChunkCoords& b)
+	{
+		return a.CalcLengthSquared() < b.CalcLengthSquared();
+	});
 }
 
 World::~World()
 {
-	while (m_activeChunks.begin() != m_activeChunks.end())
+	FinishChunkJobs();
+	for (int slot = 0; slot < m_activeChunks.GetSlotCount(); )
 	{
-		std::map<ChunkCoords, Chunk*>::const_iterator iterate = m_activeChunks.begin();
-		ChunkCoords currentActiveChunk = iterate->first;
-		RemoveChunkAtCoords(currentActiveChunk);
+		Chunk* chunk = m_activeChunks.GetChunkInSlot(slot);
+		if (chunk == nullptr)
+		{
+			++slot;
+			continue;
+		}
+
+		// removing shifts later chunks back into this slot, so look at it again
+		RemoveChunkAtCoords(chunk->m_chunkCoords);
 	}
-	
+	FinishChunkJobs();
 }
 
 void World::Update(float deltaSeconds)
@@ -41,48 +75,102 @@ void World::Update(float deltaSeconds)
 
 void World::ChunkManagement()
 {
-	int numberOfActiveChunks = GetNumberOfActiveChunks();
-	Vector3 playerPosition = g_theGame->m_player->m_position;
+	UpdatePlayerChunkCoords(g_theGame->m_player->m_position);
 
-	bool alreadyDidSomethingHeavy = false;
-	if (numberOfActiveChunks >= MAX_NUM_CHUNKS)
+	if (GetNumberOfActiveChunks() >= MAX_NUM_CHUNKS)
 	{
-		alreadyDidSomethingHeavy = DeactivateFarthestChunk(playerPosition);
+		DeactivateFarthestChunk();
 	}
 
-	if (!alreadyDidSomethingHeavy)
+	// keep every core generating, nearest chunks first
+	int maxPendingChunks = ((int)JobSystemGetWorkerCount() + 1) * CHUNK_REQUESTS_PER_WORKER;
+	while (m_pendingChunks.GetCount() < maxPendingChunks
+		&& GetNumberOfActiveChunks() + m_pendingChunks.GetCount() < MAX_NUM_CHUNKS)
 	{
-		alreadyDidSomethingHeavy = ActivateNearestMissingChunk(playerPosition);
+		if (!ActivateNearestMissingChunk())
+			break;
 	}
 
-	if (!alreadyDidSomethingHeavy)
+	if (GetNumberOfActiveChunks() > DESIRED_NUM_CHUNKS)
 	{
-		if(numberOfActiveChunks > DESIRED_NUM_CHUNKS )
-			alreadyDidSomethingHeavy = DeactivateFarthestChunk(playerPosition);
+		DeactivateFarthestChunk();
 	}
+
+	JobConsumer consumer;
+	consumer.add_category(JOB_MAIN);
+	consumer.consume_for_ms(CHUNK_MAIN_THREAD_BUDGET_MS);
 }
 
 void World::UpdateChunks()
 {
-	for (std::map<ChunkCoords, Chunk*>::const_iterator iterate = m_activeChunks.begin(); iterate != m_activeChunks.end(); ++iterate)
+	for (int slot = 0; slot < m_activeChunks.GetSlotCount(); ++slot)
 	{
-		Chunk* chunk = iterate->second;
-		if(chunk != nullptr)
-		{
-			if (chunk->m_isVertexArrayDirty)
-				chunk->Update();
-		}
+		Chunk* chunk = m_activeChunks.GetChunkInSlot(slot);
+		if (chunk == nullptr)
+			continue;
+
+		// sections edited uniform while a mesh job was reading them
+		if (chunk->m_hasSectionsToCompact && !chunk->IsMeshJobInFlightHereOrNextDoor())
+			chunk->CompactSections();
+
+		if (chunk->m_isVertexArrayDirty && CanMeshChunk(chunk))
+			DispatchMeshJob(chunk);
+	}
+}
+
+// Not while it's already meshing, and only once it and every neighbor it reads have blocks
+bool World::CanMeshChunk(const Chunk* chunk) const
+{
+	if (chunk->m_state != CHUNK_READY && chunk->m_state != CHUNK_MESHED)
+		return false;
+
+	const Chunk* neighbors[4] = { chunk->m_northNeighbor, chunk->m_eastNeighbor, chunk->m_southNeighbor, chunk->m_westNeighbor };
+	for (int neighborIndex = 0; neighborIndex < 4; ++neighborIndex)
+	{
+		if (neighbors[neighborIndex] != nullptr && neighbors[neighborIndex]->m_state < CHUNK_READY)
+			return false;
 	}
+	return true;
+}
+
+// Meshing only reads the chunk and its neighbors, so its dirty sections build on
+// a job into their own meshes and the upload waits its turn on JOB_MAIN.
+void World::DispatchMeshJob(Chunk* chunk)
+{
+	chunk->QueueDirtySectionsForMeshing();
+	chunk->m_state = CHUNK_MESHING;
+	++m_numChunkJobsInFlight;
+
+	Job* meshJob = JobCreate(JOB_GENERIC, [chunk]()
+	{
+		chunk->BuildVertexArray();
+	});
+	Job* uploadJob = JobCreate(JOB_MAIN, [this, chunk]()
+	{
+		OnMeshJobFinished(chunk);
+	});
+	uploadJob->dependent_on(meshJob);
+	JobDispatchAndRelease(meshJob);
+	JobDispatchAndRelease(uploadJob);
+}
+
+void World::OnMeshJobFinished(Chunk* chunk)
+{
+	--m_numChunkJobsInFlight;
+
+	// sections changed while they built are dirty again and skip the upload
+	chunk->UploadVertexArray();
+	chunk->m_state = CHUNK_MESHED;
 }
 
 void World::SetAllChunksAsDirty()
 {
-	for (std::map<ChunkCoords, Chunk*>::const_iterator iterate = m_activeChunks.begin(); iterate != m_activeChunks.end(); ++iterate)
+	for (int slot = 0; slot < m_activeChunks.GetSlotCount(); ++slot)
 	{
-		Chunk* chunk = iterate->second;
+		Chunk* chunk = m_activeChunks.GetChunkInSlot(slot);
 		if (chunk != nullptr)
 		{
-			chunk->m_isVertexArrayDirty = true;
+			chunk->SetVertexArrayDirty();
 		}
 	}
 }
@@ -94,23 +182,15 @@ void World::Render() const
 
 void World::RenderActiveChunks() const
 {
-
-	if(!g_IsDebugModeOn)
+	// chunks bind their own sprite textures, a batch at a time
+	for (int slot = 0; slot < m_activeChunks.GetSlotCount(); ++slot)
 	{
-		Texture* blockAtlas = g_myRenderer->CreateOrGetTexture("Data/Images/SimpleMinerAtlas.png");
-		g_myRenderer->BindTexture(blockAtlas);
-	}
-	else
-	{
-		Texture* debugBlockAtlas = g_myRenderer->CreateOrGetTexture("Data/Images/DebugBlockAtlas.png");
-		g_myRenderer->BindTexture(debugBlockAtlas);
-	}
+		Chunk* chunk = m_activeChunks.GetChunkInSlot(slot);
+		if (chunk == nullptr)
+			continue;
 
-	for (std::map<ChunkCoords, Chunk*>::const_iterator iterate = m_activeChunks.begin(); iterate != m_activeChunks.end(); ++iterate)
-	{
-		Chunk* chunk = iterate->second;
-		if (chunk != nullptr && IsChunkInFrustum(chunk))
-			chunk->Render();
+		if (IsChunkInFrustum(chunk))
+			chunk->Render(g_IsDebugModeOn);
 		else
 			DebuggerPrintf("Chunk not rendered");
 	}
@@ -183,104 +263,269 @@ bool World::IsChunkInFrustum(const Chunk* chunk) const
 		return false;
 }
 
-Chunk* World::CreateChunk( const ChunkCoords& newPosition)
+// Distances to every chunk change when the player crosses into another one, so
+// the activation offsets start over and the eviction buckets are redone.
+void World::UpdatePlayerChunkCoords(const Vector3& playerPosition)
 {
-	Chunk* newChunk = new Chunk( newPosition );
-	newChunk->GenerateChunk();
-	newChunk->m_northNeighbor = GetChunkAtCoords(newPosition + ChunkCoords(0,1));
-	newChunk->m_eastNeighbor = GetChunkAtCoords(newPosition + ChunkCoords(1,0));
-	newChunk->m_southNeighbor = GetChunkAtCoords(newPosition + ChunkCoords(0,-1));
-	newChunk->m_westNeighbor = GetChunkAtCoords(newPosition + ChunkCoords(-1,0));
-	
-	if(newChunk->m_westNeighbor != nullptr)
-		newChunk->m_westNeighbor->m_eastNeighbor = newChunk;
-	
-	if (newChunk->m_eastNeighbor != nullptr)
-		newChunk->m_eastNeighbor->m_westNeighbor = newChunk;
-	
-	if (newChunk->m_northNeighbor != nullptr)
-		newChunk->m_northNeighbor->m_southNeighbor = newChunk;
-	
-	if (newChunk->m_southNeighbor != nullptr)
-		newChunk->m_southNeighbor->m_northNeighbor = newChunk;
-	
-	newChunk->DirtyNeighbors();
-	return newChunk;
+	ChunkCoords playerChunkCoords = ConvertWorldPositionToChunkPosition(playerPosition);
+	if (m_hasPlayerChunkCoords && playerChunkCoords == m_playerChunkCoords)
+		return;
+
+	m_playerChunkCoords = playerChunkCoords;
+	m_hasPlayerChunkCoords = true;
+	m_activationCursor = 0;
+
+	for (int bucketIndex = 0; bucketIndex < NUM_EVICTION_BUCKETS; ++bucketIndex)
+	{
+		m_evictionBuckets[bucketIndex].clear();
+	}
+
+	for (int slot = 0; slot < m_activeChunks.GetSlotCount(); ++slot)
+	{
+		Chunk* chunk = m_activeChunks.GetChunkInSlot(slot);
+		if (chunk != nullptr)
+			AddToEvictionBuckets(chunk);
+	}
 }
 
-bool World::ActivateNearestMissingChunk( const Vector3& playerPosition) 
+// Walks the offsets out from the player's chunk, picking up where the last call
+// stopped.  A chunk still being saved is skipped for now, and holds the cursor so
+// it gets looked at again.
+bool World::ActivateNearestMissingChunk()
 {
-	bool activatingAChunk = false;
-	Vector2 playerXY(playerPosition.x, playerPosition.y);
-	ChunkCoords playerChunkCoords = ConvertWorldPositionToChunkPosition(playerPosition);
-	int chunkRange = (int)ceil(CHUNK_MAX_RANGE / (float)CHUNK_WIDTH_X);
-	ChunkCoords neighborhoodMinCoords = playerChunkCoords - ChunkCoords(chunkRange, chunkRange);
-	ChunkCoords neighborhoodMaxCoords = playerChunkCoords + ChunkCoords(chunkRange, chunkRange);
-	float winnerDistSquared = CHUNK_MAX_RANGE * CHUNK_MAX_RANGE;
-	ChunkCoords winner(0, 0);
-
-	for (int chunkY = neighborhoodMinCoords.y; chunkY < neighborhoodMaxCoords.y; ++chunkY)
-	{
-		for (int chunkX = neighborhoodMinCoords.x; chunkX < neighborhoodMaxCoords.x; ++chunkX)
-		{
-			ChunkCoords chunkCoords(chunkX, chunkY);
-			Vector3 chunkCenter = GetWorldCenterOfChunkCoords(chunkCoords);
-			Vector2 chunkXY(chunkCenter.x, chunkCenter.y);
-			Vector2 displacementToChunk = chunkXY - playerXY;
-			float currentDistSquared = displacementToChunk.CalcLengthSquared();
-			if (currentDistSquared < winnerDistSquared )
-			{
-				bool isAlreadyActive = m_activeChunks.end() != m_activeChunks.find(chunkCoords);
-				if (!isAlreadyActive)
-				{
-					winnerDistSquared = currentDistSquared;
-					winner = chunkCoords;
-					activatingAChunk = true;
-				}
-			}
+	for (int offsetIndex = m_activationCursor; offsetIndex < (int)m_activationOffsets.size(); ++offsetIndex)
+	{
+		ChunkCoords chunkCoords = m_playerChunkCoords + m_activationOffsets[offsetIndex];
+		bool isCursor = (offsetIndex == m_activationCursor);
+
+		if (m_activeChunks.Contains(chunkCoords) || m_pendingChunks.Contains(chunkCoords))
+		{
+			if (isCursor)
+				++m_activationCursor;
+			continue;
 		}
+
+		if (m_savingChunks.Contains(chunkCoords))
+			continue;
+
+		if (isCursor)
+			++m_activationCursor;
+		RequestChunk(chunkCoords);
+		return true;
 	}
+	return false;
+}
+
+bool World::IsInActivationRange(const ChunkCoords& chunkCoords) const
+{
+	ChunkCoords offset = chunkCoords - m_playerChunkCoords;
+	return offset.CalcLengthSquared() <= m_activationRangeSquared;
+}
+
+int World::GetEvictionBucket(const ChunkCoords& chunkCoords) const
+{
+	// floats, a chunk far enough away would overflow the int squares
+	float offsetX = (float)(chunkCoords.x - m_playerChunkCoords.x);
+	float offsetY = (float)(chunkCoords.y - m_playerChunkCoords.y);
+	float distance = sqrtf((offsetX * offsetX) + (offsetY * offsetY));
+	if (distance >= (float)(NUM_EVICTION_BUCKETS - 1))
+		return NUM_EVICTION_BUCKETS - 1;
+	return (int)distance;
+}
+
+void World::AddToEvictionBuckets(Chunk* chunk)
+{
+	chunk->m_evictionBucket = GetEvictionBucket(chunk->m_chunkCoords);
+	std::vector<Chunk*>& bucket = m_evictionBuckets[chunk->m_evictionBucket];
+	chunk->m_evictionSlot = (int)bucket.size();
+	bucket.push_back(chunk);
+}
+
+void World::RemoveFromEvictionBuckets(Chunk* chunk)
+{
+	std::vector<Chunk*>& bucket = m_evictionBuckets[chunk->m_evictionBucket];
+	Chunk* lastChunk = bucket.back();
+	bucket[chunk->m_evictionSlot] = lastChunk;
+	lastChunk->m_evictionSlot = chunk->m_evictionSlot;
+	bucket.pop_back();
+
+	chunk->m_evictionBucket = -1;
+	chunk->m_evictionSlot = -1;
+}
+
+// Saved chunks are their dimensions, then (block type, run length) pairs
+static bool LoadChunkBlocksFromFile(const ChunkCoords& chunkCoords, Block* out_blocks)
+{
+	std::vector<unsigned char> buffer;
+	if (!LoadBinaryFileToBuffer(Stringf("Data/Save/Chunk_at_(%i,%i).chocolate", chunkCoords.x, chunkCoords.y).c_str(), buffer))
+		return false;
 
-	if (!activatingAChunk)
+	if (buffer.size() < 3 || buffer[0] != (unsigned char)CHUNK_WIDTH_X || buffer[1] != (unsigned char)CHUNK_DEPTH_Y || buffer[2] != (unsigned char)CHUNK_HEIGHT_Z)
 		return false;
 
-	std::vector<unsigned char> outBuffer;
-	if (!LoadBinaryFileToBuffer(Stringf("Data/Save/Chunk_at_(%i,%i).chocolate", winner.x, winner.y).c_str(), outBuffer))
+	int blockIndex = 0;
+	for (size_t readIndex = 3; readIndex + 1 < buffer.size() && blockIndex < NUM_BLOCKS_PER_CHUNK; readIndex += 2)
 	{
-		Chunk* newChunk = CreateChunk(winner);
-		ASSERT_OR_DIE(newChunk != nullptr, "Chunk was null!");
-		m_activeChunks[winner] = newChunk;
-		//LightingOnChunkActivation(newChunk);
-		return true;
+		unsigned char blockType = buffer[readIndex];
+		int blockTypeCount = (int)buffer[readIndex + 1];
+		if (blockTypeCount > NUM_BLOCKS_PER_CHUNK - blockIndex)
+			blockTypeCount = NUM_BLOCKS_PER_CHUNK - blockIndex;
+
+		unsigned char lightAndFlags = GetLightAndFlagsForBlockType((BlockType)blockType);
+		for (int numBlockTypes = 0; numBlockTypes < blockTypeCount; ++numBlockTypes)
+		{
+			out_blocks[blockIndex] = Block(blockType, lightAndFlags);
+			++blockIndex;
+		}
 	}
-	else
+
+	return blockIndex == NUM_BLOCKS_PER_CHUNK;
+}
+
+static void SaveChunkBlocksToFile(const ChunkCoords& chunkCoords, const Block* blocks)//#TODO: Rewrite to use one fwrite and chunk dimensions
+{
+	std::vector<unsigned char> bitBuffer;
+	unsigned char xDimension = (unsigned char)CHUNK_WIDTH_X;
+	unsigned char yDimension = (unsigned char)CHUNK_DEPTH_Y;
+	unsigned char zDimension = (unsigned char)CHUNK_HEIGHT_Z;
+	bitBuffer.push_back(xDimension);
+	bitBuffer.push_back(yDimension);
+	bitBuffer.push_back(zDimension);
+
+	unsigned char blockCount = 1;
+	for (int blockIndex = 0; blockIndex < NUM_BLOCKS_PER_CHUNK; ++blockIndex)
 	{
-		LoadChunkAsActive(outBuffer,winner);
-		return true;
+		int nextIndex = blockIndex + 1;
+		if (nextIndex == NUM_BLOCKS_PER_CHUNK)
+		{
+			nextIndex = blockIndex;
+		}
+
+		const Block& currentBlock = blocks[blockIndex];
+		const Block& nextBlock = blocks[nextIndex];
+		unsigned char currentType = currentBlock.m_blockTypeIndex;
+		unsigned char nextType = nextBlock.m_blockTypeIndex;
+			
+		if (currentType == nextType && blockIndex != nextIndex && blockCount < 255)
+		{
+			++blockCount;
+		}
+		else 
+		{
+			bitBuffer.push_back(currentType);
+			bitBuffer.push_back(blockCount);
+			blockCount = 1;
+		}
 	}
+
+	SaveBinaryFileFromBuffer(Stringf("Data/Save/Chunk_at_(%i,%i).chocolate", chunkCoords.x, chunkCoords.y).c_str(), bitBuffer);
+}
+
+// A whole chunk of blocks per job thread, for loading, generating and saving
+// before it's packed into sections or after it's unpacked from them
+static thread_local Block* t_chunkJobBlocks = nullptr;
+
+static Block* GetChunkJobBlocks()
+{
+	if (t_chunkJobBlocks == nullptr)
+		t_chunkJobBlocks = new Block[NUM_BLOCKS_PER_CHUNK];
+	return t_chunkJobBlocks;
+}
+
+// Loading or generating only touches the new chunk, so it all happens on a job.
+// Linking it in after waits on JOB_MAIN.
+void World::RequestChunk(const ChunkCoords& chunkCoords)
+{
+	Chunk* newChunk = new Chunk(chunkCoords);
+	ASSERT_OR_DIE(newChunk != nullptr, "Chunk was null!");
+	m_pendingChunks.Insert(chunkCoords, newChunk);
+	++m_numChunkJobsInFlight;
+
+	Job* generateJob = JobCreate(JOB_GENERIC, [newChunk]()
+	{
+		newChunk->m_state = CHUNK_GENERATING;
+		Block* blocks = GetChunkJobBlocks();
+		if (!LoadChunkBlocksFromFile(newChunk->m_chunkCoords, blocks))
+			GenerateChunkBlocks(newChunk->m_chunkCoords, blocks);
+		newChunk->SetAllBlocks(blocks);
+		newChunk->m_state = CHUNK_READY;
+	});
+	Job* linkJob = JobCreate(JOB_MAIN, [this, newChunk]()
+	{
+		LinkReadyChunk(newChunk);
+	});
+	linkJob->dependent_on(generateJob);
+	JobDispatchAndRelease(generateJob);
+	JobDispatchAndRelease(linkJob);
 }
 
-bool World::DeactivateFarthestChunk(const Vector3& playerPosition)
+void World::LinkReadyChunk(Chunk* readyChunk)
 {
-	float farthestChunkDistanceSquared = 0.f;
-	Vector2 playerPositionXY(playerPosition.x, playerPosition.y);
-	ChunkCoords chunkToRemove(0, 0);
+	--m_numChunkJobsInFlight;
+	ASSERT_OR_DIE(readyChunk->m_state == CHUNK_READY, "Linking a chunk without its blocks!");
+	ChunkCoords chunkCoords = readyChunk->m_chunkCoords;
+	m_pendingChunks.Remove(chunkCoords);
+
+	readyChunk->m_northNeighbor = GetChunkAtCoords(chunkCoords + ChunkCoords(0, 1));
+	readyChunk->m_eastNeighbor = GetChunkAtCoords(chunkCoords + ChunkCoords(1, 0));
+	readyChunk->m_southNeighbor = GetChunkAtCoords(chunkCoords + ChunkCoords(0, -1));
+	readyChunk->m_westNeighbor = GetChunkAtCoords(chunkCoords + ChunkCoords(-1, 0));
+
+	if (readyChunk->m_westNeighbor != nullptr)
+		readyChunk->m_westNeighbor->m_eastNeighbor = readyChunk;
+
+	if (readyChunk->m_eastNeighbor != nullptr)
+		readyChunk->m_eastNeighbor->m_westNeighbor = readyChunk;
+
+	if (readyChunk->m_northNeighbor != nullptr)
+		readyChunk->m_northNeighbor->m_southNeighbor = readyChunk;
+
+	if (readyChunk->m_southNeighbor != nullptr)
+		readyChunk->m_southNeighbor->m_northNeighbor = readyChunk;
+
+	// a neighbor mesh job that saw the old links gets thrown away
+	readyChunk->DirtyNeighbors();
+	m_activeChunks.Insert(chunkCoords, readyChunk);
+	AddToEvictionBuckets(readyChunk);
+	//LightingOnChunkActivation(readyChunk);
+}
 
-	for (std::map<ChunkCoords, Chunk*>::const_iterator iterate = m_activeChunks.begin(); iterate != m_activeChunks.end(); ++iterate)
+bool World::DeactivateFarthestChunk()
+{
+	for (int bucketIndex = NUM_EVICTION_BUCKETS - 1; bucketIndex >= 0; --bucketIndex)
 	{
-		ChunkCoords currentChunkPos = iterate->first;
-		Vector3 chunkCenter = GetWorldCenterOfChunkCoords(currentChunkPos);
-		Vector2 chunkCenterXY(chunkCenter.x, chunkCenter.y);
-		float distanceSquared = CalcDistanceSquared(playerPositionXY, chunkCenterXY);
-		if (distanceSquared > farthestChunkDistanceSquared )
+		const std::vector<Chunk*>& bucket = m_evictionBuckets[bucketIndex];
+		for (size_t bucketSlot = 0; bucketSlot < bucket.size(); ++bucketSlot)
 		{
-			farthestChunkDistanceSquared = distanceSquared;
-			chunkToRemove = currentChunkPos;
+			if (CanRemoveChunk(bucket[bucketSlot]))
+			{
+				RemoveChunkAtCoords(bucket[bucketSlot]->m_chunkCoords);
+				return true;
+			}
 		}
 	}
+	return false;
+}
 
-	RemoveChunkAtCoords(chunkToRemove);
-	return true;
+// A mesh job reads its chunk and that chunk's neighbors, none of them can go while it runs
+bool World::CanRemoveChunk(const Chunk* chunk) const
+{
+	if (chunk->m_state < CHUNK_READY)
+		return false;
+
+	return !chunk->IsMeshJobInFlightHereOrNextDoor();
+}
+
+// Helps run jobs until none of this world's are left
+void World::FinishChunkJobs()
+{
+	JobConsumer consumer;
+	consumer.add_category(JOB_GENERIC);
+	consumer.add_category(JOB_MAIN);
+	while (m_numChunkJobsInFlight > 0)
+	{
+		consumer.consume_all();
+	}
 }
 
 ChunkCoords World::ConvertWorldPositionToChunkPosition( const Vector3& worldPosition)
@@ -308,9 +553,7 @@ BlockInfo World::GetBlockInfoAtWorldPosition(const Vector3& worldPosition)
 	Chunk* chunk = nullptr;
 	if (!AreLocalCoordsUnreasonable(localBlockPos))
 	{
-		std::map<ChunkCoords, Chunk*>::const_iterator iterate = m_activeChunks.find(chunkPos);
-		if (iterate != m_activeChunks.end())
-			chunk = iterate->second;
+		chunk = m_activeChunks.Find(chunkPos);
 	}
 
 	int blockIndex = 0; 
@@ -333,58 +576,16 @@ bool World::AreLocalCoordsUnreasonable(IntVector3& localPos)
 
 int World::GetNumberOfActiveChunks()
 {
-	return m_activeChunks.size();
+	return m_activeChunks.GetCount();
 }
 
-void World::RemoveChunkAtCoords(const ChunkCoords& chunkToRemove)//#TODO: Rewrite to use one fwrite and chunk dimensions
+void World::RemoveChunkAtCoords(const ChunkCoords& chunkToRemove)
 {
-	std::map<ChunkCoords, Chunk*>::iterator found = m_activeChunks.find(chunkToRemove);
-	if (found == m_activeChunks.end())
+	Chunk* currentChunk = m_activeChunks.Find(chunkToRemove);
+	if (currentChunk == nullptr)
 		return;
 
-	Chunk* currentChunk = found->second;
-	ASSERT_OR_DIE(currentChunk != nullptr, "Chunk was null!");
-
-	std::vector<unsigned char> bitBuffer;
-	unsigned char xDimension = (unsigned char)CHUNK_WIDTH_X;
-	unsigned char yDimension = (unsigned char)CHUNK_DEPTH_Y;
-	unsigned char zDimension = (unsigned char)CHUNK_HEIGHT_Z;
-	//fwrite(reinterpret_cast<const void*>(&xCoord), sizeof(unsigned char), sizeof(xCoord), chunkFile);
-	//fwrite(reinterpret_cast<const void*>(&yCoord), sizeof(unsigned char), sizeof(yCoord), chunkFile);
-	bitBuffer.push_back(xDimension);
-	bitBuffer.push_back(yDimension);
-	bitBuffer.push_back(zDimension);
-
-	unsigned char blockCount = 1;
-	for (int blockIndex = 0; blockIndex < NUM_BLOCKS_PER_CHUNK; ++blockIndex)
-	{
-		int nextIndex = blockIndex + 1;
-		if (nextIndex == NUM_BLOCKS_PER_CHUNK)
-		{
-			nextIndex = blockIndex;
-		}
-
-		const Block& currentBlock = currentChunk->m_blocks[blockIndex];
-		const Block& nextBlock = currentChunk->m_blocks[nextIndex];
-		unsigned char currentType = currentBlock.m_blockTypeIndex;
-		unsigned char nextType = nextBlock.m_blockTypeIndex;
-			
-		if (currentType == nextType && blockIndex != nextIndex && blockCount < 255)
-		{
-			++blockCount;
-		}
-		else 
-		{
-			//fwrite(reinterpret_cast<const void*>(&currentType), sizeof(unsigned char), sizeof(currentType), chunkFile);
-			//fwrite(reinterpret_cast<const void*>(&blockCount), sizeof(unsigned char), sizeof(blockCount), chunkFile);
-			bitBuffer.push_back(currentType);
-			bitBuffer.push_back(blockCount);
-			blockCount = 1;
-		}
-	}
-
-	SaveBinaryFileFromBuffer(Stringf("Data/Save/Chunk_at_(%i,%i).chocolate", chunkToRemove.x, chunkToRemove.y).c_str(), bitBuffer);
-
+	ASSERT_OR_DIE(CanRemoveChunk(currentChunk), "Chunk is still being meshed!");
 
 	if (currentChunk->m_westNeighbor != nullptr)
 		currentChunk->m_westNeighbor->m_eastNeighbor = nullptr;
@@ -398,63 +599,38 @@ void World::RemoveChunkAtCoords(const ChunkCoords& chunkToRemove)//#TODO: Rewrit
 	if (currentChunk->m_southNeighbor != nullptr)
 		currentChunk->m_southNeighbor->m_northNeighbor = nullptr;
 
-	m_activeChunks.erase(found);
-	delete currentChunk;
-}
-
-void World::LoadChunkAsActive(std::vector<unsigned char>& outBuffer, const ChunkCoords& chunkCoords)
-{
-	unsigned char xDimension = outBuffer[0];
-	outBuffer.erase(outBuffer.begin());
-	unsigned char yDimension = outBuffer[1];
-	outBuffer.erase(outBuffer.begin() + 1);
-	unsigned char zDimension = outBuffer[2];
-	outBuffer.erase(outBuffer.begin() + 2);
-
-	ASSERT_OR_DIE(xDimension != CHUNK_WIDTH_X || yDimension != CHUNK_DEPTH_Y || zDimension != CHUNK_HEIGHT_Z, "Chunk Dimensions do not Match!");
-
-	Chunk* loadedChunk = new Chunk(chunkCoords);
-	ASSERT_OR_DIE(loadedChunk != nullptr, "Chunk was null!");
-	loadedChunk->m_northNeighbor = GetChunkAtCoords(chunkCoords + ChunkCoords(0, 1));
-	loadedChunk->m_eastNeighbor = GetChunkAtCoords(chunkCoords + ChunkCoords(1, 0));
-	loadedChunk->m_southNeighbor = GetChunkAtCoords(chunkCoords + ChunkCoords(0, -1));
-	loadedChunk->m_westNeighbor = GetChunkAtCoords(chunkCoords + ChunkCoords(-1, 0));
-
-	if (loadedChunk->m_westNeighbor != nullptr)
-		loadedChunk->m_westNeighbor->m_eastNeighbor = loadedChunk;
-
-	if (loadedChunk->m_eastNeighbor != nullptr)
-		loadedChunk->m_eastNeighbor->m_westNeighbor = loadedChunk;
-
-	if (loadedChunk->m_northNeighbor != nullptr)
-		loadedChunk->m_northNeighbor->m_southNeighbor = loadedChunk;
+	m_activeChunks.Remove(chunkToRemove);
+	RemoveFromEvictionBuckets(currentChunk);
 
-	if (loadedChunk->m_southNeighbor != nullptr)
-		loadedChunk->m_southNeighbor->m_northNeighbor = loadedChunk;
+	// the offsets walk has to come back for it
+	if (IsInActivationRange(chunkToRemove))
+		m_activationCursor = 0;
 
-	loadedChunk->DirtyNeighbors();
+	// nothing can reach it now, so it's written out on a job and deleted back
+	// here [its VBO is GL], and isn't loaded again until the file is done
+	m_savingChunks.Insert(chunkToRemove, currentChunk);
+	++m_numChunkJobsInFlight;
 
-	int blockIndex = 0;
-	Block blockList[NUM_BLOCKS_PER_CHUNK];
-	for ( ;; )
+	Job* saveJob = JobCreate(JOB_GENERIC, [currentChunk]()
 	{
-		unsigned char blockType = outBuffer[0];
-		outBuffer.erase(outBuffer.begin());
-		unsigned char blockTypeCount = outBuffer[1];
-		outBuffer.erase(outBuffer.begin() + 1);
-		unsigned char lightAndFlags = GetLightAndFlagsForBlockType((BlockType)blockType);
-		for (int numBlockTypes = 0; numBlockTypes < (int)blockTypeCount; ++numBlockTypes)
-		{
-			ASSERT_OR_DIE(blockIndex < NUM_BLOCKS_PER_CHUNK, "Too many blocks!");
-			loadedChunk->m_blocks[blockIndex] = Block(blockType, lightAndFlags);
-			++blockIndex;
-		}
-		if (blockIndex >= NUM_BLOCKS_PER_CHUNK)
-			break;
-	}
+		Block* blocks = GetChunkJobBlocks();
+		currentChunk->GetAllBlocks(blocks);
+		SaveChunkBlocksToFile(currentChunk->m_chunkCoords, blocks);
+	});
+	Job* deleteJob = JobCreate(JOB_MAIN, [this, currentChunk]()
+	{
+		OnChunkSaved(currentChunk);
+	});
+	deleteJob->dependent_on(saveJob);
+	JobDispatchAndRelease(saveJob);
+	JobDispatchAndRelease(deleteJob);
+}
 
-	m_activeChunks[chunkCoords] = loadedChunk;
-	//LightingOnChunkActivation(loadedChunk);
+void World::OnChunkSaved(Chunk* savedChunk)
+{
+	--m_numChunkJobsInFlight;
+	m_savingChunks.Remove(savedChunk->m_chunkCoords);
+	delete savedChunk;
 }
 
 void World::PlayerDigOrPlaceBlock()
@@ -470,7 +646,7 @@ void World::PlayerDigOrPlaceBlock()
 
 	for (int step = 0; step < Num_Steps; step++)
 	{
-		if(m_activeChunks.size() != 0)
+		if(m_activeChunks.GetCount() != 0)
 		{
 			currentWorldPos = g_theGame->m_camera.m_position + (singleStep * (float)step);
 			BlockInfo currentBlockInfo = GetBlockInfoAtWorldPosition(currentWorldPos);
@@ -479,7 +655,7 @@ void World::PlayerDigOrPlaceBlock()
 			
 			if(currentChunk != nullptr)
 			{
-				Block& currentBlock = currentChunk->m_blocks[blockIndex];
+				const Block& currentBlock = currentChunk->GetBlock(blockIndex);
 				BlockType currentBlockType = BlockDefinition(currentBlock.m_blockTypeIndex).m_blockType;
 
 				if (currentBlockType == AIR || currentBlockType == WATER)
@@ -527,13 +703,12 @@ void World::PlayerDigOrPlaceBlock()
 
 				if (g_playerPlacedBlock)
 				{
-					currentChunk->m_isVertexArrayDirty = true;
-					Block* blockToBeReplaced = blockToReplace.GetBlockPointer();
-
-					if (g_theGame->m_player->m_blockList[g_selectedBlockIndex].m_blockTypeIndex != BlockType::HOOKSHOT)
-						*blockToBeReplaced = g_theGame->m_player->m_blockList[g_selectedBlockIndex];
+					const Block& blockToPlace = g_theGame->m_player->m_blockList[g_selectedBlockIndex];
+					if (blockToPlace.m_blockTypeIndex != BlockType::HOOKSHOT && blockToReplace.m_chunk != nullptr)
+						blockToReplace.m_chunk->SetBlock(blockToReplace.m_blockIndex, blockToPlace);
 					
-					blockToReplace.SetAllNeighborsDirtyFlagAsTrue();
+					// lighting is off, and flagging the neighbors would give uniform sections their own blocks
+					//blockToReplace.SetAllNeighborsDirtyFlagAsTrue();
 					g_playerPlacedBlock = false;
 				}
 
@@ -544,10 +719,8 @@ void World::PlayerDigOrPlaceBlock()
 						return;
 					}
 
-					currentChunk->m_isVertexArrayDirty = true;
-					currentChunk->DirtyNeighbors();
-					currentBlock = Block(AIR, 0b01000000);
-					currentBlockInfo.SetAllNeighborsDirtyFlagAsTrue();
+					currentChunk->SetBlock(blockIndex, Block(AIR, 0b01000000));
+					//currentBlockInfo.SetAllNeighborsDirtyFlagAsTrue();
 					g_playerDestroyedBlock = false;
 				}
 			}
@@ -583,7 +756,7 @@ void World::FireHookShot()
 
 	for (int step = 0; step < Num_Steps; step++)
 	{
-		if (m_activeChunks.size() != 0)
+		if (m_activeChunks.GetCount() != 0)
 		{
 			currentWorldPos = g_theGame->m_player->m_position + (singleStep * (float)step);
 			currentBlockInfo = GetBlockInfoAtWorldPosition(currentWorldPos);
@@ -604,12 +777,7 @@ void World::FireHookShot()
 
 Chunk* World::GetChunkAtCoords(const ChunkCoords& chunkCoords)
 {
-	std::map<ChunkCoords, Chunk*>::iterator iterate = m_activeChunks.find(chunkCoords);
-	if (iterate != m_activeChunks.end())
-	{
-		return iterate->second;
-	}
-	return nullptr;
+	return m_activeChunks.Find(chunkCoords);
 }
 
 void World::UpdateLighting()
@@ -742,17 +910,42 @@ void World::LightingOnChunkActivation(Chunk* chunkActivated)
 
 void World::InitializeLightForAllBlocks(Chunk* chunkActivated)
 {
-	for (int blockIndex = 0; blockIndex < NUM_BLOCKS_PER_CHUNK; ++blockIndex)
+	for (int sectionIndex = 0; sectionIndex < NUM_CHUNK_SECTIONS; ++sectionIndex)
 	{
-		BlockInfo currentBlock(chunkActivated, blockIndex);
-		currentBlock.SetLightValueForBlock((unsigned char)0);
+		// SetLightValueForBlock only ORs light in, so 0 leaves a uniform section as
+		// it is - skipped rather than giving it its own blocks
+		ChunkSection& section = chunkActivated->m_sections[sectionIndex];
+		if (section.m_blocks == nullptr)
+			continue;
+
+		int firstBlockIndex = sectionIndex << SECTION_BITS;
+		for (int blockIndex = firstBlockIndex; blockIndex < firstBlockIndex + BLOCKS_PER_SECTION; ++blockIndex)
+		{
+			BlockInfo currentBlock(chunkActivated, blockIndex);
+			currentBlock.SetLightValueForBlock((unsigned char)0);
+		}
 	}
 }
 
 void World::DescendColumnAndMarkSky(Chunk* chunkActivated)
 {
-	int startingZIndex = NUM_BLOCKS_PER_CHUNK - BLOCKS_PER_LAYER;
-	for (int columnIndex = startingZIndex; columnIndex < NUM_BLOCKS_PER_CHUNK; ++columnIndex)
+	// every column runs straight through the uniform see-through sections at the
+	// top, so they're marked whole and the columns start below them
+	int sectionIndex = NUM_CHUNK_SECTIONS - 1;
+	for (; sectionIndex >= 0; --sectionIndex)
+	{
+		ChunkSection& section = chunkActivated->m_sections[sectionIndex];
+		if (section.m_blocks != nullptr || (section.m_uniformBlock.m_lightAndFlags & BLOCK_OPAQUE_MASK) == BLOCK_OPAQUE_MASK)
+			break;
+
+		section.m_uniformBlock.m_lightAndFlags |= BLOCK_SKY_MASK;
+		section.m_uniformBlock.m_lightAndFlags |= (unsigned char)SKY_LIGHT & BLOCK_LIGHT_MASK;
+	}
+	if (sectionIndex < 0)
+		return;
+
+	int startingZIndex = ((sectionIndex + 1) << SECTION_BITS) - BLOCKS_PER_LAYER;
+	for (int columnIndex = startingZIndex; columnIndex < startingZIndex + BLOCKS_PER_LAYER; ++columnIndex)
 	{
 		int blockIndex = columnIndex;
 		for (;;)
@@ -826,9 +1019,12 @@ void World::DirtySelfIlluminateBlocks(Chunk* chunkActivated)
 
 void World::AddAnyDirtyBlocksToQueue()
 {
-	for (std::map<ChunkCoords, Chunk*>::const_iterator iterate = m_activeChunks.begin(); iterate != m_activeChunks.end(); ++iterate)
+	for (int slot = 0; slot < m_activeChunks.GetSlotCount(); ++slot)
 	{
-		Chunk* chunk = iterate->second;
+		Chunk* chunk = m_activeChunks.GetChunkInSlot(slot);
+		if (chunk == nullptr)
+			continue;
+
 		for (int blockIndex = 0; blockIndex < NUM_BLOCKS_PER_CHUNK; ++blockIndex)
 		{
 			BlockInfo currentBlock(chunk, blockIndex);
@@ -1666,7 +1862,7 @@ float World::RaycastDistanceCanTravel(const Vector3& startingPosition, const Vec
 
 	for (int step = 0; step < Num_Steps; step++)
 	{
-		if (m_activeChunks.size() != 0)
+		if (m_activeChunks.GetCount() != 0)
 		{
 			currentWorldPos = g_theGame->m_camera.m_position + (singleStep * (float)step);
 			BlockInfo currentBlockInfo = GetBlockInfoAtWorldPosition(currentWorldPos);
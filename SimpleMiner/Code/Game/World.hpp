@@ -1,9 +1,10 @@
 #pragma once
 #include "Game/GameCommons.hpp"
 #include "Game/Chunk.hpp"
+#include "Game/ChunkTable.hpp"
 #include "Game/BlockInfo.hpp"
 #include "Engine/Math/Vector3.hpp"
-#include <map>
+#include <vector>
 #include <stdio.h>
 #include <deque>
 
@@ -11,10 +12,30 @@ const int DAY_LIGHT = MAX_LEVEL;
 const int MOON_LIGHT = 6;
 const int SKY_LIGHT = MOON_LIGHT;
 
+// Chunks are loaded or generated, meshed and saved on jobs.  The main thread only
+// links finished chunks into the world and uploads finished meshes, on JOB_MAIN,
+// for this long a frame.
+const unsigned int CHUNK_MAIN_THREAD_BUDGET_MS = 2;
+const int CHUNK_REQUESTS_PER_WORKER = 2;		// chunks being generated at once, per core
+
+// Active chunks are bucketed by whole chunks of distance from the player's chunk,
+// so the farthest is always in the last non-empty bucket.  Anything farther than
+// the last bucket shares it.
+const int NUM_EVICTION_BUCKETS = 64;
+
 class World
 {
 public:
-	std::map<ChunkCoords, Chunk*> m_activeChunks;
+	ChunkTable m_activeChunks;
+	ChunkTable m_pendingChunks;			// requested or generating, not linked in yet
+	ChunkTable m_savingChunks;			// deactivated, file not written yet
+	int m_numChunkJobsInFlight;
+	ChunkCoords m_playerChunkCoords;
+	bool m_hasPlayerChunkCoords;
+	std::vector<ChunkCoords> m_activationOffsets;		// every offset in range of the player's chunk, nearest first
+	int m_activationCursor;								// offsets before this are all active or pending
+	int m_activationRangeSquared;						// in chunks
+	std::vector<Chunk*> m_evictionBuckets[NUM_EVICTION_BUCKETS];
 	std::deque<BlockInfo> m_dirtyLightBlocksQueue;
 
 	World();
@@ -26,16 +47,27 @@ public:
 	void Render() const;
 	void RenderActiveChunks() const;
 	bool IsChunkInFrustum(const Chunk* chunk) const;
-	Chunk* CreateChunk(const ChunkCoords& newPosition);
-	bool ActivateNearestMissingChunk( const Vector3& playerPosition);
-	bool DeactivateFarthestChunk(const Vector3& playerPosition);
+	void UpdatePlayerChunkCoords(const Vector3& playerPosition);
+	bool ActivateNearestMissingChunk();
+	bool DeactivateFarthestChunk();
+	bool IsInActivationRange(const ChunkCoords& chunkCoords) const;
+	int GetEvictionBucket(const ChunkCoords& chunkCoords) const;
+	void AddToEvictionBuckets(Chunk* chunk);
+	void RemoveFromEvictionBuckets(Chunk* chunk);
+	void RequestChunk(const ChunkCoords& chunkCoords);
+	void LinkReadyChunk(Chunk* readyChunk);
+	void DispatchMeshJob(Chunk* chunk);
+	void OnMeshJobFinished(Chunk* chunk);
+	bool CanMeshChunk(const Chunk* chunk) const;
+	void OnChunkSaved(Chunk* savedChunk);
+	bool CanRemoveChunk(const Chunk* chunk) const;
+	void FinishChunkJobs();
 	ChunkCoords ConvertWorldPositionToChunkPosition(const Vector3& worldPosition);
 	Vector3 ConvertChunkPositionToWorldPosition( const ChunkCoords& chunkPosition);
 	BlockInfo GetBlockInfoAtWorldPosition(const Vector3& worldPosition);
 	bool AreLocalCoordsUnreasonable(IntVector3& localPos);
 	int GetNumberOfActiveChunks();
 	void RemoveChunkAtCoords(const ChunkCoords& chunkToRemove);
-	void LoadChunkAsActive(std::vector<unsigned char>& outBuffer, const ChunkCoords& chunkCoords);
 	void PlayerDigOrPlaceBlock();
 	void PullPlayerTowardHookShot(float deltaSeconds);
 	void FireHookShot();